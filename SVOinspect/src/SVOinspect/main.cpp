@@ -0,0 +1,348 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+// Offline inspection of SVO dumps (written with the 'P'-key in
+// VoxelConeTracing, see SVOdump). Reports node occupancy per level, tile fill
+// ratios, neighbour-pointer coverage, brick utilization and the memory per
+// attribute as JSON on stdout. Needs no GPU.
+//
+// Usage: SVOinspect <dumpfile>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "VoxelConeTracing/Util/SVOdumpFormat.h"
+
+typedef unsigned int uint;
+
+struct SPool {
+  SSVOdumpPool info;
+  std::vector<uint> data;
+};
+
+struct SDump {
+  SSVOdumpHeader header;
+  std::vector<uint> levelAddresses;
+  std::vector<SPool> nodeAttributes;
+  std::vector<SPool> brickAttributes;
+};
+
+static bool readDump(const char* file, SDump& dump) {
+  FILE* f = fopen(file, "rb");
+  if (!f) {
+    fprintf(stderr, "Could not open %s\n", file);
+    return false;
+  }
+
+  bool ok = fread(&dump.header, sizeof(SSVOdumpHeader), 1, f) == 1;
+  if (!ok || dump.header.magic != SVODUMP_MAGIC ||
+      dump.header.version != SVODUMP_VERSION) {
+    fprintf(stderr, "%s is not a supported SVO dump\n", file);
+    fclose(f);
+    return false;
+  }
+
+  const SSVOdumpHeader& h = dump.header;
+  dump.levelAddresses.resize(h.numLevels);
+  ok = h.numLevels == 0 ||
+       fread(&dump.levelAddresses[0], sizeof(uint), h.numLevels, f)
+         == h.numLevels;
+
+  dump.nodeAttributes.resize(h.numNodeAttributes);
+  for (uint i = 0; ok && i < h.numNodeAttributes; ++i) {
+    SPool& pool = dump.nodeAttributes[i];
+    ok = fread(&pool.info, sizeof(SSVOdumpPool), 1, f) == 1;
+    if (ok && pool.info.hasData && h.numAllocatedNodes > 0) {
+      pool.data.resize(h.numAllocatedNodes);
+      ok = fread(&pool.data[0], sizeof(uint), h.numAllocatedNodes, f)
+             == h.numAllocatedNodes;
+    }
+  }
+
+  dump.brickAttributes.resize(h.numBrickAttributes);
+  for (uint i = 0; ok && i < h.numBrickAttributes; ++i) {
+    SPool& pool = dump.brickAttributes[i];
+    ok = fread(&pool.info, sizeof(SSVOdumpPool), 1, f) == 1;
+    uint numTexels =
+      pool.info.resolution * pool.info.resolution * pool.info.resolution;
+    if (ok && pool.info.hasData && numTexels > 0) {
+      pool.data.resize(numTexels);
+      ok = fread(&pool.data[0], sizeof(uint), numTexels, f) == numTexels;
+    }
+    pool.info.name[SVODUMP_NAME_LENGTH - 1] = '\0';
+  }
+
+  fclose(f);
+  if (!ok) {
+    fprintf(stderr, "%s is truncated\n", file);
+  }
+  return ok;
+}
+
+static const SPool* findPool(const std::vector<SPool>& pools,
+                             const char* name) {
+  for (uint i = 0; i < pools.size(); ++i) {
+    if (strncmp(pools[i].info.name, name, SVODUMP_NAME_LENGTH) == 0) {
+      return &pools[i];
+    }
+  }
+  return NULL;
+}
+
+static uint minU(uint a, uint b) {
+  return a < b ? a : b;
+}
+
+static double ratio(double part, double total) {
+  return total > 0.0 ? part / total : 0.0;
+}
+
+// A brick is empty if all of its 27 texels are completely transparent.
+// (bx, by, bz) is its first texel.
+static bool isBrickEmpty(const SPool& color, uint res,
+                         uint bx, uint by, uint bz) {
+  for (uint z = 0; z < 3; ++z) {
+    for (uint y = 0; y < 3; ++y) {
+      for (uint x = 0; x < 3; ++x) {
+        uint texel = color.data[(bx + x) + (by + y) * res
+                                + (bz + z) * res * res];
+        if ((texel >> 24) != 0) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// Leaf nodes are never subdivided, they are occupied if they got a brick
+// with voxel data. Without the brick data, the brick flag is used alone.
+static bool isLeafOccupied(const SDump& dump, const SPool* nodeColor,
+                           const SPool* brickColor, uint node, uint next) {
+  if ((next & SVODUMP_NODE_MASK_BRICK) == 0) {
+    return false;
+  }
+  if (!nodeColor || !brickColor) {
+    return true;
+  }
+
+  // Brick address as vec3ToUintXYZ10() in _utilityFunctions.shader
+  uint res = dump.header.brickPoolResolution;
+  uint brick = nodeColor->data[node];
+  uint bx = brick & 0x3FF;
+  uint by = (brick >> 10) & 0x3FF;
+  uint bz = (brick >> 20) & 0x3FF;
+  if (bx + 3 > res || by + 3 > res || bz + 3 > res) {
+    return false;
+  }
+  return !isBrickEmpty(*brickColor, res, bx, by, bz);
+}
+
+static void reportLevels(const SDump& dump) {
+  const SSVOdumpHeader& h = dump.header;
+  const SPool* next = findPool(dump.nodeAttributes, "next");
+  const SPool* nodeColor = findPool(dump.nodeAttributes, "color");
+  const SPool* brickColor = findPool(dump.brickAttributes, "color");
+  if (nodeColor && nodeColor->data.empty()) {
+    nodeColor = NULL;
+  }
+  if (brickColor && brickColor->data.empty()) {
+    brickColor = NULL;
+  }
+
+  static const char* neighbourNames[] = {
+    "neighbour_x", "neighbour_neg_x", "neighbour_y",
+    "neighbour_neg_y", "neighbour_z", "neighbour_neg_z"
+  };
+
+  printf("  \"levels\": [\n");
+  for (uint level = 0; level < h.numLevels; ++level) {
+    // Levels are stored consecutively, starting at their level address.
+    // Unallocated levels keep the initial address 0xFFFFFFFF.
+    uint start = minU(dump.levelAddresses[level], h.numAllocatedNodes);
+    uint end = h.numAllocatedNodes;
+    if (level + 1 < h.numLevels) {
+      end = minU(dump.levelAddresses[level + 1], h.numAllocatedNodes);
+    }
+    if (end < start) {
+      end = start;
+    }
+
+    // An inner node is occupied if it is subdivided or was flagged for
+    // subdivision, a leaf node if it holds voxel data
+    bool leafLevel = level + 1 == h.numLevels;
+    uint numOccupied = 0;
+    uint tileHistogram[9] = {0};
+    uint numTiles = 0;
+    for (uint tile = start; next && tile < end; tile += 8) {
+      uint occupied = 0;
+      uint tileEnd = minU(tile + 8, end);
+      for (uint node = tile; node < tileEnd; ++node) {
+        uint value = next->data[node];
+        if (leafLevel) {
+          if (isLeafOccupied(dump, nodeColor, brickColor, node, value)) {
+            ++occupied;
+          }
+        } else if ((value & SVODUMP_NODE_MASK_VALUE) != 0 ||
+                   (value & SVODUMP_NODE_MASK_TAG) != 0) {
+          ++occupied;
+        }
+      }
+      numOccupied += occupied;
+      ++tileHistogram[occupied];
+      ++numTiles;
+    }
+
+    uint numNodes = end - start;
+    printf("    {\"level\": %u, \"nodes\": %u, \"occupiedNodes\": %u, "
+           "\"tiles\": %u, \"tileFillRatio\": %.4f,\n",
+           level, numNodes, numOccupied, numTiles,
+           ratio(numOccupied, numNodes));
+
+    printf("     \"tileFillHistogram\": [");
+    for (uint i = 0; i < 9; ++i) {
+      printf(i == 0 ? "%u" : ", %u", tileHistogram[i]);
+    }
+    printf("],\n");
+
+    printf("     \"neighbourCoverage\": {");
+    for (uint i = 0; i < 6; ++i) {
+      const SPool* neighbours = findPool(dump.nodeAttributes, neighbourNames[i]);
+      uint numSet = 0;
+      for (uint node = start; neighbours && node < end; ++node) {
+        if (neighbours->data[node] != 0) {
+          ++numSet;
+        }
+      }
+      printf("%s\"%s\": %.4f", i == 0 ? "" : ", ",
+             neighbourNames[i] + strlen("neighbour_"), ratio(numSet, numNodes));
+    }
+    printf("}}%s\n", level + 1 < h.numLevels ? "," : "");
+  }
+  printf("  ],\n");
+}
+
+static void reportBricks(const SDump& dump) {
+  const SSVOdumpHeader& h = dump.header;
+  const SPool* color = findPool(dump.brickAttributes, "color");
+
+  uint bricksPerAxis = h.brickPoolResolution / 3;
+  uint capacity = bricksPerAxis * bricksPerAxis * bricksPerAxis;
+  uint numAllocated = minU(h.numAllocatedBricks, capacity);
+
+  // Empty bricks are completely transparent, constant bricks hold the same
+  // value in all 27 texels and could be stored in the node instead.
+  uint numEmpty = 0;
+  uint numConstant = 0;
+  uint res = h.brickPoolResolution;
+  for (uint brick = 0; color && brick < numAllocated; ++brick) {
+    // Same addressing as in AllocBricks.shader
+    uint bx = (brick % bricksPerAxis) * 3;
+    uint by = ((brick / bricksPerAxis) % bricksPerAxis) * 3;
+    uint bz = (brick / (bricksPerAxis * bricksPerAxis)) * 3;
+
+    uint first = color->data[bx + by * res + bz * res * res];
+    bool constant = true;
+    for (uint z = 0; z < 3; ++z) {
+      for (uint y = 0; y < 3; ++y) {
+        for (uint x = 0; x < 3; ++x) {
+          uint texel = color->data[(bx + x) + (by + y) * res
+                                   + (bz + z) * res * res];
+          constant = constant && texel == first;
+        }
+      }
+    }
+
+    if (isBrickEmpty(*color, res, bx, by, bz)) {
+      ++numEmpty;
+    } else if (constant) {
+      ++numConstant;
+    }
+  }
+
+  printf("  \"bricks\": {\"capacity\": %u, \"allocated\": %u, \"unused\": %u, "
+         "\"utilization\": %.4f, \"overflowed\": %s,\n",
+         capacity, h.numAllocatedBricks, capacity - numAllocated,
+         ratio(numAllocated, capacity),
+         h.numAllocatedBricks > capacity ? "true" : "false");
+  if (color) {
+    printf("             \"empty\": %u, \"constant\": %u},\n",
+           numEmpty, numConstant);
+  } else {
+    printf("             \"empty\": null, \"constant\": null},\n");
+  }
+}
+
+static void reportAttributes(const SDump& dump) {
+  const SSVOdumpHeader& h = dump.header;
+  unsigned long long totalBytes = 0;
+
+  printf("  \"attributes\": [\n");
+  for (uint i = 0; i < dump.nodeAttributes.size(); ++i) {
+    const SSVOdumpPool& info = dump.nodeAttributes[i].info;
+    printf("    {\"pool\": \"node\", \"name\": \"%s\", \"bytes\": %u, "
+           "\"usedBytes\": %u},\n", info.name, info.byteSize,
+           h.numAllocatedNodes * (uint) sizeof(uint));
+    totalBytes += info.byteSize;
+  }
+
+  for (uint i = 0; i < dump.brickAttributes.size(); ++i) {
+    const SSVOdumpPool& info = dump.brickAttributes[i].info;
+    printf("    {\"pool\": \"brick\", \"name\": \"%s\", \"resolution\": %u, "
+           "\"bytes\": %u}%s\n", info.name, info.resolution, info.byteSize,
+           i + 1 < dump.brickAttributes.size() ? "," : "");
+    totalBytes += info.byteSize;
+  }
+  printf("  ],\n");
+  printf("  \"totalBytes\": %llu\n", totalBytes);
+}
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: SVOinspect <dumpfile>\n");
+    return EXIT_FAILURE;
+  }
+
+  SDump dump;
+  if (!readDump(argv[1], dump)) {
+    return EXIT_FAILURE;
+  }
+
+  const SSVOdumpHeader& h = dump.header;
+  printf("{\n");
+  printf("  \"numLevels\": %u,\n", h.numLevels);
+  printf("  \"nodePool\": {\"capacity\": %u, \"allocated\": %u, "
+         "\"utilization\": %.4f},\n", h.numNodes, h.numAllocatedNodes,
+         ratio(h.numAllocatedNodes, h.numNodes));
+  reportLevels(dump);
+  reportBricks(dump);
+  reportAttributes(dump);
+  printf("}\n");
+
+  return EXIT_SUCCESS;
+}
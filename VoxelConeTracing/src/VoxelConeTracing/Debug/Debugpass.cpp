@@ -41,6 +41,11 @@
 #include "KoRE/Operations/ResetAtomicCounterBuffer.h"
 #include "KoRE/Operations/MemoryBarrierOp.h"
 #include "KoRE/Operations/BindOperations/BindUniform.h"
+#include "VoxelConeTracing/Util/GPUreadback.h"
+#include "VoxelConeTracing/Util/AsyncLog.h"
+
+using std::placeholders::_1;
+using std::placeholders::_2;
 
 DebugPass::~DebugPass(void) {
 }
@@ -99,95 +104,63 @@ void DebugPass::debugCleanup()
 }
 
 
+// Callbacks of the readbacks below
+static void logCounter(const char* label, const uint* values,
+                       uint /*numValues*/) {
+  AsyncLog::getInstance()->write("%s: %u \n", label, values[0]);
+}
+
+static void logValues(const char* label, const uint* values, uint numValues) {
+  AsyncLog::getInstance()->writeValues(label, values, numValues);
+}
+
 void DebugPass::debugNextFreeAC() {
-  _renderMgr->bindBufferBase(GL_ATOMIC_COUNTER_BUFFER,
-    0,
-    _vctScene->getNodePool()->getAcNodePoolNextFree()->getHandle());
-
-  GLuint* ptr = (GLuint*)glMapBufferRange(GL_ATOMIC_COUNTER_BUFFER, 0,
-    sizeof(GLuint),
-    GL_MAP_READ_BIT);
-  kore::Log::getInstance()->write("Next free nodepool address: %i \n", *ptr);
-  glUnmapBuffer(GL_ATOMIC_COUNTER_BUFFER);
+  GPUreadback::getInstance()->request(
+    _vctScene->getNodePool()->getAcNodePoolNextFree()->getHandle(), 0, 1,
+    std::bind(&logCounter, "Next free nodepool address", _1, _2));
 }
 
 void DebugPass::debugVoxelIndexAC() {
-  _renderMgr->bindBufferBase(GL_ATOMIC_COUNTER_BUFFER,
-                             0,
-                             _vctScene->getAcVoxelIndex()->getHandle());
-
-  GLuint* ptr = (GLuint*)glMapBufferRange(GL_ATOMIC_COUNTER_BUFFER, 0,
-                                        sizeof(GLuint),
-                                        GL_MAP_READ_BIT);
-  kore::Log::getInstance()->write("Number of voxels: %i \n", *ptr);
-  glUnmapBuffer(GL_ATOMIC_COUNTER_BUFFER);
+  GPUreadback::getInstance()->request(
+    _vctScene->getAcVoxelIndex()->getHandle(), 0, 1,
+    std::bind(&logCounter, "Number of voxels", _1, _2));
 }
 
 void DebugPass::debugBrickAc() {
-  _renderMgr->bindBufferBase(GL_ATOMIC_COUNTER_BUFFER,
-                             0, _vctScene->getBrickPool()->getAcNextFree()->getHandle());
-
-  GLuint* ptr = (GLuint*)glMapBufferRange(GL_ATOMIC_COUNTER_BUFFER, 0,
-                                          sizeof(GLuint),
-                                          GL_MAP_READ_BIT);
-  kore::Log::getInstance()->write("Number of bricks: %i \n", *ptr);
-  glUnmapBuffer(GL_ATOMIC_COUNTER_BUFFER);
+  GPUreadback::getInstance()->request(
+    _vctScene->getBrickPool()->getAcNextFree()->getHandle(), 0, 1,
+    std::bind(&logCounter, "Number of bricks", _1, _2));
 }
 
 void DebugPass::debugVoxelFragmentList() {
-  uint byteSize =
-    _vctScene->getVoxelFragList()->getVoxelFragList()->getProperties().size;
-    
-  _renderMgr->bindBuffer(GL_TEXTURE_BUFFER, _vctScene->getVoxelFragList()->getVoxelFragList()->getBufferHandle());
-
-  const GLuint* ptr = (const GLuint*) glMapBuffer(GL_TEXTURE_BUFFER, GL_READ_ONLY);
+  kore::TextureBuffer* fragList =
+    _vctScene->getVoxelFragList()->getVoxelFragList();
 
-  uint numEntries = byteSize / sizeof(uint);
-  kore::Log::getInstance()->write("\nVoxelFragmentList Position-contents (%i voxels):", numEntries);
-  for (uint i = 0; i < numEntries; ++i) {
-    kore::Log::getInstance()->write("%u ", ptr[i]);
-  }
-
-  glUnmapBuffer(GL_TEXTURE_BUFFER);
+  GPUreadback::getInstance()->request(fragList->getBufferHandle(), 0,
+    fragList->getProperties().size / sizeof(uint),
+    std::bind(&logValues, "VoxelFragmentList Position-contents", _1, _2));
 }
 
 void DebugPass::debugIndirectCmdBuff(){
-  
-  _renderMgr->bindBuffer(GL_TEXTURE_BUFFER, _vctScene->getVoxelFragList()->getFragListIndCmdBuf()->getBufferHandle());
-
-  const GLuint* ptr = (const GLuint*) glMapBuffer(GL_TEXTURE_BUFFER, GL_READ_ONLY);
-  kore::Log::getInstance()->write("VoxelFragList indirectCmdBuf contents:\n");
-   for (uint i = 0; i < 4; ++i) {
-    kore::Log::getInstance()->write("%u ", ptr[i]);
-  }
-   kore::Log::getInstance()->write("\n");
-
-  glUnmapBuffer(GL_TEXTURE_BUFFER);
+  GPUreadback::getInstance()->request(
+    _vctScene->getVoxelFragList()->getFragListIndCmdBuf()->getBufferHandle(),
+    0, 4, std::bind(&logValues, "VoxelFragList indirectCmdBuf contents",
+                    _1, _2));
 }
 
 
 void DebugPass::debugLevelAddressBuf(){
-  _renderMgr->bindBuffer(GL_TEXTURE_BUFFER, _vctScene->getNodePool()->getLevelAddressBuffer()->getBufferHandle());
-
-  const GLuint* ptr = (const GLuint*) glMapBuffer(GL_TEXTURE_BUFFER, GL_READ_ONLY);
-  kore::Log::getInstance()->write("LevelAddressBuffer contents:\n");
-  for (uint i = 0; i < _vctScene->getNodePool()->getNumLevels(); ++i) {
-    kore::Log::getInstance()->write("%u\n", ptr[i]);
-  }
-  kore::Log::getInstance()->write("\n");
-
-  glUnmapBuffer(GL_TEXTURE_BUFFER);
+  GPUreadback::getInstance()->request(
+    _vctScene->getNodePool()->getLevelAddressBuffer()->getBufferHandle(),
+    0, _vctScene->getNodePool()->getNumLevels(),
+    std::bind(&logValues, "LevelAddressBuffer contents", _1, _2));
 }
 
 void DebugPass::debugNodePool() {
-  _renderMgr->bindBuffer(GL_TEXTURE_BUFFER, _vctScene->getNodePool()->getNodePool(NEXT)->getBufferHandle());
-  const uint* nodePtr = (const uint*) glMapBuffer(GL_TEXTURE_BUFFER, GL_READ_ONLY);
-  kore::Log::getInstance()->write("NodePool contents:\n");
-  for (uint i = 0; i < _vctScene->getNodePool()->getNumNodes(); ++i) {
-    kore::Log::getInstance()->write("%u: %u\n", i, nodePtr[i]);
-  }
-  kore::Log::getInstance()->write("\n");
-  glUnmapBuffer(GL_TEXTURE_BUFFER);
+  GPUreadback::getInstance()->request(
+    _vctScene->getNodePool()->getNodePool(NEXT)->getBufferHandle(), 0,
+    _vctScene->getNodePool()->getNumNodes(),
+    std::bind(&logValues, "NodePool contents", _1, _2));
 
 
   //const uint NODE_MASK_VALUE = 0x3FFFFFFF;
@@ -231,10 +204,10 @@ void DebugPass::debugNodePool() {
 
 void printNode(uint address, uint flagged, uint next, bool useAddress) {
   if (useAddress) {
-    kore::Log::getInstance()->write("%u: %u", address, next);
+    AsyncLog::getInstance()->write("%u: %u", address, next);
   } else 
   {
-    kore::Log::getInstance()->write("%u ", next);
+    AsyncLog::getInstance()->write("%u ", next);
   }
 }
 
@@ -244,7 +217,7 @@ void printTabsForLevel(uint level, uint maxlevel) {
 
   uint numTabbs = numNodes / 8;
   for(uint uTab = 0; uTab < numTabbs; ++uTab) {
-    kore::Log::getInstance()->write("       ");
+    AsyncLog::getInstance()->write("       ");
   }
 }
 
@@ -280,31 +253,34 @@ void traverseOctree(const uint* root, const uint* parent, uint level, uint maxLe
 
   // Print additional offset between bricks
   if (level + 1 == maxLevel) {
-     kore::Log::getInstance()->write("\t\t");
+     AsyncLog::getInstance()->write("\t\t");
   }
 }
 
-void DebugPass::debugNodePool_Octree() {
-  _renderMgr->bindBuffer(GL_TEXTURE_BUFFER, _vctScene->getNodePool()->getNodePool(NEXT)->getBufferHandle());
-
-  const uint* nodePtr = (const uint*) glMapBuffer(GL_TEXTURE_BUFFER, GL_READ_ONLY);
-  kore::Log::getInstance()->write("NodePool contents:\n");
+static void logOctree(uint numLevels, const uint* nodePtr, uint /*numValues*/) {
+  AsyncLog::getInstance()->write("NodePool contents:\n");
 
-  for (uint iLevel = 0; iLevel < _vctScene->getNodePool()->getNumLevels(); ++iLevel) {
-    printTabsForLevel(iLevel, _vctScene->getNodePool()->getNumLevels() - 1);
+  for (uint iLevel = 0; iLevel < numLevels; ++iLevel) {
+    printTabsForLevel(iLevel, numLevels - 1);
     traverseOctree(nodePtr, nodePtr, 0, iLevel);
-    kore::Log::getInstance()->write("\n");
-    kore::Log::getInstance()->write("\n");
-    kore::Log::getInstance()->write("\n");
-    kore::Log::getInstance()->write("\n");
-    kore::Log::getInstance()->write("\n");
-    kore::Log::getInstance()->write("\n");
-    kore::Log::getInstance()->write("\n");
-    kore::Log::getInstance()->write("\n");
+    AsyncLog::getInstance()->write("\n");
+    AsyncLog::getInstance()->write("\n");
+    AsyncLog::getInstance()->write("\n");
+    AsyncLog::getInstance()->write("\n");
+    AsyncLog::getInstance()->write("\n");
+    AsyncLog::getInstance()->write("\n");
+    AsyncLog::getInstance()->write("\n");
+    AsyncLog::getInstance()->write("\n");
   }
 
-  kore::Log::getInstance()->write("\n");
-  glUnmapBuffer(GL_TEXTURE_BUFFER);
+  AsyncLog::getInstance()->write("\n");
+}
+
+void DebugPass::debugNodePool_Octree() {
+  GPUreadback::getInstance()->request(
+    _vctScene->getNodePool()->getNodePool(NEXT)->getBufferHandle(), 0,
+    _vctScene->getNodePool()->getNumNodes(),
+    std::bind(&logOctree, _vctScene->getNodePool()->getNumLevels(), _1, _2));
 }
 
 glm::uvec3 uintXYZ10ToVec3(uint val) {
@@ -313,15 +289,19 @@ glm::uvec3 uintXYZ10ToVec3(uint val) {
                     uint((val & 0x3FF00000) >> 20U));
 }
 
-void DebugPass::debugColorNodePool() {
-  _renderMgr->bindBuffer(GL_TEXTURE_BUFFER, _vctScene->getNodePool()->getNodePool(COLOR)->getBufferHandle());
-  const uint* nodePtr = (const uint*) glMapBuffer(GL_TEXTURE_BUFFER, GL_READ_ONLY);
-  kore::Log::getInstance()->write("\n");
-  for (uint i = 0; i < _vctScene->getNodePool()->getNumNodes(); ++i) {
-      kore::Log::getInstance()->write("brick pointer %u: x:%u y:%u z:%u\n", i, uintXYZ10ToVec3(nodePtr[i]).x,uintXYZ10ToVec3(nodePtr[i]).y,uintXYZ10ToVec3(nodePtr[i]).z);
+static void logBrickPointers(const uint* nodePtr, uint numValues) {
+  AsyncLog::getInstance()->write("\n");
+  for (uint i = 0; i < numValues; ++i) {
+      AsyncLog::getInstance()->write("brick pointer %u: x:%u y:%u z:%u\n", i, uintXYZ10ToVec3(nodePtr[i]).x,uintXYZ10ToVec3(nodePtr[i]).y,uintXYZ10ToVec3(nodePtr[i]).z);
   }
-  kore::Log::getInstance()->write("\n");
-  glUnmapBuffer(GL_TEXTURE_BUFFER);
+  AsyncLog::getInstance()->write("\n");
+}
+
+void DebugPass::debugColorNodePool() {
+  GPUreadback::getInstance()->request(
+    _vctScene->getNodePool()->getNodePool(COLOR)->getBufferHandle(), 0,
+    _vctScene->getNodePool()->getNumNodes(),
+    std::bind(&logBrickPointers, _1, _2));
 }
 
 
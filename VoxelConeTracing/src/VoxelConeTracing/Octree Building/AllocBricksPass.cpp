@@ -30,6 +30,8 @@
 #include "KoRE\ResourceManager.h"
 
 #include "Kore\Operations\Operations.h"
+#include "VoxelConeTracing/Util/ShaderProgramCache.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
 
 AllocBricksPass::~AllocBricksPass(void) {
 }
@@ -39,7 +41,8 @@ AllocBricksPass::AllocBricksPass(VCTscene* vctScene,
   using namespace kore;
 
   _name = "Alloc Bricks";
-  _useGPUProfiling = vctScene->getUseGPUprofiling();
+  GPUprofiler::getInstance()->addPass(this);
+  bool useCompute = vctScene->getUseComputeShaders();
 
   this->setExecutionType(executionType);
   
@@ -48,36 +51,41 @@ AllocBricksPass::AllocBricksPass(VCTscene* vctScene,
   _sceneMgr = SceneManager::getInstance();
   _resMgr = ResourceManager::getInstance();
   
-  _shader.loadShader("./assets/shader/AllocBricks.shader",
-                 GL_VERTEX_SHADER);
-
-  _shader.setName("Allocate Bricks shader");
-  _shader.init();
-  this->setShaderProgram(&_shader);
+  _shader = ShaderProgramCache::getInstance()->getProgram(
+    "Allocate Bricks shader", "./assets/shader/AllocBricks.shader",
+    ThreadDispatch::getShaderType(useCompute),
+    ThreadDispatch::getShaderDefines(useCompute));
+  this->setShaderProgram(_shader);
   
   // Threads: All nodes in the SVO
-  addStartupOperation(new kore::BindBuffer(GL_DRAW_INDIRECT_BUFFER,
-             vctScene->getNodePool()->getCmdBufSVOnodes()->getBufferHandle()));
-
-  addStartupOperation(new ColorMaskOp(glm::bvec4(false, false, false, false)));
   addStartupOperation(new BindUniform(
                       vctScene->getBrickPool()->getShdBrickPoolResolutionLeaf(),
-                      _shader.getUniform("brickPoolResolution")));
+                      _shader->getUniform("brickPoolResolution")));
 
   addStartupOperation(new BindImageTexture(
                       vctScene->getNodePool()->getShdNodePool(NEXT),
-                      _shader.getUniform("nodePool_next")));
+                      _shader->getUniform("nodePool_next")));
 
   addStartupOperation(new BindImageTexture(
                       vctScene->getNodePool()->getShdNodePool(COLOR),
-                      _shader.getUniform("nodePool_color")));
+                      _shader->getUniform("nodePool_color")));
   
   addStartupOperation(new BindAtomicCounterBuffer(
                       vctScene->getBrickPool()->getShdAcNextFree(),
-                      _shader.getUniform("nextFreeBrick")));
-
-  addStartupOperation(new DrawIndirectOp(GL_POINTS, 0));
-  addFinishOperation(new MemoryBarrierOp(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
+                      _shader->getUniform("nextFreeBrick")));
+
+  ThreadDispatch::addLaunchOperations(this,
+    vctScene->getNodePool()->getCmdBufSVOnodes()->getBufferHandle(),
+    useCompute);
+
+  declareResource(vctScene->getNodePool()->getShdCmdBufSVOnodes(),
+                  ACCESS_READ, USAGE_INDIRECT_COMMAND);
+  declareResource(vctScene->getNodePool()->getShdNodePool(NEXT),
+                  ACCESS_READ_WRITE, USAGE_IMAGE);
+  declareResource(vctScene->getNodePool()->getShdNodePool(COLOR),
+                  ACCESS_WRITE, USAGE_IMAGE);
+  declareResource(vctScene->getBrickPool()->getShdAcNextFree(),
+                  ACCESS_READ_WRITE, USAGE_ATOMIC_COUNTER);
 }
 
 
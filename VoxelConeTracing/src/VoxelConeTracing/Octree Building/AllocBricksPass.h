@@ -28,12 +28,14 @@
 
 #include "KoRE/Passes/ShaderProgramPass.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
+#include "VoxelConeTracing/Util/BarrierPlanner.h"
 #include "KoRE/SceneManager.h"
 #include "KoRE/RenderManager.h"
 #include "KoRE/ResourceManager.h"
 #include "KoRE/Operations/BindBuffer.h"
 
-class AllocBricksPass : public kore::ShaderProgramPass
+class AllocBricksPass : public kore::ShaderProgramPass,
+                        public ResourceUsage
 {
   public:
     AllocBricksPass(VCTscene* vctScene, kore::EOperationExecutionType executionType);
@@ -45,7 +47,7 @@ private:
     kore::ResourceManager* _resMgr;
 
     VCTscene* _vctScene;
-    kore::ShaderProgram _shader;
+    kore::ShaderProgram* _shader;
 };
 
 #endif  // VCT_SRC_VCT_ALLOCATEBRICKSPASS_H_
@@ -25,6 +25,8 @@
 
 #include "VoxelConeTracing/Octree Building/ClearBrickTexPass.h"
 #include "Kore/Operations/Operations.h"
+#include "VoxelConeTracing/Util/ShaderProgramCache.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
 
 ClearBrickTexPass::~ClearBrickTexPass(void) {
 }
@@ -35,7 +37,8 @@ ClearBrickTexPass::ClearBrickTexPass(VCTscene* vctScene,
   using namespace kore;
 
   _name = "Clear Bricks";
-  _useGPUProfiling = vctScene->getUseGPUprofiling();
+  GPUprofiler::getInstance()->addPass(this);
+  bool useCompute = vctScene->getUseComputeShaders();
   
   this->setExecutionType(executionType);
 
@@ -44,30 +47,22 @@ ClearBrickTexPass::ClearBrickTexPass(VCTscene* vctScene,
   _shdClearMode.type = GL_UNSIGNED_INT;
   _shdClearMode.data = &_eClearMode;
   
-  ShaderProgram* shader = new ShaderProgram();
-  shader->loadShader("./assets/shader/ClearBrickTex.shader",
-                 GL_VERTEX_SHADER);
-  shader->setName("ClearBrickTex shader");
-  shader->init();
+  ShaderProgram* shader = ShaderProgramCache::getInstance()->getProgram(
+    "ClearBrickTex shader", "./assets/shader/ClearBrickTex.shader",
+    ThreadDispatch::getShaderType(useCompute),
+    ThreadDispatch::getShaderDefines(useCompute));
   this->setShaderProgram(shader);
 
   SDrawArraysIndirectCommand cmd;
-  cmd.numVertices = vctScene->getBrickPool()->getBrickPoolResolution_leaf() * 
+  cmd.setNumThreads(vctScene->getBrickPool()->getBrickPoolResolution_leaf() * 
                     vctScene->getBrickPool()->getBrickPoolResolution_leaf() *
-                    vctScene->getBrickPool()->getBrickPoolResolution_leaf();
-  cmd.numPrimitives = 1;
-  cmd.baseInstanceIdx = 0;
-  cmd.firstVertexIdx = 0;
+                    vctScene->getBrickPool()->getBrickPoolResolution_leaf());
 
   _svoCmdBuf.create(GL_DRAW_INDIRECT_BUFFER,
                     sizeof(SDrawArraysIndirectCommand),
                     GL_STATIC_DRAW,
                     &cmd);
 
-  addStartupOperation(
-    new kore::BindBuffer(GL_DRAW_INDIRECT_BUFFER,_svoCmdBuf.getHandle()));
-  
-  addStartupOperation(new ColorMaskOp(glm::bvec4(false, false, false, false)));
   addStartupOperation(
     new kore::BindImageTexture(
       vctScene->getBrickPool()->getShdBrickPool(BRICKPOOL_COLOR),
@@ -83,11 +78,27 @@ ClearBrickTexPass::ClearBrickTexPass(VCTscene* vctScene,
     vctScene->getBrickPool()->getShdBrickPool(BRICKPOOL_NORMAL),
     shader->getUniform("brickPool_normal")));
 
+  addStartupOperation(
+    new kore::BindImageTexture(
+    vctScene->getShdLightMask(), shader->getUniform("lightMask")));
+
   addStartupOperation(
     new kore::BindUniform(
-    &_shdClearMode, shader->getUniform("clearMode")));
+    vctScene->getShdInjectLights(), shader->getUniform("injectLights")));
 
-  addStartupOperation(new kore::DrawIndirectOp(GL_POINTS, 0));
+  addStartupOperation(
+    new kore::BindUniform(
+    &_shdClearMode, shader->getUniform("clearMode")));
 
-  addStartupOperation(new MemoryBarrierOp(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
+  ThreadDispatch::addLaunchOperations(this, _svoCmdBuf.getHandle(), useCompute);
+
+  declareResource(vctScene->getBrickPool()->getShdBrickPool(BRICKPOOL_IRRADIANCE),
+                  ACCESS_WRITE, USAGE_IMAGE);
+  declareResource(vctScene->getShdLightMask(), ACCESS_READ_WRITE, USAGE_IMAGE);
+  if (clearMode == CLEAR_BRICK_ALL) {
+    declareResource(vctScene->getBrickPool()->getShdBrickPool(BRICKPOOL_COLOR),
+                    ACCESS_WRITE, USAGE_IMAGE);
+    declareResource(vctScene->getBrickPool()->getShdBrickPool(BRICKPOOL_NORMAL),
+                    ACCESS_WRITE, USAGE_IMAGE);
+  }
 }
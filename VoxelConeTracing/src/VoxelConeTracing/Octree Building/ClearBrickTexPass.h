@@ -28,8 +28,10 @@
 
 #include "KoRE/Passes/ShaderProgramPass.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
+#include "VoxelConeTracing/Util/BarrierPlanner.h"
 
-class ClearBrickTexPass : public kore::ShaderProgramPass
+class ClearBrickTexPass : public kore::ShaderProgramPass,
+                          public ResourceUsage
 {
   public:
     enum EClearMode {
@@ -25,6 +25,8 @@
 
 #include "VoxelConeTracing/Octree Building/ClearNodeMapPass.h"
 #include "Kore/Operations/Operations.h"
+#include "VoxelConeTracing/Util/ShaderProgramCache.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
 
 ClearNodeMapPass::~ClearNodeMapPass(void) {
 }
@@ -34,27 +36,33 @@ ClearNodeMapPass::ClearNodeMapPass(VCTscene* vctScene,
   using namespace kore;
 
   _name = "Clear Node Map";
-  _useGPUProfiling = vctScene->getUseGPUprofiling();
+  GPUprofiler::getInstance()->addPass(this);
+  bool useCompute = vctScene->getUseComputeShaders();
   
   this->setExecutionType(executionType);
 
-  ShaderProgram* shader = new ShaderProgram();
-  shader->loadShader("./assets/shader/ClearNodeMap.shader",
-                 GL_VERTEX_SHADER);
-  shader->setName("ClearNodeMap shader");
-  shader->init();
+  ShaderProgram* shader = ShaderProgramCache::getInstance()->getProgram(
+    "ClearNodeMap shader", "./assets/shader/ClearNodeMap.shader",
+    ThreadDispatch::getShaderType(useCompute),
+    ThreadDispatch::getShaderDefines(useCompute));
   this->setShaderProgram(shader);
 
-  addStartupOperation(
-    new kore::BindBuffer(GL_DRAW_INDIRECT_BUFFER,
-                         vctScene->getThreadBuf_nodeMap_complete()->getHandle()));
-  addStartupOperation(new ColorMaskOp(glm::bvec4(false, false, false, false)));
-
   addStartupOperation(
     new kore::BindImageTexture(
       vctScene->getShdLightNodeMap(),
       shader->getUniform("nodeMap")));
 
-  addStartupOperation(new kore::DrawIndirectOp(GL_POINTS, 0));
-  addStartupOperation(new MemoryBarrierOp(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
+  addStartupOperation(
+    new kore::BindImageTexture(
+      vctScene->getShdLightNodeFlags(),
+      shader->getUniform("nodeFlags")));
+
+  ThreadDispatch::addLaunchOperations(this,
+    vctScene->getThreadBuf_nodeMap_complete()->getHandle(),
+    useCompute);
+
+  declareResource(vctScene->getShdLightNodeMap(),
+                  ACCESS_READ_WRITE, USAGE_IMAGE);
+  declareResource(vctScene->getShdLightNodeFlags(),
+                  ACCESS_WRITE, USAGE_IMAGE);
 }
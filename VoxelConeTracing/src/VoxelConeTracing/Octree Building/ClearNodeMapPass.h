@@ -28,8 +28,10 @@
 
 #include "KoRE\Passes\ShaderProgramPass.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
+#include "VoxelConeTracing/Util/BarrierPlanner.h"
 
-class ClearNodeMapPass : public kore::ShaderProgramPass {
+class ClearNodeMapPass : public kore::ShaderProgramPass,
+                         public ResourceUsage {
 
   public:
     ClearNodeMapPass(VCTscene* vctScene, 
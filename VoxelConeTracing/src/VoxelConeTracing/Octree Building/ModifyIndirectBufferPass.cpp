@@ -30,6 +30,8 @@
 #include "KoRE\ResourceManager.h"
 
 #include "Kore\Operations\Operations.h"
+#include "VoxelConeTracing/Util/ShaderProgramCache.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
 
 ModifyIndirectBufferPass::~ModifyIndirectBufferPass(void) {
 }
@@ -42,7 +44,8 @@ ModifyIndirectBufferPass::
   using namespace kore;
   
   _name = "Modifiy indirect buffer";
-  _useGPUProfiling = vctScene->getUseGPUprofiling();
+  GPUprofiler::getInstance()->addPass(this);
+  bool useCompute = vctScene->getUseComputeShaders();
 
   this->setExecutionType(executionType);
 
@@ -56,36 +59,33 @@ ModifyIndirectBufferPass::
 
   initCallBuffer();
 
-  _shader.loadShader("./assets/shader/ModifyIndirectBufferVert.shader",
-                     GL_VERTEX_SHADER);
-  _shader.setName("ModyfyIndirectBuffer shader");
-  _shader.init();
+  _shader = ShaderProgramCache::getInstance()->getProgram(
+    "ModyfyIndirectBuffer shader", "./assets/shader/ModifyIndirectBufferVert.shader",
+    ThreadDispatch::getShaderType(useCompute),
+    ThreadDispatch::getShaderDefines(useCompute));
   
-  this->setShaderProgram(&_shader);
+  this->setShaderProgram(_shader);
 
 
-  addStartupOperation(
-    new kore::BindBuffer(GL_DRAW_INDIRECT_BUFFER, _callIndirectBuffer.getHandle()));
-  addStartupOperation(new ColorMaskOp(glm::bvec4(false, false, false, false)));
-
   addStartupOperation(
     new kore::BindImageTexture(_shdIndirectBuffer,
-                               _shader.getUniform("indirectCommandBuf")));
+                               _shader->getUniform("indirectCommandBuf")));
 
   addStartupOperation(
     new kore::BindAtomicCounterBuffer(_shdAcNumThreads,
-                                      _shader.getUniform("numThreads")));
+                                      _shader->getUniform("numThreads")));
 
-  addStartupOperation(
-    new kore::DrawIndirectOp(GL_POINTS, 0));
+  // Single thread that writes the draw- and dispatch-arguments
+  ThreadDispatch::addLaunchOperations(this, _callIndirectBuffer.getHandle(),
+                                      useCompute);
+
+  declareResource(_shdAcNumThreads, ACCESS_READ, USAGE_ATOMIC_COUNTER);
+  declareResource(_shdIndirectBuffer, ACCESS_WRITE, USAGE_IMAGE);
 }
 
 void ModifyIndirectBufferPass::initCallBuffer() {
   SDrawArraysIndirectCommand cmd;
-  cmd.numVertices = 1;
-  cmd.numPrimitives = 1;
-  cmd.firstVertexIdx = 0;
-  cmd.baseInstanceIdx = 0;
+  cmd.setNumThreads(1);
 
   _callIndirectBuffer.create(GL_DRAW_INDIRECT_BUFFER,
                              sizeof(SDrawArraysIndirectCommand),
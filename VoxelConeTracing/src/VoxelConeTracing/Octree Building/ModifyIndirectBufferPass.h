@@ -28,12 +28,14 @@
 
 #include "KoRE/Passes/ShaderProgramPass.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
+#include "VoxelConeTracing/Util/BarrierPlanner.h"
 #include "KoRE/SceneManager.h"
 #include "KoRE/RenderManager.h"
 #include "KoRE/ResourceManager.h"
 
 
-class ModifyIndirectBufferPass : public kore::ShaderProgramPass
+class ModifyIndirectBufferPass : public kore::ShaderProgramPass,
+                                 public ResourceUsage
 {
   public:
     ModifyIndirectBufferPass(const kore::ShaderData* shdIndirectBuffer,
@@ -54,7 +56,7 @@ class ModifyIndirectBufferPass : public kore::ShaderProgramPass
 
     kore::IndexedBuffer _callIndirectBuffer;
 
-    kore::ShaderProgram _shader;
+    kore::ShaderProgram* _shader;
     VCTscene* _vctScene;
 };
 
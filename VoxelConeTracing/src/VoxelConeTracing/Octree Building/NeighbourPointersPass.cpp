@@ -28,6 +28,8 @@
 #include "KoRE\RenderManager.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
 #include "Kore\Operations\Operations.h"
+#include "VoxelConeTracing/Util/ShaderProgramCache.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
 
 NeighbourPointersPass::
   NeighbourPointersPass(VCTscene* vctScene,
@@ -36,7 +38,8 @@ NeighbourPointersPass::
   using namespace kore;
 
   _name = std::string("Neighbour Pointer (level ").append(std::to_string(level).append(")"));
-  _useGPUProfiling = vctScene->getUseGPUprofiling();
+  GPUprofiler::getInstance()->addPass(this);
+  bool useCompute = vctScene->getUseComputeShaders();
 
   this->setExecutionType(executionType);
 
@@ -46,60 +49,68 @@ NeighbourPointersPass::
   _shdLevel.name = "OctreeLevel";
   _shdLevel.type = GL_UNSIGNED_INT;
     
-  _shader.loadShader("./assets/shader/NeighbourPointer.shader",
-                      GL_VERTEX_SHADER);
-  _shader.setName("NeighbourPointer shader");
-  _shader.init();
+  _shader = ShaderProgramCache::getInstance()->getProgram(
+    "NeighbourPointer shader", "./assets/shader/NeighbourPointer.shader",
+    ThreadDispatch::getShaderType(useCompute),
+    ThreadDispatch::getShaderDefines(useCompute));
 
-  this->setShaderProgram(&_shader);
+  this->setShaderProgram(_shader);
   
-  addStartupOperation(
-    new kore::BindBuffer(GL_DRAW_INDIRECT_BUFFER,
-    vctScene->getVoxelFragList()->getFragListIndCmdBuf()->getBufferHandle()));
-  addStartupOperation(new ColorMaskOp(glm::bvec4(false, false, false, false)));
-
   addStartupOperation(new BindImageTexture(
     vctScene->getVoxelFragList()->getShdVoxelFragList(),
-    _shader.getUniform("voxelFragmentListPosition"), GL_READ_ONLY));
+    _shader->getUniform("voxelFragmentListPosition"), GL_READ_ONLY));
 
-  addStartupOperation(new BindUniform(&_shdLevel, _shader.getUniform("level")));
+  addStartupOperation(new BindUniform(&_shdLevel, _shader->getUniform("level")));
 
   addStartupOperation(new BindImageTexture(
     vctScene->getNodePool()->getShdNodePool(NEXT),
-    _shader.getUniform("nodePool_next"), GL_READ_ONLY));
+    _shader->getUniform("nodePool_next"), GL_READ_ONLY));
 
   addStartupOperation(new BindImageTexture(
     vctScene->getNodePool()->getShdNodePool(NEIGHBOUR_X),
-    _shader.getUniform("nodePool_X")));
+    _shader->getUniform("nodePool_X")));
 
   addStartupOperation(new BindImageTexture(
     vctScene->getNodePool()->getShdNodePool(NEIGHBOUR_NEG_X),
-    _shader.getUniform("nodePool_X_neg")));
+    _shader->getUniform("nodePool_X_neg")));
 
   addStartupOperation(new BindImageTexture(
     vctScene->getNodePool()->getShdNodePool(NEIGHBOUR_Y),
-    _shader.getUniform("nodePool_Y")));
+    _shader->getUniform("nodePool_Y")));
 
   addStartupOperation(new BindImageTexture(
     vctScene->getNodePool()->getShdNodePool(NEIGHBOUR_NEG_Y),
-    _shader.getUniform("nodePool_Y_neg")));
+    _shader->getUniform("nodePool_Y_neg")));
 
   addStartupOperation(new BindImageTexture(
     vctScene->getNodePool()->getShdNodePool(NEIGHBOUR_Z),
-    _shader.getUniform("nodePool_Z")));
+    _shader->getUniform("nodePool_Z")));
 
   addStartupOperation(new BindImageTexture(
     vctScene->getNodePool()->getShdNodePool(NEIGHBOUR_NEG_Z),
-    _shader.getUniform("nodePool_Z_neg")));
+    _shader->getUniform("nodePool_Z_neg")));
 
   addStartupOperation(new BindUniform(vctScene->getNodePool()->getShdNumLevels(),
-                      _shader.getUniform("numLevels")));
+                      _shader->getUniform("numLevels")));
 
   addStartupOperation(new BindUniform(vctScene->getShdVoxelGridResolution(),
-                      _shader.getUniform("voxelGridResolution")));
-
-  addStartupOperation(new DrawIndirectOp(GL_POINTS, 0));
-
+                      _shader->getUniform("voxelGridResolution")));
+
+  ThreadDispatch::addLaunchOperations(this,
+    vctScene->getVoxelFragList()->getFragListIndCmdBuf()->getBufferHandle(),
+    useCompute);
+
+  declareResource(vctScene->getVoxelFragList()->getShdFragListIndCmdBuf(),
+                  ACCESS_READ, USAGE_INDIRECT_COMMAND);
+  declareResource(vctScene->getVoxelFragList()->getShdVoxelFragList(),
+                  ACCESS_READ, USAGE_IMAGE);
+  declareResource(vctScene->getNodePool()->getShdNodePool(NEXT),
+                  ACCESS_READ, USAGE_IMAGE);
+  for (uint i = NEIGHBOUR_X; i <= NEIGHBOUR_NEG_Z; ++i) {
+    declareResource(vctScene->getNodePool()->getShdNodePool(
+                    static_cast<ENodePoolAttributes>(i)),
+                    ACCESS_WRITE, USAGE_IMAGE);
+  }
 }
 
 NeighbourPointersPass::~NeighbourPointersPass(void) {
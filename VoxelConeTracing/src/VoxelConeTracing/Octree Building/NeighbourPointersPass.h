@@ -28,9 +28,11 @@
 
 #include "KoRE/Passes/ShaderProgramPass.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
+#include "VoxelConeTracing/Util/BarrierPlanner.h"
 
 
-class NeighbourPointersPass : public kore::ShaderProgramPass
+class NeighbourPointersPass : public kore::ShaderProgramPass,
+                              public ResourceUsage
 {
   public:
     NeighbourPointersPass(VCTscene* vctScene,
@@ -39,7 +41,7 @@ class NeighbourPointersPass : public kore::ShaderProgramPass
     virtual ~NeighbourPointersPass(void);
 
   private:
-    kore::ShaderProgram _shader;
+    kore::ShaderProgram* _shader;
 
     uint _level;
     kore::ShaderData _shdLevel;
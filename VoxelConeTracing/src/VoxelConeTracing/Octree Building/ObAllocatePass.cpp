@@ -30,6 +30,11 @@
 #include "KoRE\ResourceManager.h"
 
 #include "Kore\Operations\Operations.h"
+#include "KoRE\Operations\FunctionOp.h"
+#include "VoxelConeTracing/Util/ShaderProgramCache.h"
+#include "VoxelConeTracing/Util/GPUreadback.h"
+#include "VoxelConeTracing/Util/AsyncLog.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
 
 ObAllocatePass::~ObAllocatePass(void) {
 }
@@ -39,7 +44,8 @@ ObAllocatePass::ObAllocatePass(VCTscene* vctScene, uint level,
   using namespace kore;
 
   _name = std::string("Allocate Pass (level ").append(std::to_string(level).append(")"));
-  _useGPUProfiling = vctScene->getUseGPUprofiling();
+  GPUprofiler::getInstance()->addPass(this);
+  bool useCompute = vctScene->getUseComputeShaders();
   
   this->setExecutionType(executionType);
 
@@ -48,89 +54,83 @@ ObAllocatePass::ObAllocatePass(VCTscene* vctScene, uint level,
   _sceneMgr = SceneManager::getInstance();
   _resMgr = ResourceManager::getInstance();
   _level = level;
+  _bindIndCmdBufOp = NULL;
 
   _shdLevel.component = NULL;
   _shdLevel.data = &_level;
   _shdLevel.name = "OctreeLevel";
   _shdLevel.type = GL_UNSIGNED_INT;
 
-  _allocateShader
-     .loadShader("./assets/shader/ObAllocateVert.shader",
-                 GL_VERTEX_SHADER);
+  _allocateShader = ShaderProgramCache::getInstance()->getProgram(
+    "ObAllocate shader", "./assets/shader/ObAllocateVert.shader",
+    ThreadDispatch::getShaderType(useCompute),
+    ThreadDispatch::getShaderDefines(useCompute));
+  this->setShaderProgram(_allocateShader);
 
-  _allocateShader.setName("ObAllocate shader");
-  _allocateShader.init();
-  this->setShaderProgram(&_allocateShader);
-
-  addStartupOperation(new MemoryBarrierOp(GL_ALL_BARRIER_BITS));
-    
-
-  _bindIndCmdBufOp =
-    new kore::BindBuffer(GL_DRAW_INDIRECT_BUFFER,
-                         vctScene->getNodePool()->
-                         getCompleteThreadBuf(level)->getHandle());
-
-  addStartupOperation(_bindIndCmdBufOp);
-  addStartupOperation(new ColorMaskOp(glm::bvec4(false, false, false, false)));
-
-  addStartupOperation(new BindUniform(&_shdLevel, _allocateShader.getUniform("level")));
+  addStartupOperation(new BindUniform(&_shdLevel, _allocateShader->getUniform("level")));
 
   addStartupOperation(new BindImageTexture(
     _vctScene->getNodePool()->getShdLevelAddressBuffer(),
-    _allocateShader.getUniform("levelAddressBuffer")));
+    _allocateShader->getUniform("levelAddressBuffer")));
   
   addStartupOperation(new BindImageTexture(
                       vctScene->getNodePool()->getShdNodePool(NEXT),
-                      _allocateShader.getUniform("nodePool_next")));
+                      _allocateShader->getUniform("nodePool_next")));
   
   addStartupOperation(new BindAtomicCounterBuffer(
                        vctScene->getNodePool()->getShdAcNextFree(),
-                       _allocateShader.getUniform("nextFreeAddress")));
-
-  addStartupOperation(new DrawIndirectOp(GL_POINTS, 0));
-//  addFinishOperation(new MemoryBarrierOp(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT |GL_ATOMIC_COUNTER_BARRIER_BIT));
-  addFinishOperation(new MemoryBarrierOp(GL_ALL_BARRIER_BITS));
+                       _allocateShader->getUniform("nextFreeAddress")));
+
+  // The level can be changed later (see setLevel()), so the thread buffer
+  // has to be looked up when the pass is executed.
+  if (useCompute) {
+    addStartupOperation(
+      new FunctionOp(std::bind(&ObAllocatePass::dispatchThreads, this)));
+  } else {
+    _bindIndCmdBufOp =
+      new kore::BindBuffer(GL_DRAW_INDIRECT_BUFFER,
+                           vctScene->getNodePool()->
+                           getCompleteThreadBuf(level)->getHandle());
+
+    addStartupOperation(_bindIndCmdBufOp);
+    addStartupOperation(
+      new ColorMaskOp(glm::bvec4(false, false, false, false)));
+    addStartupOperation(new DrawIndirectOp(GL_POINTS, 0));
+  }
 
-  /*addFinishOperation(
-    new FunctionOp(std::bind(&ObAllocatePass::setLevelAddressBuffer, this)));*/
+  declareResource(vctScene->getNodePool()->getShdLevelAddressBuffer(),
+                  ACCESS_READ_WRITE, USAGE_IMAGE);
+  declareResource(vctScene->getNodePool()->getShdNodePool(NEXT),
+                  ACCESS_READ_WRITE, USAGE_IMAGE);
+  declareResource(vctScene->getNodePool()->getShdAcNextFree(),
+                  ACCESS_READ_WRITE, USAGE_ATOMIC_COUNTER);
 }
 
 
-void ObAllocatePass::setLevelAddressBuffer() {
-  if (_level < 1) {
-    return;
-  }
-
-  uint nextFree = 0;
-  _renderMgr->bindBufferBase(GL_ATOMIC_COUNTER_BUFFER,
-                             0, _vctScene->getNodePool()->getAcNodePoolNextFree()->getHandle());
-  GLuint* ptr = (GLuint*)glMapBufferRange(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), GL_MAP_READ_BIT);
-  nextFree = (*ptr);
-  glUnmapBuffer(GL_ATOMIC_COUNTER_BUFFER);
-
-  _renderMgr->bindBuffer(GL_TEXTURE_BUFFER, _vctScene->getNodePool()->getLevelAddressBuffer()->getBufferHandle());
-  ptr = (GLuint*) glMapBuffer(GL_TEXTURE_BUFFER, GL_READ_WRITE);
-  ptr[_level + 1] = 1U + nextFree * 8U;
-  glUnmapBuffer(GL_TEXTURE_BUFFER);
+// Callback of the readback in debugIndirectCmdBuff()
+static void logIndirectCmdBuf(uint level, const uint* values, uint numValues) {
+  AsyncLog::getInstance()->write("Level %u: ", level);
+  AsyncLog::getInstance()->writeValues("Alloc indirectCmdBuf contents",
+                                       values, numValues);
 }
 
 void ObAllocatePass::debugIndirectCmdBuff(){
-  _renderMgr->bindBuffer(GL_DRAW_INDIRECT_BUFFER, _vctScene->getNodePool()->
-                        getCompleteThreadBuf(_level)->getHandle());
-
-  const GLuint* ptr = (const GLuint*) glMapBuffer(GL_DRAW_INDIRECT_BUFFER, GL_READ_ONLY);
-  kore::Log::getInstance()->write("Alloc indirectCmdBuf contents on level %u:\n", _level);
-  for (uint i = 0; i < 4; ++i) {
-    kore::Log::getInstance()->write("%u ", ptr[i]);
-  }
-  kore::Log::getInstance()->write("\n");
-
-  glUnmapBuffer(GL_DRAW_INDIRECT_BUFFER);
+  GPUreadback::getInstance()->request(
+    _vctScene->getNodePool()->getCompleteThreadBuf(_level)->getHandle(), 0, 4,
+    std::bind(&logIndirectCmdBuf, _level, std::placeholders::_1,
+              std::placeholders::_2));
 }
 
 void ObAllocatePass::setLevel(uint level) {
   _level = level;
 
-  _bindIndCmdBufOp->connect(GL_DRAW_INDIRECT_BUFFER,
-    _vctScene->getNodePool()->getCompleteThreadBuf(level)->getHandle());
+  if (_bindIndCmdBufOp) {
+    _bindIndCmdBufOp->connect(GL_DRAW_INDIRECT_BUFFER,
+      _vctScene->getNodePool()->getCompleteThreadBuf(level)->getHandle());
+  }
+}
+
+void ObAllocatePass::dispatchThreads() {
+  ThreadDispatch::dispatchIndirect(
+    _vctScene->getNodePool()->getCompleteThreadBuf(_level)->getHandle());
 }
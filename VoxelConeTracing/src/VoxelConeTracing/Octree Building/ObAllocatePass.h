@@ -28,12 +28,14 @@
 
 #include "KoRE/Passes/ShaderProgramPass.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
+#include "VoxelConeTracing/Util/BarrierPlanner.h"
 #include "KoRE/SceneManager.h"
 #include "KoRE/RenderManager.h"
 #include "KoRE/ResourceManager.h"
 #include "KoRE/Operations/BindBuffer.h"
 
-class ObAllocatePass : public kore::ShaderProgramPass
+class ObAllocatePass : public kore::ShaderProgramPass,
+                       public ResourceUsage
 {
   public:
     ObAllocatePass(VCTscene* vctScene, uint level,
@@ -43,15 +45,17 @@ class ObAllocatePass : public kore::ShaderProgramPass
     void setLevel(uint level);
     void debugVoxelIndexAC();
     void debugIndirectCmdBuff();
-    void setLevelAddressBuffer();
 private:
+    void dispatchThreads();
+
+
     kore::RenderManager* _renderMgr;
     kore::SceneManager* _sceneMgr;
     kore::ResourceManager* _resMgr;
 
     kore::BindBuffer* _bindIndCmdBufOp;
 
-    kore::ShaderProgram _allocateShader;
+    kore::ShaderProgram* _allocateShader;
     VCTscene* _vctScene;
 
     kore::ShaderData _shdLevel;
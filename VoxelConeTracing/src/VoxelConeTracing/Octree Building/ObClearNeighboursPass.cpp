@@ -25,6 +25,8 @@
 
 #include "VoxelConeTracing/Octree Building/ObClearNeighboursPass.h"
 #include "Kore/Operations/Operations.h"
+#include "VoxelConeTracing/Util/ShaderProgramCache.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
 
 ObClearNeighboursPass::~ObClearNeighboursPass(void) {
 }
@@ -34,32 +36,25 @@ ObClearNeighboursPass::ObClearNeighboursPass(VCTscene* vctScene,
   using namespace kore;
   
   _name = "Clear Neighbours";
-  _useGPUProfiling = vctScene->getUseGPUprofiling();
+  GPUprofiler::getInstance()->addPass(this);
+  bool useCompute = vctScene->getUseComputeShaders();
 
   this->setExecutionType(executionType);
 
-  ShaderProgram* shader = new ShaderProgram();
-  shader->loadShader("./assets/shader/ObClearNeighbours.shader",
-                 GL_VERTEX_SHADER);
-  shader->setName("ObClearNeighbours shader");
-  shader->init();
+  ShaderProgram* shader = ShaderProgramCache::getInstance()->getProgram(
+    "ObClearNeighbours shader", "./assets/shader/ObClearNeighbours.shader",
+    ThreadDispatch::getShaderType(useCompute),
+    ThreadDispatch::getShaderDefines(useCompute));
   this->setShaderProgram(shader);
 
   SDrawArraysIndirectCommand cmd;
-  cmd.numVertices = vctScene->getNodePool()->getNumNodes();
-  cmd.numPrimitives = 1;
-  cmd.baseInstanceIdx = 0;
-  cmd.firstVertexIdx = 0;
+  cmd.setNumThreads(vctScene->getNodePool()->getNumNodes());
 
   _svoCmdBuf.create(GL_DRAW_INDIRECT_BUFFER,
                     sizeof(SDrawArraysIndirectCommand),
                     GL_STATIC_DRAW,
                     &cmd);
 
-  addStartupOperation(
-    new kore::BindBuffer(GL_DRAW_INDIRECT_BUFFER,_svoCmdBuf.getHandle()));
-  addStartupOperation(new ColorMaskOp(glm::bvec4(false, false, false, false)));
-
   addStartupOperation(new BindImageTexture(
                     vctScene->getNodePool()->getShdNodePool(NEIGHBOUR_X),
                     shader->getUniform("nodePool_X")));
@@ -84,7 +79,11 @@ ObClearNeighboursPass::ObClearNeighboursPass(VCTscene* vctScene,
                   vctScene->getNodePool()->getShdNodePool(NEIGHBOUR_NEG_Z),
                   shader->getUniform("nodePool_Z_neg")));
   
-  addStartupOperation(new kore::DrawIndirectOp(GL_POINTS, 0));
+  ThreadDispatch::addLaunchOperations(this, _svoCmdBuf.getHandle(), useCompute);
 
-  addStartupOperation(new MemoryBarrierOp(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
+  for (uint i = NEIGHBOUR_X; i <= NEIGHBOUR_NEG_Z; ++i) {
+    declareResource(vctScene->getNodePool()->getShdNodePool(
+                    static_cast<ENodePoolAttributes>(i)),
+                    ACCESS_WRITE, USAGE_IMAGE);
+  }
 }
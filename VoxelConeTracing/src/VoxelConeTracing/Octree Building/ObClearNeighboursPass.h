@@ -28,8 +28,10 @@
 
 #include "KoRE/Passes/ShaderProgramPass.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
+#include "VoxelConeTracing/Util/BarrierPlanner.h"
 
-class ObClearNeighboursPass : public kore::ShaderProgramPass
+class ObClearNeighboursPass : public kore::ShaderProgramPass,
+                              public ResourceUsage
 {
   public:
     ObClearNeighboursPass(VCTscene* vctScene,
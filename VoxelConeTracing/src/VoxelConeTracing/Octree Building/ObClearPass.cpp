@@ -25,6 +25,10 @@
 
 #include "VoxelConeTracing/Octree Building/ObClearPass.h"
 #include "Kore/Operations/Operations.h"
+#include "KoRE/Operations/ResetAtomicCounterBuffer.h"
+#include "KoRE/Operations/FunctionOp.h"
+#include "VoxelConeTracing/Util/ShaderProgramCache.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
 
 ObClearPass::~ObClearPass(void) {
 }
@@ -34,32 +38,35 @@ ObClearPass::ObClearPass(VCTscene* vctScene,
   using namespace kore;
   
   _name = "Clear Pass";
-  _useGPUProfiling = vctScene->getUseGPUprofiling();
+  GPUprofiler::getInstance()->addPass(this);
+  bool useCompute = vctScene->getUseComputeShaders();
 
   this->setExecutionType(executionType);
 
-  ShaderProgram* shader = new ShaderProgram();
-  shader->loadShader("./assets/shader/ObClearVert.shader",
-                 GL_VERTEX_SHADER);
-  shader->setName("ObClear shader");
-  shader->init();
+  ShaderProgram* shader = ShaderProgramCache::getInstance()->getProgram(
+    "ObClear shader", "./assets/shader/ObClearVert.shader",
+    ThreadDispatch::getShaderType(useCompute),
+    ThreadDispatch::getShaderDefines(useCompute));
   this->setShaderProgram(shader);
 
+  // A rebuild allocates from the start of the pools again
+  NodePool* nodePool = vctScene->getNodePool();
+  addStartupOperation(
+    new ResetAtomicCounterBuffer(nodePool->getShdAcNextFree(), 0));
+  addStartupOperation(
+    new ResetAtomicCounterBuffer(vctScene->getBrickPool()->getShdAcNextFree(),
+                                 0));
+  addStartupOperation(new FunctionOp(
+    std::bind(&NodePool::resetLevelAddressBuffer, nodePool)));
+
   SDrawArraysIndirectCommand cmd;
-  cmd.numVertices = vctScene->getNodePool()->getNumNodes();
-  cmd.numPrimitives = 1;
-  cmd.baseInstanceIdx = 0;
-  cmd.firstVertexIdx = 0;
+  cmd.setNumThreads(vctScene->getNodePool()->getNumNodes());
 
   _svoCmdBuf.create(GL_DRAW_INDIRECT_BUFFER,
                     sizeof(SDrawArraysIndirectCommand),
                     GL_STATIC_DRAW,
                     &cmd);
 
-  addStartupOperation(
-    new kore::BindBuffer(GL_DRAW_INDIRECT_BUFFER,_svoCmdBuf.getHandle()));
-  addStartupOperation(new ColorMaskOp(glm::bvec4(false, false, false, false)));
-
   addStartupOperation(new BindImageTexture(
                     vctScene->getNodePool()->getShdNodePool(COLOR),
                     shader->getUniform("nodePool_color")));
@@ -97,7 +104,17 @@ ObClearPass::ObClearPass(VCTscene* vctScene,
                   vctScene->getNodePool()->getShdNodePool(NEIGHBOUR_NEG_Z),
                   shader->getUniform("nodePool_Z_neg"))); */
   
-  addStartupOperation(new kore::DrawIndirectOp(GL_POINTS, 0));
-
-  addStartupOperation(new MemoryBarrierOp(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
+  ThreadDispatch::addLaunchOperations(this, _svoCmdBuf.getHandle(), useCompute);
+
+  for (uint i = 0; i < NODEPOOL_ATTRIBUTES_NUM; ++i) {
+    declareResource(vctScene->getNodePool()->getShdNodePool(
+                    static_cast<ENodePoolAttributes>(i)),
+                    ACCESS_WRITE, USAGE_IMAGE);
+  }
+  declareResource(nodePool->getShdAcNextFree(),
+                  ACCESS_WRITE, USAGE_BUFFER_UPDATE);
+  declareResource(vctScene->getBrickPool()->getShdAcNextFree(),
+                  ACCESS_WRITE, USAGE_BUFFER_UPDATE);
+  declareResource(nodePool->getShdLevelAddressBuffer(),
+                  ACCESS_WRITE, USAGE_BUFFER_UPDATE);
 }
@@ -28,8 +28,10 @@
 
 #include "KoRE/Passes/ShaderProgramPass.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
+#include "VoxelConeTracing/Util/BarrierPlanner.h"
 
-class ObClearPass : public kore::ShaderProgramPass
+class ObClearPass : public kore::ShaderProgramPass,
+                    public ResourceUsage
 {
   public:
     ObClearPass(VCTscene* vctScene,
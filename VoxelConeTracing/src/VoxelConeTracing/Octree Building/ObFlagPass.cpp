@@ -30,6 +30,8 @@
 #include "KoRE\ResourceManager.h"
 
 #include "Kore\Operations\Operations.h"
+#include "VoxelConeTracing/Util/ShaderProgramCache.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
 
 ObFlagPass::~ObFlagPass(void) {
 }
@@ -39,7 +41,8 @@ ObFlagPass::ObFlagPass(VCTscene* vctScene,
   using namespace kore;
   
   _name = "Flag Pass";
-  _useGPUProfiling = vctScene->getUseGPUprofiling();
+  GPUprofiler::getInstance()->addPass(this);
+  bool useCompute = vctScene->getUseComputeShaders();
 
   this->setExecutionType(executionType);
 
@@ -48,34 +51,36 @@ ObFlagPass::ObFlagPass(VCTscene* vctScene,
   _sceneMgr = SceneManager::getInstance();
   _resMgr = ResourceManager::getInstance();
 
-  _flagShader
-     .loadShader("./assets/shader/ObFlagVert.shader",
-                 GL_VERTEX_SHADER);
-  _flagShader.setName("ObFlag shader");
-  _flagShader.init();
+  _flagShader = ShaderProgramCache::getInstance()->getProgram(
+    "ObFlag shader", "./assets/shader/ObFlagVert.shader",
+    ThreadDispatch::getShaderType(useCompute),
+    ThreadDispatch::getShaderDefines(useCompute));
   
-  this->setShaderProgram(&_flagShader);
-
-  addStartupOperation(
-    new kore::BindBuffer(GL_DRAW_INDIRECT_BUFFER,
-    vctScene->getVoxelFragList()->getFragListIndCmdBuf()->getBufferHandle()));
-  addStartupOperation(new ColorMaskOp(glm::bvec4(false, false, false, false)));
+  this->setShaderProgram(_flagShader);
 
   addStartupOperation(new BindImageTexture(
                       vctScene->getVoxelFragList()->getShdVoxelFragList(),
-                      _flagShader.getUniform("voxelFragmentListPosition")));
+                      _flagShader->getUniform("voxelFragmentListPosition")));
 
   addStartupOperation(new BindUniform(
                       vctScene->getShdVoxelGridResolution(),
-                      _flagShader.getUniform("voxelGridResolution")));
+                      _flagShader->getUniform("voxelGridResolution")));
 
   addStartupOperation(new BindUniform(vctScene->getNodePool()->getShdNumLevels(),
-                    _flagShader.getUniform("numLevels")));
+                    _flagShader->getUniform("numLevels")));
 
   addStartupOperation(new BindImageTexture(
                     vctScene->getNodePool()->getShdNodePool(NEXT),
-                    _flagShader.getUniform("nodePool_next")));
+                    _flagShader->getUniform("nodePool_next")));
   
-  addStartupOperation(
-     new kore::DrawIndirectOp(GL_POINTS, 0));
+  ThreadDispatch::addLaunchOperations(this,
+    vctScene->getVoxelFragList()->getFragListIndCmdBuf()->getBufferHandle(),
+    useCompute);
+
+  declareResource(vctScene->getVoxelFragList()->getShdFragListIndCmdBuf(),
+                  ACCESS_READ, USAGE_INDIRECT_COMMAND);
+  declareResource(vctScene->getVoxelFragList()->getShdVoxelFragList(),
+                  ACCESS_READ, USAGE_IMAGE);
+  declareResource(vctScene->getNodePool()->getShdNodePool(NEXT),
+                  ACCESS_READ_WRITE, USAGE_IMAGE);
 }
@@ -28,11 +28,13 @@
 
 #include "KoRE/Passes/ShaderProgramPass.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
+#include "VoxelConeTracing/Util/BarrierPlanner.h"
 #include "KoRE/SceneManager.h"
 #include "KoRE/RenderManager.h"
 #include "KoRE/ResourceManager.h"
 
-class ObFlagPass : public kore::ShaderProgramPass
+class ObFlagPass : public kore::ShaderProgramPass,
+                   public ResourceUsage
 {
   public:
     ObFlagPass(VCTscene* vctScene,
@@ -44,7 +46,7 @@ class ObFlagPass : public kore::ShaderProgramPass
     kore::SceneManager* _sceneMgr;
     kore::ResourceManager* _resMgr;
 
-    kore::ShaderProgram _flagShader;
+    kore::ShaderProgram* _flagShader;
     VCTscene* _vctScene;
 };
 
@@ -28,6 +28,8 @@
 #include "KoRE\RenderManager.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
 #include "Kore\Operations\Operations.h"
+#include "VoxelConeTracing/Util/ShaderProgramCache.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
 
 BorderTransferPass::
   BorderTransferPass(VCTscene* vctScene, EBrickPoolAttributes eBrickPool, EThreadMode eThreadMode,
@@ -35,7 +37,8 @@ BorderTransferPass::
   using namespace kore;
 
   _name = std::string("BorderTransfer (level: ").append(std::to_string(level).append(")"));
-  _useGPUProfiling = vctScene->getUseGPUprofiling();
+  GPUprofiler::getInstance()->addPass(this);
+  bool useCompute = vctScene->getUseComputeShaders();
 
   this->setExecutionType(executionType);
   _level = level;
@@ -65,90 +68,100 @@ BorderTransferPass::
   _shdLevel.type = GL_INT;
   _shdLevel.data = &_level;
     
+  std::string defines = ThreadDispatch::getShaderDefines(useCompute);
   if (eThreadMode == THREAD_MODE_COMPLETE) {
-    _shader.loadShader("./assets/shader/BorderTransfer.shader",
-                       GL_VERTEX_SHADER, "#define THREAD_MODE 0\n\n");
+    defines += "#define THREAD_MODE 0\n";
   } else if (eThreadMode == THREAD_MODE_LIGHT) {
-    _shader.loadShader("./assets/shader/BorderTransfer.shader",
-                        GL_VERTEX_SHADER, "#define THREAD_MODE 1\n\n");
+    defines += "#define THREAD_MODE 1\n";
   }
-  
-  _shader.setName("BorderTransfer shader");
-  _shader.init();
 
-  this->setShaderProgram(&_shader);
-  addStartupOperation(new ColorMaskOp(glm::bvec4(false, false, false, false)));
+  _shader = ShaderProgramCache::getInstance()->getProgram(
+    "BorderTransfer shader", "./assets/shader/BorderTransfer.shader",
+    ThreadDispatch::getShaderType(useCompute),
+    defines);
+
+  this->setShaderProgram(_shader);
 
+  GLuint indirectBuffer = 0;
   if (eThreadMode == THREAD_MODE_LIGHT) {
-    addStartupOperation(
-      new kore::BindBuffer(GL_DRAW_INDIRECT_BUFFER,
-      vctScene->getThreadBuf_nodeMap(level)->getHandle()));
+    indirectBuffer = vctScene->getLightNodeListCmdBuf(level)->getBufferHandle();
 
     addStartupOperation(new BindTexture(
-      vctScene->getShdLightNodeMapSampler(),
-      _shader.getUniform("nodeMap")));
-
-    addStartupOperation(new BindUniform(vctScene->getShdNodeMapOffsets(),
-      _shader.getUniform("nodeMapOffset[0]")));
-
-    addStartupOperation(new BindUniform(vctScene->getShdNodeMapSizes(),
-      _shader.getUniform("nodeMapSize[0]")));
+      vctScene->getShdLightNodeListSampler(level),
+      _shader->getUniform("lightNodeList")));
 
   } else {
-    addStartupOperation(
-      new kore::BindBuffer(GL_DRAW_INDIRECT_BUFFER,
-      vctScene->getNodePool()->getDenseThreadBuf(_level)->getHandle()));
+    indirectBuffer =
+      vctScene->getNodePool()->getDenseThreadBuf(_level)->getHandle();
 
     addStartupOperation(
       new kore::BindUniform(vctScene->getNodePool()->getShdNumLevels(),
-      _shader.getUniform("numLevels")));
+      _shader->getUniform("numLevels")));
 
     addStartupOperation(
       new kore::BindTexture(
       vctScene->getNodePool()->getShdLevelAddressBufferSampler(),
-      _shader.getUniform("levelAddressBuffer")));
+      _shader->getUniform("levelAddressBuffer")));
   }
 
-  addStartupOperation(new BindUniform(&_shdLevel, _shader.getUniform("level")));
+  addStartupOperation(new BindUniform(&_shdLevel, _shader->getUniform("level")));
   
   addStartupOperation(new BindTexture(
     vctScene->getNodePool()->getShdNodePoolSampler(COLOR),
-    _shader.getUniform("nodePool_color")));
+    _shader->getUniform("nodePool_color")));
 
   addStartupOperation(new BindImageTexture(
     vctScene->getBrickPool()->getShdBrickPool(eBrickPool),
-    _shader.getUniform("brickPool_value")));
+    _shader->getUniform("brickPool_value")));
 
     // X Axis ADD
-  addStartupOperation(new BindUniform(&_shdAxisX, _shader.getUniform("axis")));
+  addStartupOperation(new BindUniform(&_shdAxisX, _shader->getUniform("axis")));
   addStartupOperation(new BindTexture(
     vctScene->getNodePool()->getShdNodePoolSampler(NEIGHBOUR_X),
-    _shader.getUniform("nodePool_Neighbour")));
+    _shader->getUniform("nodePool_Neighbour")));
 
-  addStartupOperation(new DrawIndirectOp(GL_POINTS, 0));
+  ThreadDispatch::addLaunchOperations(this, indirectBuffer, useCompute);
   addStartupOperation(new MemoryBarrierOp(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
   //////////////////////////////////////////////////////////////////////////
   
   // Y Axis ADD
-  addStartupOperation(new BindUniform(&_shdAxisY, _shader.getUniform("axis")));
+  addStartupOperation(new BindUniform(&_shdAxisY, _shader->getUniform("axis")));
   addStartupOperation(new BindTexture(
     vctScene->getNodePool()->getShdNodePoolSampler(NEIGHBOUR_Y),
-    _shader.getUniform("nodePool_Neighbour")));
+    _shader->getUniform("nodePool_Neighbour")));
 
-  addStartupOperation(new DrawIndirectOp(GL_POINTS, 0));
+  ThreadDispatch::addLaunchOperations(this, indirectBuffer, useCompute);
   addStartupOperation(new MemoryBarrierOp(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
   //////////////////////////////////////////////////////////////////////////
    
   // Z Axis ADD
-  addStartupOperation(new BindUniform(&_shdAxisZ, _shader.getUniform("axis")));
+  addStartupOperation(new BindUniform(&_shdAxisZ, _shader->getUniform("axis")));
   addStartupOperation(new BindTexture(
     vctScene->getNodePool()->getShdNodePoolSampler(NEIGHBOUR_Z),
-    _shader.getUniform("nodePool_Neighbour")));
+    _shader->getUniform("nodePool_Neighbour")));
 
-  addStartupOperation(new DrawIndirectOp(GL_POINTS, 0));
-  addStartupOperation(new MemoryBarrierOp(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
+  ThreadDispatch::addLaunchOperations(this, indirectBuffer, useCompute);
   //////////////////////////////////////////////////////////////////////////
 
+  if (eThreadMode == THREAD_MODE_LIGHT) {
+    declareResource(vctScene->getShdLightNodeListCmdBuf(level),
+                    ACCESS_READ, USAGE_INDIRECT_COMMAND);
+    declareResource(vctScene->getShdLightNodeListSampler(level),
+                    ACCESS_READ, USAGE_TEXTURE_FETCH);
+  } else {
+    declareResource(vctScene->getNodePool()->getShdLevelAddressBufferSampler(),
+                    ACCESS_READ, USAGE_TEXTURE_FETCH);
+  }
+  declareResource(vctScene->getNodePool()->getShdNodePoolSampler(COLOR),
+                  ACCESS_READ, USAGE_TEXTURE_FETCH);
+  declareResource(vctScene->getNodePool()->getShdNodePoolSampler(NEIGHBOUR_X),
+                  ACCESS_READ, USAGE_TEXTURE_FETCH);
+  declareResource(vctScene->getNodePool()->getShdNodePoolSampler(NEIGHBOUR_Y),
+                  ACCESS_READ, USAGE_TEXTURE_FETCH);
+  declareResource(vctScene->getNodePool()->getShdNodePoolSampler(NEIGHBOUR_Z),
+                  ACCESS_READ, USAGE_TEXTURE_FETCH);
+  declareResource(vctScene->getBrickPool()->getShdBrickPool(eBrickPool),
+                  ACCESS_READ_WRITE, USAGE_IMAGE);
 }
 
 BorderTransferPass::~BorderTransferPass(void) {
@@ -28,9 +28,11 @@
 
 #include "KoRE/Passes/ShaderProgramPass.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
+#include "VoxelConeTracing/Util/BarrierPlanner.h"
 
 
-class BorderTransferPass : public kore::ShaderProgramPass
+class BorderTransferPass : public kore::ShaderProgramPass,
+                           public ResourceUsage
 {
   public:
        BorderTransferPass(VCTscene* vctScene, 
@@ -42,7 +44,7 @@ class BorderTransferPass : public kore::ShaderProgramPass
     virtual ~BorderTransferPass(void);
 
   private:
-    kore::ShaderProgram _shader;
+    kore::ShaderProgram* _shader;
     
     int _level;
     kore::ShaderData _shdLevel;
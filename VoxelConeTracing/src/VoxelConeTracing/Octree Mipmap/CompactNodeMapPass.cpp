@@ -0,0 +1,101 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#include "VoxelConeTracing/Octree Mipmap/CompactNodeMapPass.h"
+#include "KoRE/Operations/Operations.h"
+#include "KoRE/Operations/ResetAtomicCounterBuffer.h"
+#include "VoxelConeTracing/Util/ShaderProgramCache.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
+
+CompactNodeMapPass::
+  CompactNodeMapPass(VCTscene* vctScene, uint level,
+                     kore::EOperationExecutionType executionType) {
+  using namespace kore;
+
+  _name = std::string("CompactNodeMap (level: ").append(std::to_string(level).append(")"));
+  GPUprofiler::getInstance()->addPass(this);
+  bool useCompute = vctScene->getUseComputeShaders();
+
+  this->setExecutionType(executionType);
+
+  _level = level;
+  _shdLevel.component = NULL;
+  _shdLevel.name = "Level";
+  _shdLevel.size = 1;
+  _shdLevel.type = GL_UNSIGNED_INT;
+  _shdLevel.data = &_level;
+
+  _shader = ShaderProgramCache::getInstance()->getProgram(
+    "CompactNodeMap shader", "./assets/shader/CompactNodeMap.shader",
+    ThreadDispatch::getShaderType(useCompute),
+    ThreadDispatch::getShaderDefines(useCompute));
+  this->setShaderProgram(_shader);
+
+  addStartupOperation(
+    new ResetAtomicCounterBuffer(vctScene->getShdAcLightNodeList(level), 0));
+
+  // One thread per nodemap-texel of this level
+  addStartupOperation(new BindTexture(
+    vctScene->getShdLightNodeMapSampler(),
+    _shader->getUniform("nodeMap")));
+
+  addStartupOperation(new BindUniform(vctScene->getShdNodeMapOffsets(),
+    _shader->getUniform("nodeMapOffset[0]")));
+
+  addStartupOperation(new BindUniform(vctScene->getShdNodeMapSizes(),
+    _shader->getUniform("nodeMapSize[0]")));
+
+  addStartupOperation(new BindUniform(&_shdLevel, _shader->getUniform("level")));
+
+  addStartupOperation(new BindImageTexture(
+    vctScene->getShdLightNodeFlags(),
+    _shader->getUniform("nodeFlags")));
+
+  addStartupOperation(new BindImageTexture(
+    vctScene->getShdLightNodeList(level),
+    _shader->getUniform("lightNodeList")));
+
+  addStartupOperation(new BindAtomicCounterBuffer(
+    vctScene->getShdAcLightNodeList(level),
+    _shader->getUniform("numLightNodes")));
+
+  ThreadDispatch::addLaunchOperations(this,
+    vctScene->getThreadBuf_nodeMap(level)->getHandle(),
+    useCompute);
+
+  declareResource(vctScene->getShdLightNodeMapSampler(),
+                  ACCESS_READ, USAGE_TEXTURE_FETCH);
+  declareResource(vctScene->getShdLightNodeFlags(),
+                  ACCESS_READ_WRITE, USAGE_IMAGE);
+  declareResource(vctScene->getShdLightNodeList(level),
+                  ACCESS_WRITE, USAGE_IMAGE);
+  declareResource(vctScene->getShdAcLightNodeList(level),
+                  ACCESS_WRITE, USAGE_BUFFER_UPDATE);
+  declareResource(vctScene->getShdAcLightNodeList(level),
+                  ACCESS_READ_WRITE, USAGE_ATOMIC_COUNTER);
+}
+
+CompactNodeMapPass::~CompactNodeMapPass(void) {
+}
@@ -0,0 +1,54 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#ifndef VCT_SRC_VCT_COMPACTNODEMAPPASS_H_
+#define VCT_SRC_VCT_COMPACTNODEMAPPASS_H_
+
+#include "KoRE/Passes/ShaderProgramPass.h"
+#include "VoxelConeTracing/Scene/VCTscene.h"
+#include "VoxelConeTracing/Util/BarrierPlanner.h"
+
+/*! Writes all unique nodes of one level of the light node map into the
+*   light node list of that level. The number of nodes is counted in the
+*   level's atomic counter, which has to be copied into the list's indirect
+*   command buffer afterwards (see ModifyIndirectBufferPass).
+*/
+class CompactNodeMapPass : public kore::ShaderProgramPass,
+                           public ResourceUsage
+{
+  public:
+    CompactNodeMapPass(VCTscene* vctScene,
+                       uint level,
+                       kore::EOperationExecutionType executionType);
+    virtual ~CompactNodeMapPass(void);
+
+  private:
+    kore::ShaderProgram* _shader;
+
+    uint _level;
+    kore::ShaderData _shdLevel;
+};
+
+#endif //VCT_SRC_VCT_COMPACTNODEMAPPASS_H_
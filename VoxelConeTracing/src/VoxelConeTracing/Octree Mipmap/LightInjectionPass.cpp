@@ -28,32 +28,41 @@
 #include "VoxelConeTracing/Octree Mipmap/LightInjectionPass.h"
 #include "KoRE/Operations/Operations.h"
 #include "VoxelConeTracing/FullscreenQuad.h"
+#include "VoxelConeTracing/Util/ShaderProgramCache.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
 
 
 LightInjectionPass::LightInjectionPass(VCTscene* vctScene,
-                                kore::SceneNode* lightNode,
-                                kore::FrameBuffer* shadowMapFBO,
                                 kore::EOperationExecutionType executionType) {
 
   using namespace kore;
 
   _name = std::string("Light Injection");
-  _useGPUProfiling = vctScene->getUseGPUprofiling();
+  GPUprofiler::getInstance()->addPass(this);
+  bool useCompute = vctScene->getUseComputeShaders();
 
   this->setExecutionType(executionType);
   _vctScene = vctScene;
   _renderMgr = RenderManager::getInstance();
   _sceneMgr = SceneManager::getInstance();
   _resMgr = ResourceManager::getInstance();
-  _shadowMapFBO = shadowMapFBO;
 
+  ShadowMapArray* shadowMaps = vctScene->getShadowMapArray();
 
-  ShaderProgram* shader = new ShaderProgram;
+  _phaseMark = 0;
+  _shdPhaseMark.type = GL_UNSIGNED_INT;
+  _shdPhaseMark.data = &_phaseMark;
 
-  shader->loadShader("./assets/shader/LightInjectionFrag.shader",
-    GL_VERTEX_SHADER);
-  shader->setName("light injection shader");
-  shader->init();
+  _phaseResolve = 1;
+  _shdPhaseResolve.type = GL_UNSIGNED_INT;
+  _shdPhaseResolve.data = &_phaseResolve;
+
+
+  ShaderProgram* shader = ShaderProgramCache::getInstance()->getProgram(
+    "light injection shader", "./assets/shader/LightInjectionFrag.shader",
+    ThreadDispatch::getShaderType(useCompute),
+    ShadowMapArray::getShaderDefines()
+    + ThreadDispatch::getShaderDefines(useCompute));
 
   this->setShaderProgram(shader);
 
@@ -61,18 +70,11 @@ LightInjectionPass::LightInjectionPass(VCTscene* vctScene,
   texSamplerProps.wrapping = glm::uvec3(GL_REPEAT, GL_REPEAT, GL_REPEAT);
   texSamplerProps.minfilter = GL_NEAREST;
   texSamplerProps.magfilter = GL_NEAREST;
-  texSamplerProps.type = GL_SAMPLER_2D;
+  texSamplerProps.type = GL_SAMPLER_2D_ARRAY;
   shader->setSamplerProperties(0, texSamplerProps);
 
-  addStartupOperation(new BindBuffer(
-    GL_DRAW_INDIRECT_BUFFER,
-    _vctScene->getThreadBuf_nodeMap(_vctScene->getNodePool()->getNumLevels() - 1)->getHandle()));
-
-  addStartupOperation(new ColorMaskOp(glm::bvec4(true, true, true, true)));
-  
-  std::vector<ShaderData>& vSMBufferTex = shadowMapFBO->getOutputs();
   addStartupOperation(new BindTexture(
-                         &vSMBufferTex[1],
+                         shadowMaps->getShdPositionArraySampler(),
                           shader->getUniform("smPosition")));
 
   addStartupOperation(new BindUniform(
@@ -82,14 +84,12 @@ LightInjectionPass::LightInjectionPass(VCTscene* vctScene,
                         vctScene->getNodePool()->getShdNumLevels(),
                         shader->getUniform("numLevels")));
 
-  kore::LightComponent* lightComp = static_cast<LightComponent*>(lightNode->getComponent(COMPONENT_LIGHT));
-  addStartupOperation(new BindUniform(
-                         lightComp->getShaderData("color"),
-                         shader->getUniform("lightColor")));
-
-  addStartupOperation(new BindUniform(
-                          lightComp->getShaderData("direction"),
-                          shader->getUniform("lightDir")));
+  addStartupOperation(new BindUniform(shadowMaps->getShdNumLights(),
+                                      shader->getUniform("numLights")));
+  addStartupOperation(new BindUniform(shadowMaps->getShdLightColors(),
+                                      shader->getUniform("lightColor[0]")));
+  addStartupOperation(new BindUniform(shadowMaps->getShdLightDirs(),
+                                      shader->getUniform("lightDir[0]")));
 
   addStartupOperation(new BindTexture(
                          vctScene->getNodePool()->getShdNodePoolSampler(NEXT),
@@ -121,23 +121,44 @@ LightInjectionPass::LightInjectionPass(VCTscene* vctScene,
   addStartupOperation(new BindUniform(vctScene->getShdNodeMapSizes(),
                                       shader->getUniform("nodeMapSize[0]")));
 
-  addStartupOperation(new DrawIndirectOp(GL_POINTS, 0));
-
-  this->addFinishOperation(new MemoryBarrierOp(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
+  addStartupOperation(new BindImageTexture(vctScene->getShdLightMask(),
+                                           shader->getUniform("lightMask")));
+
+  addStartupOperation(new BindUniform(vctScene->getShdInjectLights(),
+                                      shader->getUniform("injectLights")));
+
+  // Each voxel gets the summed radiance of all lights that see it. The
+  // lights first mark the voxels they see and then all threads resolve the
+  // marks, so the threads of one voxel don't race with different values.
+  uint leafLevel = _vctScene->getNodePool()->getNumLevels() - 1;
+  GLuint indirectBuffer =
+    _vctScene->getThreadBuf_nodeMap(leafLevel)->getHandle();
+
+  addStartupOperation(new BindUniform(&_shdPhaseMark,
+                                      shader->getUniform("injectionPhase")));
+  ThreadDispatch::addLaunchOperations(this, indirectBuffer, useCompute);
+  addStartupOperation(new MemoryBarrierOp(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
+
+  addStartupOperation(new BindUniform(&_shdPhaseResolve,
+                                      shader->getUniform("injectionPhase")));
+  ThreadDispatch::addLaunchOperations(this, indirectBuffer, useCompute);
+
+  declareResource(vctScene->getNodePool()->getShdNodePoolSampler(NEXT),
+                  ACCESS_READ, USAGE_TEXTURE_FETCH);
+  declareResource(vctScene->getNodePool()->getShdNodePoolSampler(COLOR),
+                  ACCESS_READ, USAGE_TEXTURE_FETCH);
+  declareResource(vctScene->getBrickPool()->getShdBrickPool(BRICKPOOL_COLOR),
+                  ACCESS_READ, USAGE_IMAGE);
+  declareResource(vctScene->getBrickPool()->getShdBrickPool(BRICKPOOL_IRRADIANCE),
+                  ACCESS_WRITE, USAGE_IMAGE);
+  declareResource(vctScene->getShdLightNodeMap(),
+                  ACCESS_WRITE, USAGE_IMAGE);
+  declareResource(vctScene->getShdLightMask(),
+                  ACCESS_READ_WRITE, USAGE_IMAGE);
 
   
 }
 
 
-void LightInjectionPass::setViewport() {
-  RenderManager::getInstance()->bindFrameBuffer(GL_FRAMEBUFFER, _shadowMapFBO->getHandle());
-  RenderManager::getInstance()->setViewport(glm::ivec4(0, 0, 2048, 2048));
-}
-
-void LightInjectionPass::resetFBO() {
-  _renderMgr->bindFrameBuffer(GL_FRAMEBUFFER, 0);
-}
-
-
 LightInjectionPass::~LightInjectionPass(void) {
 }
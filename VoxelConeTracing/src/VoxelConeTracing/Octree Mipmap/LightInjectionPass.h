@@ -28,16 +28,17 @@
 
 #include "KoRE/Passes/ShaderProgramPass.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
+#include "VoxelConeTracing/Util/BarrierPlanner.h"
 #include "KoRE/SceneManager.h"
 #include "KoRE/RenderManager.h"
 #include "KoRE/ResourceManager.h"
 
 
-class LightInjectionPass : public kore::ShaderProgramPass
+class LightInjectionPass : public kore::ShaderProgramPass,
+                           public ResourceUsage
 {
 public:
-  LightInjectionPass(VCTscene* vctScene, kore::SceneNode* lightNode,
-                      kore::FrameBuffer* shadowMapFBO,
+  LightInjectionPass(VCTscene* vctScene,
                       kore::EOperationExecutionType executionType);
   virtual ~LightInjectionPass(void);
  
@@ -47,10 +48,11 @@ private:
   kore::ResourceManager* _resMgr;
   VCTscene* _vctScene;
 
-  kore::FrameBuffer* _shadowMapFBO;
+  uint _phaseMark;
+  kore::ShaderData _shdPhaseMark;
 
- void setViewport();
- void resetFBO();
+  uint _phaseResolve;
+  kore::ShaderData _shdPhaseResolve;
 };
 
 #endif
\ No newline at end of file
@@ -28,11 +28,13 @@
 
 #include "KoRE/Passes/ShaderProgramPass.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
+#include "VoxelConeTracing/Util/BarrierPlanner.h"
 #include "KoRE/SceneManager.h"
 #include "KoRE/RenderManager.h"
 #include "KoRE/ResourceManager.h"
 
-class MipmapCenterPass : public kore::ShaderProgramPass
+class MipmapCenterPass : public kore::ShaderProgramPass,
+                         public ResourceUsage
 {
   public:
     MipmapCenterPass(VCTscene* vctScene,
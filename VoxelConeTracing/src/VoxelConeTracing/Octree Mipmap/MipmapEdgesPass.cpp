@@ -30,6 +30,8 @@
 #include "KoRE\ResourceManager.h"
 
 #include "Kore\Operations\Operations.h"
+#include "VoxelConeTracing/Util/ShaderProgramCache.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
 
 MipmapEdgesPass::~MipmapEdgesPass(void) {
 }
@@ -43,7 +45,8 @@ MipmapEdgesPass::
   using namespace kore;
 
   _name = std::string("MipmapEdges (level: ").append(std::to_string(level).append(")"));
-  _useGPUProfiling = vctScene->getUseGPUprofiling();
+  GPUprofiler::getInstance()->addPass(this);
+  bool useCompute = vctScene->getUseComputeShaders();
   
   this->setExecutionType(executionType);
 
@@ -59,42 +62,34 @@ MipmapEdgesPass::
   _shdLevel.name = "OctreeLevel";
   _shdLevel.type = GL_UNSIGNED_INT;
 
-  kore::ShaderProgram* shp = new kore::ShaderProgram;
-  this->setShaderProgram(shp);
-
+  std::string defines = ThreadDispatch::getShaderDefines(useCompute);
   if (mipmapMode == THREAD_MODE_COMPLETE) {
-    shp->loadShader("./assets/shader/MipmapEdges.shader",
-      GL_VERTEX_SHADER, "#define THREAD_MODE 0\n\n");
+    defines += "#define THREAD_MODE 0\n";
   } else if (mipmapMode == THREAD_MODE_LIGHT) {
-    shp->loadShader("./assets/shader/MipmapEdges.shader",
-      GL_VERTEX_SHADER, "#define THREAD_MODE 1\n\n");
+    defines += "#define THREAD_MODE 1\n";
   }
-  
-  shp->setName("MipmapEdges shader");
-  shp->init();
+
+  kore::ShaderProgram* shp = ShaderProgramCache::getInstance()->getProgram(
+    "MipmapEdges shader", "./assets/shader/MipmapEdges.shader",
+    ThreadDispatch::getShaderType(useCompute),
+    defines);
+  this->setShaderProgram(shp);
 
   shp->startUniformBindingCheck();
 
   // Launch a thread for every node up to _level
+  GLuint indirectBuffer = 0;
   if (mipmapMode == THREAD_MODE_LIGHT) {
-    addStartupOperation(
-      new kore::BindBuffer(GL_DRAW_INDIRECT_BUFFER,
-      _vctScene->getThreadBuf_nodeMap(level)->getHandle()));
+    indirectBuffer =
+      _vctScene->getLightNodeListCmdBuf(level)->getBufferHandle();
 
     addStartupOperation(new BindTexture(
-      _vctScene->getShdLightNodeMapSampler(),
-      shp->getUniform("nodeMap")));
-
-    addStartupOperation(new BindUniform(vctScene->getShdNodeMapOffsets(),
-      shp->getUniform("nodeMapOffset[0]")));
-
-    addStartupOperation(new BindUniform(vctScene->getShdNodeMapSizes(),
-      shp->getUniform("nodeMapSize[0]")));
+      _vctScene->getShdLightNodeListSampler(level),
+      shp->getUniform("lightNodeList")));
 
   } else {
-    addStartupOperation(
-      new kore::BindBuffer(GL_DRAW_INDIRECT_BUFFER,
-      _vctScene->getNodePool()->getDenseThreadBuf(_level)->getHandle()));
+    indirectBuffer =
+      _vctScene->getNodePool()->getDenseThreadBuf(_level)->getHandle();
 
     addStartupOperation(
       new kore::BindUniform(_vctScene->getNodePool()->getShdNumLevels(),
@@ -106,8 +101,6 @@ MipmapEdgesPass::
       shp->getUniform("levelAddressBuffer")));
   }
 
-  addStartupOperation(new ColorMaskOp(glm::bvec4(false, false, false, false)));
-
   addStartupOperation(new BindImageTexture(
                     vctScene->getBrickPool()->getShdBrickPool(eBrickPoolAtt),
                                           shp->getUniform("brickPool_value")));
@@ -120,10 +113,23 @@ MipmapEdgesPass::
 
   addStartupOperation(new BindUniform(&_shdLevel, shp->getUniform("level")));
   
-  addStartupOperation(
-    new kore::DrawIndirectOp(GL_POINTS, 0));
+  ThreadDispatch::addLaunchOperations(this, indirectBuffer, useCompute);
 
-  addFinishOperation(new MemoryBarrierOp(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
+  if (mipmapMode == THREAD_MODE_LIGHT) {
+    declareResource(vctScene->getShdLightNodeListCmdBuf(level),
+                    ACCESS_READ, USAGE_INDIRECT_COMMAND);
+    declareResource(vctScene->getShdLightNodeListSampler(level),
+                    ACCESS_READ, USAGE_TEXTURE_FETCH);
+  } else {
+    declareResource(vctScene->getNodePool()->getShdLevelAddressBufferSampler(),
+                    ACCESS_READ, USAGE_TEXTURE_FETCH);
+  }
+  declareResource(vctScene->getBrickPool()->getShdBrickPool(eBrickPoolAtt),
+                  ACCESS_READ_WRITE, USAGE_IMAGE);
+  declareResource(vctScene->getNodePool()->getShdNodePool(NEXT),
+                  ACCESS_READ, USAGE_IMAGE);
+  declareResource(vctScene->getNodePool()->getShdNodePool(COLOR),
+                  ACCESS_READ, USAGE_IMAGE);
 
   shp->finishUniformBindingCheck();
 }
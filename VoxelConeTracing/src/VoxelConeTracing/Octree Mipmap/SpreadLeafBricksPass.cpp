@@ -29,6 +29,8 @@
 #include "KoRE\ResourceManager.h"
 
 #include "Kore\Operations\Operations.h"
+#include "VoxelConeTracing/Util/ShaderProgramCache.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
 
 SpreadLeafBricksPass::~SpreadLeafBricksPass(void) {
 }
@@ -41,7 +43,8 @@ SpreadLeafBricksPass::
   using namespace kore;
   
   _name = std::string("SpreadLeafs");
-  _useGPUProfiling = vctScene->getUseGPUprofiling();
+  GPUprofiler::getInstance()->addPass(this);
+  bool useCompute = vctScene->getUseComputeShaders();
 
   this->setExecutionType(executionType);
 
@@ -50,40 +53,33 @@ SpreadLeafBricksPass::
   _sceneMgr = SceneManager::getInstance();
   _resMgr = ResourceManager::getInstance();
 
-  kore::ShaderProgram* shp = new kore::ShaderProgram;
-  this->setShaderProgram(shp);
-  shp->setName("SpreadLeafBricks shader");
-
+  std::string defines = ThreadDispatch::getShaderDefines(useCompute);
   if (eThreadMode == THREAD_MODE_COMPLETE) {
-    shp->loadShader("./assets/shader/SpreadLeafBricks.shader",
-      GL_VERTEX_SHADER, "#define THREAD_MODE 0\n\n");
+    defines += "#define THREAD_MODE 0\n";
   } else if (eThreadMode == THREAD_MODE_LIGHT) {
-    shp->loadShader("./assets/shader/SpreadLeafBricks.shader",
-      GL_VERTEX_SHADER, "#define THREAD_MODE 1\n\n");
+    defines += "#define THREAD_MODE 1\n";
   }
 
-  shp->init();
+  kore::ShaderProgram* shp = ShaderProgramCache::getInstance()->getProgram(
+    "SpreadLeafBricks shader", "./assets/shader/SpreadLeafBricks.shader",
+    ThreadDispatch::getShaderType(useCompute),
+    defines);
+  this->setShaderProgram(shp);
   shp->startUniformBindingCheck();
     
+  uint leafLevel = vctScene->getNodePool()->getNumLevels() - 1;
+  GLuint indirectBuffer = 0;
   if (eThreadMode == THREAD_MODE_LIGHT) {
-    addStartupOperation(
-      new kore::BindBuffer(GL_DRAW_INDIRECT_BUFFER,
-      vctScene->getThreadBuf_nodeMap(vctScene->getNodePool()->getNumLevels() - 1)->getHandle()));
+    indirectBuffer =
+      vctScene->getLightNodeListCmdBuf(leafLevel)->getBufferHandle();
 
     addStartupOperation(new BindTexture(
-      vctScene->getShdLightNodeMapSampler(),
-      shp->getUniform("nodeMap")));
-
-    addStartupOperation(new BindUniform(vctScene->getShdNodeMapOffsets(),
-      shp->getUniform("nodeMapOffset[0]")));
-
-    addStartupOperation(new BindUniform(vctScene->getShdNodeMapSizes(),
-      shp->getUniform("nodeMapSize[0]")));
+      vctScene->getShdLightNodeListSampler(vctScene->getNodePool()->getNumLevels() - 1),
+      shp->getUniform("lightNodeList")));
 
   } else {
-    addStartupOperation(
-      new kore::BindBuffer(GL_DRAW_INDIRECT_BUFFER,
-      vctScene->getNodePool()->getDenseThreadBuf(vctScene->getNodePool()->getNumLevels() - 1)->getHandle()));
+    indirectBuffer =
+      vctScene->getNodePool()->getDenseThreadBuf(leafLevel)->getHandle();
 
     addStartupOperation(
       new kore::BindTexture(
@@ -91,8 +87,6 @@ SpreadLeafBricksPass::
       shp->getUniform("levelAddressBuffer")));
   }
 
-  addStartupOperation(new ColorMaskOp(glm::bvec4(false, false, false, false)));
-
   addStartupOperation(
     new kore::BindUniform(vctScene->getNodePool()->getShdNumLevels(),
     shp->getUniform("numLevels")));
@@ -105,12 +99,21 @@ SpreadLeafBricksPass::
     vctScene->getBrickPool()->getShdBrickPool(eBrickPool),
     shp->getUniform("brickPool_value")));
 
+  ThreadDispatch::addLaunchOperations(this, indirectBuffer, useCompute);
 
-
-  addStartupOperation(
-    new kore::DrawIndirectOp(GL_POINTS, 0));
-
-  addFinishOperation(new MemoryBarrierOp(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
+  if (eThreadMode == THREAD_MODE_LIGHT) {
+    declareResource(vctScene->getShdLightNodeListCmdBuf(leafLevel),
+                    ACCESS_READ, USAGE_INDIRECT_COMMAND);
+    declareResource(vctScene->getShdLightNodeListSampler(leafLevel),
+                    ACCESS_READ, USAGE_TEXTURE_FETCH);
+  } else {
+    declareResource(vctScene->getNodePool()->getShdLevelAddressBufferSampler(),
+                    ACCESS_READ, USAGE_TEXTURE_FETCH);
+  }
+  declareResource(vctScene->getNodePool()->getShdNodePool(COLOR),
+                  ACCESS_READ, USAGE_IMAGE);
+  declareResource(vctScene->getBrickPool()->getShdBrickPool(eBrickPool),
+                  ACCESS_READ_WRITE, USAGE_IMAGE);
 
   shp->finishUniformBindingCheck();
 }
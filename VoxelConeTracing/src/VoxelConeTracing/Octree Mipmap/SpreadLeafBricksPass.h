@@ -28,12 +28,14 @@
 
 #include "KoRE/Passes/ShaderProgramPass.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
+#include "VoxelConeTracing/Util/BarrierPlanner.h"
 #include "KoRE/SceneManager.h"
 #include "KoRE/RenderManager.h"
 #include "KoRE/ResourceManager.h"
 
 
-class SpreadLeafBricksPass : public kore::ShaderProgramPass
+class SpreadLeafBricksPass : public kore::ShaderProgramPass,
+                             public ResourceUsage
 {
   public:
     SpreadLeafBricksPass(VCTscene* vctScene,
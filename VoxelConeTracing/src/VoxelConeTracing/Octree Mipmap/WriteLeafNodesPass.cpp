@@ -29,6 +29,8 @@
 #include "KoRE\ResourceManager.h"
 
 #include "Kore\Operations\Operations.h"
+#include "VoxelConeTracing/Util/ShaderProgramCache.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
 
 WriteLeafNodesPass::~WriteLeafNodesPass(void) {
 }
@@ -39,7 +41,8 @@ WriteLeafNodesPass::
   using namespace kore;
   
   _name = std::string("Write leafs");
-  _useGPUProfiling = vctScene->getUseGPUprofiling();
+  GPUprofiler::getInstance()->addPass(this);
+  bool useCompute = vctScene->getUseComputeShaders();
 
   this->setExecutionType(executionType);
 
@@ -48,20 +51,14 @@ WriteLeafNodesPass::
   _sceneMgr = SceneManager::getInstance();
   _resMgr = ResourceManager::getInstance();
 
-  kore::ShaderProgram* shp = new kore::ShaderProgram;
+  kore::ShaderProgram* shp = ShaderProgramCache::getInstance()->getProgram(
+    "OctreeWriteLeaf shader", "./assets/shader/OctreeWriteLeafs.shader",
+    ThreadDispatch::getShaderType(useCompute),
+    ThreadDispatch::getShaderDefines(useCompute));
   this->setShaderProgram(shp);
-  shp->setName("OctreeWriteLeaf shader");
-  shp->loadShader("./assets/shader/OctreeWriteLeafs.shader",
-                 GL_VERTEX_SHADER);
-  shp->init();
   
   
   // Launch a thread for every node up to the max level
-  addStartupOperation(
-    new kore::BindBuffer(GL_DRAW_INDIRECT_BUFFER,
-        _vctScene->getVoxelFragList()->getFragListIndCmdBuf()->getBufferHandle()));
-  addStartupOperation(new ColorMaskOp(glm::bvec4(false, false, false, false)));
-
   addStartupOperation(new BindUniform(vctScene->getNodePool()->getShdNumLevels(),
                                               shp->getUniform("numLevels")));
 
@@ -100,8 +97,26 @@ WriteLeafNodesPass::
   addStartupOperation(new BindUniform(vctScene->getShdVoxelGridResolution(),
                                       shp->getUniform("voxelGridResolution")));
 
-  addStartupOperation(
-    new kore::DrawIndirectOp(GL_POINTS, 0));
-
-  addFinishOperation(new MemoryBarrierOp(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
+  ThreadDispatch::addLaunchOperations(this,
+    _vctScene->getVoxelFragList()->getFragListIndCmdBuf()->getBufferHandle(),
+    useCompute);
+
+  declareResource(vctScene->getVoxelFragList()->getShdFragListIndCmdBuf(),
+                  ACCESS_READ, USAGE_INDIRECT_COMMAND);
+  declareResource(vctScene->getVoxelFragList()->getShdVoxelFragList(),
+                  ACCESS_READ, USAGE_IMAGE);
+  declareResource(vctScene->getVoxelFragTex()->getShdVoxelFragTex(VOXELATT_COLOR),
+                  ACCESS_READ, USAGE_IMAGE);
+  declareResource(vctScene->getVoxelFragTex()->getShdVoxelFragTex(VOXELATT_NORMAL),
+                  ACCESS_READ, USAGE_IMAGE);
+  declareResource(vctScene->getNodePool()->getShdNodePool(NEXT),
+                  ACCESS_READ, USAGE_IMAGE);
+  declareResource(vctScene->getNodePool()->getShdNodePool(COLOR),
+                  ACCESS_READ, USAGE_IMAGE);
+  declareResource(vctScene->getBrickPool()->getShdBrickPool(BRICKPOOL_COLOR),
+                  ACCESS_WRITE, USAGE_IMAGE);
+  declareResource(vctScene->getBrickPool()->getShdBrickPool(BRICKPOOL_NORMAL),
+                  ACCESS_WRITE, USAGE_IMAGE);
+  declareResource(vctScene->getBrickPool()->getShdBrickPool(BRICKPOOL_IRRADIANCE),
+                  ACCESS_WRITE, USAGE_IMAGE);
 }
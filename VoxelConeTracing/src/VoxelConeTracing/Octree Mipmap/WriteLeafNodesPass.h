@@ -28,12 +28,14 @@
 
 #include "KoRE/Passes/ShaderProgramPass.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
+#include "VoxelConeTracing/Util/BarrierPlanner.h"
 #include "KoRE/SceneManager.h"
 #include "KoRE/RenderManager.h"
 #include "KoRE/ResourceManager.h"
 
 
-class WriteLeafNodesPass : public kore::ShaderProgramPass
+class WriteLeafNodesPass : public kore::ShaderProgramPass,
+                           public ResourceUsage
 {
   public:
     WriteLeafNodesPass(VCTscene* vctScene,
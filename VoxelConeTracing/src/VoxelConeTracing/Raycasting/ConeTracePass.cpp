@@ -26,13 +26,14 @@
 #include "ConeTracePass.h"
 #include "VoxelConeTracing/FullscreenQuad.h"
 #include "KoRE/Operations/Operations.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
 
 
 ConeTracePass::ConeTracePass(VCTscene* vctScene){
   using namespace kore;
 
   _name = std::string("ConeTrace");
-  _useGPUProfiling = vctScene->getUseGPUprofiling();
+  GPUprofiler::getInstance()->addPass(this);
 
     _vctScene = vctScene;
     _renderMgr = RenderManager::getInstance();
@@ -119,7 +120,7 @@ ConeTracePass::ConeTracePass(VCTscene* vctScene){
 
     addStartupOperation(new BindTexture(vctScene->getBrickPool()->getShdBrickPoolTexture(BRICKPOOL_COLOR),
                                         _coneTraceShader.getUniform("brickPool_color")));
-    addStartupOperation(new BindTexture(vctScene->getBrickPool()->getShdBrickPoolTexture(BRICKPOOL_IRRADIANCE),
+    addStartupOperation(new BindTexture(vctScene->getBrickPool()->getShdBrickPoolTexture(BRICKPOOL_IRRADIANCE_DISPLAY),
                                         _coneTraceShader.getUniform("brickPool_irradiance")));
     addStartupOperation(new BindTexture(vctScene->getBrickPool()->getShdBrickPoolTexture(BRICKPOOL_NORMAL),
                                         _coneTraceShader.getUniform("brickPool_normal")));
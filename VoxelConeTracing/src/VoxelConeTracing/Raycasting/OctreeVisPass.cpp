@@ -32,6 +32,7 @@
 #include "KoRE\RenderManager.h"
 #include "KoRE\ResourceManager.h"
 #include "KoRE\Components\TexturesComponent.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
 
 
 OctreeVisPass::~OctreeVisPass(void) {
@@ -41,7 +42,7 @@ OctreeVisPass::OctreeVisPass(VCTscene* vctScene) {
   using namespace kore;
 
   _name = std::string("Octree Vis");
-  _useGPUProfiling = vctScene->getUseGPUprofiling();
+  GPUprofiler::getInstance()->addPass(this);
   
   _vctScene = vctScene;
   _renderMgr = RenderManager::getInstance();
@@ -35,13 +35,14 @@
 #include "KoRE\RenderManager.h"
 #include "KoRE\ResourceManager.h"
 #include "KoRE\Components\TexturesComponent.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
 
 
 RayCastingPass::RayCastingPass(VCTscene* vctScene) {
   using namespace kore;
 
   _name = std::string("Raycasting Pass");
-  _useGPUProfiling = vctScene->getUseGPUprofiling();
+  GPUprofiler::getInstance()->addPass(this);
   
   _raycastShader
      .loadShader("./assets/shader/VoxelConeTracing/raycastVert.shader",
@@ -29,14 +29,21 @@
 #include "KoRE\Components\TexturesComponent.h"
 #include "KoRE\RenderManager.h"
 #include "KoRE\TextureSampler.h"
+#include "KoRE\Operations\FunctionOp.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
+#include "VoxelConeTracing/Util/CommandList.h"
 
 
 
-DeferredPass::DeferredPass(kore::Camera* cam, std::vector<kore::SceneNode*>& vRenderNodes){
+DeferredPass::DeferredPass(kore::Camera* cam,
+                           std::vector<kore::SceneNode*>& vRenderNodes,
+                           MeshBatch* meshBatch)
+  : _commandList(NULL),
+    _batchDraw(NULL) {
   using namespace kore;
 
   _name = std::string("GBuffer Pass");
-  _useGPUProfiling = true;
+  GPUprofiler::getInstance()->addPass(this);
 
   _useNMap_false = 0;
   _useNMap_true = 1;
@@ -52,10 +59,11 @@ DeferredPass::DeferredPass(kore::Camera* cam, std::vector<kore::SceneNode*>& vRe
   kore::ShaderProgram* shader = new kore::ShaderProgram;
   this->setShaderProgram(shader);
 
+  std::string defines = meshBatch ? MeshBatch::getShaderDefines() : "";
   shader->loadShader("./assets/shader/deferredVert.shader",
-    GL_VERTEX_SHADER);
+    GL_VERTEX_SHADER, defines);
   shader->loadShader("./assets/shader/deferredFrag.shader",
-    GL_FRAGMENT_SHADER);
+    GL_FRAGMENT_SHADER, defines);
   
   shader->setName("deferred shader");
   shader->init();
@@ -66,6 +74,15 @@ DeferredPass::DeferredPass(kore::Camera* cam, std::vector<kore::SceneNode*>& vRe
                                      renderMgr->getScreenResolution().x,
                                      renderMgr->getScreenResolution().y)));
   addStartupOperation(new ClearOp());
+
+  _vNodes.resize(vRenderNodes.size(), -1);
+
+  if (meshBatch) {
+    initBatchedDraw(cam, vRenderNodes, meshBatch, shader);
+    return;
+  }
+
+  _commandList = new CommandList(this, shader);
   
   for (uint i = 0; i < vRenderNodes.size(); ++i) {
     const TexturesComponent* texComp =
@@ -83,6 +100,8 @@ DeferredPass::DeferredPass(kore::Camera* cam, std::vector<kore::SceneNode*>& vRe
       continue;
     }
 
+    _vNodes[i] = _commandList->getNumNodes();
+
     std::vector<const Texture*> normalTextures =
                           texComp->getTextures(TEXSEMANTICS_NORMAL);
 
@@ -97,56 +116,90 @@ DeferredPass::DeferredPass(kore::Camera* cam, std::vector<kore::SceneNode*>& vRe
     MeshComponent* meshComp =
       static_cast<MeshComponent*>(vRenderNodes[i]->getComponent(COMPONENT_MESH));
 
-    nodePass
-      ->addOperation(OperationFactory::create(OP_BINDATTRIBUTE, "v_position",
-                                              meshComp, "v_position", shader));
-    nodePass
-      ->addOperation(OperationFactory::create(OP_BINDATTRIBUTE, "v_normal",
-                                              meshComp, "v_normal", shader));
-    nodePass
-      ->addOperation(OperationFactory::create(OP_BINDATTRIBUTE, "v_tangent",
-                                              meshComp, "v_tangent", shader));
-
-    nodePass
-      ->addOperation(OperationFactory::create(OP_BINDATTRIBUTE, "v_uv0",
-                                              meshComp, "v_uv0", shader));
-    nodePass
-      ->addOperation(OperationFactory::create(OP_BINDUNIFORM, "projection Matrix",
-                                              cam,"projectionMat", shader));
-    nodePass
-      ->addOperation(OperationFactory::create(OP_BINDUNIFORM, "view Matrix",
-                                              cam, "viewMat", shader));
-    nodePass
-      ->addOperation(OperationFactory::create(OP_BINDUNIFORM, "model Matrix",
-                                              vRenderNodes[i]->getTransform(),
-                                              "modelMat", shader));
-    nodePass
-      ->addOperation(OperationFactory::create(OP_BINDUNIFORM, "normal Matrix",
-                                              vRenderNodes[i]->getTransform(),
-                                              "normalMat", shader));
-
-
-
-    nodePass
-      ->addOperation(OperationFactory::create(OP_BINDTEXTURE, diffTextures[0]->getName(),
-                                              texComp, "diffuseTex", shader));
+    _commandList->beginNode(nodePass);
+    _commandList->bindAttribute("v_position", meshComp, "v_position");
+    _commandList->bindAttribute("v_normal", meshComp, "v_normal");
+    _commandList->bindAttribute("v_tangent", meshComp, "v_tangent");
+    _commandList->bindAttribute("v_uv0", meshComp, "v_uv0");
+    _commandList->bindUniform("projection Matrix", cam, "projectionMat");
+    _commandList->bindUniform("view Matrix", cam, "viewMat");
+    _commandList->bindUniform("model Matrix", vRenderNodes[i]->getTransform(),
+                              "modelMat");
+    _commandList->bindUniform("normal Matrix",
+                              vRenderNodes[i]->getTransform(), "normalMat");
+
+    _commandList->bindTexture(diffTextures[0]->getName(), texComp,
+                              "diffuseTex");
 
     if(normalTextures.size() == 0) {
-      nodePass->addOperation(new BindUniform(&_shdUseNmapFalse, shader->getUniform("useNormalMap")));
+      _commandList->bindUniform(&_shdUseNmapFalse, "useNormalMap");
     } else {
-      nodePass->addOperation(new BindUniform(&_shdUseNmapTrue, shader->getUniform("useNormalMap")));
-      
-      nodePass
-        ->addOperation(OperationFactory::create(OP_BINDTEXTURE, normalTextures[0]->getName(),
-                                               texComp, "normalTex", shader));
+      _commandList->bindUniform(&_shdUseNmapTrue, "useNormalMap");
+      _commandList->bindTexture(normalTextures[0]->getName(), texComp,
+                                "normalTex");
     }
 
-    nodePass
-      ->addOperation(new RenderMesh(meshComp));
+    _commandList->draw(meshComp);
   }
+
+  _commandList->bake();
 }
 
 
 DeferredPass::~DeferredPass(void)
 {
+  delete _commandList;
+  delete _batchDraw;
+}
+
+void DeferredPass::initBatchedDraw(kore::Camera* cam,
+                          const std::vector<kore::SceneNode*>& vRenderNodes,
+                          MeshBatch* meshBatch, kore::ShaderProgram* shader) {
+  using namespace kore;
+
+  kore::TexSamplerProperties samplerProps;
+  samplerProps.type = GL_SAMPLER_2D_ARRAY;
+  samplerProps.wrapping = glm::uvec3(GL_REPEAT);
+  samplerProps.minfilter = GL_LINEAR_MIPMAP_LINEAR;
+  samplerProps.magfilter = GL_LINEAR;
+  shader->setSamplerProperties("diffuseTexArray", samplerProps);
+  shader->setSamplerProperties("normalTexArray", samplerProps);
+
+  addStartupOperation(OperationFactory::create(OP_BINDUNIFORM,
+                                               "projection Matrix", cam,
+                                               "projectionMat", shader));
+  addStartupOperation(OperationFactory::create(OP_BINDUNIFORM,
+                                               "view Matrix", cam,
+                                               "viewMat", shader));
+
+  // Meshes without diffuse texture are left out as in the per-node path
+  _batchDraw = new MeshBatchDraw(this, meshBatch,
+                                 shader->getUniform("diffuseTexArray"),
+                                 shader->getUniform("normalTexArray"));
+  for (uint i = 0; i < meshBatch->getNumDraws(); ++i) {
+    _batchDraw->setDrawEnabled(i,
+                               meshBatch->getDrawData(i).diffuseLayer >= 0);
+  }
+
+  for (uint i = 0; i < vRenderNodes.size(); ++i) {
+    int draw = meshBatch->getDraw(vRenderNodes[i]);
+    if (draw >= 0 && meshBatch->getDrawData(draw).diffuseLayer >= 0) {
+      _vNodes[i] = draw;
+    }
+  }
+
+  addStartupOperation(
+    new FunctionOp(std::bind(&MeshBatchDraw::execute, _batchDraw)));
+}
+
+void DeferredPass::setNodeVisible(uint renderNode, bool visible) {
+  if (_vNodes[renderNode] < 0) {
+    return;
+  }
+
+  if (_batchDraw) {
+    _batchDraw->setDrawEnabled(_vNodes[renderNode], visible);
+  } else {
+    _commandList->setNodeEnabled(_vNodes[renderNode], visible);
+  }
 }
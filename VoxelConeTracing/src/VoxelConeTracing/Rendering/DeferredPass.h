@@ -28,19 +28,38 @@
 
 #include "KoRE/Passes/ShaderProgramPass.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
+#include "VoxelConeTracing/Scene/MeshBatch.h"
+
+class CommandList;
 
 class DeferredPass : public kore::ShaderProgramPass
 {
 public:
-  DeferredPass(kore::Camera* cam, std::vector<kore::SceneNode*>& vRenderNodes);
+  /// Draws the nodes separately or all meshes of meshBatch at once if it
+  /// is not NULL.
+  DeferredPass(kore::Camera* cam, std::vector<kore::SceneNode*>& vRenderNodes,
+               MeshBatch* meshBatch = NULL);
   ~DeferredPass(void);
 
+  /// Skips the render node if it is not visible
+  void setNodeVisible(uint renderNode, bool visible);
+
 private:
+  void initBatchedDraw(kore::Camera* cam,
+                       const std::vector<kore::SceneNode*>& vRenderNodes,
+                       MeshBatch* meshBatch, kore::ShaderProgram* shader);
+
   int _useNMap_true;
   int _useNMap_false;
   kore::ShaderData _shdUseNmapTrue;
   kore::ShaderData _shdUseNmapFalse;
 
+  CommandList* _commandList;
+  MeshBatchDraw* _batchDraw;
+
+  // Command list node or batch draw of each render node, -1 if not drawn
+  std::vector<int> _vNodes;
+
 };
 
 #endif //VCT_SRC_VCT_DEFERREDPASS_H_
\ No newline at end of file
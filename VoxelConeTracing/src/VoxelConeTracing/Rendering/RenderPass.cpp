@@ -26,18 +26,60 @@
 #include "RenderPass.h"
 #include "VoxelConeTracing/FullscreenQuad.h"
 #include "KoRE/Operations/Operations.h"
+#include "KoRE/Operations/FunctionOp.h"
 #include "KoRE/RenderManager.h"
 #include "KoRE/SceneNode.h"
-
-
-RenderPass::RenderPass(kore::FrameBuffer* gBuffer, kore::FrameBuffer* smBuffer,
-                       std::vector<SceneNode*> lightNodes, VCTscene* vctScene) {
+#include "VoxelConeTracing/Util/GPUprofiler.h"
+#include "VoxelConeTracing/Scene/VCTcascades.h"
+#include "VoxelConeTracing/Scene/BrickCache.h"
+#include "VoxelConeTracing/Util/GPUreadback.h"
+#include "VoxelConeTracing/Util/Instrumentation.h"
+
+#include <cfloat>
+#include <vector>
+
+
+RenderPass::RenderPass(kore::FrameBuffer* gBuffer, VCTscene* vctScene,
+                       VCTcascades* cascades, uint cascade,
+                       BrickCache* brickCache)
+  : _stepsPerCone(0.0f),
+    _numCones(0),
+    _coneTraceStatsWidth(0),
+    _coneTraceStatsPending(false) {
   using namespace kore;
 
   _name = std::string("Final Render pass");
-  _useGPUProfiling = vctScene->getUseGPUprofiling();
+  if (cascade > 0) {
+    _name += " (cascade " + std::to_string((unsigned long long)cascade) + ")";
+  }
+  GPUprofiler::getInstance()->addPass(this);
+
+  // The tweak parameters of cascade 0 apply to all cascades
+  VCTscene* tweakScene = cascades ? cascades->getScene(0) : vctScene;
+  _cascadeGridRange = cascades ? cascades->getGridRange(cascade)
+                               : glm::vec2(0.0f, FLT_MAX);
+  _shdCascadeGridRange.name = "cascade grid range";
+  _shdCascadeGridRange.type = GL_FLOAT_VEC2;
+  _shdCascadeGridRange.size = 1;
+  _shdCascadeGridRange.data = &_cascadeGridRange;
+
+  // The finest cascade has no finer one, its range starts at 0
+  VCTscene* finerScene = cascades && cascade > 0 ?
+                         cascades->getScene(cascade - 1) : vctScene;
 
   RenderManager* renderMgr = RenderManager::getInstance();
+  ShadowMapArray* shadowMaps = vctScene->getShadowMapArray();
+
+  std::string defines = std::string("#define LEAF_NODE_RESOLUTION ")
+    + std::to_string(vctScene->getNodePool()->getLeafNodeResolution())
+    + std::string("\n") + ShadowMapArray::getShaderDefines()
+    + std::string("\n");
+  if (brickCache) {
+    defines += BrickCache::getShaderDefines();
+  }
+  if (Instrumentation::CONE_TRACE_STATS) {
+    defines += "#define CONE_TRACE_STATS\n";
+  }
 
   ShaderProgram* shader = new ShaderProgram;
 
@@ -45,9 +87,7 @@ RenderPass::RenderPass(kore::FrameBuffer* gBuffer, kore::FrameBuffer* smBuffer,
                               GL_VERTEX_SHADER);
 
   shader->loadShader("./assets/shader/finalRenderFrag.shader",
-    GL_FRAGMENT_SHADER, std::string("#define LEAF_NODE_RESOLUTION ")
-    + std::to_string(vctScene->getNodePool()->getLeafNodeResolution())
-    + std::string("\n\n"));
+                     GL_FRAGMENT_SHADER, defines);
   shader->setName("final render shader");
   shader->init();
   
@@ -58,6 +98,12 @@ RenderPass::RenderPass(kore::FrameBuffer* gBuffer, kore::FrameBuffer* smBuffer,
   texSamplerNearest.minfilter = GL_NEAREST;
   texSamplerNearest.magfilter = GL_NEAREST;
 
+  kore::TexSamplerProperties texSamplerArrayNearest;
+  texSamplerArrayNearest.type = GL_SAMPLER_2D_ARRAY;
+  texSamplerArrayNearest.wrapping = glm::uvec3(GL_CLAMP_TO_EDGE);
+  texSamplerArrayNearest.minfilter = GL_NEAREST;
+  texSamplerArrayNearest.magfilter = GL_NEAREST;
+
   kore::TexSamplerProperties texSampler3DLinear;
   texSampler3DLinear.type = GL_SAMPLER_3D;
   texSampler3DLinear.wrapping = glm::uvec3(GL_REPEAT);
@@ -74,23 +120,67 @@ RenderPass::RenderPass(kore::FrameBuffer* gBuffer, kore::FrameBuffer* smBuffer,
   shader->setSamplerProperties("brickPool_normal", texSampler3DLinear);
   shader->setSamplerProperties("brickPool_irradiance", texSampler3DLinear);
   shader->setSamplerProperties("gBuffer_color", texSamplerNearest);
-  shader->setSamplerProperties("gBuffer_pos", texSamplerNearest);
   shader->setSamplerProperties("gBuffer_normal", texSamplerNearest);
   shader->setSamplerProperties("gBuffer_tangent", texSamplerNearest);
-  shader->setSamplerProperties("shadowMap", texSamplerNearest);
+  shader->setSamplerProperties("gBuffer_depth", texSamplerNearest);
+  shader->setSamplerProperties("shadowMap", texSamplerArrayNearest);
   shader->setSamplerProperties("randomTex", texSampler2DLinearRepeat);  
   
   this->setShaderProgram(shader);
 
-  addStartupOperation(new EnableDisableOp(GL_DEPTH_TEST, EnableDisableOp::ENABLE));
+  // The quads of the coarser cascades are drawn at the same depth
+  addStartupOperation(new EnableDisableOp(GL_DEPTH_TEST, cascade == 0 ?
+                                          EnableDisableOp::ENABLE :
+                                          EnableDisableOp::DISABLE));
   addStartupOperation(new ColorMaskOp(glm::bvec4(true, true, true, true)));
   addStartupOperation(new ViewportOp(glm::ivec4(0, 0,
                                      renderMgr->getScreenResolution().x,
                                      renderMgr->getScreenResolution().y)));
-  addStartupOperation(new ClearOp());
+  if (cascade == 0) {
+    addStartupOperation(new ClearOp());
+  }
   
   kore::Camera* cam = vctScene->getCamera();
 
+  _camera = cam;
+  _shdViewProjI.name = "inverse view projection Matrix";
+  _shdViewProjI.type = GL_FLOAT_MAT4;
+  _shdViewProjI.size = 1;
+  _shdViewProjI.data = &_viewProjI;
+  addStartupOperation(
+    new FunctionOp(std::bind(&RenderPass::updateViewProjI, this)));
+
+  // Every pixel stores its own counts, which are summed on the CPU. This
+  // avoids the contention of global atomics and the overflow of a 32 bit
+  // sum. All pixels are written each frame, so the buffer isn't cleared.
+  if (Instrumentation::CONE_TRACE_STATS) {
+    glm::ivec2 resolution = renderMgr->getScreenResolution();
+    _coneTraceStatsWidth = resolution.x;
+    _shdConeTraceStatsWidth.name = "Cone trace stats width";
+    _shdConeTraceStatsWidth.type = GL_UNSIGNED_INT;
+    _shdConeTraceStatsWidth.size = 1;
+    _shdConeTraceStatsWidth.data = &_coneTraceStatsWidth;
+
+    std::vector<uint> zeros(resolution.x * resolution.y * 2, 0);
+    STextureBufferProperties statsProps;
+    statsProps.internalFormat = GL_R32UI;
+    statsProps.size = sizeof(uint) * zeros.size();
+    statsProps.usageHint = GL_DYNAMIC_COPY;
+    _coneTraceStats.create(statsProps, "Cone trace stats", &zeros[0]);
+
+    _coneTraceStatsTexInfo.internalFormat = GL_R32UI;
+    _coneTraceStatsTexInfo.texLocation = _coneTraceStats.getTexHandle();
+    _coneTraceStatsTexInfo.texTarget = GL_TEXTURE_BUFFER;
+
+    _shdConeTraceStats.name = "Cone trace stats";
+    _shdConeTraceStats.type = GL_TEXTURE_BUFFER;
+    _shdConeTraceStats.size = 1;
+    _shdConeTraceStats.data = &_coneTraceStatsTexInfo;
+
+    addFinishOperation(
+      new FunctionOp(std::bind(&RenderPass::requestConeTraceStats, this)));
+  }
+
   SceneNode* fsquadnode = new SceneNode();
   SceneManager::getInstance()->getRootNode()->addChild(fsquadnode);
 
@@ -102,35 +192,34 @@ RenderPass::RenderPass(kore::FrameBuffer* gBuffer, kore::FrameBuffer* smBuffer,
   this->addNodePass(nodePass);
 
   std::vector<ShaderData>& vGBufferTex = gBuffer->getOutputs();
-  std::vector<ShaderData>& vSMBufferTex = smBuffer->getOutputs();
 
   shader->startUniformBindingCheck();
   
   // TEXTURES
   nodePass->addOperation(
     new BindTexture(
-      vctScene->getBrickPool()->getShdBrickPoolTexture(BRICKPOOL_COLOR),
+      vctScene->getBrickPool()->getShdBrickPoolDisplayTexture(BRICKPOOL_COLOR),
       shader->getUniform("brickPool_color")));
 
   nodePass->addOperation(
     new BindTexture(
-      vctScene->getBrickPool()->getShdBrickPoolTexture(BRICKPOOL_IRRADIANCE),
+      vctScene->getBrickPool()->getShdBrickPoolTexture(BRICKPOOL_IRRADIANCE_DISPLAY),
       shader->getUniform("brickPool_irradiance")));
 
   nodePass->addOperation(
     new BindTexture(
-      vctScene->getBrickPool()->getShdBrickPoolTexture(BRICKPOOL_NORMAL),
+      vctScene->getBrickPool()->getShdBrickPoolDisplayTexture(BRICKPOOL_NORMAL),
       shader->getUniform("brickPool_normal")));
 
   nodePass->addOperation(new BindTexture(&vGBufferTex[0],
                          shader->getUniform("gBuffer_color")));
   nodePass->addOperation(new BindTexture(&vGBufferTex[1],
-                         shader->getUniform("gBuffer_pos")));
-  nodePass->addOperation(new BindTexture(&vGBufferTex[2],
                          shader->getUniform("gBuffer_normal")));
+  nodePass->addOperation(new BindTexture(&vGBufferTex[2],
+                         shader->getUniform("gBuffer_tangent")));
   nodePass->addOperation(new BindTexture(&vGBufferTex[3],
-                        shader->getUniform("gBuffer_tangent")));
-  nodePass->addOperation(new BindTexture(&vSMBufferTex[0],
+                         shader->getUniform("gBuffer_depth")));
+  nodePass->addOperation(new BindTexture(shadowMaps->getShdDepthArraySampler(),
                          shader->getUniform("shadowMap")));
   /*
   nodePass->addOperation(new BindImageTexture(
@@ -139,31 +228,41 @@ RenderPass::RenderPass(kore::FrameBuffer* gBuffer, kore::FrameBuffer* smBuffer,
       GL_READ_ONLY));
       */
 
-  nodePass->addOperation(new BindTexture(vctScene->getNodePool()->getShdNodePoolSampler(NEXT),
+  // The SVO being constructed or lit is not rendered, see VCTscene
+  nodePass->addOperation(new BindTexture(vctScene->getNodePool()->getShdNodePoolDisplaySampler(NEXT),
                                          shader->getUniform("nodePool_nextS")));
 
-  nodePass->addOperation(new BindTexture(vctScene->getNodePool()->getShdNodePoolSampler(COLOR),
+  nodePass->addOperation(new BindTexture(vctScene->getNodePool()->getShdNodePoolDisplaySampler(COLOR),
                                          shader->getUniform("nodePool_colorS")));
 
+  if (brickCache) {
+    nodePass->addOperation(new BindImageTexture(
+      brickCache->getShdNodeUsage(),
+      shader->getUniform("nodePool_usage"), GL_READ_WRITE));
+    nodePass->addOperation(new BindUniform(brickCache->getShdUsageStamp(),
+                                    shader->getUniform("brickUsageStamp")));
+  }
+
+  if (Instrumentation::CONE_TRACE_STATS) {
+    nodePass->addOperation(new BindImageTexture(&_shdConeTraceStats,
+      shader->getUniform("coneTraceStats"), GL_WRITE_ONLY));
+    nodePass->addOperation(new BindUniform(&_shdConeTraceStatsWidth,
+      shader->getUniform("coneTraceStatsWidth")));
+  }
+
   //////////////////////////////////////////////////////////////////////////
 
-  kore::Camera* lightcam = static_cast<Camera*>(lightNodes[0]->getComponent(COMPONENT_CAMERA));
-  kore::LightComponent* light = static_cast<LightComponent*>(lightNodes[0]->getComponent(COMPONENT_LIGHT));
-  
   nodePass
-    ->addOperation(new BindUniform(lightcam->getShaderData("projection Matrix"),
-    shader->getUniform("lightCamProjMat")));
+    ->addOperation(new BindUniform(shadowMaps->getShdNumLights(),
+    shader->getUniform("numLights")));
 
   nodePass
-    ->addOperation(new BindUniform(lightcam->getShaderData("view Matrix"),
-    shader->getUniform("lightCamviewMat")));
+    ->addOperation(new BindUniform(shadowMaps->getShdLightViewProjs(),
+    shader->getUniform("lightViewProj[0]")));
 
   nodePass
-    ->addOperation(new BindUniform(light->getShaderData("position"),
-    shader->getUniform("lightPos")));
-  nodePass
-    ->addOperation(new BindUniform(light->getShaderData("direction"),
-    shader->getUniform("lightDir")));
+    ->addOperation(new BindUniform(shadowMaps->getShdLightDirs(),
+    shader->getUniform("lightDir[0]")));
 
   nodePass->addOperation(OperationFactory::create(OP_BINDATTRIBUTE, 
                                                   "v_position",
@@ -202,9 +301,19 @@ RenderPass::RenderPass(kore::FrameBuffer* gBuffer, kore::FrameBuffer* smBuffer,
                                                   "viewI",
                                                   shader));
 
-  nodePass->addOperation(OperationFactory::create(OP_BINDUNIFORM,
-    "inverse model Matrix", vctScene->getVoxelGridNode()->getTransform(),
-    "voxelGridTransformI", shader));
+  nodePass->addOperation(new BindUniform(&_shdViewProjI,
+                                         shader->getUniform("viewProjI")));
+
+  nodePass->addOperation(new BindUniform(&_shdCascadeGridRange,
+                                     shader->getUniform("cascadeGridRange")));
+
+  nodePass->addOperation(new BindUniform(
+    vctScene->getShdDisplayGridTransformI(),
+    shader->getUniform("voxelGridTransformI")));
+
+  nodePass->addOperation(new BindUniform(
+    finerScene->getShdDisplayGridTransformI(),
+    shader->getUniform("finerGridTransformI")));
 
   nodePass->addOperation(new BindUniform(vctScene->getNodePool()->getShdNumLevels(),
                                          shader->getUniform("numLevels"))); 
@@ -214,20 +323,21 @@ RenderPass::RenderPass(kore::FrameBuffer* gBuffer, kore::FrameBuffer* smBuffer,
 
   //////////////////////////////////////////////////////////////////////////
   // Tweak-Parameters
-  nodePass->addOperation(new BindUniform(vctScene->getShdGIintensity(),
+  nodePass->addOperation(new BindUniform(tweakScene->getShdGIintensity(),
                                          shader->getUniform("giIntensity")));
-  nodePass->addOperation(new BindUniform(vctScene->getShdSpecGIintensity(),
+  nodePass->addOperation(new BindUniform(tweakScene->getShdSpecGIintensity(),
                                          shader->getUniform("specGiIntensity")));
-  nodePass->addOperation(new BindUniform(vctScene->getShdSpecExponent(),
+  nodePass->addOperation(new BindUniform(tweakScene->getShdSpecExponent(),
                                          shader->getUniform("specExponent")));
-  nodePass->addOperation(new BindUniform(vctScene->getShdUseLighting(),
+  nodePass->addOperation(new BindUniform(tweakScene->getShdUseLighting(),
                                          shader->getUniform("useLighting")));
-  nodePass->addOperation(new BindUniform(vctScene->getShdUseWideCone(),
+  nodePass->addOperation(new BindUniform(tweakScene->getShdUseWideCone(),
                                           shader->getUniform("useWideCone")));
-  nodePass->addOperation(new BindUniform(&vctScene->_shdConeDiameter, shader->getUniform("coneAngle")));
-  //nodePass->addOperation(new BindUniform(&vctScene->_shdConeMaxDistance, shader->getUniform("coneMaxDistance")));
-  nodePass->addOperation(new BindUniform(&vctScene->_shdRenderAO, shader->getUniform("renderAO")));
-  //nodePass->addOperation(new BindUniform(&vctScene->_shdUseAlphaCorrection, shader->getUniform("useAlphaCorrection")));
+  nodePass->addOperation(new BindUniform(&tweakScene->_shdConeDiameter, shader->getUniform("coneAngle")));
+  //nodePass->addOperation(new BindUniform(&tweakScene->_shdConeMaxDistance, shader->getUniform("coneMaxDistance")));
+  nodePass->addOperation(new BindUniform(&tweakScene->_shdRenderAO, shader->getUniform("renderAO")));
+  nodePass->addOperation(new BindUniform(&tweakScene->_shdSkipEmptySpace, shader->getUniform("skipEmptySpace")));
+  //nodePass->addOperation(new BindUniform(&tweakScene->_shdUseAlphaCorrection, shader->getUniform("useAlphaCorrection")));
   //////////////////////////////////////////////////////////////////////////
 
   nodePass->addOperation(new RenderMesh(fsqMeshComponent));
@@ -239,3 +349,37 @@ RenderPass::RenderPass(kore::FrameBuffer* gBuffer, kore::FrameBuffer* smBuffer,
 RenderPass::~RenderPass(void)
 {
 }
+
+void RenderPass::updateViewProjI() {
+  const glm::mat4& viewProj = *static_cast<glm::mat4*>(
+    _camera->getShaderData("view projection Matrix")->data);
+  _viewProjI = glm::inverse(viewProj);
+}
+
+void RenderPass::requestConeTraceStats() {
+  // The buffer is large, so only one readback is in flight
+  if (_coneTraceStatsPending) {
+    return;
+  }
+
+  _coneTraceStatsPending = true;
+  GPUreadback::getInstance()->request(_coneTraceStats.getBufferHandle(), 0,
+    (uint)(_coneTraceStats.getProperties().size / sizeof(uint)),
+    std::bind(&RenderPass::onConeTraceStats, this,
+              std::placeholders::_1, std::placeholders::_2));
+}
+
+void RenderPass::onConeTraceStats(const uint* values, uint numValues) {
+  _coneTraceStatsPending = false;
+
+  unsigned long long numCones = 0;
+  unsigned long long numSteps = 0;
+  for (uint i = 0; i + 1 < numValues; i += 2) {
+    numCones += values[i];
+    numSteps += values[i + 1];
+  }
+
+  _numCones = static_cast<uint>(glm::min(numCones, 0xFFFFFFFFULL));
+  _stepsPerCone = numCones > 0 ?
+    static_cast<float>(static_cast<double>(numSteps) / numCones) : 0.0f;
+}
@@ -28,12 +28,51 @@
 #include "KoRE\Passes\ShaderProgramPass.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
 #include "KoRE/SceneNode.h"
+#include "KoRE/TextureBuffer.h"
+
+class VCTcascades;
+class BrickCache;
 
 class RenderPass : public kore::ShaderProgramPass
 {
 public:
-  RenderPass(kore::FrameBuffer* gBuffer, kore::FrameBuffer* smBuffer, std::vector<kore::SceneNode*> lightNodes, VCTscene* vctScene);
+  /// With cascades, the pass only shades the pixels within the distance
+  /// range of the cascade of vctScene. The passes of the coarser cascades
+  /// have to follow the one of cascade 0, which clears the framebuffer.
+  /// With a brickCache, the sampled nodes are reported to it.
+  RenderPass(kore::FrameBuffer* gBuffer, VCTscene* vctScene,
+             VCTcascades* cascades = NULL, uint cascade = 0,
+             BrickCache* brickCache = NULL);
   ~RenderPass(void);
+
+  /// Average steps of the cones of the last measured frame. Only counted
+  /// with the TIMING instrumentation.
+  inline float* getStepsPerConePtr() {return &_stepsPerCone;}
+  inline uint* getNumConesPtr() {return &_numCones;}
+
+private:
+  // The world-space position is reconstructed from the G-buffer depth
+  void updateViewProjI();
+
+  kore::Camera* _camera;
+  glm::mat4 _viewProjI;
+  kore::ShaderData _shdViewProjI;
+
+  glm::vec2 _cascadeGridRange;
+  kore::ShaderData _shdCascadeGridRange;
+
+  void requestConeTraceStats();
+  void onConeTraceStats(const uint* values, uint numValues);
+
+  // Two values per pixel, see finalRenderFrag.shader
+  kore::TextureBuffer _coneTraceStats;
+  kore::STextureInfo _coneTraceStatsTexInfo;
+  kore::ShaderData _shdConeTraceStats;
+  uint _coneTraceStatsWidth;
+  kore::ShaderData _shdConeTraceStatsWidth;
+  bool _coneTraceStatsPending;
+  float _stepsPerCone;
+  uint _numCones;
 };
 
 #endif //VCT_SRC_VCT_RENDERPASS_H_
\ No newline at end of file
@@ -23,25 +23,52 @@
 * \author Andreas Weinmann (andy.weinmann@gmail.com)
 */
 
+#include <sstream>
+
 #include "ShadowMapPass.h"
 #include "KoRE\RenderManager.h"
 #include "KoRE\SceneManager.h"
 #include "KoRE\Operations\Operations.h"
+#include "KoRE\Operations\FunctionOp.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
+#include "VoxelConeTracing/Util/CommandList.h"
+
+
+ShadowMapPass::ShadowMapPass(std::vector<kore::SceneNode*>& vRenderNodes,
+                             ShadowMapArray* shadowMaps, uint light,
+                             EShadowMapPassType type,
+                             kore::FrameBuffer* shadowBuffer,
+                             kore::EOperationExecutionType executionType,
+                             MeshBatch* meshBatch)
+  : _shadowMaps(shadowMaps),
+    _light(light),
+    _type(type),
+    _shadowBuffer(shadowBuffer),
+    _commandList(NULL),
+    _batchDraw(NULL),
+    _cacheFBO(0) {
+  using namespace kore;
 
+  std::stringstream name;
+  if (type == SHADOWMAP_PASS_STATIC) {
+    name << "Static Shadow Map Construction (light: " << light << ")";
+  } else {
+    name << "Shadow Map Construction (light: " << light << ")";
+  }
+  _name = name.str();
+  GPUprofiler::getInstance()->addPass(this);
 
-ShadowMapPass::ShadowMapPass(std::vector<kore::SceneNode*>& vRenderNodes, kore::SceneNode* light, glm::uvec2 smSize)
-{
-  using namespace kore;
+  this->setExecutionType(executionType);
 
-  _name = std::string("Shadow Map Construction");
-  _useGPUProfiling = true;
+  glm::uvec2 smSize = shadowMaps->getResolution();
 
   RenderManager* renderMgr = RenderManager::getInstance();
 
   ShaderProgram* shader = new ShaderProgram;
 
+  std::string defines = meshBatch ? MeshBatch::getShaderDefines() : "";
   shader->loadShader("./assets/shader/ShadowMapVert.shader",
-    GL_VERTEX_SHADER);
+    GL_VERTEX_SHADER, defines);
 
   shader->loadShader("./assets/shader/ShadowMapFrag.shader",
     GL_FRAGMENT_SHADER);
@@ -52,13 +79,49 @@ ShadowMapPass::ShadowMapPass(std::vector<kore::SceneNode*>& vRenderNodes, kore::
   this->setShaderProgram(shader);
 
 
-
+  addStartupOperation(
+    new FunctionOp(std::bind(&ShadowMapPass::attachLayer, this)));
   addStartupOperation(new EnableDisableOp(GL_DEPTH_TEST, EnableDisableOp::ENABLE));
   addStartupOperation(new ViewportOp(glm::ivec4(0,0,smSize.x, smSize.y)));
   addStartupOperation(new ColorMaskOp(glm::bvec4(true, true, true, true)));
-  addStartupOperation(new ClearOp());
 
-  kore::Camera* lightcam = static_cast<Camera*>(light->getComponent(COMPONENT_CAMERA));
+  if (type == SHADOWMAP_PASS_STATIC) {
+    addStartupOperation(new ClearOp());
+  } else {
+    glGenFramebuffers(1, &_cacheFBO);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _cacheFBO);
+    glFramebufferTextureLayer(GL_READ_FRAMEBUFFER,
+                              GL_DEPTH_STENCIL_ATTACHMENT,
+                              _shadowMaps->getStaticDepthArray()->getHandle(),
+                              0, _light);
+    glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           _shadowMaps->getStaticPositionArray()->getHandle(),
+                           0, _light);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    addStartupOperation(
+      new FunctionOp(std::bind(&ShadowMapPass::copyStaticCache, this)));
+  }
+
+  kore::Camera* lightcam = static_cast<Camera*>(
+    shadowMaps->getLightNode(light)->getComponent(COMPONENT_CAMERA));
+
+  if (meshBatch) {
+    addStartupOperation(
+      new BindUniform(lightcam->getShaderData("view projection Matrix"),
+                      shader->getUniform("viewProjMat")));
+
+    _batchDraw = new MeshBatchDraw(this, meshBatch);
+    for (uint i = 0; i < vRenderNodes.size(); ++i) {
+      _vDraws.push_back(meshBatch->getDraw(vRenderNodes[i]));
+    }
+
+    addStartupOperation(
+      new FunctionOp(std::bind(&MeshBatchDraw::execute, _batchDraw)));
+    return;
+  }
+
+  _commandList = new CommandList(this, shader);
 
   for (uint i = 0; i < vRenderNodes.size(); ++i) {
 
@@ -68,25 +131,63 @@ ShadowMapPass::ShadowMapPass(std::vector<kore::SceneNode*>& vRenderNodes, kore::
     MeshComponent* meshComp =
       static_cast<MeshComponent*>(vRenderNodes[i]->getComponent(COMPONENT_MESH));
 
-    nodePass
-      ->addOperation(OperationFactory::create(OP_BINDATTRIBUTE, "v_position",
-      meshComp, "v_position", shader));
+    _commandList->beginNode(nodePass);
+    _commandList->bindAttribute("v_position", meshComp, "v_position");
+    _commandList->bindUniform(
+      lightcam->getShaderData("view projection Matrix"), "viewProjMat");
+    _commandList->bindUniform("model Matrix", vRenderNodes[i]->getTransform(),
+                              "modelMat");
+    _commandList->draw(meshComp);
+  }
+
+  _commandList->bake();
+}
 
-    nodePass
-      ->addOperation(new BindUniform(lightcam->getShaderData("view projection Matrix"),
-      shader->getUniform("viewProjMat")));
 
-    nodePass
-      ->addOperation(OperationFactory::create(OP_BINDUNIFORM, "model Matrix",
-      vRenderNodes[i]->getTransform(),
-      "modelMat", shader));
+ShadowMapPass::~ShadowMapPass(void)
+{
+  delete _commandList;
+  delete _batchDraw;
 
-    nodePass
-      ->addOperation(new RenderMesh(meshComp));
+  if (_cacheFBO) {
+    glDeleteFramebuffers(1, &_cacheFBO);
   }
 }
 
+void ShadowMapPass::setCasterEnabled(uint renderNode, bool enabled) {
+  if (!_batchDraw) {
+    _commandList->setNodeEnabled(renderNode, enabled);
+  } else if (_vDraws[renderNode] >= 0) {
+    _batchDraw->setDrawEnabled(_vDraws[renderNode], enabled);
+  }
+}
 
-ShadowMapPass::~ShadowMapPass(void)
-{
+void ShadowMapPass::attachLayer() {
+  kore::RenderManager::getInstance()->bindFrameBuffer(GL_FRAMEBUFFER,
+                                            _shadowBuffer->getHandle());
+
+  kore::Texture* depthArray = _shadowMaps->getDepthArray();
+  kore::Texture* positionArray = _shadowMaps->getPositionArray();
+  if (_type == SHADOWMAP_PASS_STATIC) {
+    depthArray = _shadowMaps->getStaticDepthArray();
+    positionArray = _shadowMaps->getStaticPositionArray();
+  }
+
+  glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            depthArray->getHandle(), 0, _light);
+  glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            positionArray->getHandle(), 0, _light);
+}
+
+void ShadowMapPass::copyStaticCache() {
+  // Takes the place of the clear: depth and positions of the static casters
+  // are the starting point for the dynamic ones.
+  glm::uvec2 smSize = _shadowMaps->getResolution();
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, _cacheFBO);
+  glBlitFramebuffer(0, 0, smSize.x, smSize.y, 0, 0, smSize.x, smSize.y,
+                    GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT
+                    | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+
+  // Restore the read binding the RenderManager expects
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, _shadowBuffer->getHandle());
 }
@@ -27,12 +27,55 @@
 #define VCT_SRC_VCT_SHADOWMAPPASS_H_
 
 #include "KoRE/Passes/ShaderProgramPass.h"
+#include "KoRE/FrameBuffer.h"
+#include "VoxelConeTracing/Scene/ShadowMapArray.h"
+#include "VoxelConeTracing/Scene/MeshBatch.h"
 
+class CommandList;
 
+enum EShadowMapPassType {
+  SHADOWMAP_PASS_STATIC = 0,  // Static casters into the cache
+  SHADOWMAP_PASS_COMPOSITE    // Cache plus the dynamic casters
+};
+
+/*! Renders the shadow map of one light into its layer of the
+*   ShadowMapArray. The static pass renders the static casters into the
+*   layer of the static cache. The composite pass copies that layer into the
+*   shadow map and renders the dynamic casters on top.
+*/
 class ShadowMapPass : public kore::ShaderProgramPass
 {
 public:
-  ShadowMapPass(std::vector<kore::SceneNode*>& vRenderNodes,kore::SceneNode* light, glm::uvec2 smSize);
+  ShadowMapPass(std::vector<kore::SceneNode*>& vRenderNodes,
+                ShadowMapArray* shadowMaps, uint light,
+                EShadowMapPassType type,
+                kore::FrameBuffer* shadowBuffer,
+                kore::EOperationExecutionType executionType,
+                MeshBatch* meshBatch = NULL);
   ~ShadowMapPass(void);
+
+  inline uint getLight() {return _light;}
+  inline EShadowMapPassType getType() {return _type;}
+
+  /// Selects the render nodes this pass draws
+  void setCasterEnabled(uint renderNode, bool enabled);
+
+private:
+  ShadowMapArray* _shadowMaps;
+  uint _light;
+  EShadowMapPassType _type;
+  kore::FrameBuffer* _shadowBuffer;
+  CommandList* _commandList;
+
+  // Only if the meshes are batched, with the draw of each render node
+  MeshBatchDraw* _batchDraw;
+  std::vector<int> _vDraws;
+
+  // Framebuffer with the light's layer of the static cache, the composite
+  // pass copies from it
+  GLuint _cacheFBO;
+
+  void attachLayer();
+  void copyStaticCache();
 };
 #endif //VCT_SRC_VCT_SHADOWMAPPASS_H_
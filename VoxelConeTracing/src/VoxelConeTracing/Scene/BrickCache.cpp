@@ -0,0 +1,670 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+#include "VoxelConeTracing/Scene/BrickCache.h"
+
+#include <functional>
+
+#include "KoRE/RenderManager.h"
+#include "KoRE/Log.h"
+#include "VoxelConeTracing/Util/GPUreadback.h"
+#include "VoxelConeTracing/Util/MappedFile.h"
+#include "VoxelConeTracing/Util/SVOdumpFormat.h"
+
+// Order of the attributes within a brick of the page file
+static const EBrickPoolAttributes PAGED_ATTRIBUTES[] = {
+  BRICKPOOL_COLOR,
+  BRICKPOOL_NORMAL,
+  BRICKPOOL_IRRADIANCE_DISPLAY
+};
+
+// The page file starts with this header. It is reused as long as the dump
+// has the same size and modification time.
+struct SBrickPageHeader {
+  uint magic;
+  uint version;
+  uint numBricks;
+  uint padding;
+  unsigned long long dumpSize;
+  unsigned long long dumpTime;
+};
+
+static const uint BRICK_PAGE_MAGIC = 0x4B435242;  // "BRCK"
+static const uint BRICK_PAGE_VERSION = 1;
+
+static uint uvec3ToUintXYZ10(const glm::uvec3& val) {
+  return (val.z & 0x3FF) << 20 | (val.y & 0x3FF) << 10 | (val.x & 0x3FF);
+}
+
+BrickCache::BrickCache()
+  : _vctScene(NULL),
+    _batchState(BATCH_IDLE),
+    _quitReader(false),
+    _numLevels(0),
+    _numNodes(0),
+    _dumpResolution(0),
+    _numDumpBricks(0),
+    _voxelGridCenter(0.0f),
+    _dirtyBegin(0),
+    _dirtyEnd(0),
+    _slotsPerAxis(0),
+    _lruHead(NO_INDEX),
+    _lruTail(NO_INDEX),
+    _nextRequest(0),
+    _feedbackPending(false),
+    _feedbackStamp(0),
+    _cacheFull(false),
+    _usageStamp(0),
+    _numResident(0),
+    _numPagedIn(0),
+    _numEvicted(0) {
+  _shdUsageStamp.name = "Brick usage stamp";
+  _shdUsageStamp.type = GL_UNSIGNED_INT;
+  _shdUsageStamp.size = 1;
+  _shdUsageStamp.data = &_usageStamp;
+}
+
+BrickCache::~BrickCache() {
+  shutdown();
+}
+
+void BrickCache::shutdown() {
+  if (!_reader.joinable()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_batchMutex);
+    _quitReader = true;
+  }
+  _batchCondition.notify_one();
+  _reader.join();
+}
+
+std::string BrickCache::getShaderDefines() {
+  return std::string("#define BRICK_USAGE_FEEDBACK\n")
+    + "#define BRICK_NOT_RESIDENT "
+    + std::to_string((unsigned long long)BRICK_NOT_RESIDENT) + "U\n";
+}
+
+bool BrickCache::load(const std::string& file, uint cacheResolution,
+                      SVCTparameters& params) {
+  kore::Log* log = kore::Log::getInstance();
+
+  std::ifstream dump(file.c_str(), std::ios::in | std::ios::binary);
+  if (!dump.is_open()) {
+    log->write("[ERROR] Could not open SVO dump %s\n", file.c_str());
+    return false;
+  }
+
+  SSVOdumpHeader header;
+  dump.read((char*) &header, sizeof(SSVOdumpHeader));
+  if (!dump || header.magic != SVODUMP_MAGIC ||
+      header.version != SVODUMP_VERSION ||
+      header.numNodeAttributes != NODEPOOL_ATTRIBUTES_NUM ||
+      header.numBrickAttributes != BRICKPOOL_ATTRIBUTES_NUM ||
+      header.numAllocatedNodes == 0) {
+    log->write("[ERROR] %s is not a supported SVO dump\n", file.c_str());
+    return false;
+  }
+
+  // The number of levels follows from the grid resolution, see NodePool
+  uint numLevels = 0;
+  for (uint res = params.voxel_grid_resolution; res > 1; res /= 2) {
+    ++numLevels;
+  }
+
+  if (header.numLevels != numLevels) {
+    log->write("[ERROR] SVO dump %s has %u levels, the voxel grid "
+               "resolution needs %u\n", file.c_str(), header.numLevels,
+               numLevels);
+    return false;
+  }
+
+  _vLevelAddresses.resize(header.numLevels);
+  dump.read((char*) &_vLevelAddresses[0], sizeof(uint) * header.numLevels);
+
+  _vNodeValues.resize(NODEPOOL_ATTRIBUTES_NUM);
+  for (uint i = 0; i < NODEPOOL_ATTRIBUTES_NUM; ++i) {
+    SSVOdumpPool pool;
+    dump.read((char*) &pool, sizeof(SSVOdumpPool));
+    _vNodeValues[i].assign(header.numAllocatedNodes, 0);
+    if (pool.hasData) {
+      dump.read((char*) &_vNodeValues[i][0],
+                sizeof(uint) * header.numAllocatedNodes);
+    }
+  }
+
+  // Only remember where the brick pools are, they are converted below
+  std::vector<std::streamoff> vPoolOffsets(BRICKPOOL_ATTRIBUTES_NUM, -1);
+  for (uint i = 0; i < BRICKPOOL_ATTRIBUTES_NUM && dump; ++i) {
+    SSVOdumpPool pool;
+    dump.read((char*) &pool, sizeof(SSVOdumpPool));
+    if (pool.hasData) {
+      vPoolOffsets[i] = dump.tellg();
+      dump.seekg(pool.byteSize, std::ios::cur);
+    }
+  }
+
+  if (!dump) {
+    log->write("[ERROR] SVO dump %s is truncated\n", file.c_str());
+    return false;
+  }
+
+  for (uint i = 0; i < NUM_PAGED_ATTRIBUTES; ++i) {
+    if (vPoolOffsets[PAGED_ATTRIBUTES[i]] < 0) {
+      log->write("[ERROR] SVO dump %s lacks brick attribute %u, it has to "
+                 "be dumped again\n", file.c_str(), PAGED_ATTRIBUTES[i]);
+      return false;
+    }
+  }
+
+  _numLevels = header.numLevels;
+  _numNodes = header.numAllocatedNodes;
+  _dumpResolution = header.brickPoolResolution;
+  uint dumpBricksPerAxis = _dumpResolution / 3;
+  _numDumpBricks = glm::min(header.numAllocatedBricks,
+    dumpBricksPerAxis * dumpBricksPerAxis * dumpBricksPerAxis);
+  _voxelGridCenter = glm::vec3(header.voxelGridCenter[0],
+                               header.voxelGridCenter[1],
+                               header.voxelGridCenter[2]);
+
+  // Converting a large dump takes a while, so the page file of the last
+  // run is kept as long as the dump is unchanged
+  unsigned long long dumpSize = 0;
+  unsigned long long dumpTime = 0;
+  MappedFile::getFileStamp(file, &dumpSize, &dumpTime);
+
+  _pageFileName = file + ".bricks";
+  if (isPageFileCurrent(dumpSize, dumpTime)) {
+    log->write("[DEBUG] Reusing the brick page file %s\n",
+               _pageFileName.c_str());
+  } else if (!convertBricks(dump, vPoolOffsets, dumpSize, dumpTime)) {
+    log->write("[ERROR] Could not write the brick page file %s\n",
+               _pageFileName.c_str());
+    return false;
+  }
+
+  _pageFile.open(_pageFileName.c_str(), std::ios::in | std::ios::binary);
+  if (!_pageFile.is_open()) {
+    log->write("[ERROR] Could not open the brick page file %s\n",
+               _pageFileName.c_str());
+    return false;
+  }
+
+  params.maxNumNodes = _numNodes;
+  params.brickPoolResolution = cacheResolution;
+
+  uint cacheBricksPerAxis = cacheResolution / 3;
+  log->write("[DEBUG] Paging %u bricks of %s through a cache of %u bricks\n",
+             _numDumpBricks, file.c_str(),
+             cacheBricksPerAxis * cacheBricksPerAxis * cacheBricksPerAxis - 1);
+  return true;
+}
+
+bool BrickCache::isPageFileCurrent(unsigned long long dumpSize,
+                                   unsigned long long dumpTime) const {
+  std::ifstream in(_pageFileName.c_str(), std::ios::in | std::ios::binary);
+  if (!in.is_open()) {
+    return false;
+  }
+
+  SBrickPageHeader header;
+  in.read((char*) &header, sizeof(SBrickPageHeader));
+  if (!in || header.magic != BRICK_PAGE_MAGIC ||
+      header.version != BRICK_PAGE_VERSION ||
+      header.numBricks != _numDumpBricks ||
+      header.dumpSize != dumpSize || header.dumpTime != dumpTime) {
+    return false;
+  }
+
+  // A conversion that was interrupted left a shorter file
+  unsigned long long pageFileSize = 0;
+  unsigned long long pageFileTime = 0;
+  MappedFile::getFileStamp(_pageFileName, &pageFileSize, &pageFileTime);
+  return pageFileSize == sizeof(SBrickPageHeader)
+    + (unsigned long long) _numDumpBricks * NUM_PAGED_ATTRIBUTES
+      * BRICK_TEXELS * sizeof(uint);
+}
+
+bool BrickCache::convertBricks(std::ifstream& dump,
+                               const std::vector<std::streamoff>& vPoolOffsets,
+                               unsigned long long dumpSize,
+                               unsigned long long dumpTime) {
+  std::ofstream out(_pageFileName.c_str(),
+                    std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    return false;
+  }
+
+  SBrickPageHeader header;
+  header.magic = BRICK_PAGE_MAGIC;
+  header.version = BRICK_PAGE_VERSION;
+  header.numBricks = _numDumpBricks;
+  header.padding = 0;
+  header.dumpSize = dumpSize;
+  header.dumpTime = dumpTime;
+  out.write((const char*) &header, sizeof(SBrickPageHeader));
+
+  // The bricks are allocated in x, y, z order, so each slab of three
+  // texel slices holds a consecutive range of bricks. A brick is stored with
+  // its 27 texels per attribute in the order glTexSubImage3D expects.
+  const uint res = _dumpResolution;
+  const uint bricksPerAxis = res / 3;
+  const uint bricksPerSlab = bricksPerAxis * bricksPerAxis;
+  const uint slabTexels = res * res * 3;
+  const uint brickValues = NUM_PAGED_ATTRIBUTES * BRICK_TEXELS;
+
+  std::vector<std::vector<uint> > vSlabs(NUM_PAGED_ATTRIBUTES);
+  std::vector<uint> vBricks;
+  for (uint slab = 0; slab * bricksPerSlab < _numDumpBricks; ++slab) {
+    uint firstBrick = slab * bricksPerSlab;
+    uint numBricks = glm::min(bricksPerSlab, _numDumpBricks - firstBrick);
+
+    for (uint a = 0; a < NUM_PAGED_ATTRIBUTES; ++a) {
+      vSlabs[a].resize(slabTexels);
+      dump.seekg(vPoolOffsets[PAGED_ATTRIBUTES[a]] +
+                 static_cast<std::streamoff>(slab) * slabTexels * sizeof(uint));
+      dump.read((char*) &vSlabs[a][0], slabTexels * sizeof(uint));
+    }
+
+    vBricks.resize(numBricks * brickValues);
+    uint* dst = &vBricks[0];
+    for (uint b = 0; b < numBricks; ++b) {
+      uint x0 = (b % bricksPerAxis) * 3;
+      uint y0 = (b / bricksPerAxis) * 3;
+      for (uint a = 0; a < NUM_PAGED_ATTRIBUTES; ++a) {
+        for (uint z = 0; z < 3; ++z) {
+          for (uint y = 0; y < 3; ++y) {
+            for (uint x = 0; x < 3; ++x) {
+              *dst++ = vSlabs[a][(z * res + y0 + y) * res + x0 + x];
+            }
+          }
+        }
+      }
+    }
+    out.write((const char*) &vBricks[0], vBricks.size() * sizeof(uint));
+  }
+
+  return dump && out;
+}
+
+void BrickCache::init(VCTscene* vctScene) {
+  kore::RenderManager* renderMgr = kore::RenderManager::getInstance();
+  NodePool* nodePool = vctScene->getNodePool();
+  BrickPool* brickPool = vctScene->getBrickPool();
+
+  _vctScene = vctScene;
+  _vctScene->setVoxelGridCenter(_voxelGridCenter);
+
+  // Remember the brick of each node. None of them is resident yet, nodes
+  // without a brick point to the empty brick in slot 0.
+  const uint dumpBricksPerAxis = _dumpResolution / 3;
+  std::vector<uint>& vNext = _vNodeValues[NEXT];
+  std::vector<uint>& vColor = _vNodeValues[COLOR];
+  _vNodeBrick.assign(_numNodes, NO_INDEX);
+  _vNodeSlot.assign(_numNodes, NO_INDEX);
+  for (uint node = 0; node < _numNodes; ++node) {
+    if (vNext[node] & SVODUMP_NODE_MASK_BRICK) {
+      uint x = (vColor[node] & 0x3FF) / 3;
+      uint y = ((vColor[node] >> 10) & 0x3FF) / 3;
+      uint z = ((vColor[node] >> 20) & 0x3FF) / 3;
+      uint brick = x + (y + z * dumpBricksPerAxis) * dumpBricksPerAxis;
+      if (brick < _numDumpBricks) {
+        _vNodeBrick[node] = brick;
+      }
+    }
+    vColor[node] = _vNodeBrick[node] != NO_INDEX ?
+                   BRICK_NOT_RESIDENT : uvec3ToUintXYZ10(glm::uvec3(0));
+  }
+
+  uint numNodes = glm::min(_numNodes, nodePool->getNumNodes());
+  for (uint i = 0; i < NODEPOOL_ATTRIBUTES_NUM; ++i) {
+    kore::TextureBuffer* buffer =
+      nodePool->getNodePool(static_cast<ENodePoolAttributes>(i));
+    renderMgr->bindBuffer(GL_TEXTURE_BUFFER, buffer->getBufferHandle());
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(uint) * numNodes,
+                    &_vNodeValues[i][0]);
+  }
+  renderMgr->bindBuffer(GL_TEXTURE_BUFFER,
+                        nodePool->getLevelAddressBuffer()->getBufferHandle());
+  glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(uint) * _numLevels,
+                  &_vLevelAddresses[0]);
+  _vNodePointers.swap(vColor);
+  _vNodePointers.resize(numNodes);
+  _vNodeValues.clear();
+
+  // All slots but the empty brick are free
+  _slotsPerAxis = brickPool->getBrickPoolResolution_leaf() / 3;
+  uint numSlots = _slotsPerAxis * _slotsPerAxis * _slotsPerAxis;
+  _vSlotNode.assign(numSlots, NO_INDEX);
+  _vSlotLastUse.assign(numSlots, 0);
+  _vLruPrev.assign(numSlots, NO_INDEX);
+  _vLruNext.assign(numSlots, NO_INDEX);
+  _vFreeSlots.clear();
+  for (uint slot = numSlots - 1; slot > 0; --slot) {
+    _vFreeSlots.push_back(slot);
+  }
+
+  std::vector<uint> vEmptyBrick(BRICK_TEXELS, 0);
+  for (uint a = 0; a < NUM_PAGED_ATTRIBUTES; ++a) {
+    renderMgr->bindTexture(GL_TEXTURE_3D,
+      brickPool->getBrickPoolTex(PAGED_ATTRIBUTES[a])->getHandle());
+    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, 3, 3, 3, GL_RGBA,
+                    GL_UNSIGNED_BYTE, &vEmptyBrick[0]);
+  }
+  renderMgr->bindTexture(GL_TEXTURE_3D, 0);
+
+  // Usage feedback, the last frame each node was sampled in
+  std::vector<uint> vStamps(_numNodes, 0);
+  kore::STextureBufferProperties usageProps;
+  usageProps.internalFormat = GL_R32UI;
+  usageProps.size = sizeof(uint) * _numNodes;
+  usageProps.usageHint = GL_DYNAMIC_COPY;
+  _nodeUsage.create(usageProps, "Node usage", &vStamps[0]);
+
+  _nodeUsageTexInfo.internalFormat = GL_R32UI;
+  _nodeUsageTexInfo.texLocation = _nodeUsage.getTexHandle();
+  _nodeUsageTexInfo.texTarget = GL_TEXTURE_BUFFER;
+
+  _shdNodeUsage.name = "Node usage";
+  _shdNodeUsage.type = GL_TEXTURE_BUFFER;
+  _shdNodeUsage.size = 1;
+  _shdNodeUsage.data = &_nodeUsageTexInfo;
+
+  _reader = std::thread(&BrickCache::readerLoop, this);
+}
+
+void BrickCache::update() {
+  if (!_vctScene) {
+    return;
+  }
+
+  // Stamp of the frame rendered next
+  ++_usageStamp;
+
+  // The marks of all frames before this one are complete
+  if (!_feedbackPending && _usageStamp % FEEDBACK_INTERVAL == 0) {
+    _feedbackPending = true;
+    GPUreadback::getInstance()->request(_nodeUsage.getBufferHandle(), 0,
+      _numNodes, std::bind(&BrickCache::onFeedback, this,
+                           std::placeholders::_1, std::placeholders::_2,
+                           _usageStamp - 1));
+  }
+
+  pageIn();
+}
+
+void BrickCache::onFeedback(const uint* stamps, uint numValues,
+                            uint feedbackStamp) {
+  _feedbackPending = false;
+  _feedbackStamp = feedbackStamp;
+  _vRequests.clear();
+  _nextRequest = 0;
+  _cacheFull = false;
+
+  // Nodes are stored level by level, so the coarse bricks are requested
+  // first. They are also used for the interpolation with the finer ones.
+  uint numNodes = glm::min(numValues, _numNodes);
+  for (uint node = 0; node < numNodes; ++node) {
+    uint stamp = stamps[node];
+    if (stamp == 0 || stamp + FEEDBACK_INTERVAL <= feedbackStamp) {
+      continue;
+    }
+
+    uint slot = _vNodeSlot[node];
+    if (slot != NO_INDEX) {
+      _vSlotLastUse[slot] = stamp;
+      lruRemove(slot);
+      lruAppend(slot);
+    } else if (_vNodeBrick[node] != NO_INDEX) {
+      _vRequests.push_back(node);
+    }
+  }
+}
+
+void BrickCache::pageIn() {
+  EBatchState batchState;
+  {
+    std::lock_guard<std::mutex> lock(_batchMutex);
+    batchState = _batchState;
+  }
+
+  // The reader thread only touches the batch while it is reading it
+  if (batchState == BATCH_READ) {
+    uploadBatch();
+    batchState = BATCH_IDLE;
+  }
+
+  // Only one batch is in flight, so no slot of it can be evicted before its
+  // bricks have been uploaded
+  if (batchState == BATCH_IDLE) {
+    requestBatch();
+  }
+
+  uploadNodeBricks();
+}
+
+void BrickCache::uploadBatch() {
+  if (_batch.readFailed) {
+    kore::Log::getInstance()->write("[ERROR] Could not read bricks from %s\n",
+                                    _pageFileName.c_str());
+  }
+
+  const uint brickValues = NUM_PAGED_ATTRIBUTES * BRICK_TEXELS;
+  kore::RenderManager* renderMgr = kore::RenderManager::getInstance();
+  BrickPool* brickPool = _vctScene->getBrickPool();
+  for (uint a = 0; a < NUM_PAGED_ATTRIBUTES; ++a) {
+    renderMgr->bindTexture(GL_TEXTURE_3D,
+      brickPool->getBrickPoolTex(PAGED_ATTRIBUTES[a])->getHandle());
+    for (uint i = 0; i < _batch.vSlots.size(); ++i) {
+      glm::uvec3 texel = getSlotTexel(_batch.vSlots[i]);
+      glTexSubImage3D(GL_TEXTURE_3D, 0, texel.x, texel.y, texel.z, 3, 3, 3,
+                      GL_RGBA, GL_UNSIGNED_BYTE,
+                      &_batch.vTexels[i * brickValues + a * BRICK_TEXELS]);
+    }
+  }
+  renderMgr->bindTexture(GL_TEXTURE_3D, 0);
+
+  // The nodes point to the bricks after they have been uploaded
+  for (uint i = 0; i < _batch.vNodes.size(); ++i) {
+    writeNodeBrick(_batch.vNodes[i],
+                   uvec3ToUintXYZ10(getSlotTexel(_batch.vSlots[i])));
+  }
+  _numPagedIn += _batch.vNodes.size();
+
+  std::lock_guard<std::mutex> lock(_batchMutex);
+  _batchState = BATCH_IDLE;
+}
+
+void BrickCache::requestBatch() {
+  _batch.vNodes.clear();
+  _batch.vSlots.clear();
+  while (_batch.vNodes.size() < MAX_PAGE_INS_PER_FRAME &&
+         _nextRequest < _vRequests.size()) {
+    uint node = _vRequests[_nextRequest];
+    if (_vNodeSlot[node] != NO_INDEX) {
+      ++_nextRequest;
+      continue;
+    }
+
+    uint slot = allocSlot();
+    if (slot == NO_INDEX) {
+      // Wait for the next feedback rather than thrashing
+      if (!_cacheFull) {
+        kore::Log::getInstance()->write("[WARNING] Brick cache is too small "
+          "for the SVO in view, %u bricks are missing\n",
+          (uint)(_vRequests.size() - _nextRequest));
+      }
+      _cacheFull = true;
+      _nextRequest = _vRequests.size();
+      break;
+    }
+
+    // Reserve the slot, so the batch can't evict it again
+    _vNodeSlot[node] = slot;
+    _vSlotNode[slot] = node;
+    _vSlotLastUse[slot] = _feedbackStamp;
+    lruAppend(slot);
+
+    _batch.vNodes.push_back(node);
+    _batch.vSlots.push_back(slot);
+    ++_nextRequest;
+  }
+
+  if (_batch.vNodes.empty()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_batchMutex);
+    _batchState = BATCH_READING;
+  }
+  _batchCondition.notify_one();
+}
+
+// Runs on the reader thread, must not touch GL or the KoRE log.
+void BrickCache::readerLoop() {
+  const uint brickValues = NUM_PAGED_ATTRIBUTES * BRICK_TEXELS;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(_batchMutex);
+      while (!_quitReader && _batchState != BATCH_READING) {
+        _batchCondition.wait(lock);
+      }
+      if (_quitReader) {
+        return;
+      }
+    }
+
+    _batch.vTexels.resize(_batch.vNodes.size() * brickValues);
+    for (uint i = 0; i < _batch.vNodes.size(); ++i) {
+      _pageFile.seekg(sizeof(SBrickPageHeader) +
+                      static_cast<std::streamoff>(_vNodeBrick[_batch.vNodes[i]])
+                      * brickValues * sizeof(uint));
+      _pageFile.read((char*) &_batch.vTexels[i * brickValues],
+                     brickValues * sizeof(uint));
+    }
+    _batch.readFailed = !_pageFile;
+    _pageFile.clear();
+
+    std::lock_guard<std::mutex> lock(_batchMutex);
+    _batchState = BATCH_READ;
+  }
+}
+
+uint BrickCache::allocSlot() {
+  if (!_vFreeSlots.empty()) {
+    uint slot = _vFreeSlots.back();
+    _vFreeSlots.pop_back();
+    ++_numResident;
+    return slot;
+  }
+
+  // Bricks used since the previous feedback are kept
+  uint slot = _lruHead;
+  if (slot == NO_INDEX ||
+      _vSlotLastUse[slot] + FEEDBACK_INTERVAL > _feedbackStamp) {
+    return NO_INDEX;
+  }
+
+  // The node is written before the brick is overwritten, so no later draw
+  // samples the new brick in its place
+  uint evictedNode = _vSlotNode[slot];
+  lruRemove(slot);
+  _vNodeSlot[evictedNode] = NO_INDEX;
+  _vSlotNode[slot] = NO_INDEX;
+  writeNodeBrick(evictedNode, BRICK_NOT_RESIDENT);
+  ++_numEvicted;
+  return slot;
+}
+
+void BrickCache::lruRemove(uint slot) {
+  uint prev = _vLruPrev[slot];
+  uint next = _vLruNext[slot];
+  if (prev != NO_INDEX) {
+    _vLruNext[prev] = next;
+  } else if (_lruHead == slot) {
+    _lruHead = next;
+  }
+
+  if (next != NO_INDEX) {
+    _vLruPrev[next] = prev;
+  } else if (_lruTail == slot) {
+    _lruTail = prev;
+  }
+
+  _vLruPrev[slot] = NO_INDEX;
+  _vLruNext[slot] = NO_INDEX;
+}
+
+void BrickCache::lruAppend(uint slot) {
+  _vLruPrev[slot] = _lruTail;
+  _vLruNext[slot] = NO_INDEX;
+  if (_lruTail != NO_INDEX) {
+    _vLruNext[_lruTail] = slot;
+  } else {
+    _lruHead = slot;
+  }
+  _lruTail = slot;
+}
+
+glm::uvec3 BrickCache::getSlotTexel(uint slot) const {
+  // Same layout as the allocation in AllocBricks.shader
+  return glm::uvec3(slot % _slotsPerAxis,
+                    (slot / _slotsPerAxis) % _slotsPerAxis,
+                    slot / (_slotsPerAxis * _slotsPerAxis)) * 3U;
+}
+
+void BrickCache::writeNodeBrick(uint node, uint brickPointer) {
+  if (node >= _vNodePointers.size()) {
+    return;
+  }
+
+  _vNodePointers[node] = brickPointer;
+  if (_dirtyBegin == _dirtyEnd) {
+    _dirtyBegin = node;
+    _dirtyEnd = node + 1;
+  } else {
+    _dirtyBegin = glm::min(_dirtyBegin, node);
+    _dirtyEnd = glm::max(_dirtyEnd, node + 1);
+  }
+}
+
+void BrickCache::uploadNodeBricks() {
+  if (_dirtyBegin == _dirtyEnd) {
+    return;
+  }
+
+  // One upload of the changed range rather than one per node. The nodes in
+  // between are written with their current values.
+  kore::RenderManager::getInstance()->bindBuffer(GL_TEXTURE_BUFFER,
+    _vctScene->getNodePool()->getNodePool(COLOR)->getBufferHandle());
+  glBufferSubData(GL_TEXTURE_BUFFER, sizeof(uint) * _dirtyBegin,
+                  sizeof(uint) * (_dirtyEnd - _dirtyBegin),
+                  &_vNodePointers[_dirtyBegin]);
+  _dirtyBegin = 0;
+  _dirtyEnd = 0;
+}
@@ -0,0 +1,198 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+#ifndef VCT_SRC_VCT_BRICKCACHE_H_
+#define VCT_SRC_VCT_BRICKCACHE_H_
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "KoRE/Common.h"
+#include "KoRE/TextureBuffer.h"
+#include "VoxelConeTracing/Scene/VCTscene.h"
+
+/*! Renders the SVO of a dump (see SVOdump) with a brick pool that only holds
+*   the recently used bricks, so the SVO may need more bricks than fit into
+*   GPU memory.
+*
+*   The final render marks every node it samples with the current frame
+*   (BRICK_USAGE_FEEDBACK). The marks are read back without stalling, the
+*   used resident bricks move to the back of an LRU list and the missing
+*   ones are paged in from disk into free slots or in place of the least
+*   recently used bricks. Nodes whose brick is not resident have the brick
+*   pointer BRICK_NOT_RESIDENT. The cone trace samples only the parent
+*   brick in their place, or skips them if that is missing too. Nodes
+*   without a brick in the dump point to an empty brick.
+*
+*   The bricks of a batch are read from the page file on a reader thread and
+*   uploaded in the next frame after they have been read, so the render
+*   thread never waits for the disk. The brick pointers of a frame are
+*   uploaded at once from a copy of the node pool.
+*
+*   The node pools are uploaded completely. Only the color, normal and
+*   displayed irradiance bricks are paged, the SVO is neither constructed
+*   nor lit again.
+*/
+class BrickCache {
+public:
+  BrickCache();
+  ~BrickCache();
+
+  /// Reads the node pools of the dump and converts its bricks into a page
+  /// file next to it, unless the page file of the same dump exists already.
+  /// Sets the node pool size in params to the dumped SVO
+  /// and the brick pool to cacheResolution^3 texels. Has to be called before
+  /// the VCTscene is initialized with params.
+  bool load(const std::string& file, uint cacheResolution,
+            SVCTparameters& params);
+
+  /// Uploads the node pools, moves the voxel grid to the dumped one and
+  /// starts the reader thread. All nodes start without a resident brick.
+  void init(VCTscene* vctScene);
+
+  /// Advances the usage stamp, requests the feedback of the last frames,
+  /// uploads the bricks read since the last frame and requests the next
+  /// batch of missing bricks.
+  void update();
+
+  /// Stops the reader thread. Has to be called before exit.
+  void shutdown();
+
+  inline bool isActive() const {return _vctScene != NULL;}
+
+  inline kore::ShaderData* getShdNodeUsage() {return &_shdNodeUsage;}
+  inline kore::ShaderData* getShdUsageStamp() {return &_shdUsageStamp;}
+
+  inline uint* getNumResidentPtr() {return &_numResident;}
+  inline uint* getNumPagedInPtr() {return &_numPagedIn;}
+  inline uint* getNumEvictedPtr() {return &_numEvicted;}
+
+  static std::string getShaderDefines();
+
+  static const uint FEEDBACK_INTERVAL = 4;  // Frames between readbacks
+  static const uint MAX_PAGE_INS_PER_FRAME = 256;
+
+private:
+  static const uint NO_INDEX = 0xFFFFFFFF;
+  static const uint BRICK_NOT_RESIDENT = 0xFFFFFFFF;  // Not a XYZ10 pointer
+  static const uint NUM_PAGED_ATTRIBUTES = 3;
+  static const uint BRICK_TEXELS = 27;
+
+  enum EBatchState {
+    BATCH_IDLE,
+    BATCH_READING,  // Owned by the reader thread
+    BATCH_READ
+  };
+
+  // Bricks paged in together. Their slots are reserved when the batch is
+  // requested.
+  struct SPageBatch {
+    std::vector<uint> vNodes;
+    std::vector<uint> vSlots;
+    std::vector<uint> vTexels;
+    bool readFailed;
+  };
+
+  bool isPageFileCurrent(unsigned long long dumpSize,
+                         unsigned long long dumpTime) const;
+  bool convertBricks(std::ifstream& dump,
+                     const std::vector<std::streamoff>& vPoolOffsets,
+                     unsigned long long dumpSize,
+                     unsigned long long dumpTime);
+
+  void onFeedback(const uint* stamps, uint numValues, uint feedbackStamp);
+  void pageIn();
+  void uploadBatch();
+  void requestBatch();
+  void readerLoop();
+
+  uint allocSlot();
+  void lruRemove(uint slot);
+  void lruAppend(uint slot);
+  glm::uvec3 getSlotTexel(uint slot) const;
+  void writeNodeBrick(uint node, uint brickPointer);
+  void uploadNodeBricks();
+
+  VCTscene* _vctScene;
+
+  std::string _pageFileName;
+  std::ifstream _pageFile;  // Only read by the reader thread after init()
+
+  std::thread _reader;
+  std::mutex _batchMutex;
+  std::condition_variable _batchCondition;
+  EBatchState _batchState;
+  SPageBatch _batch;
+  bool _quitReader;
+
+  uint _numLevels;
+  uint _numNodes;
+  uint _dumpResolution;
+  uint _numDumpBricks;
+  glm::vec3 _voxelGridCenter;
+  std::vector<uint> _vLevelAddresses;
+  std::vector<std::vector<uint> > _vNodeValues;  // Until init
+
+  std::vector<uint> _vNodeBrick;  // Brick in the page file
+  std::vector<uint> _vNodeSlot;   // Resident brick in the cache
+
+  // Brick pointers of the color node pool, written back in one upload per
+  // frame. The range of changed nodes is [_dirtyBegin, _dirtyEnd).
+  std::vector<uint> _vNodePointers;
+  uint _dirtyBegin;
+  uint _dirtyEnd;
+
+  // Slot 0 is the empty brick and never handed out
+  uint _slotsPerAxis;
+  std::vector<uint> _vSlotNode;
+  std::vector<uint> _vSlotLastUse;
+  std::vector<uint> _vLruPrev;
+  std::vector<uint> _vLruNext;
+  uint _lruHead;  // Least recently used
+  uint _lruTail;
+  std::vector<uint> _vFreeSlots;
+
+  std::vector<uint> _vRequests;  // Nodes to page in, coarse levels first
+  uint _nextRequest;
+  bool _feedbackPending;
+  uint _feedbackStamp;  // Last frame of the processed feedback
+  bool _cacheFull;
+
+  uint _usageStamp;
+  kore::ShaderData _shdUsageStamp;
+
+  kore::TextureBuffer _nodeUsage;
+  kore::STextureInfo _nodeUsageTexInfo;
+  kore::ShaderData _shdNodeUsage;
+
+  uint _numResident;
+  uint _numPagedIn;
+  uint _numEvicted;
+};
+
+#endif  // VCT_SRC_VCT_BRICKCACHE_H_
@@ -30,11 +30,30 @@
 #include "KoRE/Operations/BindOperations/BindImageTexture.h"
 #include "../Util/MathUtil.h"
 
+const EBrickPoolAttributes
+  BrickPool::DISPLAY_ATTRIBUTES[BrickPool::NUM_DISPLAY_ATTRIBUTES] =
+  {BRICKPOOL_COLOR, BRICKPOOL_NORMAL};
 
-BrickPool::BrickPool() {
+static void setSamplingParameters(GLuint texture) {
+  kore::RenderManager::getInstance()->bindTexture(GL_TEXTURE_3D, texture);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_SWIZZLE_R, GL_RED);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_SWIZZLE_G, GL_GREEN);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_SWIZZLE_B, GL_BLUE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_SWIZZLE_A, GL_ALPHA);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  kore::RenderManager::getInstance()->bindTexture(GL_TEXTURE_3D, 0);
+}
+
+BrickPool::BrickPool()
+  : _hasDisplayCopy(false) {
 }
 
-void BrickPool::init(uint brickPoolResolution, NodePool* nodePool) {
+void BrickPool::init(uint brickPoolResolution, NodePool* nodePool,
+                     bool displayCopy) {
   _brickPoolResolution_leaf = brickPoolResolution;
 
   _shdBrickPoolResolution_leaf.component = NULL;
@@ -70,6 +89,7 @@ void BrickPool::init(uint brickPoolResolution, NodePool* nodePool) {
   allocBrickPoolTex(BRICKPOOL_COLOR, brickPoolProps);
   allocBrickPoolTex(BRICKPOOL_NORMAL, brickPoolProps);
   allocBrickPoolTex(BRICKPOOL_IRRADIANCE, brickPoolProps);
+  allocBrickPoolTex(BRICKPOOL_IRRADIANCE_DISPLAY, brickPoolProps);
   allocBrickPoolTex(BRICKPOOL_COLOR_X, brickPoolPropsNodes);
   allocBrickPoolTex(BRICKPOOL_COLOR_X_NEG, brickPoolPropsNodes);
   allocBrickPoolTex(BRICKPOOL_COLOR_Y, brickPoolPropsNodes);
@@ -77,6 +97,21 @@ void BrickPool::init(uint brickPoolResolution, NodePool* nodePool) {
   allocBrickPoolTex(BRICKPOOL_COLOR_Z, brickPoolPropsNodes);
   allocBrickPoolTex(BRICKPOOL_COLOR_Z_NEG, brickPoolPropsNodes);
 
+  _hasDisplayCopy = displayCopy;
+  for (uint i = 0; i < NUM_DISPLAY_ATTRIBUTES; ++i) {
+    EBrickPoolAttributes brickAtt = DISPLAY_ATTRIBUTES[i];
+    _shdDisplayPoolTexture[i] = _shdBrickPoolTexture[brickAtt];
+    if (!_hasDisplayCopy) {
+      continue;
+    }
+
+    _displayPool[i].init(brickPoolProps, "BrickPool Display Tex");
+    _displayPoolTexInfo[i] = _brickPoolTexInfo[brickAtt];
+    _displayPoolTexInfo[i].texLocation = _displayPool[i].getHandle();
+    _shdDisplayPoolTexture[i].data = &_displayPoolTexInfo[i];
+    setSamplingParameters(_displayPool[i].getHandle());
+  }
+
   //////////////////////////////////////////////////////////////////////////
   // NextFreeBrick -- Atomic counter
   uint allocAcValue = 0;
@@ -93,6 +128,45 @@ BrickPool::~BrickPool() {
 
 }
 
+void BrickPool::copyBrickPool(EBrickPoolAttributes src,
+                              EBrickPoolAttributes dst) {
+  // Make the image stores of the previous passes visible to the copy
+  glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+  glCopyImageSubData(_brickPool[src].getHandle(), GL_TEXTURE_3D, 0, 0, 0, 0,
+                     _brickPool[dst].getHandle(), GL_TEXTURE_3D, 0, 0, 0, 0,
+                     _brickPoolResolution_leaf,
+                     _brickPoolResolution_leaf,
+                     _brickPoolResolution_leaf);
+}
+
+kore::ShaderData* BrickPool::getShdBrickPoolDisplayTexture(
+                                      EBrickPoolAttributes eAttribute) {
+  for (uint i = 0; i < NUM_DISPLAY_ATTRIBUTES; ++i) {
+    if (DISPLAY_ATTRIBUTES[i] == eAttribute) {
+      return &_shdDisplayPoolTexture[i];
+    }
+  }
+  return &_shdBrickPoolTexture[eAttribute];
+}
+
+void BrickPool::copyToDisplay() {
+  if (!_hasDisplayCopy) {
+    return;
+  }
+
+  glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+  for (uint i = 0; i < NUM_DISPLAY_ATTRIBUTES; ++i) {
+    glCopyImageSubData(_brickPool[DISPLAY_ATTRIBUTES[i]].getHandle(),
+                       GL_TEXTURE_3D, 0, 0, 0, 0,
+                       _displayPool[i].getHandle(), GL_TEXTURE_3D, 0, 0, 0, 0,
+                       _brickPoolResolution_leaf,
+                       _brickPoolResolution_leaf,
+                       _brickPoolResolution_leaf);
+  }
+}
+
 void BrickPool::allocBrickPoolTex(EBrickPoolAttributes brickAtt,
                                   const kore::STextureProperties& sProps)
 {
@@ -125,15 +199,5 @@ void BrickPool::allocBrickPoolTex(EBrickPoolAttributes brickAtt,
   _shdBrickPoolTexture[brickAtt].size = 1;
   _shdBrickPoolTexture[brickAtt].component = NULL;
 
-  kore::RenderManager::getInstance()->bindTexture(GL_TEXTURE_3D, _brickPool[brickAtt].getHandle());
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_BASE_LEVEL, 0);
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, 0);
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_SWIZZLE_R, GL_RED);
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_SWIZZLE_G, GL_GREEN);
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_SWIZZLE_B, GL_BLUE);
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_SWIZZLE_A, GL_ALPHA);
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-  kore::RenderManager::getInstance()->bindTexture(GL_TEXTURE_3D, 0);
+  setSamplingParameters(_brickPool[brickAtt].getHandle());
 }
@@ -46,6 +46,10 @@ enum EBrickPoolAttributes {
   BRICKPOOL_COLOR_Z_NEG,
   BRICKPOOL_IRRADIANCE,
   BRICKPOOL_NORMAL,
+
+  // Completed copy of BRICKPOOL_IRRADIANCE that is used for rendering while
+  // a new light update is in progress.
+  BRICKPOOL_IRRADIANCE_DISPLAY,
   
   /*
   Additional attributes later
@@ -59,7 +63,10 @@ public:
   BrickPool();
   ~BrickPool();
 
-  void init(uint brickPoolResolution, NodePool* nodePool);
+  /// With displayCopy, the color and normal pools get copies for rendering
+  /// that only change in copyToDisplay(), see NodePool::init().
+  void init(uint brickPoolResolution, NodePool* nodePool,
+            bool displayCopy = false);
   
   inline kore::IndexedBuffer* getAcNextFree()
   {return &_acBrickPoolNextFree;}
@@ -73,6 +80,22 @@ public:
   inline kore::ShaderData* getShdBrickPoolTexture(EBrickPoolAttributes eAttribute)
   {return &_shdBrickPoolTexture[eAttribute];}
 
+  inline kore::Texture* getBrickPoolTex(EBrickPoolAttributes eAttribute)
+  {return &_brickPool[eAttribute];}
+
+  /// Copies the complete content of one leaf-resolution brick pool
+  /// texture into another
+  void copyBrickPool(EBrickPoolAttributes src, EBrickPoolAttributes dst);
+
+  /// Texture of the attribute used for rendering. The display copy of
+  /// BRICKPOOL_COLOR and BRICKPOOL_NORMAL if there is one, otherwise the
+  /// same as getShdBrickPoolTexture().
+  kore::ShaderData* getShdBrickPoolDisplayTexture(
+                                      EBrickPoolAttributes eAttribute);
+
+  /// Copies the color and normal pools to the display copy, if any
+  void copyToDisplay();
+
   inline uint getBrickPoolResolution_leaf() {return _brickPoolResolution_leaf;}
 
   inline kore::ShaderData* getShdBrickPoolResolutionLeaf() {
@@ -94,6 +117,14 @@ private:
   kore::ShaderData _shdBrickPool[BRICKPOOL_ATTRIBUTES_NUM];
   kore::ShaderData _shdBrickPoolTexture[BRICKPOOL_ATTRIBUTES_NUM];
 
+  // Copies of BRICKPOOL_COLOR and BRICKPOOL_NORMAL for rendering
+  static const uint NUM_DISPLAY_ATTRIBUTES = 2;
+  static const EBrickPoolAttributes DISPLAY_ATTRIBUTES[NUM_DISPLAY_ATTRIBUTES];
+  bool _hasDisplayCopy;
+  kore::Texture _displayPool[NUM_DISPLAY_ATTRIBUTES];
+  kore::STextureInfo _displayPoolTexInfo[NUM_DISPLAY_ATTRIBUTES];
+  kore::ShaderData _shdDisplayPoolTexture[NUM_DISPLAY_ATTRIBUTES];
+
   kore::IndexedBuffer _acBrickPoolNextFree;
   kore::ShaderData _shdAcBrickPoolNextFree;
 
@@ -0,0 +1,120 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+#include "VoxelConeTracing/Scene/FrustumCuller.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "KoRE/Log.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
+#include "VoxelConeTracing/Util/ThreadPool.h"
+
+// Subtrees per thread, so the tasks balance the uneven subtree costs
+static const uint SUBTREES_PER_THREAD = 4;
+
+FrustumCuller::FrustumCuller()
+  : _cullTimeMS(0.0f),
+    _enabled(true) {
+}
+
+FrustumCuller::~FrustumCuller() {
+}
+
+void FrustumCuller::init(const std::vector<kore::SceneNode*>& vRenderNodes) {
+  _bvh.build(vRenderNodes);
+
+  uint numThreads = ThreadPool::getInstance()->getNumThreads();
+  _bvh.getSubtrees(numThreads * SUBTREES_PER_THREAD, _vSubtrees);
+
+  kore::Log::getInstance()->write("[DEBUG] Frustum culling: %u render nodes"
+                                  " in %u subtrees on %u threads\n",
+                                  (uint)vRenderNodes.size(),
+                                  (uint)_vSubtrees.size(), numThreads);
+}
+
+uint FrustumCuller::addCamera(kore::Camera* camera, const std::string& name) {
+  _vCameras.push_back(camera);
+  _vCameraNames.push_back(name);
+  _vFrustums.push_back(SFrustum());
+  _vVisibility.push_back(
+    std::vector<unsigned char>(_bvh.getNumRenderNodes(), 1));
+
+  SCullingCounters counters;
+  counters.numVisible = _bvh.getNumRenderNodes();
+  counters.numCulled = 0;
+  _vCounters.push_back(counters);
+
+  return _vCameras.size() - 1;
+}
+
+void FrustumCuller::cullTask(uint task) {
+  uint camera = task / _vSubtrees.size();
+  uint subtree = task % _vSubtrees.size();
+  _vTaskNumVisible[task] = _bvh.cull(_vFrustums[camera], _vSubtrees[subtree],
+                                     &_vVisibility[camera][0]);
+}
+
+void FrustumCuller::update() {
+  if (_vSubtrees.empty()) {
+    return;
+  }
+
+  GPUprofiler* profiler = GPUprofiler::getInstance();
+  double startMS = profiler->getCPUtimeMS();
+  uint numNodes = _bvh.getNumRenderNodes();
+
+  if (!_enabled) {
+    for (uint i = 0; i < _vCameras.size(); ++i) {
+      std::fill(_vVisibility[i].begin(), _vVisibility[i].end(), 1);
+      _vCounters[i].numVisible = numNodes;
+      _vCounters[i].numCulled = 0;
+    }
+    _cullTimeMS = 0.0f;
+    return;
+  }
+
+  _bvh.refit();
+
+  for (uint i = 0; i < _vCameras.size(); ++i) {
+    const glm::mat4& viewProj = *static_cast<glm::mat4*>(
+      _vCameras[i]->getShaderData("view projection Matrix")->data);
+    _vFrustums[i].setFromViewProjection(viewProj);
+  }
+
+  uint numTasks = _vCameras.size() * _vSubtrees.size();
+  _vTaskNumVisible.resize(numTasks);
+  ThreadPool::getInstance()->run(numTasks,
+    std::bind(&FrustumCuller::cullTask, this, std::placeholders::_1));
+
+  for (uint i = 0; i < _vCameras.size(); ++i) {
+    _vCounters[i].numVisible = 0;
+    for (uint s = 0; s < _vSubtrees.size(); ++s) {
+      _vCounters[i].numVisible += _vTaskNumVisible[i * _vSubtrees.size() + s];
+    }
+    _vCounters[i].numCulled = numNodes - _vCounters[i].numVisible;
+  }
+
+  _cullTimeMS = static_cast<float>(profiler->getCPUtimeMS() - startMS);
+}
@@ -0,0 +1,96 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+#ifndef VCT_SRC_VCT_FRUSTUMCULLER_H_
+#define VCT_SRC_VCT_FRUSTUMCULLER_H_
+
+#include <string>
+#include <vector>
+
+#include "KoRE/Common.h"
+#include "KoRE/SceneNode.h"
+#include "KoRE/Components/Camera.h"
+#include "VoxelConeTracing/Scene/SceneBVH.h"
+
+struct SCullingCounters {
+  uint numVisible;
+  uint numCulled;
+};
+
+/*! Determines the render nodes inside the view frustum of each registered
+*   camera (e.g. the main camera and the light cameras of the shadow maps).
+*   All frustums are culled at once on the ThreadPool, each task traverses
+*   one subtree of the SceneBVH for one camera.
+*/
+class FrustumCuller {
+public:
+  FrustumCuller();
+  ~FrustumCuller();
+
+  void init(const std::vector<kore::SceneNode*>& vRenderNodes);
+
+  /// Returns the index of the camera's visibility.
+  uint addCamera(kore::Camera* camera, const std::string& name);
+
+  /// Refits the BVH to the moved nodes and culls against all cameras. Has
+  /// to be called after the SceneManager update.
+  void update();
+
+  /// One entry per render node, 1 if it is visible to the camera
+  inline const std::vector<unsigned char>& getVisibility(uint camera) const
+  {return _vVisibility[camera];}
+
+  inline uint getNumCameras() const {return _vCameras.size();}
+  inline const std::string& getCameraName(uint camera) const
+  {return _vCameraNames[camera];}
+
+  inline const SCullingCounters& getCounters(uint camera) const
+  {return _vCounters[camera];}
+
+  /// CPU-time of the last update, including the BVH refit
+  inline float* getCullTimeMSptr() {return &_cullTimeMS;}
+
+  /// If disabled, every node is visible to every camera
+  inline bool* getEnabledPtr() {return &_enabled;}
+
+private:
+  void cullTask(uint task);
+
+  SceneBVH _bvh;
+  std::vector<uint> _vSubtrees;
+
+  std::vector<kore::Camera*> _vCameras;
+  std::vector<std::string> _vCameraNames;
+  std::vector<SFrustum> _vFrustums;
+  std::vector<std::vector<unsigned char> > _vVisibility;
+  std::vector<SCullingCounters> _vCounters;
+
+  // Visible nodes found by each task, summed after all are done
+  std::vector<uint> _vTaskNumVisible;
+
+  float _cullTimeMS;
+  bool _enabled;
+};
+
+#endif  // VCT_SRC_VCT_FRUSTUMCULLER_H_
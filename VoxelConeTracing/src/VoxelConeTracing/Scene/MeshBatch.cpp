@@ -0,0 +1,625 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#include "VoxelConeTracing/Scene/MeshBatch.h"
+
+#include <algorithm>
+
+#include "KoRE/Log.h"
+#include "KoRE/Mesh.h"
+#include "KoRE/RenderManager.h"
+#include "KoRE/Components/MeshComponent.h"
+#include "KoRE/Components/TexturesComponent.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
+
+MeshBatch::MeshBatch()
+  : _numVertices(0),
+    _numIndices(0),
+    _vao(0),
+    _vertexBuffer(0),
+    _indexBuffer(0),
+    _drawIDBuffer(0),
+    _drawDataBuffer(0) {
+}
+
+MeshBatch::~MeshBatch() {
+  destroy();
+}
+
+void MeshBatch::destroy() {
+  glDeleteVertexArrays(1, &_vao);
+  glDeleteBuffers(1, &_vertexBuffer);
+  glDeleteBuffers(1, &_indexBuffer);
+  glDeleteBuffers(1, &_drawIDBuffer);
+  glDeleteBuffers(1, &_drawDataBuffer);
+  _vao = _vertexBuffer = _indexBuffer = _drawIDBuffer = _drawDataBuffer = 0;
+
+  for (uint i = 0; i < _vTextureArrays.size(); ++i) {
+    glDeleteTextures(1, &_vTextureArrays[i]->handle);
+    delete _vTextureArrays[i];
+  }
+  _vTextureArrays.clear();
+  _textureLayers.clear();
+}
+
+std::string MeshBatch::getShaderDefines() {
+  return std::string("#define MESH_BATCHING\n")
+    + std::string("#define MESH_BATCH_BINDING ")
+    + std::to_string((unsigned long long)MESH_BATCH_BINDING)
+    + std::string("\n");
+}
+
+int MeshBatch::getDraw(const kore::SceneNode* node) {
+  for (uint i = 0; i < _vNodes.size(); ++i) {
+    if (_vNodes[i] == node) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Copies a vertex attribute of the mesh into dst as vec3s, missing
+// attributes and components are zero.
+static bool appendAttribute(const kore::Mesh* mesh, const std::string& name,
+                            std::vector<glm::vec3>& dst) {
+  uint numVertices = mesh->getNumVertices();
+  uint offset = dst.size();
+  dst.resize(offset + numVertices, glm::vec3(0.0f));
+
+  const kore::MeshAttributeArray* att = mesh->getAttributeByName(name);
+  if (!att) {
+    return true;
+  }
+
+  if (!att->data || att->componentType != GL_FLOAT
+      || att->numComponents > 3) {
+    return false;
+  }
+
+  const float* src = static_cast<const float*>(att->data);
+  for (uint v = 0; v < numVertices; ++v) {
+    for (uint c = 0; c < att->numComponents; ++c) {
+      dst[offset + v][c] = src[v * att->numComponents + c];
+    }
+  }
+  return true;
+}
+
+// Vertex and index count the batch takes from the mesh
+static SMeshCacheEntry getMeshEntry(const kore::Mesh* mesh) {
+  SMeshCacheEntry entry;
+  entry.numVertices = mesh->getNumVertices();
+  entry.numIndices = mesh->hasIndices() ? mesh->getIndices().size()
+                                        : mesh->getNumVertices();
+  return entry;
+}
+
+bool MeshBatch::matchesCache(const std::vector<kore::SceneNode*>& vNodes,
+                             MeshCache* cache) {
+  using namespace kore;
+
+  uint numMeshes = 0;
+  for (uint i = 0; i < vNodes.size(); ++i) {
+    MeshComponent* meshComp =
+      static_cast<MeshComponent*>(vNodes[i]->getComponent(COMPONENT_MESH));
+    if (!meshComp || !meshComp->getMesh()) {
+      continue;
+    }
+
+    if (numMeshes >= cache->getNumEntries()) {
+      return false;
+    }
+
+    SMeshCacheEntry entry = getMeshEntry(meshComp->getMesh());
+    const SMeshCacheEntry& cached = cache->getEntry(numMeshes);
+    if (entry.numVertices != cached.numVertices
+        || entry.numIndices != cached.numIndices) {
+      return false;
+    }
+    ++numMeshes;
+  }
+
+  return numMeshes == cache->getNumEntries();
+}
+
+void MeshBatch::storeCache(MeshCache* cache) {
+  std::vector<SMeshCacheEntry> vEntries(_vCommands.size());
+  for (uint i = 0; i < _vCommands.size(); ++i) {
+    uint nextBaseVertex = i + 1 < _vCommands.size() ?
+                          _vCommands[i + 1].baseVertex : _numVertices;
+    vEntries[i].numVertices = nextBaseVertex - _vCommands[i].baseVertex;
+    vEntries[i].numIndices = _vCommands[i].numIndices;
+  }
+
+  const std::vector<glm::vec3>* blocks[4] = {&_vPositions, &_vNormals,
+                                             &_vTangents, &_vUVs};
+  cache->store(vEntries, blocks, _vIndices);
+}
+
+bool MeshBatch::appendMesh(kore::SceneNode* node, bool geometryCached) {
+  using namespace kore;
+
+  MeshComponent* meshComp =
+    static_cast<MeshComponent*>(node->getComponent(COMPONENT_MESH));
+  if (!meshComp || !meshComp->getMesh()) {
+    return true;  // Nothing to draw
+  }
+
+  const Mesh* mesh = meshComp->getMesh();
+  if (mesh->getPrimitiveType() != GL_TRIANGLES) {
+    return false;
+  }
+
+  if (!mesh->getAttributeByName("v_position")) {
+    return false;
+  }
+
+  if (!geometryCached) {
+    if (!appendAttribute(mesh, "v_position", _vPositions)
+        || !appendAttribute(mesh, "v_normal", _vNormals)
+        || !appendAttribute(mesh, "v_tangent", _vTangents)
+        || !appendAttribute(mesh, "v_uv0", _vUVs)) {
+      return false;
+    }
+
+    if (mesh->hasIndices()) {
+      const std::vector<uint>& indices = mesh->getIndices();
+      _vIndices.insert(_vIndices.end(), indices.begin(), indices.end());
+    } else {
+      for (uint i = 0; i < mesh->getNumVertices(); ++i) {
+        _vIndices.push_back(i);
+      }
+    }
+  }
+
+  SMeshCacheEntry entry = getMeshEntry(mesh);
+  SDrawElementsIndirectCommand cmd;
+  cmd.firstIndex = _numIndices;
+  cmd.baseVertex = _numVertices;
+  cmd.baseInstance = _vNodes.size();
+  cmd.numInstances = 1;
+  cmd.numIndices = entry.numIndices;
+  _numVertices += entry.numVertices;
+  _numIndices += entry.numIndices;
+
+  SBatchDrawData drawData;
+  drawData.diffuseLayer = -1;
+  drawData.normalLayer = -1;
+  drawData.diffuseArray = -1;
+  drawData.normalArray = -1;
+
+  const TexturesComponent* texComp =
+    static_cast<TexturesComponent*>(node->getComponent(COMPONENT_TEXTURES));
+  if (texComp) {
+    std::vector<const Texture*> diffTextures =
+      texComp->getTextures(TEXSEMANTICS_DIFFUSE);
+    std::vector<const Texture*> normalTextures =
+      texComp->getTextures(TEXSEMANTICS_NORMAL);
+
+    if (diffTextures.size() > 0) {
+      drawData.diffuseLayer = getTextureLayer(diffTextures[0],
+                                              &drawData.diffuseArray);
+    }
+    if (normalTextures.size() > 0) {
+      drawData.normalLayer = getTextureLayer(normalTextures[0],
+                                             &drawData.normalArray);
+    }
+  }
+
+  _vNodes.push_back(node);
+  _vCommands.push_back(cmd);
+  _vDrawData.push_back(drawData);
+  return true;
+}
+
+// glTexStorage needs a sized format, textures may report the base format
+static GLenum getSizedFormat(GLenum format) {
+  switch (format) {
+    case GL_RED: return GL_R8;
+    case GL_RG: return GL_RG8;
+    case GL_RGB: return GL_RGB8;
+    case GL_RGBA: return GL_RGBA8;
+    default: return format;
+  }
+}
+
+int MeshBatch::getTextureLayer(const kore::Texture* texture, int* array) {
+  std::map<const kore::Texture*, std::pair<int, int> >::iterator it =
+    _textureLayers.find(texture);
+  if (it != _textureLayers.end()) {
+    *array = it->second.first;
+    return it->second.second;
+  }
+
+  GLint width = 0;
+  GLint height = 0;
+  GLint format = 0;
+  kore::RenderManager* renderMgr = kore::RenderManager::getInstance();
+  renderMgr->bindTexture(GL_TEXTURE_2D, texture->getHandle());
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT,
+                           &format);
+
+  // Levels that are not defined report a width of zero
+  uint numLevels = 1;
+  while (true) {
+    GLint levelWidth = 0;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, numLevels, GL_TEXTURE_WIDTH,
+                             &levelWidth);
+    if (levelWidth <= 0) {
+      break;
+    }
+    ++numLevels;
+  }
+  renderMgr->bindTexture(GL_TEXTURE_2D, 0);
+
+  GLenum internalFormat = getSizedFormat(format);
+  int iArray = 0;
+  for (; iArray < (int)_vTextureArrays.size(); ++iArray) {
+    const SBatchTextureArray* texArray = _vTextureArrays[iArray];
+    if (texArray->width == (uint)width && texArray->height == (uint)height
+        && texArray->internalFormat == internalFormat
+        && texArray->numLevels == numLevels) {
+      break;
+    }
+  }
+
+  if (iArray == (int)_vTextureArrays.size()) {
+    SBatchTextureArray* texArray = new SBatchTextureArray;
+    texArray->handle = 0;
+    texArray->internalFormat = internalFormat;
+    texArray->width = width;
+    texArray->height = height;
+    texArray->numLevels = numLevels;
+    _vTextureArrays.push_back(texArray);
+  }
+
+  int layer = _vTextureArrays[iArray]->vTextures.size();
+  _vTextureArrays[iArray]->vTextures.push_back(texture);
+  _textureLayers[texture] = std::make_pair(iArray, layer);
+  *array = iArray;
+  return layer;
+}
+
+bool MeshBatch::init(const std::vector<kore::SceneNode*>& vNodes,
+                     MeshCache* cache) {
+  bool geometryCached = cache && cache->waitForLoad()
+                        && matchesCache(vNodes, cache);
+
+  for (uint i = 0; i < vNodes.size(); ++i) {
+    if (!appendMesh(vNodes[i], geometryCached)) {
+      kore::Log::getInstance()->write("[WARNING] Mesh of node %u can't be "
+        "batched, the meshes are drawn separately\n", i);
+      _vNodes.clear();
+      if (cache) {
+        cache->release();
+      }
+      return false;
+    }
+  }
+
+  if (cache && !geometryCached) {
+    storeCache(cache);
+  }
+
+  // Don't let the buffer bindings of the RenderManager go stale
+  GLint oldArrayBuffer = 0;
+  GLint oldVAO = 0;
+  glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &oldArrayBuffer);
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &oldVAO);
+
+  glGenVertexArrays(1, &_vao);
+  glBindVertexArray(_vao);
+
+  // A valid cache is uploaded straight from the mapped file
+  const glm::vec3* blocks[4];
+  const uint* indices = NULL;
+  if (geometryCached) {
+    for (uint i = 0; i < 4; ++i) {
+      blocks[i] = cache->getBlock(i);
+    }
+    indices = cache->getIndices();
+  } else {
+    blocks[0] = &_vPositions[0];
+    blocks[1] = &_vNormals[0];
+    blocks[2] = &_vTangents[0];
+    blocks[3] = &_vUVs[0];
+    indices = &_vIndices[0];
+  }
+
+  uint blockSize = _numVertices * sizeof(glm::vec3);
+  glGenBuffers(1, &_vertexBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+  glBufferData(GL_ARRAY_BUFFER, 4 * blockSize, NULL, GL_STATIC_DRAW);
+  for (uint i = 0; i < 4; ++i) {
+    glBufferSubData(GL_ARRAY_BUFFER, i * blockSize, blockSize, blocks[i]);
+    glEnableVertexAttribArray(i);
+    glVertexAttribPointer(i, 3, GL_FLOAT, GL_FALSE, 0,
+                          reinterpret_cast<GLvoid*>(i * blockSize));
+  }
+
+  std::vector<uint> vDrawIDs(_vNodes.size());
+  for (uint i = 0; i < vDrawIDs.size(); ++i) {
+    vDrawIDs[i] = i;
+  }
+
+  glGenBuffers(1, &_drawIDBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, _drawIDBuffer);
+  glBufferData(GL_ARRAY_BUFFER, vDrawIDs.size() * sizeof(uint),
+               &vDrawIDs[0], GL_STATIC_DRAW);
+  glEnableVertexAttribArray(4);
+  glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, 0, NULL);
+  glVertexAttribDivisor(4, 1);
+
+  glGenBuffers(1, &_indexBuffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, _numIndices * sizeof(uint),
+               indices, GL_STATIC_DRAW);
+
+  glBindVertexArray(oldVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, oldArrayBuffer);
+
+  for (uint i = 0; i < _vNodes.size(); ++i) {
+    updateDrawData(i);
+  }
+
+  glGenBuffers(1, &_drawDataBuffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, _drawDataBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER,
+               _vDrawData.size() * sizeof(SBatchDrawData),
+               &_vDrawData[0], GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  for (uint i = 0; i < _vTextureArrays.size(); ++i) {
+    initTextureArray(_vTextureArrays[i]);
+  }
+
+  kore::Log::getInstance()->write("Batched %u meshes (%u vertices) and %u "
+    "textures in %u texture arrays into one multi-draw per pass and array\n",
+    (uint)_vNodes.size(), _numVertices,
+    (uint)_textureLayers.size(), (uint)_vTextureArrays.size());
+
+  // The vertex data is on the GPU now
+  if (cache) {
+    cache->release();
+  }
+  std::vector<glm::vec3>().swap(_vPositions);
+  std::vector<glm::vec3>().swap(_vNormals);
+  std::vector<glm::vec3>().swap(_vTangents);
+  std::vector<glm::vec3>().swap(_vUVs);
+  std::vector<uint>().swap(_vIndices);
+  return true;
+}
+
+void MeshBatch::initTextureArray(SBatchTextureArray* texArray) {
+  kore::RenderManager* renderMgr = kore::RenderManager::getInstance();
+  glGenTextures(1, &texArray->handle);
+  renderMgr->bindTexture(GL_TEXTURE_2D_ARRAY, texArray->handle);
+  glTexStorage3D(GL_TEXTURE_2D_ARRAY, texArray->numLevels,
+                 texArray->internalFormat, texArray->width, texArray->height,
+                 texArray->vTextures.size());
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                  texArray->numLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR
+                                          : GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  renderMgr->bindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+  // Same size and format, so every level is copied as it is. This works
+  // for compressed formats as well.
+  for (uint layer = 0; layer < texArray->vTextures.size(); ++layer) {
+    for (uint level = 0; level < texArray->numLevels; ++level) {
+      glCopyImageSubData(texArray->vTextures[layer]->getHandle(),
+                         GL_TEXTURE_2D, level, 0, 0, 0,
+                         texArray->handle, GL_TEXTURE_2D_ARRAY, level,
+                         0, 0, layer,
+                         glm::max(texArray->width >> level, 1U),
+                         glm::max(texArray->height >> level, 1U), 1);
+    }
+  }
+
+  texArray->texInfo.internalFormat = texArray->internalFormat;
+  texArray->texInfo.texLocation = texArray->handle;
+  texArray->texInfo.texTarget = GL_TEXTURE_2D_ARRAY;
+
+  texArray->shdSampler.name = "MeshBatch texture array";
+  texArray->shdSampler.type = GL_SAMPLER_2D_ARRAY;
+  texArray->shdSampler.data = &texArray->texInfo;
+
+  kore::Log::getInstance()->write("MeshBatch texture array: %u x %u, "
+    "format 0x%x, %u levels, %u layers\n", texArray->width,
+    texArray->height, texArray->internalFormat, texArray->numLevels,
+    (uint)texArray->vTextures.size());
+}
+
+void MeshBatch::updateDrawData(uint draw) {
+  const kore::SceneComponent* transform = _vNodes[draw]->getTransform();
+  const glm::mat4& modelMat = *static_cast<glm::mat4*>(
+    transform->getShaderData("model Matrix")->data);
+  const glm::mat3& normalMat = *static_cast<glm::mat3*>(
+    transform->getShaderData("normal Matrix")->data);
+
+  _vDrawData[draw].modelMat = modelMat;
+  _vDrawData[draw].normalMat = glm::mat4(normalMat);
+}
+
+void MeshBatch::update() {
+  if (!_drawDataBuffer) {
+    return;
+  }
+
+  for (uint i = 0; i < _vNodes.size(); ++i) {
+    glm::mat4 oldModelMat = _vDrawData[i].modelMat;
+    updateDrawData(i);
+    if (_vDrawData[i].modelMat == oldModelMat) {
+      continue;
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _drawDataBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, i * sizeof(SBatchDrawData),
+                    sizeof(SBatchDrawData), &_vDrawData[i]);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  }
+}
+
+
+MeshBatchDraw::MeshBatchDraw(kore::ShaderProgramPass* pass, MeshBatch* batch,
+                             const kore::ShaderInput* diffuseSampler,
+                             const kore::ShaderInput* normalSampler)
+  : _pass(pass),
+    _batch(batch),
+    _commandsDirty(false) {
+  SCommandCounters zero = {0, 0, 0, 0, 0.0};
+  _counters = zero;
+  getRegistry().push_back(this);
+
+  const std::vector<SDrawElementsIndirectCommand>& vCommands =
+    batch->getCommands();
+
+  // Sort the draws by the texture arrays the pass samples, so each set of
+  // arrays is bound once and drawn with one multi-draw
+  std::vector<std::pair<std::pair<int, int>, uint> > vSortedDraws;
+  for (uint i = 0; i < vCommands.size(); ++i) {
+    const SBatchDrawData& drawData = batch->getDrawData(i);
+    std::pair<int, int> arrays(diffuseSampler ? drawData.diffuseArray : -1,
+                               normalSampler ? drawData.normalArray : -1);
+    vSortedDraws.push_back(std::make_pair(arrays, i));
+  }
+  std::sort(vSortedDraws.begin(), vSortedDraws.end());
+
+  _vCommandOfDraw.resize(vCommands.size());
+  for (uint i = 0; i < vSortedDraws.size(); ++i) {
+    uint draw = vSortedDraws[i].second;
+    _vCommands.push_back(vCommands[draw]);
+    _vCommandOfDraw[draw] = i;
+
+    const std::pair<int, int>& arrays = vSortedDraws[i].first;
+    if (i > 0 && arrays == vSortedDraws[i - 1].first) {
+      ++_vGroups.back().numCommands;
+      continue;
+    }
+
+    SDrawGroup group;
+    group.firstCommand = i;
+    group.numCommands = 1;
+    group.bindDiffuse = arrays.first < 0 ? NULL : new kore::BindTexture(
+      batch->getShdTextureArraySampler(arrays.first), diffuseSampler);
+    group.bindNormal = arrays.second < 0 ? NULL : new kore::BindTexture(
+      batch->getShdTextureArraySampler(arrays.second), normalSampler);
+    _vGroups.push_back(group);
+  }
+
+  glGenBuffers(1, &_indirectBuffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, _indirectBuffer);
+  glBufferData(GL_COPY_WRITE_BUFFER,
+               _vCommands.size() * sizeof(SDrawElementsIndirectCommand),
+               _vCommands.empty() ? NULL : &_vCommands[0], GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  _bindIndirectBuffer =
+    new kore::BindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirectBuffer);
+}
+
+MeshBatchDraw::~MeshBatchDraw() {
+  for (uint i = 0; i < _vGroups.size(); ++i) {
+    delete _vGroups[i].bindDiffuse;
+    delete _vGroups[i].bindNormal;
+  }
+  delete _bindIndirectBuffer;
+  glDeleteBuffers(1, &_indirectBuffer);
+
+  std::vector<MeshBatchDraw*>& registry = getRegistry();
+  registry.erase(std::remove(registry.begin(), registry.end(), this),
+                 registry.end());
+}
+
+std::vector<MeshBatchDraw*>& MeshBatchDraw::getRegistry() {
+  static std::vector<MeshBatchDraw*> registry;
+  return registry;
+}
+
+const std::vector<MeshBatchDraw*>& MeshBatchDraw::getBatchDraws() {
+  return getRegistry();
+}
+
+void MeshBatchDraw::setDrawEnabled(uint draw, bool enabled) {
+  uint numInstances = enabled ? 1 : 0;
+  SDrawElementsIndirectCommand& command = _vCommands[_vCommandOfDraw[draw]];
+  if (command.numInstances != numInstances) {
+    command.numInstances = numInstances;
+    _commandsDirty = true;
+  }
+}
+
+void MeshBatchDraw::execute() {
+  if (_vCommands.empty()) {
+    return;
+  }
+
+  GPUprofiler* profiler = GPUprofiler::getInstance();
+  double startMS = profiler->getCPUtimeMS();
+  _counters.binds = 0;
+  _counters.draws = 0;
+
+  if (_commandsDirty) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _indirectBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, 0,
+                    _vCommands.size() * sizeof(SDrawElementsIndirectCommand),
+                    &_vCommands[0]);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    _commandsDirty = false;
+  }
+
+  GLint oldVAO = 0;
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &oldVAO);
+
+  glBindVertexArray(_batch->getVAO());
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_BATCH_BINDING,
+                   _batch->getDrawDataBuffer());
+  _bindIndirectBuffer->execute();
+
+  for (uint i = 0; i < _vGroups.size(); ++i) {
+    const SDrawGroup& group = _vGroups[i];
+    if (group.bindDiffuse) {
+      group.bindDiffuse->execute();
+      ++_counters.binds;
+    }
+    if (group.bindNormal) {
+      group.bindNormal->execute();
+      ++_counters.binds;
+    }
+
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+      reinterpret_cast<GLvoid*>(group.firstCommand
+                                * sizeof(SDrawElementsIndirectCommand)),
+      group.numCommands, 0);
+    ++_counters.draws;
+  }
+
+  glBindVertexArray(oldVAO);
+  _counters.submitMS = profiler->getCPUtimeMS() - startMS;
+}
@@ -0,0 +1,211 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#ifndef VCT_SRC_VCT_MESHBATCH_H_
+#define VCT_SRC_VCT_MESHBATCH_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "KoRE/Common.h"
+#include "KoRE/SceneNode.h"
+#include "KoRE/ShaderData.h"
+#include "KoRE/Texture.h"
+#include "KoRE/Operations/BindBuffer.h"
+#include "KoRE/Operations/BindTexture.h"
+#include "KoRE/Passes/ShaderProgramPass.h"
+#include "VoxelConeTracing/Scene/MeshCache.h"
+#include "VoxelConeTracing/Util/CommandList.h"
+
+// Shader storage binding of the per-draw data (see _meshBatch.shader)
+#define MESH_BATCH_BINDING 6
+
+/// glMultiDrawElementsIndirect-arguments of one mesh
+struct SDrawElementsIndirectCommand {
+  uint numIndices;
+  uint numInstances;
+  uint firstIndex;
+  uint baseVertex;
+  uint baseInstance;  // Doubles as draw ID (see MeshBatch)
+};
+
+/// Per-draw data, has to match SDrawData in _meshBatch.shader (std430)
+struct SBatchDrawData {
+  glm::mat4 modelMat;
+  glm::mat4 normalMat;  // mat3 in the upper left
+  int diffuseLayer;     // -1 if the mesh has no diffuse texture
+  int normalLayer;      // -1 if the mesh has no normal map
+  int diffuseArray;     // Texture array of the layers, -1 if none
+  int normalArray;
+};
+
+/// Texture array of all batched textures with the same size, format and
+/// number of mip levels
+struct SBatchTextureArray {
+  GLuint handle;
+  GLenum internalFormat;
+  uint width;
+  uint height;
+  uint numLevels;
+  std::vector<const kore::Texture*> vTextures;
+  kore::STextureInfo texInfo;
+  kore::ShaderData shdSampler;
+};
+
+/*! Merges the meshes of the render nodes into one vertex and index buffer,
+*   so a pass can draw all of them with one glMultiDrawElementsIndirect
+*   (see MeshBatchDraw). The transform and texture layers of each mesh are
+*   stored in a shader storage buffer indexed by the draw ID, which reaches
+*   the vertex shader as instanced attribute via the base instance of the
+*   draw's command. Textures of the same size and format share a texture
+*   array. Their mip levels are copied as they are, so compressed textures
+*   stay compressed. The merged vertex and index data can be taken from a
+*   MeshCache of a previous run.
+*
+*   Vertex attributes: 0 position, 1 normal, 2 tangent, 3 uv, 4 draw ID
+*/
+class MeshBatch {
+public:
+  MeshBatch();
+  ~MeshBatch();
+
+  /// Returns false if any of the meshes can't be batched, e.g. because its
+  /// vertex data is not available on the CPU. The passes then have to
+  /// draw the nodes separately. The vertex and index data is taken from
+  /// cache if it matches the meshes, otherwise it is stored there.
+  bool init(const std::vector<kore::SceneNode*>& vNodes,
+            MeshCache* cache = NULL);
+
+  /// Uploads the transforms of all nodes that moved.
+  void update();
+
+  inline uint getNumDraws() {return _vNodes.size();}
+
+  /// Draw of the node or -1 if it is not part of the batch
+  int getDraw(const kore::SceneNode* node);
+
+  inline const SBatchDrawData& getDrawData(uint draw)
+  {return _vDrawData[draw];}
+
+  inline const std::vector<SDrawElementsIndirectCommand>& getCommands()
+  {return _vCommands;}
+
+  inline GLuint getVAO() {return _vao;}
+  inline GLuint getDrawDataBuffer() {return _drawDataBuffer;}
+
+  inline uint getNumTextureArrays() {return _vTextureArrays.size();}
+  inline kore::ShaderData* getShdTextureArraySampler(uint array)
+  {return &_vTextureArrays[array]->shdSampler;}
+
+  /// Defines for the shaders of batched passes
+  static std::string getShaderDefines();
+
+private:
+  /// With geometryCached, the vertex and index data is already in place
+  /// and only the draw of the node is added.
+  bool appendMesh(kore::SceneNode* node, bool geometryCached);
+  bool matchesCache(const std::vector<kore::SceneNode*>& vNodes,
+                    MeshCache* cache);
+  void storeCache(MeshCache* cache);
+  /// Adds the texture to the array of its size and format if it is not
+  /// part of one yet. Returns its layer and sets array.
+  int getTextureLayer(const kore::Texture* texture, int* array);
+  void initTextureArray(SBatchTextureArray* texArray);
+  void updateDrawData(uint draw);
+  void destroy();
+
+  std::vector<kore::SceneNode*> _vNodes;
+  std::vector<SBatchDrawData> _vDrawData;
+  std::vector<SDrawElementsIndirectCommand> _vCommands;
+
+  // Vertex data of all meshes, one block per attribute
+  std::vector<glm::vec3> _vPositions;
+  std::vector<glm::vec3> _vNormals;
+  std::vector<glm::vec3> _vTangents;
+  std::vector<glm::vec3> _vUVs;
+  std::vector<uint> _vIndices;
+  uint _numVertices;
+  uint _numIndices;
+
+  std::vector<SBatchTextureArray*> _vTextureArrays;
+  std::map<const kore::Texture*, std::pair<int, int> > _textureLayers;
+
+  GLuint _vao;
+  GLuint _vertexBuffer;
+  GLuint _indexBuffer;
+  GLuint _drawIDBuffer;
+  GLuint _drawDataBuffer;
+};
+
+/*! One multi-draw over the meshes of a MeshBatch per set of texture arrays
+*   the pass samples. Every pass has its own, so each can leave out meshes
+*   (by drawing them with zero instances).
+*/
+class MeshBatchDraw {
+public:
+  /// The texture arrays of the draws are bound to diffuseSampler and
+  /// normalSampler, NULL if the pass doesn't sample them.
+  MeshBatchDraw(kore::ShaderProgramPass* pass, MeshBatch* batch,
+                const kore::ShaderInput* diffuseSampler = NULL,
+                const kore::ShaderInput* normalSampler = NULL);
+  ~MeshBatchDraw();
+
+  void setDrawEnabled(uint draw, bool enabled);
+
+  /// Draws all enabled meshes. The program has to be bound already.
+  void execute();
+
+  inline kore::ShaderProgramPass* getPass() const {return _pass;}
+
+  /// Texture binds, multi-draw calls and CPU-time of the last execution
+  inline const SCommandCounters& getCounters() const {return _counters;}
+
+  /// All batch draws, e.g. to show their counters
+  static const std::vector<MeshBatchDraw*>& getBatchDraws();
+
+private:
+  /// Consecutive commands that use the same texture arrays
+  struct SDrawGroup {
+    uint firstCommand;
+    uint numCommands;
+    kore::BindTexture* bindDiffuse;  // NULL if not sampled
+    kore::BindTexture* bindNormal;
+  };
+
+  static std::vector<MeshBatchDraw*>& getRegistry();
+
+  kore::ShaderProgramPass* _pass;
+  MeshBatch* _batch;
+  std::vector<SDrawElementsIndirectCommand> _vCommands;  // Sorted by group
+  std::vector<uint> _vCommandOfDraw;
+  std::vector<SDrawGroup> _vGroups;
+  GLuint _indirectBuffer;
+  kore::BindBuffer* _bindIndirectBuffer;
+  bool _commandsDirty;
+  SCommandCounters _counters;
+};
+
+#endif  // VCT_SRC_VCT_MESHBATCH_H_
@@ -0,0 +1,196 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+#include "VoxelConeTracing/Scene/MeshCache.h"
+
+#include <fstream>
+
+#include "KoRE/Log.h"
+#include "KoRE/Timer.h"
+
+#define MESHCACHE_MAGIC 0x4843534D  // "MSCH"
+#define MESHCACHE_VERSION 2
+
+struct SMeshCacheHeader {
+  uint magic;
+  uint version;
+  unsigned long long sceneFileSize;
+  unsigned long long sceneFileTime;
+  uint numMeshes;
+  uint numVertices;
+  uint numIndices;
+  uint padding;  // Keeps the entries behind the header 8-byte aligned
+};
+
+MeshCache::MeshCache() :
+  _loaded(false),
+  _loadTimeMS(0.0),
+  _numEntries(0),
+  _numVertices(0),
+  _numIndices(0),
+  _entries(NULL),
+  _indices(NULL) {
+  for (uint i = 0; i < 4; ++i) {
+    _blocks[i] = NULL;
+  }
+}
+
+MeshCache::~MeshCache() {
+  if (_worker.joinable()) {
+    _worker.join();
+  }
+}
+
+std::string MeshCache::getCacheFile() const {
+  return _sceneFile + ".meshcache";
+}
+
+void MeshCache::startLoad(const std::string& sceneFile) {
+  _sceneFile = sceneFile;
+  _loaded = false;
+  _worker = std::thread(&MeshCache::load, this);
+}
+
+bool MeshCache::waitForLoad() {
+  if (!_worker.joinable()) {
+    return _loaded;
+  }
+
+  _worker.join();
+  if (_loaded) {
+    kore::Log::getInstance()->write(
+      "[SETUP] Mesh cache %s: %u meshes, %u vertices mapped in %f ms\n",
+      getCacheFile().c_str(), _numEntries, _numVertices, _loadTimeMS);
+  }
+  return _loaded;
+}
+
+void MeshCache::release() {
+  if (_worker.joinable()) {
+    _worker.join();
+  }
+
+  _file.close();
+  _loaded = false;
+  _numEntries = 0;
+  _numVertices = 0;
+  _numIndices = 0;
+  _entries = NULL;
+  _indices = NULL;
+  for (uint i = 0; i < 4; ++i) {
+    _blocks[i] = NULL;
+  }
+}
+
+// Runs on the worker thread, must not touch GL or the KoRE log.
+void MeshCache::load() {
+  kore::Timer timer;
+  timer.start();
+
+  unsigned long long sceneFileSize = 0;
+  unsigned long long sceneFileTime = 0;
+  if (!MappedFile::getFileStamp(_sceneFile, &sceneFileSize, &sceneFileTime)
+      || !_file.open(getCacheFile())
+      || _file.getSize() < sizeof(SMeshCacheHeader)) {
+    _file.close();
+    return;
+  }
+
+  const SMeshCacheHeader* header =
+    reinterpret_cast<const SMeshCacheHeader*>(_file.getData());
+  if (header->magic != MESHCACHE_MAGIC
+      || header->version != MESHCACHE_VERSION
+      || header->sceneFileSize != sceneFileSize
+      || header->sceneFileTime != sceneFileTime
+      || header->numMeshes == 0 || header->numVertices == 0
+      || header->numIndices == 0) {
+    _file.close();
+    return;
+  }
+
+  unsigned long long expectedSize = sizeof(SMeshCacheHeader)
+    + sizeof(SMeshCacheEntry) * (unsigned long long) header->numMeshes
+    + 4 * sizeof(glm::vec3) * (unsigned long long) header->numVertices
+    + sizeof(uint) * (unsigned long long) header->numIndices;
+  if (_file.getSize() != expectedSize) {
+    _file.close();
+    return;
+  }
+
+  const char* data = _file.getData() + sizeof(SMeshCacheHeader);
+  _entries = reinterpret_cast<const SMeshCacheEntry*>(data);
+  data += sizeof(SMeshCacheEntry) * header->numMeshes;
+
+  for (uint i = 0; i < 4; ++i) {
+    _blocks[i] = reinterpret_cast<const glm::vec3*>(data);
+    data += sizeof(glm::vec3) * header->numVertices;
+  }
+  _indices = reinterpret_cast<const uint*>(data);
+
+  _numEntries = header->numMeshes;
+  _numVertices = header->numVertices;
+  _numIndices = header->numIndices;
+  _loaded = true;
+  _loadTimeMS = timer.timeSinceLastCall() * 1000.0;
+}
+
+void MeshCache::store(const std::vector<SMeshCacheEntry>& vEntries,
+                      const std::vector<glm::vec3>* blocks[4],
+                      const std::vector<uint>& vIndices) {
+  if (_sceneFile.empty() || vEntries.empty()) {
+    return;
+  }
+
+  // The mapping of an outdated cache would keep the file open
+  release();
+
+  SMeshCacheHeader header;
+  header.magic = MESHCACHE_MAGIC;
+  header.version = MESHCACHE_VERSION;
+  if (!MappedFile::getFileStamp(_sceneFile, &header.sceneFileSize,
+                                &header.sceneFileTime)) {
+    return;
+  }
+
+  std::ofstream out(getCacheFile().c_str(), std::ios::out | std::ios::binary);
+  if (!out.is_open()) {
+    kore::Log::getInstance()->write(
+      "[WARNING] Could not write mesh cache %s\n", getCacheFile().c_str());
+    return;
+  }
+
+  header.numMeshes = vEntries.size();
+  header.numVertices = blocks[0]->size();
+  header.numIndices = vIndices.size();
+  header.padding = 0;
+  out.write((const char*) &header, sizeof(SMeshCacheHeader));
+  out.write((const char*) &vEntries[0],
+            sizeof(SMeshCacheEntry) * header.numMeshes);
+
+  for (uint i = 0; i < 4; ++i) {
+    out.write((const char*) &(*blocks[i])[0],
+              sizeof(glm::vec3) * header.numVertices);
+  }
+  out.write((const char*) &vIndices[0], sizeof(uint) * header.numIndices);
+}
@@ -0,0 +1,97 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+#ifndef VCT_SRC_VCT_MESHCACHE_H_
+#define VCT_SRC_VCT_MESHCACHE_H_
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "KoRE/Common.h"
+#include "VoxelConeTracing/Util/MappedFile.h"
+
+/// Vertex and index counts of one cached mesh
+struct SMeshCacheEntry {
+  uint numVertices;
+  uint numIndices;
+};
+
+/*! Binary cache of the vertex and index data a MeshBatch builds from the
+*   meshes of a scene (one vec3 block per attribute plus the indices). The
+*   file of the previous run is memory-mapped and validated on a worker
+*   thread while KoRE parses the scene. The batch then uploads the mapped
+*   blocks directly instead of converting the mesh attributes.
+*   The cache is stored next to the scene file and is discarded if the
+*   scene file's size or modification time changed.
+*/
+class MeshCache {
+public:
+  MeshCache();
+  ~MeshCache();
+
+  /// Starts mapping the cache of sceneFile on a worker thread.
+  void startLoad(const std::string& sceneFile);
+
+  /// Waits for the worker. Returns false if there is no valid cache.
+  bool waitForLoad();
+
+  /// Unmaps the cache, e.g. after its data has been uploaded.
+  void release();
+
+  /// Writes the data of a freshly built batch for the next run.
+  void store(const std::vector<SMeshCacheEntry>& vEntries,
+             const std::vector<glm::vec3>* blocks[4],
+             const std::vector<uint>& vIndices);
+
+  inline uint getNumEntries() const {return _numEntries;}
+  inline const SMeshCacheEntry& getEntry(uint i) const {return _entries[i];}
+
+  inline uint getNumVertices() const {return _numVertices;}
+  inline uint getNumIndices() const {return _numIndices;}
+
+  /// Attribute blocks: 0 position, 1 normal, 2 tangent, 3 uv. Point into
+  /// the mapped file until release().
+  inline const glm::vec3* getBlock(uint i) const {return _blocks[i];}
+  inline const uint* getIndices() const {return _indices;}
+
+private:
+  void load();
+  std::string getCacheFile() const;
+
+  std::string _sceneFile;
+  std::thread _worker;
+  bool _loaded;
+  double _loadTimeMS;
+
+  MappedFile _file;
+  uint _numEntries;
+  uint _numVertices;
+  uint _numIndices;
+  const SMeshCacheEntry* _entries;
+  const glm::vec3* _blocks[4];
+  const uint* _indices;
+};
+
+#endif  // VCT_SRC_VCT_MESHCACHE_H_
@@ -25,28 +25,19 @@
 
 
 #include "VoxelConeTracing/Scene/NodePool.h"
+#include "VoxelConeTracing/Util/ThreadDispatch.h"
 #include "KoRE/RenderManager.h"
 #include <sstream>
 #include "KoRE/Operations/BindOperations/BindImageTexture.h"
 
-struct SDrawArraysIndirectCommand {
-  SDrawArraysIndirectCommand() :
-    numVertices(0),
-    numPrimitives(0),
-    firstVertexIdx(0),
-    baseInstanceIdx(0) {}
 
-  uint numVertices;
-  uint numPrimitives;
-  uint firstVertexIdx;
-  uint baseInstanceIdx;
-};
 
-
-NodePool::NodePool() {
+NodePool::NodePool()
+  : _hasDisplayCopy(false) {
 }
 
-void NodePool::init(uint voxelGridResolution) {
+void NodePool::init(uint voxelGridResolution, uint maxNumNodes,
+                    bool displayCopy) {
   // Calculate num nodes
   float fnumNodesLevel = glm::pow(static_cast<float>(voxelGridResolution), 3.0f);
   uint numNodesLevel = static_cast<uint>(glm::ceil(fnumNodesLevel));
@@ -56,6 +47,11 @@ void NodePool::init(uint voxelGridResolution) {
     numNodesLevel /= 8;
     _numNodes += numNodesLevel;
   }
+
+  // A calibrated scene only needs the nodes it actually allocates
+  if (maxNumNodes > 0) {
+    _numNodes = glm::min(_numNodes, maxNumNodes);
+  }
   //////////////////////////////////////////////////////////////////////////
 
   // Calculate num Levels
@@ -88,9 +84,7 @@ void NodePool::init(uint voxelGridResolution) {
   levelAddressProps.usageHint = GL_STATIC_DRAW;
 
   std::vector<uint> initialValues;
-  initialValues.resize(_numLevels, 0xFFFFFFFF);
-  initialValues[0] = 0;
-  initialValues[1] = 1;
+  getInitialLevelAddresses(initialValues);
   _levelAddressBuffer.create(levelAddressProps, "LevelAddress Buffer", &initialValues[0]);
 
   _levelAddressBuffer_texInfo.internalFormat = GL_R32UI;
@@ -148,6 +142,35 @@ void NodePool::init(uint voxelGridResolution) {
     }
     glUnmapBuffer(GL_TEXTURE_BUFFER);*/
   }
+
+  // The display copy starts empty, so nothing is rendered before the first
+  // complete SVO
+  _hasDisplayCopy = displayCopy;
+  std::vector<uint> emptyNodes;
+  if (_hasDisplayCopy) {
+    emptyNodes.resize(_numNodes, 0U);
+  }
+
+  for (uint i = 0; i < NUM_DISPLAY_ATTRIBUTES; ++i) {
+    if (_hasDisplayCopy) {
+      std::stringstream ssName;
+      ssName << "NodePool_Display_" << i;
+      _nodePoolDisplay[i].create(nodePoolBufProps, ssName.str(),
+                                 &emptyNodes[0]);
+
+      _nodePoolDisplayTexInfo[i].internalFormat = GL_R32UI;
+      _nodePoolDisplayTexInfo[i].texLocation =
+        _nodePoolDisplay[i].getTexHandle();
+      _nodePoolDisplayTexInfo[i].texTarget = GL_TEXTURE_BUFFER;
+      _shdNodePoolDisplaySampler[i].name = ssName.str();
+      _shdNodePoolDisplaySampler[i].data = &_nodePoolDisplayTexInfo[i];
+    } else {
+      _shdNodePoolDisplaySampler[i].name = _shdNodePoolSampler[i].name;
+      _shdNodePoolDisplaySampler[i].data = &_nodePoolTexInfo[i];
+    }
+    _shdNodePoolDisplaySampler[i].type = GL_UNSIGNED_INT_SAMPLER_BUFFER;
+  }
+
   // Create node pool allocation AC
 
 
@@ -161,6 +184,41 @@ void NodePool::init(uint voxelGridResolution) {
   _shdAcNodePoolNextFree.type = GL_UNSIGNED_INT_ATOMIC_COUNTER;
 }
 
+void NodePool::copyToDisplay() {
+  if (!_hasDisplayCopy) {
+    return;
+  }
+
+  // Make the image stores of the construction visible to the copy
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+  for (uint i = 0; i < NUM_DISPLAY_ATTRIBUTES; ++i) {
+    glBindBuffer(GL_COPY_READ_BUFFER, _nodePool[i].getBufferHandle());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _nodePoolDisplay[i].getBufferHandle());
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                        sizeof(uint) * _numNodes);
+  }
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void NodePool::getInitialLevelAddresses(std::vector<uint>& addresses) {
+  addresses.clear();
+  addresses.resize(_numLevels, 0xFFFFFFFF);
+  addresses[0] = 0;
+  addresses[1] = 1;
+}
+
+void NodePool::resetLevelAddressBuffer() {
+  std::vector<uint> initialValues;
+  getInitialLevelAddresses(initialValues);
+
+  kore::RenderManager::getInstance()->
+    bindBuffer(GL_TEXTURE_BUFFER, _levelAddressBuffer.getBufferHandle());
+  glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(uint) * _numLevels,
+                  &initialValues[0]);
+}
+
 
 NodePool::~NodePool() {
 
@@ -173,10 +231,7 @@ void NodePool::initThreadBuffers() {
   // filled correctly with a modify-Pass.
   // Voxel fragment list indirect command buf
   SDrawArraysIndirectCommand svoNodesCMD;
-  svoNodesCMD.numVertices = 1;
-  svoNodesCMD.numPrimitives = 1;
-  svoNodesCMD.firstVertexIdx = 0;
-  svoNodesCMD.baseInstanceIdx = 0;
+  svoNodesCMD.setNumThreads(1);
 
   kore::STextureBufferProperties props;
   props.internalFormat = GL_R32UI;
@@ -210,10 +265,7 @@ void NodePool::initThreadBuffers() {
     kore::Log::getInstance()->write("[DEBUG] number of voxels on level %u: %u \n",
                                     iLevel, numVoxelsOnLevel);
     SDrawArraysIndirectCommand command;
-    command.numVertices = numVoxelsOnLevel;
-    command.numPrimitives = 1;
-    command.firstVertexIdx = 0;
-    command.baseInstanceIdx = 0;
+    command.setNumThreads(numVoxelsOnLevel);
 
     _vThreadBufs_denseLevel[iLevel].create(GL_DRAW_INDIRECT_BUFFER,
                                           sizeof(SDrawArraysIndirectCommand),
@@ -221,7 +273,7 @@ void NodePool::initThreadBuffers() {
                                           &command,
                                           "ThreadBuffers_denseLevel");
 
-    command.numVertices = numVoxelsUpToLevel;
+    command.setNumThreads(numVoxelsUpToLevel);
     _vThreadBufs_upToLevel[iLevel].create(GL_DRAW_INDIRECT_BUFFER,
                                           sizeof(SDrawArraysIndirectCommand),
                                           GL_STATIC_DRAW,
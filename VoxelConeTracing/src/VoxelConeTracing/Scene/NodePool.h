@@ -58,7 +58,11 @@ public:
   NodePool();
   ~NodePool();
 
-  void init(uint voxelGridResolution);
+  /// With displayCopy, the attributes read by the final render get copies
+  /// that only change in copyToDisplay(), so the SVO can be constructed
+  /// again while the last one is still rendered.
+  void init(uint voxelGridResolution, uint maxNumNodes = 0,
+            bool displayCopy = false);
 
   inline uint getNumLevels() {return _numLevels;}
   inline uint getNumNodes() {return _numNodes;}
@@ -85,6 +89,16 @@ public:
     return &_shdNodePoolSampler[eAttribute];
   }
 
+  /// Sampler of the NEXT or COLOR attribute used for rendering. The same as
+  /// getShdNodePoolSampler() without a display copy.
+  inline kore::ShaderData* getShdNodePoolDisplaySampler(
+                                      ENodePoolAttributes eAttribute) {
+    return &_shdNodePoolDisplaySampler[eAttribute];
+  }
+
+  /// Copies the NEXT and COLOR attributes to the display copy, if any
+  void copyToDisplay();
+
   inline kore::ShaderData* getShdNumLevels()
   {return &_shdNumLevels;}
 
@@ -97,6 +111,10 @@ public:
   inline kore::ShaderData* getShdLevelAddressBufferSampler()
   {return &_shdLevelAddressBufferSampler;}
 
+  /// Sets the level addresses back to their values before the first
+  /// construction: the root at 0, its children at 1 and no other levels
+  void resetLevelAddressBuffer();
+
   inline kore::TextureBuffer* getCmdBufSVOnodes()
   {return &_cmdBufSVOnodes;}
 
@@ -111,11 +129,20 @@ public:
   }
 
 private:
+  void getInitialLevelAddresses(std::vector<uint>& addresses);
+
   kore::TextureBuffer _nodePool[NODEPOOL_ATTRIBUTES_NUM];
   kore::STextureInfo _nodePoolTexInfo[NODEPOOL_ATTRIBUTES_NUM];
   kore::ShaderData _shdNodePool[NODEPOOL_ATTRIBUTES_NUM];
   kore::ShaderData _shdNodePoolSampler[NODEPOOL_ATTRIBUTES_NUM];
 
+  // NEXT and COLOR, the attributes the final render reads
+  static const uint NUM_DISPLAY_ATTRIBUTES = 2;
+  bool _hasDisplayCopy;
+  kore::TextureBuffer _nodePoolDisplay[NUM_DISPLAY_ATTRIBUTES];
+  kore::STextureInfo _nodePoolDisplayTexInfo[NUM_DISPLAY_ATTRIBUTES];
+  kore::ShaderData _shdNodePoolDisplaySampler[NUM_DISPLAY_ATTRIBUTES];
+
   /// Thread buffers
   std::vector<kore::IndexedBuffer> _vThreadBufs_denseLevel;
   std::vector<kore::IndexedBuffer> _vThreadBufs_upToLevel;
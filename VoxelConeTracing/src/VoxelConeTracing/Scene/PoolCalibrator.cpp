@@ -0,0 +1,372 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#include "VoxelConeTracing/Scene/PoolCalibrator.h"
+
+#include <fstream>
+
+#include "KoRE/RenderManager.h"
+#include "KoRE/Operations/FunctionOp.h"
+#include "KoRE/Log.h"
+#include "VoxelConeTracing/Scene/SceneBVH.h"
+#include "VoxelConeTracing/Util/GPUreadback.h"
+
+// Largest brick pool the 10-bit brick addresses can reference (in bricks)
+static const uint MAX_BRICKPOOL_BRICKS_PER_AXIS = 341;
+
+// Granularity of the fragment list size (see VoxelFragList::init())
+static const uint FRAGLIST_SIZE_DIVISOR = 1024;
+
+// Relative tolerance when comparing the stored grid with the fitted one
+static const float GRID_TOLERANCE = 1e-4f;
+
+PoolCalibrator::PoolCalibrator()
+  : _calibrated(false),
+    _gridCenter(0.0f),
+    _vctScene(NULL),
+    _checkedScene(NULL),
+    _checkedResolution(0),
+    _numCountsRead(0) {
+}
+
+PoolCalibrator::~PoolCalibrator() {
+}
+
+std::string PoolCalibrator::getCalibrationFile() const {
+  return _sceneFile + ".calib";
+}
+
+bool PoolCalibrator::fitGrid(const std::vector<kore::SceneNode*>& vRenderNodes,
+                             float headroom, SVCTparameters& params) {
+  SceneBVH bvh;
+  bvh.build(vRenderNodes);
+
+  SAABB bounds;
+  if (!bvh.getSceneBounds(bounds)) {
+    kore::Log::getInstance()->write("[WARNING] The scene bounds are not "
+      "available on the CPU, the voxel grid is not fitted\n");
+    return false;
+  }
+
+  // The voxels stay cubic, so the grid is fitted to the largest extent
+  glm::vec3 extents = bounds.max - bounds.min;
+  float sideLength = glm::max(extents.x, glm::max(extents.y, extents.z));
+  sideLength *= 1.0f + headroom;
+
+  params.voxel_grid_sidelengths = glm::vec3(sideLength);
+  _gridCenter = (bounds.min + bounds.max) * 0.5f;
+
+  kore::Log::getInstance()->write(
+    "[SETUP] Fitted voxel grid: side length %f, center %f %f %f\n",
+    sideLength, _gridCenter.x, _gridCenter.y, _gridCenter.z);
+  return true;
+}
+
+bool PoolCalibrator::load(const std::string& sceneFile) {
+  _sceneFile = sceneFile;
+  _calibrated = false;
+
+  std::ifstream file(getCalibrationFile().c_str());
+  if (!file.is_open()) {
+    return false;
+  }
+
+  std::string key;
+  SPoolCalibration& c = _calib;
+  uint numValues = 0;
+  while (file >> key) {
+    if (key == "voxelGridSideLengths") {
+      file >> c.voxelGridSideLengths.x >> c.voxelGridSideLengths.y
+           >> c.voxelGridSideLengths.z;
+    } else if (key == "voxelGridResolution") {
+      file >> c.voxelGridResolution;
+    } else if (key == "voxelGridCenter") {
+      file >> c.voxelGridCenter.x >> c.voxelGridCenter.y
+           >> c.voxelGridCenter.z;
+    } else if (key == "numVoxelFragments") {
+      file >> c.numVoxelFragments;
+    } else if (key == "numNodes") {
+      file >> c.numNodes;
+    } else if (key == "numBricks") {
+      file >> c.numBricks;
+    } else {
+      continue;
+    }
+    ++numValues;
+  }
+
+  if (numValues != 6 || file.bad()) {
+    kore::Log::getInstance()->write(
+      "[ERROR] Invalid pool calibration %s, ignoring it\n",
+      getCalibrationFile().c_str());
+    return false;
+  }
+
+  _calibrated = true;
+  return true;
+}
+
+bool PoolCalibrator::save() const {
+  std::ofstream file(getCalibrationFile().c_str());
+  if (!file.is_open()) {
+    kore::Log::getInstance()->write(
+      "[ERROR] Could not write pool calibration %s\n",
+      getCalibrationFile().c_str());
+    return false;
+  }
+
+  // Enough digits to compare the grid with the fitted one after loading
+  file.precision(9);
+
+  const SPoolCalibration& c = _calib;
+  file << "voxelGridSideLengths " << c.voxelGridSideLengths.x << " "
+       << c.voxelGridSideLengths.y << " " << c.voxelGridSideLengths.z << "\n";
+  file << "voxelGridResolution " << c.voxelGridResolution << "\n";
+  file << "voxelGridCenter " << c.voxelGridCenter.x << " "
+       << c.voxelGridCenter.y << " " << c.voxelGridCenter.z << "\n";
+  file << "numVoxelFragments " << c.numVoxelFragments << "\n";
+  file << "numNodes " << c.numNodes << "\n";
+  file << "numBricks " << c.numBricks << "\n";
+  return true;
+}
+
+bool PoolCalibrator::matchesGrid(const glm::vec3& sideLengths,
+                                 uint resolution,
+                                 const glm::vec3& center) const {
+  float tolerance = GRID_TOLERANCE * glm::max(sideLengths.x,
+    glm::max(sideLengths.y, sideLengths.z));
+  return resolution == _calib.voxelGridResolution
+    && glm::all(glm::lessThanEqual(
+         glm::abs(sideLengths - _calib.voxelGridSideLengths),
+         glm::vec3(tolerance)))
+    && glm::all(glm::lessThanEqual(
+         glm::abs(center - _calib.voxelGridCenter), glm::vec3(tolerance)));
+}
+
+bool PoolCalibrator::apply(float headroom, SVCTparameters& params) const {
+  if (!_calibrated) {
+    return false;
+  }
+
+  // The counts are only valid for the grid they were measured with
+  if (!matchesGrid(params.voxel_grid_sidelengths,
+                   params.voxel_grid_resolution, _gridCenter)) {
+    kore::Log::getInstance()->write("[SETUP] Pool calibration %s was "
+      "measured with another voxel grid, measuring again\n",
+      getCalibrationFile().c_str());
+    return false;
+  }
+
+  float countScale = 1.0f + headroom;
+
+  // Fragment list
+  double numGridVoxels = glm::pow((double) params.voxel_grid_resolution, 3.0);
+  double numFragments = _calib.numVoxelFragments * countScale;
+  params.fraglist_size_divisor = FRAGLIST_SIZE_DIVISOR;
+  params.fraglist_size_multiplier = static_cast<uint>(
+    glm::ceil(numFragments * FRAGLIST_SIZE_DIVISOR / numGridVoxels));
+  params.fraglist_size_multiplier =
+    glm::max(params.fraglist_size_multiplier, 1U);
+
+  // Node pool
+  params.maxNumNodes =
+    static_cast<uint>(glm::ceil(_calib.numNodes * countScale));
+
+  // Brick pool (one brick is 3x3x3 texels)
+  float numBricks = _calib.numBricks * countScale;
+  uint bricksPerAxis =
+    static_cast<uint>(glm::ceil(glm::pow(numBricks, 1.0f / 3.0f)));
+  bricksPerAxis = glm::clamp(bricksPerAxis, 1U, MAX_BRICKPOOL_BRICKS_PER_AXIS);
+  params.brickPoolResolution = bricksPerAxis * 3;
+
+  kore::Log::getInstance()->write(
+    "[SETUP] Calibrated pools: fragment list %u/%u, %u nodes, brick pool "
+    "resolution %u\n", params.fraglist_size_multiplier,
+    params.fraglist_size_divisor, params.maxNumNodes,
+    params.brickPoolResolution);
+  return true;
+}
+
+void PoolCalibrator::measureAfter(kore::ShaderProgramPass* lastPass,
+                                  VCTscene* vctScene,
+                                  const SVCTparameters& params) {
+  _vctScene = vctScene;
+  _calib.voxelGridSideLengths = params.voxel_grid_sidelengths;
+  _calib.voxelGridResolution = params.voxel_grid_resolution;
+  _calib.voxelGridCenter = vctScene->getVoxelGridCenter();
+
+  lastPass->addFinishOperation(
+    new kore::FunctionOp(std::bind(&PoolCalibrator::measure, this)));
+}
+
+uint PoolCalibrator::readAtomicCounter(GLuint bufferHandle) const {
+  kore::RenderManager::getInstance()->bindBufferBase(GL_ATOMIC_COUNTER_BUFFER,
+                                                     0, bufferHandle);
+
+  GLuint* ptr = (GLuint*) glMapBufferRange(GL_ATOMIC_COUNTER_BUFFER, 0,
+                                           sizeof(GLuint), GL_MAP_READ_BIT);
+  uint value = *ptr;
+  glUnmapBuffer(GL_ATOMIC_COUNTER_BUFFER);
+  return value;
+}
+
+void PoolCalibrator::measure() {
+  // Only the first construction, the SVO is constructed again whenever the
+  // camera moves the grid
+  if (!_vctScene) {
+    return;
+  }
+
+  // Make the counters visible to the mapped reads
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
+
+  NodePool* nodePool = _vctScene->getNodePool();
+  BrickPool* brickPool = _vctScene->getBrickPool();
+
+  _calib.numVoxelFragments =
+    readAtomicCounter(_vctScene->getAcVoxelIndex()->getHandle());
+
+  // The node counter counts allocated tiles of 8 nodes after the root
+  _calib.numNodes =
+    1 + 8 * readAtomicCounter(nodePool->getAcNodePoolNextFree()->getHandle());
+
+  _calib.numBricks =
+    readAtomicCounter(brickPool->getAcNextFree()->getHandle());
+
+  uint capacity = _vctScene->getVoxelFragList()->getVoxelFragList()
+                    ->getProperties().size / sizeof(uint);
+  if (_calib.numVoxelFragments > capacity) {
+    kore::Log::getInstance()->write(
+      "[WARNING] Voxel fragment list overflowed during calibration "
+      "(%u of %u fragments stored)\n", capacity, _calib.numVoxelFragments);
+  }
+
+  kore::Log::getInstance()->write(
+    "[SETUP] Measured %u voxel fragments, %u nodes and %u bricks\n",
+    _calib.numVoxelFragments, _calib.numNodes, _calib.numBricks);
+
+  if (save()) {
+    kore::Log::getInstance()->write(
+      "[SETUP] Stored pool calibration in %s, it is used from the next start\n",
+      getCalibrationFile().c_str());
+  }
+  _calibrated = true;
+  _vctScene = NULL;
+}
+
+void PoolCalibrator::checkAfter(kore::ShaderProgramPass* lastPass,
+                                VCTscene* vctScene,
+                                const SVCTparameters& params) {
+  _checkedScene = vctScene;
+  _checkedSideLengths = params.voxel_grid_sidelengths;
+  _checkedResolution = params.voxel_grid_resolution;
+
+  lastPass->addFinishOperation(
+    new kore::FunctionOp(std::bind(&PoolCalibrator::requestCounters, this)));
+}
+
+void PoolCalibrator::requestCounters() {
+  using namespace std::placeholders;
+
+  // The previous check is still in flight
+  if (_numCountsRead > 0 && _numCountsRead < COUNTER_NUM) {
+    return;
+  }
+  _numCountsRead = 0;
+
+  GLuint buffers[COUNTER_NUM] = {
+    _checkedScene->getAcVoxelIndex()->getHandle(),
+    _checkedScene->getNodePool()->getAcNodePoolNextFree()->getHandle(),
+    _checkedScene->getBrickPool()->getAcNextFree()->getHandle()};
+
+  glMemoryBarrier(GL_ATOMIC_COUNTER_BARRIER_BIT);
+  for (uint i = 0; i < COUNTER_NUM; ++i) {
+    GPUreadback::getInstance()->request(buffers[i], 0, 1,
+      std::bind(&PoolCalibrator::onCounterRead, this, (ECounter) i, _1, _2));
+  }
+}
+
+void PoolCalibrator::onCounterRead(ECounter counter, const uint* values,
+                                   uint numValues) {
+  _counts[counter] = numValues > 0 ? values[0] : 0;
+  if (++_numCountsRead == COUNTER_NUM) {
+    checkCounters();
+  }
+}
+
+void PoolCalibrator::checkCounters() {
+  uint numFragments = _counts[COUNTER_FRAGMENTS];
+  uint numNodes = 1 + 8 * _counts[COUNTER_NODES];
+  uint numBricks = _counts[COUNTER_BRICKS];
+
+  uint fragCapacity = _checkedScene->getVoxelFragList()->getVoxelFragList()
+                        ->getProperties().size / sizeof(uint);
+  uint nodeCapacity = _checkedScene->getNodePool()->getNumNodes();
+  uint bricksPerAxis =
+    _checkedScene->getBrickPool()->getBrickPoolResolution_leaf() / 3;
+  uint brickCapacity = bricksPerAxis * bricksPerAxis * bricksPerAxis;
+
+  bool overflowed = false;
+  if (numFragments > fragCapacity) {
+    kore::Log::getInstance()->write("[WARNING] Voxel fragment list "
+      "overflowed (%u fragments, capacity %u)\n", numFragments, fragCapacity);
+    overflowed = true;
+  }
+  if (numNodes > nodeCapacity) {
+    kore::Log::getInstance()->write("[WARNING] Node pool overflowed "
+      "(%u nodes, capacity %u)\n", numNodes, nodeCapacity);
+    overflowed = true;
+  }
+  if (numBricks > brickCapacity) {
+    kore::Log::getInstance()->write("[WARNING] Brick pool overflowed "
+      "(%u bricks, capacity %u)\n", numBricks, brickCapacity);
+    overflowed = true;
+  }
+
+  if (!overflowed || !_calibrated) {
+    return;
+  }
+
+  // The counters keep counting past the end of the pools, so they are the
+  // counts the current grid needs. Only grow, a later rebuild of a smaller
+  // part of the scene must not shrink the pools again. Counts of another
+  // grid size are not comparable.
+  float tolerance = GRID_TOLERANCE * _checkedSideLengths.x;
+  if (_checkedResolution != _calib.voxelGridResolution
+      || glm::abs(_checkedSideLengths.x - _calib.voxelGridSideLengths.x)
+         > tolerance) {
+    return;
+  }
+
+  _calib.numVoxelFragments = glm::max(_calib.numVoxelFragments, numFragments);
+  _calib.numNodes = glm::max(_calib.numNodes, numNodes);
+  _calib.numBricks = glm::max(_calib.numBricks, numBricks);
+
+  if (save()) {
+    kore::Log::getInstance()->write("[WARNING] Raised the pool calibration "
+      "in %s, the pools grow from the next start\n",
+      getCalibrationFile().c_str());
+  }
+}
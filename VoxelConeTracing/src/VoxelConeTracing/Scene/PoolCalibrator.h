@@ -0,0 +1,124 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#ifndef VCT_SRC_VCT_POOLCALIBRATOR_H_
+#define VCT_SRC_VCT_POOLCALIBRATOR_H_
+
+#include <string>
+#include <vector>
+
+#include "KoRE/Common.h"
+#include "KoRE/Passes/ShaderProgramPass.h"
+#include "VoxelConeTracing/Scene/VCTscene.h"
+
+/*! The voxel-, node- and brick-counts of one scene, measured with the given
+*   voxel grid.
+*/
+struct SPoolCalibration {
+  glm::vec3 voxelGridSideLengths;
+  uint voxelGridResolution;
+  glm::vec3 voxelGridCenter;
+  uint numVoxelFragments;
+  uint numNodes;
+  uint numBricks;
+};
+
+/*! Fits the voxel grid around the scene's mesh bounds and sizes the pools
+*   from a construction with exactly that grid instead of the hand-tuned
+*   defaults. The counts are stored next to the scene-file, so only the
+*   first run (or a recalibration, or a run with another grid) constructs
+*   the SVO with the default pool sizes to measure them.
+*/
+class PoolCalibrator {
+public:
+  PoolCalibrator();
+  ~PoolCalibrator();
+
+  /// Fits the voxel grid around the world-space AABB of the render nodes'
+  /// meshes, enlarged by headroom (e.g. 0.1 for 10%). Returns false and
+  /// keeps the grid if a mesh has no vertices on the CPU.
+  bool fitGrid(const std::vector<kore::SceneNode*>& vRenderNodes,
+               float headroom, SVCTparameters& params);
+
+  /// Center of the fitted grid, the measurement has to be constructed there
+  inline const glm::vec3& getGridCenter() const {return _gridCenter;}
+
+  /// Loads the stored calibration of the scene. Returns false if the scene
+  /// has not been calibrated yet.
+  bool load(const std::string& sceneFile);
+
+  /// Sizes the fragment list, node pool and brick pool to the measured
+  /// counts plus headroom. Returns false if the calibration was measured
+  /// with another grid than the one in params, which has to be measured
+  /// then (see measureAfter()).
+  bool apply(float headroom, SVCTparameters& params) const;
+
+  /// Reads the counters of the SVO construction after lastPass has been
+  /// executed and stores them as the calibration of the scene.
+  void measureAfter(kore::ShaderProgramPass* lastPass, VCTscene* vctScene,
+                    const SVCTparameters& params);
+
+  /// Reads the counters back (without stalling) after every execution of
+  /// lastPass and warns if the calibrated pools overflowed. The counts of
+  /// the current grid then replace the stored ones, so the next start
+  /// sizes the pools from them.
+  void checkAfter(kore::ShaderProgramPass* lastPass, VCTscene* vctScene,
+                  const SVCTparameters& params);
+
+  inline bool isCalibrated() const {return _calibrated;}
+
+private:
+  enum ECounter {
+    COUNTER_FRAGMENTS = 0,
+    COUNTER_NODES,
+    COUNTER_BRICKS,
+    COUNTER_NUM
+  };
+
+  void measure();
+  void requestCounters();
+  void onCounterRead(ECounter counter, const uint* values, uint numValues);
+  void checkCounters();
+  bool matchesGrid(const glm::vec3& sideLengths, uint resolution,
+                   const glm::vec3& center) const;
+  bool save() const;
+  uint readAtomicCounter(GLuint bufferHandle) const;
+  std::string getCalibrationFile() const;
+
+  std::string _sceneFile;
+  SPoolCalibration _calib;
+  bool _calibrated;
+  glm::vec3 _gridCenter;
+  VCTscene* _vctScene;
+
+  // Overflow check of the calibrated pools
+  VCTscene* _checkedScene;
+  glm::vec3 _checkedSideLengths;
+  uint _checkedResolution;
+  uint _counts[COUNTER_NUM];
+  uint _numCountsRead;
+};
+
+#endif  // VCT_SRC_VCT_POOLCALIBRATOR_H_
@@ -0,0 +1,343 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+#include "VoxelConeTracing/Scene/SceneBVH.h"
+
+#include <algorithm>
+
+#include "KoRE/Mesh.h"
+#include "KoRE/Components/MeshComponent.h"
+
+// Render nodes per leaf
+static const uint MAX_LEAF_SIZE = 2;
+
+// Bounds of nodes whose vertices are not available on the CPU, they are
+// never culled
+static const float UNBOUNDED = 1e30f;
+
+void SFrustum::setFromViewProjection(const glm::mat4& viewProj) {
+  glm::vec4 rows[4];
+  for (uint i = 0; i < 4; ++i) {
+    rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i],
+                        viewProj[2][i], viewProj[3][i]);
+  }
+
+  planes[0] = rows[3] + rows[0];  // Left
+  planes[1] = rows[3] - rows[0];  // Right
+  planes[2] = rows[3] + rows[1];  // Bottom
+  planes[3] = rows[3] - rows[1];  // Top
+  planes[4] = rows[3] + rows[2];  // Near
+  planes[5] = rows[3] - rows[2];  // Far
+}
+
+static inline glm::vec3 getCenter(const SAABB& box) {
+  return (box.min + box.max) * 0.5f;
+}
+
+static inline void extend(SAABB& box, const SAABB& other) {
+  box.min = glm::min(box.min, other.min);
+  box.max = glm::max(box.max, other.max);
+}
+
+// Returns the local AABB of the node's mesh, false if the vertices are not
+// available on the CPU
+static bool getLocalBounds(kore::SceneNode* node, SAABB& bounds) {
+  using namespace kore;
+
+  bounds.min = bounds.max = glm::vec3(0.0f);
+
+  MeshComponent* meshComp =
+    static_cast<MeshComponent*>(node->getComponent(COMPONENT_MESH));
+  if (!meshComp || !meshComp->getMesh()) {
+    return true;  // Nothing to draw
+  }
+
+  const Mesh* mesh = meshComp->getMesh();
+  const MeshAttributeArray* att = mesh->getAttributeByName("v_position");
+  if (!att || !att->data || att->componentType != GL_FLOAT
+      || att->numComponents < 3 || mesh->getNumVertices() == 0) {
+    return false;
+  }
+
+  const float* src = static_cast<const float*>(att->data);
+  bounds.min = bounds.max = glm::vec3(src[0], src[1], src[2]);
+  for (uint v = 1; v < mesh->getNumVertices(); ++v) {
+    const float* pos = src + v * att->numComponents;
+    glm::vec3 p(pos[0], pos[1], pos[2]);
+    bounds.min = glm::min(bounds.min, p);
+    bounds.max = glm::max(bounds.max, p);
+  }
+  return true;
+}
+
+// Tests the box against the planes in planeMask. Returns false if it is
+// outside of one, the planes it is completely inside of are removed from
+// planeMask, so they don't have to be tested for anything inside the box.
+static bool intersects(const SFrustum& frustum, const SAABB& box,
+                       uint& planeMask) {
+  for (uint i = 0; i < 6; ++i) {
+    if (!(planeMask & (1 << i))) {
+      continue;
+    }
+
+    const glm::vec4& plane = frustum.planes[i];
+    glm::vec3 normal(plane);
+    glm::vec3 nearest(normal.x >= 0.0f ? box.max.x : box.min.x,
+                      normal.y >= 0.0f ? box.max.y : box.min.y,
+                      normal.z >= 0.0f ? box.max.z : box.min.z);
+    if (glm::dot(normal, nearest) + plane.w < 0.0f) {
+      return false;
+    }
+
+    glm::vec3 farthest(normal.x >= 0.0f ? box.min.x : box.max.x,
+                       normal.y >= 0.0f ? box.min.y : box.max.y,
+                       normal.z >= 0.0f ? box.min.z : box.max.z);
+    if (glm::dot(normal, farthest) + plane.w >= 0.0f) {
+      planeMask &= ~(1 << i);
+    }
+  }
+  return true;
+}
+
+SceneBVH::SceneBVH() {
+}
+
+SceneBVH::~SceneBVH() {
+}
+
+void SceneBVH::build(const std::vector<kore::SceneNode*>& vNodes) {
+  _vNodes = vNodes;
+  _vLocalBounds.resize(vNodes.size());
+  _vHasBounds.resize(vNodes.size());
+  _vWorldBounds.resize(vNodes.size());
+  _vTransforms.resize(vNodes.size());
+  _vPrimitives.resize(vNodes.size());
+  _vBVHNodes.clear();
+
+  for (uint i = 0; i < vNodes.size(); ++i) {
+    _vHasBounds[i] = getLocalBounds(vNodes[i], _vLocalBounds[i]);
+    updateWorldBounds(i);
+    _vPrimitives[i] = i;
+  }
+
+  if (!vNodes.empty()) {
+    _vBVHNodes.reserve(2 * vNodes.size());
+    buildRecursive(0, vNodes.size());
+  }
+}
+
+void SceneBVH::updateWorldBounds(uint renderNode) {
+  const glm::mat4& modelMat = *static_cast<glm::mat4*>(
+    _vNodes[renderNode]->getTransform()->getShaderData("model Matrix")->data);
+  _vTransforms[renderNode] = modelMat;
+
+  SAABB& world = _vWorldBounds[renderNode];
+  if (!_vHasBounds[renderNode]) {
+    world.min = glm::vec3(-UNBOUNDED);
+    world.max = glm::vec3(UNBOUNDED);
+    return;
+  }
+
+  // Transformed center and the extent projected onto the world axes
+  const SAABB& local = _vLocalBounds[renderNode];
+  glm::vec3 center = glm::vec3(modelMat * glm::vec4(getCenter(local), 1.0f));
+  glm::vec3 halfExtent = (local.max - local.min) * 0.5f;
+
+  glm::mat3 absMat;
+  for (uint col = 0; col < 3; ++col) {
+    for (uint row = 0; row < 3; ++row) {
+      absMat[col][row] = glm::abs(modelMat[col][row]);
+    }
+  }
+  glm::vec3 worldHalfExtent = absMat * halfExtent;
+
+  world.min = center - worldHalfExtent;
+  world.max = center + worldHalfExtent;
+}
+
+struct SCenterCompare {
+  SCenterCompare(const std::vector<SAABB>& vBounds, uint axis)
+    : _vBounds(vBounds), _axis(axis) {}
+
+  bool operator()(uint a, uint b) const {
+    return getCenter(_vBounds[a])[_axis] < getCenter(_vBounds[b])[_axis];
+  }
+
+  const std::vector<SAABB>& _vBounds;
+  uint _axis;
+};
+
+uint SceneBVH::buildRecursive(uint first, uint count) {
+  uint index = _vBVHNodes.size();
+  _vBVHNodes.push_back(SBVHNode());
+
+  SAABB bounds = _vWorldBounds[_vPrimitives[first]];
+  SAABB centerBounds;
+  centerBounds.min = centerBounds.max = getCenter(bounds);
+  for (uint i = first + 1; i < first + count; ++i) {
+    const SAABB& primBounds = _vWorldBounds[_vPrimitives[i]];
+    extend(bounds, primBounds);
+    centerBounds.min = glm::min(centerBounds.min, getCenter(primBounds));
+    centerBounds.max = glm::max(centerBounds.max, getCenter(primBounds));
+  }
+
+  _vBVHNodes[index].bounds = bounds;
+  _vBVHNodes[index].first = first;
+  _vBVHNodes[index].count = count;
+  _vBVHNodes[index].right = 0;
+
+  if (count <= MAX_LEAF_SIZE) {
+    return index;
+  }
+
+  // Median split along the largest extent of the centers
+  glm::vec3 extent = centerBounds.max - centerBounds.min;
+  uint axis = 0;
+  if (extent.y > extent[axis]) axis = 1;
+  if (extent.z > extent[axis]) axis = 2;
+
+  uint half = count / 2;
+  std::nth_element(_vPrimitives.begin() + first,
+                   _vPrimitives.begin() + first + half,
+                   _vPrimitives.begin() + first + count,
+                   SCenterCompare(_vWorldBounds, axis));
+
+  buildRecursive(first, half);
+  uint right = buildRecursive(first + half, count - half);
+  _vBVHNodes[index].right = right;
+  return index;
+}
+
+bool SceneBVH::refit() {
+  bool anyMoved = false;
+  for (uint i = 0; i < _vNodes.size(); ++i) {
+    const glm::mat4& modelMat = *static_cast<glm::mat4*>(
+      _vNodes[i]->getTransform()->getShaderData("model Matrix")->data);
+    if (modelMat != _vTransforms[i]) {
+      updateWorldBounds(i);
+      anyMoved = true;
+    }
+  }
+
+  if (!anyMoved) {
+    return false;
+  }
+
+  // Children are always stored after their parent
+  for (int i = static_cast<int>(_vBVHNodes.size()) - 1; i >= 0; --i) {
+    SBVHNode& node = _vBVHNodes[i];
+    if (node.right == 0) {
+      node.bounds = _vWorldBounds[_vPrimitives[node.first]];
+      for (uint p = node.first + 1; p < node.first + node.count; ++p) {
+        extend(node.bounds, _vWorldBounds[_vPrimitives[p]]);
+      }
+    } else {
+      node.bounds = _vBVHNodes[i + 1].bounds;
+      extend(node.bounds, _vBVHNodes[node.right].bounds);
+    }
+  }
+  return true;
+}
+
+bool SceneBVH::getSceneBounds(SAABB& bounds) const {
+  if (_vBVHNodes.empty()) {
+    return false;
+  }
+
+  bounds = _vBVHNodes[0].bounds;
+  return bounds.max.x < UNBOUNDED;
+}
+
+void SceneBVH::getSubtrees(uint minNumSubtrees,
+                           std::vector<uint>& vSubtrees) const {
+  vSubtrees.clear();
+  if (_vBVHNodes.empty()) {
+    return;
+  }
+
+  // Split the largest subtree until there are enough
+  vSubtrees.push_back(0);
+  while (vSubtrees.size() < minNumSubtrees) {
+    uint largest = 0;
+    for (uint i = 1; i < vSubtrees.size(); ++i) {
+      if (_vBVHNodes[vSubtrees[i]].count
+          > _vBVHNodes[vSubtrees[largest]].count) {
+        largest = i;
+      }
+    }
+
+    const SBVHNode& node = _vBVHNodes[vSubtrees[largest]];
+    if (node.right == 0) {
+      break;  // Only leaves left
+    }
+
+    vSubtrees[largest] = vSubtrees[largest] + 1;
+    vSubtrees.push_back(node.right);
+  }
+}
+
+uint SceneBVH::cull(const SFrustum& frustum, uint subtree,
+                    unsigned char* visible) const {
+  const SBVHNode& node = _vBVHNodes[subtree];
+  for (uint i = node.first; i < node.first + node.count; ++i) {
+    visible[_vPrimitives[i]] = 0;
+  }
+  return cullRecursive(frustum, subtree, 0x3F, visible);
+}
+
+uint SceneBVH::setVisible(uint node, unsigned char* visible) const {
+  const SBVHNode& bvhNode = _vBVHNodes[node];
+  for (uint i = bvhNode.first; i < bvhNode.first + bvhNode.count; ++i) {
+    visible[_vPrimitives[i]] = 1;
+  }
+  return bvhNode.count;
+}
+
+uint SceneBVH::cullRecursive(const SFrustum& frustum, uint node,
+                             uint planeMask, unsigned char* visible) const {
+  const SBVHNode& bvhNode = _vBVHNodes[node];
+  if (!intersects(frustum, bvhNode.bounds, planeMask)) {
+    return 0;
+  }
+
+  if (planeMask == 0) {
+    return setVisible(node, visible);
+  }
+
+  if (bvhNode.right == 0) {
+    uint numVisible = 0;
+    for (uint i = bvhNode.first; i < bvhNode.first + bvhNode.count; ++i) {
+      uint primPlaneMask = planeMask;
+      uint prim = _vPrimitives[i];
+      if (intersects(frustum, _vWorldBounds[prim], primPlaneMask)) {
+        visible[prim] = 1;
+        ++numVisible;
+      }
+    }
+    return numVisible;
+  }
+
+  return cullRecursive(frustum, node + 1, planeMask, visible)
+       + cullRecursive(frustum, bvhNode.right, planeMask, visible);
+}
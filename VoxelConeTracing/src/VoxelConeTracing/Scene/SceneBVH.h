@@ -0,0 +1,111 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+#ifndef VCT_SRC_VCT_SCENEBVH_H_
+#define VCT_SRC_VCT_SCENEBVH_H_
+
+#include <vector>
+
+#include "KoRE/Common.h"
+#include "KoRE/SceneNode.h"
+
+struct SAABB {
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+/// Planes of a view frustum, a point p is inside a plane if
+/// dot(plane, vec4(p, 1)) >= 0
+struct SFrustum {
+  glm::vec4 planes[6];
+
+  void setFromViewProjection(const glm::mat4& viewProj);
+};
+
+/*! Bounding volume hierarchy over the world-space AABBs of the render
+*   nodes. The tree is built once, moved nodes only refit the bounds.
+*   The render nodes of every subtree are stored contiguously, so a subtree
+*   that is completely inside a frustum is accepted without traversing it.
+*
+*   cull() only reads the tree and only writes the nodes of its subtree,
+*   so disjoint subtrees can be culled concurrently.
+*/
+class SceneBVH {
+public:
+  SceneBVH();
+  ~SceneBVH();
+
+  void build(const std::vector<kore::SceneNode*>& vNodes);
+
+  /// Updates the bounds of all nodes that moved since the last call.
+  /// Returns true if any node moved.
+  bool refit();
+
+  /// Roots of at least minNumSubtrees (if there are enough tree nodes)
+  /// disjoint subtrees that together contain all render nodes
+  void getSubtrees(uint minNumSubtrees, std::vector<uint>& vSubtrees) const;
+
+  /// Sets visible[i] to 1 for the render nodes i of the subtree that
+  /// intersect the frustum and to 0 for the others. Returns the number of
+  /// visible nodes.
+  uint cull(const SFrustum& frustum, uint subtree,
+            unsigned char* visible) const;
+
+  /// World-space bounds of all render nodes (the bounds of the root).
+  /// Returns false if there are none or the vertices of a node are not
+  /// available on the CPU.
+  bool getSceneBounds(SAABB& bounds) const;
+
+  inline uint getNumRenderNodes() const {return _vNodes.size();}
+  inline const SAABB& getWorldBounds(uint renderNode) const
+  {return _vWorldBounds[renderNode];}
+
+private:
+  // Inner nodes have their left child directly after them. Both inner
+  // nodes and leaves reference their render nodes as range in
+  // _vPrimitives.
+  struct SBVHNode {
+    SAABB bounds;
+    uint first;
+    uint count;
+    uint right;  // 0 for leaves
+  };
+
+  uint buildRecursive(uint first, uint count);
+  void updateWorldBounds(uint renderNode);
+  uint cullRecursive(const SFrustum& frustum, uint node, uint planeMask,
+                     unsigned char* visible) const;
+  uint setVisible(uint node, unsigned char* visible) const;
+
+  std::vector<kore::SceneNode*> _vNodes;
+  std::vector<SAABB> _vLocalBounds;
+  std::vector<bool> _vHasBounds;
+  std::vector<SAABB> _vWorldBounds;
+  std::vector<glm::mat4> _vTransforms;
+
+  std::vector<uint> _vPrimitives;
+  std::vector<SBVHNode> _vBVHNodes;
+};
+
+#endif  // VCT_SRC_VCT_SCENEBVH_H_
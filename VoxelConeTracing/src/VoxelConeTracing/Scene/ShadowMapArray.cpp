@@ -0,0 +1,202 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#include "VoxelConeTracing/Scene/ShadowMapArray.h"
+#include "KoRE/RenderManager.h"
+#include "KoRE/Log.h"
+#include "../Util/MathUtil.h"
+
+ShadowMapArray::ShadowMapArray() :
+  _resolution(0, 0),
+  _numLights(0) {
+  for (uint i = 0; i < MAX_NUM_LIGHTS; ++i) {
+    _dirty[i] = true;
+  }
+}
+
+ShadowMapArray::~ShadowMapArray() {
+}
+
+void ShadowMapArray::init(const std::vector<kore::SceneNode*>& lightNodes,
+                          const glm::uvec2& resolution) {
+  _resolution = resolution;
+  _lightNodes = lightNodes;
+
+  if (_lightNodes.size() > MAX_NUM_LIGHTS) {
+    kore::Log::getInstance()->write("[WARNING] Only %u of %u lights are "
+      "used for global illumination\n", MAX_NUM_LIGHTS,
+      (uint)_lightNodes.size());
+    _lightNodes.resize(MAX_NUM_LIGHTS);
+  }
+  _numLights = _lightNodes.size();
+
+  _shdNumLights.name = "Num lights";
+  _shdNumLights.type = GL_UNSIGNED_INT;
+  _shdNumLights.size = 1;
+  _shdNumLights.data = &_numLights;
+
+  _shdLightViewProjs.name = "Light viewProjection matrices";
+  _shdLightViewProjs.type = GL_FLOAT_MAT4;
+  _shdLightViewProjs.size = MAX_NUM_LIGHTS;
+  _shdLightViewProjs.data = _lightViewProjs;
+
+  _shdLightDirs.name = "Light directions";
+  _shdLightDirs.type = GL_FLOAT_VEC3;
+  _shdLightDirs.size = MAX_NUM_LIGHTS;
+  _shdLightDirs.data = _lightDirs;
+
+  _shdLightColors.name = "Light colors";
+  _shdLightColors.type = GL_FLOAT_VEC3;
+  _shdLightColors.size = MAX_NUM_LIGHTS;
+  _shdLightColors.data = _lightColors;
+
+  // One layer per light. Allocate at least one layer, so the texture is
+  // valid even if the scene has no lights.
+  kore::STextureProperties props;
+  props.width = resolution.x;
+  props.height = resolution.y;
+  props.depth = glm::max(_numLights, 1U);
+  props.targetType = GL_TEXTURE_2D_ARRAY;
+  props.format = GL_DEPTH_STENCIL;
+  props.internalFormat = GL_DEPTH24_STENCIL8;
+  props.pixelType = GL_UNSIGNED_INT_24_8;
+  _depthArray.init(props, "ShadowMapArray");
+
+  props.format = GL_RGB;
+  props.internalFormat = GL_RGB32F;
+  props.pixelType = GL_FLOAT;
+  _positionArray.init(props, "SMpositionArray");
+
+  // Cache of the static shadow casters, see ShadowMapStage
+  props.format = GL_DEPTH_STENCIL;
+  props.internalFormat = GL_DEPTH24_STENCIL8;
+  props.pixelType = GL_UNSIGNED_INT_24_8;
+  _staticDepthArray.init(props, "StaticShadowMapArray");
+
+  props.format = GL_RGB;
+  props.internalFormat = GL_RGB32F;
+  props.pixelType = GL_FLOAT;
+  _staticPositionArray.init(props, "StaticSMpositionArray");
+
+  kore::Log::getInstance()->write("Allocating shadow map array with %u layers"
+    " of size %f MB (including the static cache)\n", props.depth,
+    MathUtil::byteToMB(props.width * props.height * props.depth
+                       * (4 + 12) * 2));
+
+  GLuint arrayHandles[] = {_positionArray.getHandle(),
+                           _depthArray.getHandle(),
+                           _staticPositionArray.getHandle(),
+                           _staticDepthArray.getHandle()};
+
+  kore::RenderManager* renderMgr = kore::RenderManager::getInstance();
+  for (uint i = 0; i < 4; ++i) {
+    renderMgr->bindTexture(GL_TEXTURE_2D_ARRAY, arrayHandles[i]);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  }
+  renderMgr->bindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+  _depthArrayTexInfo.internalFormat = GL_DEPTH24_STENCIL8;
+  _depthArrayTexInfo.texLocation = _depthArray.getHandle();
+  _depthArrayTexInfo.texTarget = GL_TEXTURE_2D_ARRAY;
+
+  _shdDepthArraySampler.name = "ShadowMapArray";
+  _shdDepthArraySampler.type = GL_SAMPLER_2D_ARRAY;
+  _shdDepthArraySampler.data = &_depthArrayTexInfo;
+
+  _positionArrayTexInfo.internalFormat = GL_RGB32F;
+  _positionArrayTexInfo.texLocation = _positionArray.getHandle();
+  _positionArrayTexInfo.texTarget = GL_TEXTURE_2D_ARRAY;
+
+  _shdPositionArraySampler.name = "SMpositionArray";
+  _shdPositionArraySampler.type = GL_SAMPLER_2D_ARRAY;
+  _shdPositionArraySampler.data = &_positionArrayTexInfo;
+
+  for (uint i = 0; i < MAX_NUM_LIGHTS; ++i) {
+    _lightViewProjs[i] = glm::mat4(1.0f);
+    _lightDirs[i] = glm::vec3(0.0f);
+    _lightColors[i] = glm::vec3(0.0f);
+    _dirty[i] = true;
+  }
+
+  update();
+
+  // All lights have to be rendered at least once
+  for (uint i = 0; i < _numLights; ++i) {
+    _dirty[i] = true;
+  }
+}
+
+void ShadowMapArray::update() {
+  using namespace kore;
+
+  for (uint i = 0; i < _numLights; ++i) {
+    Camera* lightCam =
+      static_cast<Camera*>(_lightNodes[i]->getComponent(COMPONENT_CAMERA));
+    LightComponent* lightComp =
+      static_cast<LightComponent*>(_lightNodes[i]->getComponent(COMPONENT_LIGHT));
+
+    const glm::mat4& viewProj = *static_cast<glm::mat4*>(
+                    lightCam->getShaderData("view projection Matrix")->data);
+    const glm::vec3& dir = *static_cast<glm::vec3*>(
+                    lightComp->getShaderData("direction")->data);
+    const glm::vec3& color = *static_cast<glm::vec3*>(
+                    lightComp->getShaderData("color")->data);
+
+    _dirty[i] = viewProj != _lightViewProjs[i]
+             || dir != _lightDirs[i]
+             || color != _lightColors[i];
+
+    _lightViewProjs[i] = viewProj;
+    _lightDirs[i] = dir;
+    _lightColors[i] = color;
+  }
+}
+
+bool ShadowMapArray::isAnyDirty() {
+  for (uint i = 0; i < _numLights; ++i) {
+    if (_dirty[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint ShadowMapArray::getDirtyLights() {
+  uint lightMask = 0;
+  for (uint i = 0; i < _numLights; ++i) {
+    if (_dirty[i]) {
+      lightMask |= 1U << i;
+    }
+  }
+  return lightMask;
+}
+
+std::string ShadowMapArray::getShaderDefines() {
+  return std::string("#define MAX_NUM_LIGHTS ")
+         + std::to_string(MAX_NUM_LIGHTS) + std::string("\n");
+}
@@ -0,0 +1,125 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#ifndef VCT_SRC_VCT_SHADOWMAPARRAY_H_
+#define VCT_SRC_VCT_SHADOWMAPARRAY_H_
+
+#include "KoRE/Common.h"
+
+#include "KoRE/Texture.h"
+#include "KoRE/SceneNode.h"
+#include "KoRE/Components/Camera.h"
+#include "KoRE/SceneManager.h"
+
+// Has to match the array sizes in the light-shaders. It is passed to them
+// as the MAX_NUM_LIGHTS define (see getShaderDefines()).
+static const uint MAX_NUM_LIGHTS = 4;
+
+/*! Holds one layer per directional light in a layered shadow map and
+*   the per-light parameters in arrays, so all lights can be injected and
+*   shaded in single passes. Each light is tracked for changes separately.
+*/
+class ShadowMapArray {
+public:
+  ShadowMapArray();
+  ~ShadowMapArray();
+
+  void init(const std::vector<kore::SceneNode*>& lightNodes,
+            const glm::uvec2& resolution);
+
+  /// Fetches the current light parameters and updates the dirty-flags.
+  void update();
+
+  inline uint getNumLights() {return _numLights;}
+  inline kore::SceneNode* getLightNode(const uint light)
+  {return _lightNodes[light];}
+
+  inline const glm::uvec2& getResolution() {return _resolution;}
+
+  inline bool isDirty(const uint light) {return _dirty[light];}
+  bool isAnyDirty();
+
+  /// Bitmask with one bit per dirty light
+  uint getDirtyLights();
+
+  /// Bitmask with the bits of all possible lights
+  static const uint ALL_LIGHTS_MASK = (1U << MAX_NUM_LIGHTS) - 1U;
+
+  /// Marks the shadow map of a light as changed without the light itself
+  /// having changed, e.g. because a shadow caster moved.
+  inline void setDirty(const uint light) {_dirty[light] = true;}
+
+  inline kore::Texture* getDepthArray() {return &_depthArray;}
+  inline kore::Texture* getPositionArray() {return &_positionArray;}
+
+  /// Shadow maps of the static casters only
+  inline kore::Texture* getStaticDepthArray() {return &_staticDepthArray;}
+  inline kore::Texture* getStaticPositionArray()
+  {return &_staticPositionArray;}
+
+  inline kore::ShaderData* getShdDepthArraySampler()
+  {return &_shdDepthArraySampler;}
+
+  inline kore::ShaderData* getShdPositionArraySampler()
+  {return &_shdPositionArraySampler;}
+
+  inline kore::ShaderData* getShdNumLights() {return &_shdNumLights;}
+  inline kore::ShaderData* getShdLightViewProjs() {return &_shdLightViewProjs;}
+  inline kore::ShaderData* getShdLightDirs() {return &_shdLightDirs;}
+  inline kore::ShaderData* getShdLightColors() {return &_shdLightColors;}
+
+  static std::string getShaderDefines();
+
+private:
+  std::vector<kore::SceneNode*> _lightNodes;
+  glm::uvec2 _resolution;
+
+  uint _numLights;
+  kore::ShaderData _shdNumLights;
+
+  glm::mat4 _lightViewProjs[MAX_NUM_LIGHTS];
+  kore::ShaderData _shdLightViewProjs;
+
+  glm::vec3 _lightDirs[MAX_NUM_LIGHTS];
+  kore::ShaderData _shdLightDirs;
+
+  glm::vec3 _lightColors[MAX_NUM_LIGHTS];
+  kore::ShaderData _shdLightColors;
+
+  bool _dirty[MAX_NUM_LIGHTS];
+
+  kore::Texture _depthArray;
+  kore::STextureInfo _depthArrayTexInfo;
+  kore::ShaderData _shdDepthArraySampler;
+
+  kore::Texture _positionArray;
+  kore::STextureInfo _positionArrayTexInfo;
+  kore::ShaderData _shdPositionArraySampler;
+
+  kore::Texture _staticDepthArray;
+  kore::Texture _staticPositionArray;
+};
+
+#endif  // VCT_SRC_VCT_SHADOWMAPARRAY_H_
@@ -0,0 +1,204 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+#include "VoxelConeTracing/Scene/VCTcascades.h"
+
+#include <cfloat>
+
+#include "KoRE/Log.h"
+#include "KoRE/RenderManager.h"
+#include "VoxelConeTracing/Stages/SVOconstructionStage.h"
+#include "VoxelConeTracing/Stages/SVOlightUpdateStage.h"
+
+VCTcascades::VCTcascades()
+  : _camera(NULL) {
+}
+
+VCTcascades::~VCTcascades() {
+  for (uint i = 0; i < _vCascades.size(); ++i) {
+    if (_vCascades[i].ownsScene) {
+      delete _vCascades[i].scene;
+    }
+  }
+}
+
+void VCTcascades::init(VCTscene* finestScene,
+                       SVOconstructionStage* finestConstructionStage,
+                       SVOlightUpdateStage* finestLightUpdateStage,
+                       const SVCTparameters& params,
+                       uint numCascades,
+                       std::vector<kore::SceneNode*>& vRenderNodes,
+                       std::vector<kore::SceneNode*>& vLightNodes) {
+  _camera = finestScene->getCamera();
+  _vLightNodes = vLightNodes;
+
+  const glm::vec3& sideLengths = params.voxel_grid_sidelengths;
+  float minSideLength = glm::min(sideLengths.x,
+                                 glm::min(sideLengths.y, sideLengths.z));
+
+  SCascade finest;
+  finest.scene = finestScene;
+  finest.constructionStage = finestConstructionStage;
+  finest.lightUpdateStage = finestLightUpdateStage;
+  finest.cellSize = minSideLength / CELLS_PER_SIDE;
+  finest.ownsScene = false;
+  finest.lightRebuildPending = false;
+  _vCascades.push_back(finest);
+
+  // The meshes are only batched once, the coarser cascades draw them
+  // separately
+  SVCTparameters cascadeParams = params;
+  cascadeParams.useMeshBatching = false;
+  cascadeParams.meshCache = NULL;
+
+  for (uint i = 1; i < numCascades; ++i) {
+    float scale = static_cast<float>(1 << i);
+    cascadeParams.voxel_grid_sidelengths = sideLengths * scale;
+
+    SCascade cascade;
+    cascade.scene = new VCTscene;
+    cascade.scene->init(cascadeParams, vRenderNodes, vLightNodes, _camera,
+                        finestScene->getShadowMapArray());
+    cascade.constructionStage =
+      new SVOconstructionStage(vRenderNodes, cascadeParams, *cascade.scene,
+                               kore::EXECUTE_ONCE);
+    cascade.lightUpdateStage =
+      new SVOlightUpdateStage(vRenderNodes, cascadeParams, *cascade.scene,
+                              kore::EXECUTE_ONCE);
+    cascade.cellSize = minSideLength * scale / CELLS_PER_SIDE;
+    cascade.ownsScene = true;
+    cascade.lightRebuildPending = false;
+
+    kore::RenderManager::getInstance()
+      ->addFramebufferStage(cascade.constructionStage);
+    kore::RenderManager::getInstance()
+      ->addFramebufferStage(cascade.lightUpdateStage);
+    _vCascades.push_back(cascade);
+  }
+
+  kore::Log::getInstance()->write("[DEBUG] %u SVO cascades up to %f units\n",
+                                  (uint)_vCascades.size(),
+                                  minSideLength * (1 << (numCascades - 1)));
+}
+
+void VCTcascades::update() {
+  if (_vCascades.empty()) {
+    return;
+  }
+
+  const glm::mat4& viewI = *static_cast<glm::mat4*>(
+    _camera->getShaderData("inverse view Matrix")->data);
+  glm::vec3 cameraPos(viewI[3]);
+
+  bool rebuilding = false;
+  for (uint i = 0; i < _vCascades.size(); ++i) {
+    SCascade& cascade = _vCascades[i];
+    cascade.constructionStage->update();
+
+    // The new SVO is lit once all construction passes have been executed
+    if (cascade.lightRebuildPending
+        && !cascade.constructionStage->isRebuilding()) {
+      cascade.lightUpdateStage->requestRebuildUpdate();
+      cascade.lightRebuildPending = false;
+    }
+
+    rebuilding = rebuilding || cascade.lightRebuildPending
+                 || cascade.lightUpdateStage->isRebuildPending();
+  }
+
+  // Only one cascade at a time is constructed and lit
+  if (rebuilding) {
+    return;
+  }
+
+  // The cascade whose grid is the most cells behind the camera goes first.
+  // On a tie, the finer one.
+  int moveCascade = -1;
+  float maxOffsetCells = 0.0f;
+  glm::vec3 moveCenter;
+  for (uint i = 0; i < _vCascades.size(); ++i) {
+    SCascade& cascade = _vCascades[i];
+    glm::vec3 center =
+      glm::floor(cameraPos / cascade.cellSize + 0.5f) * cascade.cellSize;
+    glm::vec3 offsetCells =
+      glm::abs(center - cascade.scene->getVoxelGridCenter())
+      / cascade.cellSize;
+    float offsetCellsMax = glm::max(offsetCells.x,
+                                    glm::max(offsetCells.y, offsetCells.z));
+    if (offsetCellsMax > maxOffsetCells) {
+      moveCascade = static_cast<int>(i);
+      maxOffsetCells = offsetCellsMax;
+      moveCenter = center;
+    }
+  }
+
+  if (moveCascade < 0) {
+    return;
+  }
+
+  // The SVO is only valid for its grid, so the grid is only moved when
+  // the cascade is constructed again. The last SVO is rendered until the
+  // new one is constructed and lit within the budgets.
+  SCascade& cascade = _vCascades[moveCascade];
+  glm::vec3 offset = moveCenter - cascade.scene->getVoxelGridCenter();
+  cascade.scene->setVoxelGridCenter(moveCenter);
+  cascade.constructionStage->requestRebuild();
+  cascade.lightRebuildPending = true;
+
+  if (moveCascade + 1 == static_cast<int>(_vCascades.size())) {
+    for (uint iLight = 0; iLight < _vLightNodes.size(); ++iLight) {
+      _vLightNodes[iLight]->translate(offset, kore::SPACE_WORLD);
+    }
+  }
+}
+
+void VCTcascades::requestLightUpdate(uint lightMask) {
+  for (uint i = 0; i < _vCascades.size(); ++i) {
+    _vCascades[i].lightUpdateStage->requestUpdate(lightMask);
+  }
+}
+
+void VCTcascades::updateLightUpdateStages() {
+  // A half-constructed SVO is not lit. A running update is discarded by
+  // the rebuild update that follows the construction.
+  for (uint i = 0; i < _vCascades.size(); ++i) {
+    if (_vCascades[i].lightRebuildPending) {
+      continue;
+    }
+    _vCascades[i].lightUpdateStage->update();
+  }
+}
+
+float VCTcascades::getInnerExtent() {
+  // A cell is 1/CELLS_PER_SIDE of the shortest side, i.e. 2/CELLS_PER_SIDE
+  // in normalized coordinates along it and less along the longer sides
+  return 1.0f - 2.0f / CELLS_PER_SIDE;
+}
+
+glm::vec2 VCTcascades::getGridRange(uint cascade) const {
+  float finerExtent = cascade == 0 ? 0.0f : getInnerExtent();
+  float extent = cascade + 1 == _vCascades.size() ?
+                 FLT_MAX : getInnerExtent();
+  return glm::vec2(finerExtent, extent);
+}
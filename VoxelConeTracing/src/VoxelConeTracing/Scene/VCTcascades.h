@@ -0,0 +1,118 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+#ifndef VCT_SRC_VCT_VCTCASCADES_H_
+#define VCT_SRC_VCT_VCTCASCADES_H_
+
+#include <vector>
+
+#include "KoRE/Common.h"
+#include "KoRE/SceneNode.h"
+#include "KoRE/Components/Camera.h"
+#include "VoxelConeTracing/Scene/VCTscene.h"
+
+class SVOconstructionStage;
+class SVOlightUpdateStage;
+
+/*! SVO cascades of increasing extent that follow the camera. Cascade 0 is
+*   the scene of the application, every further cascade has twice the side
+*   lengths of the previous one at the same resolution, so the memory does
+*   not depend on the size of the world.
+*
+*   The grids are snapped to cells of 1/CELLS_PER_SIDE of their side
+*   lengths. A cascade is constructed again when the camera moves into
+*   another cell. Of all moved cascades, the one furthest behind the camera
+*   in cells goes first, so a coarse cascade is not starved by the finer
+*   ones while the camera keeps moving. The octree can't be shifted, so the
+*   whole cascade is voxelized again rather than only the slab that entered
+*   the grid. The new SVO is constructed and then lit within the GPU budgets
+*   of both stages while the last one is still rendered, and no other
+*   cascade is constructed meanwhile. The lights follow the coarsest
+*   cascade, so that their shadow maps cover all cascades.
+*/
+class VCTcascades {
+public:
+  VCTcascades();
+  ~VCTcascades();
+
+  /// Adds numCascades - 1 coarser cascades to the finest one and their
+  /// stages to the RenderManager. They share the shadow maps of the finest
+  /// cascade.
+  void init(VCTscene* finestScene,
+            SVOconstructionStage* finestConstructionStage,
+            SVOlightUpdateStage* finestLightUpdateStage,
+            const SVCTparameters& params,
+            uint numCascades,
+            std::vector<kore::SceneNode*>& vRenderNodes,
+            std::vector<kore::SceneNode*>& vLightNodes);
+
+  /// Moves the cascades with the camera and selects the construction passes
+  /// of this frame. Has to be called after GPUprofiler::beginFrame() and
+  /// before the SceneManager update, so that the moved grids are used in
+  /// this frame.
+  void update();
+
+  /// Updates the irradiance of the lights in lightMask in all cascades, e.g.
+  /// after they changed.
+  void requestLightUpdate(uint lightMask);
+
+  /// Calls SVOlightUpdateStage::update() of all cascades that are not being
+  /// constructed.
+  void updateLightUpdateStages();
+
+  inline uint getNumCascades() const {return _vCascades.size();}
+  inline VCTscene* getScene(uint cascade) {return _vCascades[cascade].scene;}
+  inline SVOconstructionStage* getConstructionStage(uint cascade)
+  {return _vCascades[cascade].constructionStage;}
+  inline SVOlightUpdateStage* getLightUpdateStage(uint cascade)
+  {return _vCascades[cascade].lightUpdateStage;}
+
+  /// Range of the cascade for rendering in normalized grid coordinates
+  /// (maximum norm, 1 at the faces of the grid). A point is rendered with
+  /// the cascade if it is at least x inside the displayed grid of the next
+  /// finer cascade and less than y inside the displayed grid of this one,
+  /// i.e. at least one cell away from its faces. The displayed grids are
+  /// used, as they lag behind the camera while a cascade is rebuilt.
+  glm::vec2 getGridRange(uint cascade) const;
+
+  static const uint CELLS_PER_SIDE = 8;
+
+private:
+  struct SCascade {
+    VCTscene* scene;
+    SVOconstructionStage* constructionStage;
+    SVOlightUpdateStage* lightUpdateStage;
+    float cellSize;
+    bool ownsScene;
+    bool lightRebuildPending;  // Lit once the construction is complete
+  };
+
+  static float getInnerExtent();
+
+  std::vector<SCascade> _vCascades;
+  std::vector<kore::SceneNode*> _vLightNodes;
+  kore::Camera* _camera;
+};
+
+#endif  // VCT_SRC_VCT_VCTCASCADES_H_
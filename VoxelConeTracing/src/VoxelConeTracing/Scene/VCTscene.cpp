@@ -34,9 +34,17 @@
 #include "KoRE/Log.h"
 
 VCTscene::VCTscene() :
+  _useComputeShaders(false),
   _camera(NULL),
+  _shadowMaps(&_shadowMapArray),
+  _useMeshBatching(false),
+  _conservativeVoxelization(false),
   _voxelGridResolution(0),
-  _voxelGridSideLengths(50, 50, 50)
+  _voxelGridSideLengths(50, 50, 50),
+  _voxelGridNode(NULL),
+  _voxelGridCenter(0.0f, 0.0f, 0.0f),
+  _displayCopySVO(false),
+  _injectLights(ShadowMapArray::ALL_LIGHTS_MASK)
    {
 }
 
@@ -70,6 +78,10 @@ void VCTscene::initTweakParameters() {
   _shdUseAlphaCorrection.type = GL_BOOL;
   _shdUseAlphaCorrection.data = &_useAlphaCorrection;
 
+  _skipEmptySpace = true;
+  _shdSkipEmptySpace.type = GL_BOOL;
+  _shdSkipEmptySpace.data = &_skipEmptySpace;
+
   _coneDiameter = 1.1546f;
   _shdConeDiameter.type = GL_FLOAT;
   _shdConeDiameter.data = &_coneDiameter;
@@ -107,13 +119,18 @@ VCTscene::~VCTscene() {
 
 void VCTscene::init(const SVCTparameters& params,
                     const std::vector<kore::SceneNode*>& meshNodes,
-                    kore::Camera* camera) {
+                    const std::vector<kore::SceneNode*>& lightNodes,
+                    kore::Camera* camera,
+                    ShadowMapArray* sharedShadowMaps) {
   initTweakParameters();
 
   _voxelGridResolution = params.voxel_grid_resolution;
   _voxelGridSideLengths = params.voxel_grid_sidelengths;
   _nodeGridResolution = _voxelGridResolution / 2;
   _smResolution = params.shadowMapResolution;
+  _useComputeShaders = params.useComputeShaders;
+  _conservativeVoxelization = params.conservativeVoxelization;
+  _displayCopySVO = params.displayCopySVO;
 
   _shdSMresolution.name = "Shadow Map resolution";
   _shdSMresolution.type = GL_INT_VEC2;
@@ -132,6 +149,16 @@ void VCTscene::init(const SVCTparameters& params,
   meshComp->setMesh(voxelGridCube);
   _voxelGridNode->addComponent(meshComp);
 
+  // Without a display copy, the rendered SVO is always the current one
+  const kore::ShaderData* gridTransformI = _voxelGridNode->getTransform()
+    ->getShaderData("inverse model Matrix");
+  _displayGridTransformI = glm::mat4(1.0f);
+  _shdDisplayGridTransformI.name = "Display voxel grid inverse transform";
+  _shdDisplayGridTransformI.type = GL_FLOAT_MAT4;
+  _shdDisplayGridTransformI.size = 1;
+  _shdDisplayGridTransformI.data = _displayCopySVO ?
+    &_displayGridTransformI : gridTransformI->data;
+
   _shdVoxelGridResolution.data = &_voxelGridResolution;
   _shdVoxelGridResolution.name = "VoxelGridResolution";
   _shdVoxelGridResolution.size = 1;
@@ -144,8 +171,21 @@ void VCTscene::init(const SVCTparameters& params,
 
   _voxelFragList.init(_voxelGridResolution, params.fraglist_size_multiplier, params.fraglist_size_divisor);
   _voxelFragTex.init(_voxelGridResolution);
-  _nodePool.init(_voxelGridResolution);
-  _brickPool.init(params.brickPoolResolution, &_nodePool);
+  _nodePool.init(_voxelGridResolution, params.maxNumNodes, _displayCopySVO);
+  _brickPool.init(params.brickPoolResolution, &_nodePool, _displayCopySVO);
+  initLightMask();
+  if (sharedShadowMaps) {
+    _shadowMaps = sharedShadowMaps;
+  } else {
+    _shadowMapArray.init(lightNodes, params.shadowMapResolution);
+  }
+
+  // Falls back to drawing the nodes separately if they can't be batched
+  _useMeshBatching = params.useMeshBatching && _meshBatch.init(meshNodes,
+                                                   params.meshCache);
+
+  // The node map has one layer per light
+  uint numLightLayers = glm::max(_shadowMaps->getNumLights(), 1U);
 
   // Init atomic counters
   uint acValue = 0;
@@ -160,7 +200,7 @@ void VCTscene::init(const SVCTparameters& params,
   STextureProperties nodeMapProps;
   
   nodeMapProps.format = GL_RED_INTEGER;
-  nodeMapProps.targetType = GL_TEXTURE_2D;
+  nodeMapProps.targetType = GL_TEXTURE_2D_ARRAY;
   nodeMapProps.internalFormat = GL_R32UI;
   nodeMapProps.pixelType = GL_UNSIGNED_INT;
 
@@ -175,25 +215,26 @@ void VCTscene::init(const SVCTparameters& params,
 
   nodeMapProps.width = params.shadowMapResolution.x + params.shadowMapResolution.x / 2;
   nodeMapProps.height = params.shadowMapResolution.y;
+  nodeMapProps.depth = numLightLayers;
 
   // Init light node map for each level
   _lightNodeMap.init(nodeMapProps, "LightNodeMap");
 
-  kore::RenderManager::getInstance()->bindTexture(GL_TEXTURE_2D, _lightNodeMap.getHandle());
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
-  kore::RenderManager::getInstance()->bindTexture(GL_TEXTURE_2D, 0);
+  kore::RenderManager::getInstance()->bindTexture(GL_TEXTURE_2D_ARRAY, _lightNodeMap.getHandle());
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+  kore::RenderManager::getInstance()->bindTexture(GL_TEXTURE_2D_ARRAY, 0);
 
   _lightNodeMapTexInfo.texLocation = _lightNodeMap.getHandle();
   _lightNodeMapTexInfo.internalFormat = GL_R32UI;
-  _lightNodeMapTexInfo.texTarget = GL_TEXTURE_2D;
+  _lightNodeMapTexInfo.texTarget = GL_TEXTURE_2D_ARRAY;
 
-  _shdLightNodeMap.type = GL_UNSIGNED_INT_IMAGE_2D;
+  _shdLightNodeMap.type = GL_UNSIGNED_INT_IMAGE_2D_ARRAY;
   _shdLightNodeMap.name = "LightNodeMap image";
   _shdLightNodeMap.size = 1;
   _shdLightNodeMap.data = &_lightNodeMapTexInfo;
 
-  _shdLightNodeMapSampler.type = GL_UNSIGNED_INT_SAMPLER_2D;
+  _shdLightNodeMapSampler.type = GL_UNSIGNED_INT_SAMPLER_2D_ARRAY;
   _shdLightNodeMapSampler.data = &_lightNodeMapTexInfo;
 
   /*
@@ -211,12 +252,11 @@ void VCTscene::init(const SVCTparameters& params,
 
 
   SDrawArraysIndirectCommand cmd;
-  cmd.numPrimitives = 1;
 
   glm::vec2 curSMmipmapRes(_smResolution.x, _smResolution.y);
   _vThreadBufs_NodeMap.resize(_nodePool.getNumLevels());
   for (int i = _nodePool.getNumLevels() - 1; i >= 0; --i) {
-    cmd.numVertices = curSMmipmapRes.x * curSMmipmapRes.y;
+    cmd.setNumThreads(curSMmipmapRes.x * curSMmipmapRes.y * numLightLayers);
     curSMmipmapRes /= 2;
 
     _vThreadBufs_NodeMap[i].create(GL_DRAW_INDIRECT_BUFFER,
@@ -225,8 +265,8 @@ void VCTscene::init(const SVCTparameters& params,
   }
 
 
-  cmd.numVertices = (_smResolution.x + _smResolution.x / 2) *
-                     _smResolution.y;
+  cmd.setNumThreads((_smResolution.x + _smResolution.x / 2) *
+                    _smResolution.y * numLightLayers);
   _threadBuf_NodeMapComplete.create(GL_DRAW_INDIRECT_BUFFER,
                              sizeof(SDrawArraysIndirectCommand),
                              GL_STATIC_DRAW, &cmd);
@@ -255,4 +295,153 @@ void VCTscene::init(const SVCTparameters& params,
   _shdNodeMapSizes.size = 8;
   _shdNodeMapSizes.type = GL_INT_VEC2;
   _shdNodeMapSizes.data = _nodeMapSizes;
+
+  initLightNodeLists();
+}
+
+void VCTscene::setVoxelGridCenter(const glm::vec3& center) {
+  _voxelGridNode->translate(center - _voxelGridCenter, kore::SPACE_WORLD);
+  _voxelGridCenter = center;
+}
+
+void VCTscene::updateDisplaySVO() {
+  if (!_displayCopySVO) {
+    return;
+  }
+
+  _nodePool.copyToDisplay();
+  _brickPool.copyToDisplay();
+  _displayGridTransformI = *static_cast<glm::mat4*>(_voxelGridNode
+    ->getTransform()->getShaderData("inverse model Matrix")->data);
+}
+
+void VCTscene::initLightMask() {
+  uint res = _brickPool.getBrickPoolResolution_leaf();
+
+  STextureProperties maskProps;
+  maskProps.width = res;
+  maskProps.height = res;
+  maskProps.depth = res;
+  maskProps.format = GL_RED_INTEGER;
+  maskProps.internalFormat = GL_R32UI;
+  maskProps.pixelType = GL_UNSIGNED_INT;
+  maskProps.targetType = GL_TEXTURE_3D;
+
+  _lightMask.init(maskProps, "LightMask");
+
+  kore::RenderManager::getInstance()->bindTexture(GL_TEXTURE_3D, _lightMask.getHandle());
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, 0);
+  kore::RenderManager::getInstance()->bindTexture(GL_TEXTURE_3D, 0);
+
+  _lightMaskTexInfo.texLocation = _lightMask.getHandle();
+  _lightMaskTexInfo.internalFormat = GL_R32UI;
+  _lightMaskTexInfo.texTarget = GL_TEXTURE_3D;
+
+  _shdLightMask.type = GL_UNSIGNED_INT_IMAGE_3D;
+  _shdLightMask.name = "LightMask image";
+  _shdLightMask.size = 1;
+  _shdLightMask.data = &_lightMaskTexInfo;
+
+  _shdInjectLights.type = GL_UNSIGNED_INT;
+  _shdInjectLights.name = "Inject lights";
+  _shdInjectLights.size = 1;
+  _shdInjectLights.data = &_injectLights;
+}
+
+void VCTscene::initLightNodeLists() {
+  uint numLevels = _nodePool.getNumLevels();
+  uint numLightLayers = glm::max(_shadowMaps->getNumLights(), 1U);
+
+  // Resize all containers first - the ShaderDatas point into the texInfos
+  _vLightNodeLists.resize(numLevels);
+  _vLightNodeListTexInfos.resize(numLevels);
+  _vShdLightNodeLists.resize(numLevels);
+  _vShdLightNodeListSamplers.resize(numLevels);
+  _vLightNodeListCmdBufs.resize(numLevels);
+  _vLightNodeListCmdBufTexInfos.resize(numLevels);
+  _vShdLightNodeListCmdBufs.resize(numLevels);
+  _vAcLightNodeLists.resize(numLevels);
+  _vShdAcLightNodeLists.resize(numLevels);
+
+  SDrawArraysIndirectCommand cmd;
+  cmd.setNumThreads(0);
+
+  uint acValue = 0;
+  glm::uvec2 curSMmipmapRes(_smResolution.x, _smResolution.y);
+  for (int i = numLevels - 1; i >= 0; --i) {
+    // There can't be more unique nodes on a level than nodemap-texels
+    uint maxNodesOnLevel = curSMmipmapRes.x * curSMmipmapRes.y * numLightLayers;
+    curSMmipmapRes /= 2;
+
+    kore::STextureBufferProperties listProps;
+    listProps.internalFormat = GL_R32UI;
+    listProps.size = sizeof(uint) * maxNodesOnLevel;
+    listProps.usageHint = GL_DYNAMIC_COPY;
+
+    std::string szListName = "LightNodeList_Level" + std::to_string(i);
+    _vLightNodeLists[i].create(listProps, szListName);
+
+    _vLightNodeListTexInfos[i].internalFormat = GL_R32UI;
+    _vLightNodeListTexInfos[i].texLocation = _vLightNodeLists[i].getTexHandle();
+    _vLightNodeListTexInfos[i].texTarget = GL_TEXTURE_BUFFER;
+
+    _vShdLightNodeLists[i].name = szListName;
+    _vShdLightNodeLists[i].type = GL_TEXTURE_BUFFER;
+    _vShdLightNodeLists[i].data = &_vLightNodeListTexInfos[i];
+
+    _vShdLightNodeListSamplers[i].name = szListName;
+    _vShdLightNodeListSamplers[i].type = GL_UNSIGNED_INT_SAMPLER_BUFFER;
+    _vShdLightNodeListSamplers[i].data = &_vLightNodeListTexInfos[i];
+
+    // Indirect command buffer. Its vertex-count is written on the GPU
+    // from the level's atomic counter after compaction.
+    kore::STextureBufferProperties cmdProps;
+    cmdProps.internalFormat = GL_R32UI;
+    cmdProps.size = sizeof(SDrawArraysIndirectCommand);
+    cmdProps.usageHint = GL_DYNAMIC_COPY;
+
+    std::string szCmdName = "LightNodeList_CmdBuf_Level" + std::to_string(i);
+    _vLightNodeListCmdBufs[i].create(cmdProps, szCmdName, &cmd);
+
+    _vLightNodeListCmdBufTexInfos[i].internalFormat = GL_R32UI;
+    _vLightNodeListCmdBufTexInfos[i].texLocation =
+                                      _vLightNodeListCmdBufs[i].getTexHandle();
+    _vLightNodeListCmdBufTexInfos[i].texTarget = GL_TEXTURE_BUFFER;
+
+    _vShdLightNodeListCmdBufs[i].name = szCmdName;
+    _vShdLightNodeListCmdBufs[i].type = GL_TEXTURE_BUFFER;
+    _vShdLightNodeListCmdBufs[i].data = &_vLightNodeListCmdBufTexInfos[i];
+
+    _vAcLightNodeLists[i].create(GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint),
+                                 GL_DYNAMIC_COPY, &acValue,
+                                 "AC_LightNodeList");
+    _vShdAcLightNodeLists[i].component = NULL;
+    _vShdAcLightNodeLists[i].name = "AC LightNodeList";
+    _vShdAcLightNodeLists[i].size = 1;
+    _vShdAcLightNodeLists[i].type = GL_UNSIGNED_INT_ATOMIC_COUNTER;
+    _vShdAcLightNodeLists[i].data = &_vAcLightNodeLists[i];
+  }
+
+  // Visited-flags: one bit per node. All bits start cleared and are reset
+  // by the ClearNodeMap-pass for all nodes of the previous light update.
+  uint numFlagWords = (_nodePool.getNumNodes() + 31) / 32;
+  std::vector<uint> initialFlags(numFlagWords, 0U);
+
+  kore::STextureBufferProperties flagProps;
+  flagProps.internalFormat = GL_R32UI;
+  flagProps.size = sizeof(uint) * numFlagWords;
+  flagProps.usageHint = GL_DYNAMIC_COPY;
+  _lightNodeFlags.create(flagProps, "LightNodeFlags", &initialFlags[0]);
+
+  _lightNodeFlagsTexInfo.internalFormat = GL_R32UI;
+  _lightNodeFlagsTexInfo.texLocation = _lightNodeFlags.getTexHandle();
+  _lightNodeFlagsTexInfo.texTarget = GL_TEXTURE_BUFFER;
+
+  _shdLightNodeFlags.name = "LightNodeFlags";
+  _shdLightNodeFlags.type = GL_TEXTURE_BUFFER;
+  _shdLightNodeFlags.data = &_lightNodeFlagsTexInfo;
+
+  kore::Log::getInstance()->write("Allocating light node lists for %u levels"
+    " and %u visited-flag words\n", numLevels, numFlagWords);
 }
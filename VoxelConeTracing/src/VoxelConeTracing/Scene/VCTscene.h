@@ -38,6 +38,9 @@
 #include "VoxelConeTracing/Scene/VoxelFragList.h"
 #include "VoxelConeTracing/Scene/VoxelFragTex.h"
 #include "BrickPool.h"
+#include "VoxelConeTracing/Scene/ShadowMapArray.h"
+#include "VoxelConeTracing/Scene/MeshBatch.h"
+#include "VoxelConeTracing/Util/ThreadDispatch.h"
 
 struct SVCTparameters {
   uint voxel_grid_resolution;
@@ -46,6 +49,16 @@ struct SVCTparameters {
   glm::vec3 voxel_grid_sidelengths;
   uint brickPoolResolution;
   glm::uvec2 shadowMapResolution;
+  float lightUpdateBudgetMS;  // GPU-time per frame for the light update
+  float constructionBudgetMS;  // GPU-time per frame for an SVO rebuild
+  bool useMinimalBarriers;  // Derive barriers from declared pass resources
+  bool useComputeShaders;  // Run the thread-per-item passes as compute
+  bool shareShaderPrograms;  // Compile identical pass programs only once
+  uint maxNumNodes;  // Node pool size, 0 for the complete octree
+  bool useMeshBatching;  // Draw all meshes with one multi-draw per pass
+  MeshCache* meshCache;  // Batch geometry of the previous run, may be NULL
+  bool conservativeVoxelization;  // Every voxel a triangle touches
+  bool displayCopySVO;  // Render the last complete SVO during a rebuild
 };
 
 enum ETex3DContent {
@@ -63,27 +76,18 @@ enum EThreadMode {
   THREAD_MODE_LIGHT
 };
 
-struct SDrawArraysIndirectCommand {
-  SDrawArraysIndirectCommand() :
-    numVertices(0),
-    numPrimitives(0),
-    firstVertexIdx(0),
-    baseInstanceIdx(0) {}
-
-  uint numVertices;
-  uint numPrimitives;
-  uint firstVertexIdx;
-  uint baseInstanceIdx;
-};
-
 class VCTscene {
 public:
   VCTscene();
   ~VCTscene();
 
+  /// Uses sharedShadowMaps instead of creating shadow maps for the lights,
+  /// e.g. for the coarser SVO cascades.
   void init(const SVCTparameters& params,
             const std::vector<kore::SceneNode*>& meshNodes,
-            kore::Camera* camera);
+            const std::vector<kore::SceneNode*>& lightNodes,
+            kore::Camera* camera,
+            ShadowMapArray* sharedShadowMaps = NULL);
 
   inline std::vector<kore::SceneNode*>& getRenderNodes() {return _meshNodes;}
 
@@ -97,6 +101,22 @@ public:
 
   inline kore::SceneNode* getVoxelGridNode() {return _voxelGridNode;}
 
+  /// Moves the voxel grid. The SVO has to be constructed again afterwards.
+  void setVoxelGridCenter(const glm::vec3& center);
+  inline const glm::vec3& getVoxelGridCenter() {return _voxelGridCenter;}
+  inline const glm::vec3& getVoxelGridSideLengths()
+  {return _voxelGridSideLengths;}
+
+  /// Inverse grid transform of the SVO used for rendering. Follows the grid
+  /// immediately without a display copy of the SVO.
+  inline kore::ShaderData* getShdDisplayGridTransformI()
+  {return &_shdDisplayGridTransformI;}
+  inline bool hasDisplayCopySVO() {return _displayCopySVO;}
+
+  /// Replaces the rendered SVO by the current one and its grid, after it
+  /// has been constructed and lit completely.
+  void updateDisplaySVO();
+
   inline kore::Camera* getCamera() {return _camera;}
 
   inline kore::IndexedBuffer* getAcVoxelIndex() {return &_acVoxelIndex;}
@@ -106,6 +126,11 @@ public:
   inline BrickPool* getBrickPool() {return &_brickPool;}
   inline VoxelFragList* getVoxelFragList() {return &_voxelFragList;}
   inline VoxelFragTex* getVoxelFragTex() {return &_voxelFragTex;}
+  inline ShadowMapArray* getShadowMapArray() {return _shadowMaps;}
+
+  /// NULL if the meshes are drawn separately
+  inline MeshBatch* getMeshBatch()
+  {return _useMeshBatching ? &_meshBatch : NULL;}
   
   inline kore::ShaderData* getShdLightNodeMap() 
   {return &_shdLightNodeMap;}
@@ -113,6 +138,13 @@ public:
   inline kore::ShaderData* getShdLightNodeMapSampler() 
   {return &_shdLightNodeMapSampler;}
 
+  /// One bit per light that sees a leaf brick voxel
+  inline kore::ShaderData* getShdLightMask() {return &_shdLightMask;}
+
+  /// Bitmask of the lights the next light update injects again
+  inline void setInjectLights(uint lightMask) {_injectLights = lightMask;}
+  inline kore::ShaderData* getShdInjectLights() {return &_shdInjectLights;}
+
   inline const glm::ivec2& getSMresolution() {return _smResolution;}
   inline kore::ShaderData* getShdSMresolution() {return &_shdSMresolution;}
 
@@ -122,13 +154,28 @@ public:
   inline kore::IndexedBuffer* getThreadBuf_nodeMap_complete()
   {return &_threadBuf_NodeMapComplete;}
 
-  inline bool getUseGPUprofiling() {
-    return _useGPUprofiling;
-  }
+  inline kore::ShaderData* getShdLightNodeList(const uint level)
+  {return &_vShdLightNodeLists[level];}
+
+  inline kore::ShaderData* getShdLightNodeListSampler(const uint level)
+  {return &_vShdLightNodeListSamplers[level];}
+
+  inline kore::TextureBuffer* getLightNodeListCmdBuf(const uint level)
+  {return &_vLightNodeListCmdBufs[level];}
+
+  inline kore::ShaderData* getShdLightNodeListCmdBuf(const uint level)
+  {return &_vShdLightNodeListCmdBufs[level];}
 
-  inline void setUseGPUprofiling(bool useProfiling) {
-    _useGPUprofiling = useProfiling;
-  }
+  inline kore::ShaderData* getShdAcLightNodeList(const uint level)
+  {return &_vShdAcLightNodeLists[level];}
+
+  inline kore::ShaderData* getShdLightNodeFlags()
+  {return &_shdLightNodeFlags;}
+
+  inline bool getUseComputeShaders() {return _useComputeShaders;}
+  inline bool getUseMeshBatching() {return _useMeshBatching;}
+  inline bool getConservativeVoxelization()
+  {return _conservativeVoxelization;}
 
   inline kore::ShaderData* getShdNodeMapOffsets() {return &_shdNodeMapOffsets;}
   inline kore::ShaderData* getShdNodeMapSizes() {return &_shdNodeMapSizes;}
@@ -170,16 +217,21 @@ public:
   bool _useAlphaCorrection;
   kore::ShaderData _shdUseAlphaCorrection;
 
+  bool _skipEmptySpace;
+  kore::ShaderData _shdSkipEmptySpace;
+
   float _coneDiameter;
   kore::ShaderData _shdConeDiameter;
 
   float _coneMaxDistance;
   kore::ShaderData _shdConeMaxDistance;
 
-  bool _useGPUprofiling;
+  bool _useComputeShaders;
 
 private:
   void initTweakParameters();
+  void initLightNodeLists();
+  void initLightMask();
 
   kore::Camera* _camera;
   std::vector<kore::SceneNode*> _meshNodes;
@@ -188,6 +240,11 @@ private:
   BrickPool _brickPool;
   VoxelFragList _voxelFragList;
   VoxelFragTex _voxelFragTex;
+  ShadowMapArray _shadowMapArray;
+  ShadowMapArray* _shadowMaps;  // Own or shared shadow maps
+  MeshBatch _meshBatch;
+  bool _useMeshBatching;
+  bool _conservativeVoxelization;
   
   uint _voxelGridResolution;
   kore::ShaderData _shdVoxelGridResolution;
@@ -203,15 +260,45 @@ private:
   kore::ShaderData _shdAcVoxelIndex;
 
   kore::SceneNode* _voxelGridNode;
+  glm::vec3 _voxelGridCenter;
+
+  bool _displayCopySVO;
+  glm::mat4 _displayGridTransformI;
+  kore::ShaderData _shdDisplayGridTransformI;
 
   kore::Texture _lightNodeMap;
   kore::STextureInfo _lightNodeMapTexInfo;
   kore::ShaderData _shdLightNodeMap;
   kore::ShaderData _shdLightNodeMapSampler;
 
+  kore::Texture _lightMask;
+  kore::STextureInfo _lightMaskTexInfo;
+  kore::ShaderData _shdLightMask;
+
+  uint _injectLights;
+  kore::ShaderData _shdInjectLights;
+
   std::vector<kore::IndexedBuffer> _vThreadBufs_NodeMap;
   kore::IndexedBuffer _threadBuf_NodeMapComplete;
 
+  /// Compacted (unique) light nodes per level
+  std::vector<kore::TextureBuffer> _vLightNodeLists;
+  std::vector<kore::STextureInfo> _vLightNodeListTexInfos;
+  std::vector<kore::ShaderData> _vShdLightNodeLists;
+  std::vector<kore::ShaderData> _vShdLightNodeListSamplers;
+
+  std::vector<kore::TextureBuffer> _vLightNodeListCmdBufs;
+  std::vector<kore::STextureInfo> _vLightNodeListCmdBufTexInfos;
+  std::vector<kore::ShaderData> _vShdLightNodeListCmdBufs;
+
+  std::vector<kore::IndexedBuffer> _vAcLightNodeLists;
+  std::vector<kore::ShaderData> _vShdAcLightNodeLists;
+
+  /// One visited-bit per node in the node pool
+  kore::TextureBuffer _lightNodeFlags;
+  kore::STextureInfo _lightNodeFlagsTexInfo;
+  kore::ShaderData _shdLightNodeFlags;
+
   glm::ivec2 _nodeMapOffsets[8];
   glm::ivec2 _nodeMapSizes[8];
   kore::ShaderData _shdNodeMapOffsets;
@@ -25,19 +25,8 @@
 
 #include "VoxelConeTracing/Scene/VoxelFragList.h"
 #include "VoxelConeTracing/Util/MathUtil.h"
+#include "VoxelConeTracing/Util/ThreadDispatch.h"
 
-struct SDrawArraysIndirectCommand {
-  SDrawArraysIndirectCommand() :
-    numVertices(0),
-    numPrimitives(0),
-    firstVertexIdx(0),
-    baseInstanceIdx(0) {}
-
-  uint numVertices;
-  uint numPrimitives;
-  uint firstVertexIdx;
-  uint baseInstanceIdx;
-};
 
 
 VoxelFragList::VoxelFragList()
@@ -50,8 +39,9 @@ VoxelFragList::~VoxelFragList()
 
 void VoxelFragList::init(uint voxelGridResolution, uint fragListSizeMultiplier, uint fragListSizeDivisor){
   // Positions
-  uint fraglistSizeByte =
-    (sizeof(uint)
+  // Computed in 64 bit, as calibrated sizes use a large divisor
+  unsigned long long requestedSizeByte =
+    (static_cast<unsigned long long>(sizeof(uint))
     * voxelGridResolution
     * voxelGridResolution
     * voxelGridResolution
@@ -62,12 +52,15 @@ void VoxelFragList::init(uint voxelGridResolution, uint fragListSizeMultiplier,
   glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexBufferSize);
   maxTexBufferSize = maxTexBufferSize * sizeof(uint);
 
-  if (fraglistSizeByte > maxTexBufferSize) {
-    kore::Log::getInstance()->write("[ERROR] VoxelFragList-size of %u is not"
-                            "supported on this hardware!", fraglistSizeByte);
+  if (requestedSizeByte > (unsigned long long) maxTexBufferSize) {
+    kore::Log::getInstance()->write("[ERROR] VoxelFragList-size of %llu is not"
+                            "supported on this hardware!", requestedSizeByte);
   }
 
-  fraglistSizeByte = glm::min((uint)maxTexBufferSize,fraglistSizeByte);
+  uint fraglistSizeByte = (uint) maxTexBufferSize;
+  if (requestedSizeByte < fraglistSizeByte) {
+    fraglistSizeByte = static_cast<uint>(requestedSizeByte);
+  }
 
   kore::Log::getInstance()
     ->write("Allocating voxel fragment list of size %f MB\n",
@@ -97,10 +90,7 @@ void VoxelFragList::initIndirectCommandBufs() {
 
   // Voxel fragment list indirect command buf
   SDrawArraysIndirectCommand cmd;
-  cmd.numVertices = 1;
-  cmd.numPrimitives = 1;
-  cmd.firstVertexIdx = 0;
-  cmd.baseInstanceIdx = 0;
+  cmd.setNumThreads(1);
 
   kore::STextureBufferProperties props;
   props.internalFormat = GL_R32UI;
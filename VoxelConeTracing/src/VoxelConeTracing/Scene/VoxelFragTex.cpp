@@ -27,19 +27,8 @@
 
 #include "VoxelConeTracing/Scene/VoxelFragTex.h"
 #include "VoxelConeTracing/Util/MathUtil.h"
+#include "VoxelConeTracing/Util/ThreadDispatch.h"
 
-struct SDrawArraysIndirectCommand {
-  SDrawArraysIndirectCommand() :
-    numVertices(0),
-    numPrimitives(0),
-    firstVertexIdx(0),
-    baseInstanceIdx(0) {}
-
-  uint numVertices;
-  uint numPrimitives;
-  uint firstVertexIdx;
-  uint baseInstanceIdx;
-};
 
 
 VoxelFragTex::VoxelFragTex()
@@ -106,8 +95,7 @@ void VoxelFragTex::init(uint voxelGridResolution) {
 
 
   SDrawArraysIndirectCommand cmd;
-  cmd.numVertices = props.width * props.height * props.depth;
-  cmd.numPrimitives = 1;
+  cmd.setNumThreads(props.width * props.height * props.depth);
 
   _voxelFragTexIndCmdBuf.create(GL_DRAW_INDIRECT_BUFFER,
                                 sizeof(SDrawArraysIndirectCommand),
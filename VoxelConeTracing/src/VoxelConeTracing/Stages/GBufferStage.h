@@ -34,10 +34,15 @@
 class GBufferStage : public kore::FrameBufferStage {
 public:
   GBufferStage(kore::Camera* mainCamera, std::vector<kore::SceneNode*>& vRenderNodes,
-              int width, int height);
+              int width, int height, MeshBatch* meshBatch = NULL);
   virtual ~GBufferStage();
 
-    
+  /// Draws only the render nodes visible to the main camera, one entry
+  /// per render node (see FrustumCuller)
+  void setVisibility(const std::vector<unsigned char>& visible);
+
+private:
+  DeferredPass* _deferredPass;
 };
 
 
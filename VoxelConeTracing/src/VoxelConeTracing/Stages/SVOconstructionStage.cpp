@@ -42,20 +42,27 @@
 #include "../Octree Mipmap/MipmapCornersPass.h"
 #include "../Octree Mipmap/MipmapEdgesPass.h"
 #include "../Voxelization/VoxelizeClearPass.h"
+#include "../Util/BarrierPlanner.h"
+#include "../Util/GPUprofiler.h"
 
 
-SVOconstructionStage::SVOconstructionStage(kore::SceneNode* lightNode,
+SVOconstructionStage::SVOconstructionStage(
                                std::vector<kore::SceneNode*>& vRenderNodes,
                                SVCTparameters& vctParams,
                                VCTscene& vctScene,
-                               kore::FrameBuffer* shadowMapFBO,
-                               kore::EOperationExecutionType exeFrequency) {
+                               kore::EOperationExecutionType exeFrequency)
+  : _frameBudgetMS(vctParams.constructionBudgetMS),
+    _rebuildRunning(false),
+    _nextPass(0) {
   std::vector<GLenum> drawBufs;
   drawBufs.clear();
   drawBufs.push_back(GL_BACK_LEFT);
   this->setActiveAttachments(drawBufs);
   this->setFrameBuffer(kore::FrameBuffer::BACKBUFFER);
 
+  // The budget needs the timings of all passes, also in release builds
+  GPUprofiler::getInstance()->setRequired(true);
+
   // Prepare render algorithm
   this->addProgramPass(new ObClearPass(&vctScene, exeFrequency));
   this->addProgramPass(new ObClearNeighboursPass(&vctScene, exeFrequency));
@@ -124,9 +131,80 @@ SVOconstructionStage::SVOconstructionStage(kore::SceneNode* lightNode,
     
     --iLevel;
   }
+
+  GPUprofiler::getInstance()->setRequired(false);
+
+  BarrierPlanner::insertBarriers("SVO construction", getShaderProgramPasses(),
+                                 vctParams.useMinimalBarriers);
+
+  _vPassCostsMS.resize(getShaderProgramPasses().size(), -1.0f);
 }
 
 SVOconstructionStage::~SVOconstructionStage() {
 
 }
 
+void SVOconstructionStage::requestRebuild() {
+  // Passes are enabled slice by slice in update()
+  std::vector<kore::ShaderProgramPass*>& passes = getShaderProgramPasses();
+  for (uint i = 0; i < passes.size(); ++i) {
+    passes[i]->setExecuted(true);
+  }
+  _rebuildRunning = true;
+  _nextPass = 0;
+}
+
+void SVOconstructionStage::update() {
+  updatePassCosts();
+  if (!_rebuildRunning) {
+    return;
+  }
+
+  // All passes have been executed in the last frame
+  std::vector<kore::ShaderProgramPass*>& passes = getShaderProgramPasses();
+  if (_nextPass == passes.size()) {
+    _rebuildRunning = false;
+    return;
+  }
+
+  // Enable the next passes until the budget is used up. At least one pass is
+  // executed per frame. Without measurements of all passes, the rebuild runs
+  // completely.
+  float frameBudgetMS = areAllPassesMeasured() ? _frameBudgetMS : 0.0f;
+  float sliceCostMS = 0.0f;
+  uint firstPass = _nextPass;
+  while (_nextPass < passes.size()) {
+    float passCostMS = glm::max(_vPassCostsMS[_nextPass], 0.0f);
+
+    if (frameBudgetMS > 0.0f && _nextPass > firstPass
+        && sliceCostMS + passCostMS > frameBudgetMS) {
+      break;
+    }
+
+    passes[_nextPass]->setExecuted(false);
+    sliceCostMS += passCostMS;
+    ++_nextPass;
+  }
+
+  this->setExecuted(false);
+}
+
+void SVOconstructionStage::updatePassCosts() {
+  std::vector<kore::ShaderProgramPass*>& passes = getShaderProgramPasses();
+
+  // Passes that are not sampled in a frame keep their last cost
+  for (uint iPass = 0; iPass < passes.size(); ++iPass) {
+    GPUprofiler::getInstance()->getPassTimesMS(passes[iPass],
+                                               &_vPassCostsMS[iPass], NULL);
+  }
+}
+
+bool SVOconstructionStage::areAllPassesMeasured() const {
+  for (uint iPass = 0; iPass < _vPassCostsMS.size(); ++iPass) {
+    if (_vPassCostsMS[iPass] < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
@@ -31,15 +31,45 @@
 #include "Kore/SceneNode.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
 
+/*! Voxelizes the scene and constructs the SVO with its color and normal
+*   bricks. The first construction runs in one frame. A rebuild is spread
+*   over several frames, so that each frame only spends about
+*   vctParams.constructionBudgetMS of GPU-time on it, like the light update.
+*   A single pass above the budget, usually the voxelization, still runs in
+*   one frame.
+*/
 class SVOconstructionStage : public kore::FrameBufferStage {
 public:
-  SVOconstructionStage(kore::SceneNode* lightNode,
-                      std::vector<kore::SceneNode*>& vRenderNodes,
-                      SVCTparameters& vctParams,
-                      VCTscene& vctScene,
-                      kore::FrameBuffer* shadowMapFBO,
+  SVOconstructionStage(std::vector<kore::SceneNode*>& vRenderNodes,
+                       SVCTparameters& vctParams,
+                       VCTscene& vctScene,
                        kore::EOperationExecutionType exeFrequency);
   virtual ~SVOconstructionStage();
+
+  /// Constructs the SVO again within the budget, e.g. after the voxel grid
+  /// has been moved. The SVO must not be lit until isRebuilding() is false.
+  void requestRebuild();
+
+  /// Selects the passes to execute in this frame. Has to be called once per
+  /// frame before rendering, after GPUprofiler::beginFrame().
+  void update();
+
+  /// True until all passes of the requested rebuild have been executed
+  inline bool isRebuilding() {return _rebuildRunning;}
+
+  /// A budget of 0 executes a complete rebuild in one frame.
+  inline float* getFrameBudgetMSptr() {return &_frameBudgetMS;}
+
+private:
+  float _frameBudgetMS;
+  bool _rebuildRunning;
+  uint _nextPass;
+
+  // Last measured GPU-time of each pass. Negative if not yet measured.
+  std::vector<float> _vPassCostsMS;
+
+  void updatePassCosts();
+  bool areAllPassesMeasured() const;
 };
 
 #endif
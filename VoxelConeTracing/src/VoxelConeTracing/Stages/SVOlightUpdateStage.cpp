@@ -24,6 +24,7 @@
 */
 
 #include "VoxelConeTracing/Stages/SVOlightUpdateStage.h"
+#include "KoRE/Log.h"
 #include "../Octree Building/ObClearPass.h"
 #include "../Voxelization/VoxelizePass.h"
 #include "../Octree Building/ModifyIndirectBufferPass.h"
@@ -42,19 +43,34 @@
 #include "../Octree Mipmap/MipmapCornersPass.h"
 #include "../Octree Mipmap/MipmapEdgesPass.h"
 #include "../Octree Building/ClearNodeMapPass.h"
+#include "../Octree Mipmap/CompactNodeMapPass.h"
+#include "../Util/BarrierPlanner.h"
+#include "../Util/GPUprofiler.h"
 
-SVOlightUpdateStage::SVOlightUpdateStage(kore::SceneNode* lightNode,
+SVOlightUpdateStage::SVOlightUpdateStage(
                                std::vector<kore::SceneNode*>& vRenderNodes,
                                SVCTparameters& vctParams,
                                VCTscene& vctScene,
-                               kore::FrameBuffer* shadowMapFBO,
-                               kore::EOperationExecutionType exeFrequency) {
+                               kore::EOperationExecutionType exeFrequency)
+  : _vctScene(&vctScene),
+    _frameBudgetMS(vctParams.lightUpdateBudgetMS),
+    _updateRequested(true),
+    _updateRunning(false),
+    _immediateUpdate(false),
+    _rebuildPending(true),
+    _requestedLights(ShadowMapArray::ALL_LIGHTS_MASK),
+    _nextPass(0),
+    _numFramesCurrentUpdate(0),
+    _numFramesLastUpdate(0) {
   std::vector<GLenum> drawBufs;
   drawBufs.clear();
   drawBufs.push_back(GL_BACK_LEFT);
   this->setActiveAttachments(drawBufs);
   this->setFrameBuffer(kore::FrameBuffer::BACKBUFFER);
 
+  // The budget needs the timings of all passes, also in release builds
+  GPUprofiler::getInstance()->setRequired(true);
+
   uint _numLevels = vctScene.getNodePool()->getNumLevels(); 
 
   // Prepare render algorithm
@@ -64,10 +80,20 @@ SVOlightUpdateStage::SVOlightUpdateStage(kore::SceneNode* lightNode,
   this->addProgramPass(new ClearNodeMapPass(&vctScene, exeFrequency));
       
   
-  this->addProgramPass(new LightInjectionPass(&vctScene,
-                                              lightNode,
-                                              shadowMapFBO,
-                                              exeFrequency));
+  // Injects all lights of the shadow map array at once
+  this->addProgramPass(new LightInjectionPass(&vctScene, exeFrequency));
+
+  // Reduce the node map to one list of unique nodes per level, so that all
+  // following passes only launch one thread per lit node.
+  for (uint iLevel = 0; iLevel < _numLevels; ++iLevel) {
+    this->addProgramPass(new CompactNodeMapPass(&vctScene, iLevel,
+                                                exeFrequency));
+    this->addProgramPass(new ModifyIndirectBufferPass(
+                         vctScene.getShdLightNodeListCmdBuf(iLevel),
+                         vctScene.getShdAcLightNodeList(iLevel), &vctScene,
+                         exeFrequency));
+  }
+
   this->addProgramPass(new SpreadLeafBricksPass(&vctScene, BRICKPOOL_IRRADIANCE, THREAD_MODE_LIGHT, exeFrequency));
   this->addProgramPass(new BorderTransferPass(&vctScene, BRICKPOOL_IRRADIANCE, THREAD_MODE_LIGHT, _numLevels - 1, exeFrequency));
 
@@ -85,7 +111,121 @@ SVOlightUpdateStage::SVOlightUpdateStage(kore::SceneNode* lightNode,
     --iLevel;
   }
 
+  GPUprofiler::getInstance()->setRequired(false);
+
+  BarrierPlanner::insertBarriers("SVO light update", getShaderProgramPasses(),
+                                 vctParams.useMinimalBarriers);
+
+  _vPassCostsMS.resize(getShaderProgramPasses().size(), -1.0f);
 }
 
 SVOlightUpdateStage::~SVOlightUpdateStage() {
 }
+
+void SVOlightUpdateStage::update() {
+  updatePassCosts();
+
+  std::vector<kore::ShaderProgramPass*>& passes = getShaderProgramPasses();
+
+  // All passes of the running update have been executed in the last frame
+  if (_updateRunning && _nextPass == passes.size()) {
+    finishUpdate();
+  }
+
+  if (!_updateRunning) {
+    if (!_updateRequested) {
+      return;
+    }
+    startUpdate();
+  }
+
+  // Enable the next passes until the budget is used up. At least one pass is
+  // executed per frame. As long as a pass has no measurement, the update
+  // can't be sliced and runs completely, which also measures all passes.
+  float frameBudgetMS = _immediateUpdate || !areAllPassesMeasured() ?
+                        0.0f : _frameBudgetMS;
+  float sliceCostMS = 0.0f;
+  uint firstPass = _nextPass;
+  while (_nextPass < passes.size()) {
+    float passCostMS = glm::max(_vPassCostsMS[_nextPass], 0.0f);
+
+    if (frameBudgetMS > 0.0f && _nextPass > firstPass
+        && sliceCostMS + passCostMS > frameBudgetMS) {
+      break;
+    }
+
+    passes[_nextPass]->setExecuted(false);
+    sliceCostMS += passCostMS;
+    ++_nextPass;
+  }
+
+  this->setExecuted(false);
+  ++_numFramesCurrentUpdate;
+}
+
+void SVOlightUpdateStage::requestImmediateUpdate() {
+  _updateRequested = true;
+  _updateRunning = false;
+  _immediateUpdate = true;
+  _requestedLights = ShadowMapArray::ALL_LIGHTS_MASK;
+}
+
+void SVOlightUpdateStage::requestRebuildUpdate() {
+  _updateRequested = true;
+  _updateRunning = false;
+  _rebuildPending = true;
+  _requestedLights = ShadowMapArray::ALL_LIGHTS_MASK;
+}
+
+void SVOlightUpdateStage::updatePassCosts() {
+  std::vector<kore::ShaderProgramPass*>& passes = getShaderProgramPasses();
+
+  // Passes that are not sampled in a frame keep their last cost
+  for (uint iPass = 0; iPass < passes.size(); ++iPass) {
+    GPUprofiler::getInstance()->getPassTimesMS(passes[iPass],
+                                               &_vPassCostsMS[iPass], NULL);
+  }
+}
+
+bool SVOlightUpdateStage::areAllPassesMeasured() const {
+  for (uint iPass = 0; iPass < _vPassCostsMS.size(); ++iPass) {
+    if (_vPassCostsMS[iPass] < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void SVOlightUpdateStage::startUpdate() {
+  // Disable all passes. They are enabled slice by slice in update()
+  std::vector<kore::ShaderProgramPass*>& passes = getShaderProgramPasses();
+  for (uint i = 0; i < passes.size(); ++i) {
+    passes[i]->setExecuted(true);
+  }
+
+  // Lights requested during this update are injected in the next one
+  _vctScene->setInjectLights(_requestedLights);
+  _requestedLights = 0;
+
+  _updateRequested = false;
+  _updateRunning = true;
+  _nextPass = 0;
+  _numFramesCurrentUpdate = 0;
+}
+
+void SVOlightUpdateStage::finishUpdate() {
+  // Show the new irradiance
+  _vctScene->getBrickPool()->copyBrickPool(BRICKPOOL_IRRADIANCE,
+                                           BRICKPOOL_IRRADIANCE_DISPLAY);
+  if (_rebuildPending) {
+    _vctScene->updateDisplaySVO();
+    _rebuildPending = false;
+  }
+
+  _updateRunning = false;
+  _immediateUpdate = false;
+  _numFramesLastUpdate = _numFramesCurrentUpdate;
+
+  kore::Log::getInstance()->write("Light update finished after %u frames\n",
+                                  _numFramesLastUpdate);
+}
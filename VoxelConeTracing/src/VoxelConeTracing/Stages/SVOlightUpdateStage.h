@@ -31,15 +31,69 @@
 #include "Kore/SceneNode.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
 
+/*! Updates the irradiance of the SVO. The passes of one update are spread
+*   over several frames, so that each frame only spends about
+*   vctParams.lightUpdateBudgetMS of GPU-time on it. The irradiance used for
+*   rendering is only replaced after an update is complete, and so is the
+*   rendered SVO after it has been constructed again.
+*/
 class SVOlightUpdateStage : public kore::FrameBufferStage {
 public:
-  SVOlightUpdateStage(kore::SceneNode* lightNode,
-                      std::vector<kore::SceneNode*>& vRenderNodes,
+  SVOlightUpdateStage(std::vector<kore::SceneNode*>& vRenderNodes,
                       SVCTparameters& vctParams,
                       VCTscene& vctScene,
-                      kore::FrameBuffer* shadowMapFBO,
                       kore::EOperationExecutionType exeFrequency);
   virtual ~SVOlightUpdateStage();
+
+  /// Starts a new update as soon as the current one is complete. Only the
+  /// lights in lightMask are injected again, the others keep their
+  /// contribution (see LightInjectionPass).
+  inline void requestUpdate(uint lightMask = ShadowMapArray::ALL_LIGHTS_MASK)
+  {_updateRequested = true; _requestedLights |= lightMask;}
+
+  /// Discards a running update and executes a complete one in the next
+  /// frame, e.g. after the SVO has been constructed again.
+  void requestImmediateUpdate();
+
+  /// Discards a running update, which lit the SVO before the construction,
+  /// and starts a new one within the budget. The new SVO is rendered once
+  /// the update is complete.
+  void requestRebuildUpdate();
+
+  inline bool isRebuildPending() {return _rebuildPending;}
+
+  /// Selects the passes to execute in this frame. Has to be called once per
+  /// frame before rendering, after GPUprofiler::beginFrame().
+  void update();
+
+  inline bool isUpdating() {return _updateRunning;}
+
+  /// A budget of 0 executes a complete update in one frame.
+  inline float* getFrameBudgetMSptr() {return &_frameBudgetMS;}
+
+  /// Number of frames the last complete update was spread over.
+  inline uint* getNumFramesLastUpdatePtr() {return &_numFramesLastUpdate;}
+
+private:
+  VCTscene* _vctScene;
+
+  float _frameBudgetMS;
+  bool _updateRequested;
+  bool _updateRunning;
+  bool _immediateUpdate;
+  bool _rebuildPending;
+  uint _requestedLights;
+  uint _nextPass;
+  uint _numFramesCurrentUpdate;
+  uint _numFramesLastUpdate;
+
+  // Last measured GPU-time of each pass. Negative if not yet measured.
+  std::vector<float> _vPassCostsMS;
+
+  void updatePassCosts();
+  bool areAllPassesMeasured() const;
+  void startUpdate();
+  void finishUpdate();
 };
 
 #endif
\ No newline at end of file
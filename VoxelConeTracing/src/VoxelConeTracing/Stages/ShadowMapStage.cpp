@@ -28,49 +28,119 @@
 #include "VoxelConeTracing/Stages/ShadowMapStage.h"
 #include "VoxelConeTracing/Rendering/ShadowMapPass.h"
 
-ShadowMapStage::ShadowMapStage(kore::SceneNode* lightNode,
+ShadowMapStage::ShadowMapStage(ShadowMapArray* shadowMaps,
                                std::vector<kore::SceneNode*>& vRenderNodes,
-                               int shadow_width, int shadow_height) {
- 
+                               MeshBatch* meshBatch)
+  : _shadowMaps(shadowMaps),
+    _vCasters(vRenderNodes),
+    _vDynamic(vRenderNodes.size(), false),
+    _vCasterVisibility(shadowMaps->getNumLights(),
+                       std::vector<unsigned char>(vRenderNodes.size(), 1)) {
+  // The layers of the shadow map array are attached by the passes
   kore::FrameBuffer* _shadowBuffer = new kore::FrameBuffer("shadowBuffer");
   kore::ResourceManager::getInstance()->addFramebuffer(_shadowBuffer);
   std::vector<GLenum> drawBufs;
   drawBufs.push_back(GL_COLOR_ATTACHMENT0);
   this->setActiveAttachments(drawBufs);
 
-  kore::STextureProperties SMprops;
-  SMprops.width = shadow_width;
-  SMprops.height = shadow_height;
-  SMprops.targetType = GL_TEXTURE_2D;
-  SMprops.format = GL_DEPTH_STENCIL;
-  SMprops.internalFormat =  GL_DEPTH24_STENCIL8;
-  SMprops.pixelType = GL_UNSIGNED_INT_24_8;
-  _shadowBuffer->addTextureAttachment(SMprops,"ShadowMap",GL_DEPTH_STENCIL_ATTACHMENT);
-
-  SMprops.format = GL_RGB;
-  SMprops.internalFormat =  GL_RGB32F;
-  SMprops.pixelType = GL_FLOAT;
-  _shadowBuffer->addTextureAttachment(SMprops,"SMposition",GL_COLOR_ATTACHMENT0);
-
-  kore::RenderManager::getInstance()->bindTexture(GL_TEXTURE_2D, _shadowBuffer->getTexture("SMposition")->getHandle());
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_RED);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_GREEN);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_BLUE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ALPHA);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  kore::RenderManager::getInstance()->bindTexture(GL_TEXTURE_2D, 0);
+  this->setFrameBuffer(_shadowBuffer);
 
+  // Two passes per light: the static casters are only rendered again if
+  // the light changed, the dynamic ones also if any of them moved
+  for (uint iLight = 0; iLight < shadowMaps->getNumLights(); ++iLight) {
+    this->addProgramPass(new ShadowMapPass(vRenderNodes, shadowMaps, iLight,
+                                           SHADOWMAP_PASS_STATIC,
+                                           _shadowBuffer,
+                                           kore::EXECUTE_ONCE, meshBatch));
+    this->addProgramPass(new ShadowMapPass(vRenderNodes, shadowMaps, iLight,
+                                           SHADOWMAP_PASS_COMPOSITE,
+                                           _shadowBuffer,
+                                           kore::EXECUTE_ONCE, meshBatch));
+  }
 
-  this->setFrameBuffer(_shadowBuffer);
-  this->addProgramPass(new ShadowMapPass(
-                       vRenderNodes, lightNode,
-                       glm::uvec2(SMprops.width, SMprops.height)));
+  _vCasterTransforms.resize(_vCasters.size());
+  for (uint i = 0; i < _vCasters.size(); ++i) {
+    _vCasterTransforms[i] = getCasterTransform(i);
+  }
+  updateCasterSets();
 }
 
 ShadowMapStage::~ShadowMapStage() {
 
 }
 
+const glm::mat4& ShadowMapStage::getCasterTransform(uint caster) {
+  return *static_cast<glm::mat4*>(_vCasters[caster]->getTransform()
+                                  ->getShaderData("model Matrix")->data);
+}
+
+void ShadowMapStage::updateCasterSets() {
+  std::vector<kore::ShaderProgramPass*>& passes = getShaderProgramPasses();
+  for (uint i = 0; i < passes.size(); ++i) {
+    ShadowMapPass* smPass = static_cast<ShadowMapPass*>(passes[i]);
+    bool dynamicPass = smPass->getType() == SHADOWMAP_PASS_COMPOSITE;
+    const std::vector<unsigned char>& visible =
+      _vCasterVisibility[smPass->getLight()];
+
+    for (uint iCaster = 0; iCaster < _vCasters.size(); ++iCaster) {
+      smPass->setCasterEnabled(iCaster, _vDynamic[iCaster] == dynamicPass
+                                        && visible[iCaster] != 0);
+    }
+  }
+}
+
+void ShadowMapStage::update() {
+  // A caster that moved once is treated as dynamic from then on, so the
+  // static cache has to be rebuilt only once for it
+  bool staticChanged = false;
+  bool dynamicChanged = false;
+  for (uint i = 0; i < _vCasters.size(); ++i) {
+    const glm::mat4& transform = getCasterTransform(i);
+    if (transform == _vCasterTransforms[i]) {
+      continue;
+    }
+
+    _vCasterTransforms[i] = transform;
+    dynamicChanged = true;
+    if (!_vDynamic[i]) {
+      _vDynamic[i] = true;
+      staticChanged = true;
+    }
+  }
+
+  // The visibility of static casters only changes with the light, in
+  // which case the static pass runs again anyway
+  updateCasterSets();
+
+  if (!_shadowMaps->isAnyDirty() && !dynamicChanged) {
+    return;
+  }
+
+  this->setExecuted(false);
+  std::vector<kore::ShaderProgramPass*>& passes = getShaderProgramPasses();
+
+  for (uint i = 0; i < passes.size(); ++i) {
+    ShadowMapPass* smPass = static_cast<ShadowMapPass*>(passes[i]);
+    uint light = smPass->getLight();
+
+    if (smPass->getType() == SHADOWMAP_PASS_STATIC) {
+      if (_shadowMaps->isDirty(light) || staticChanged) {
+        smPass->setExecuted(false);
+      }
+    } else if (_shadowMaps->isDirty(light) || dynamicChanged) {
+      smPass->setExecuted(false);
+    }
+  }
+
+  // The lighting has to be updated for the moved casters as well
+  if (dynamicChanged) {
+    for (uint iLight = 0; iLight < _shadowMaps->getNumLights(); ++iLight) {
+      _shadowMaps->setDirty(iLight);
+    }
+  }
+}
+
+void ShadowMapStage::setCasterVisibility(uint light,
+                           const std::vector<unsigned char>& visible) {
+  _vCasterVisibility[light] = visible;
+}
@@ -30,13 +30,37 @@
 #include "Kore/Components/Camera.h"
 #include "Kore/SceneNode.h"
 #include "VoxelConeTracing/Rendering/DeferredPass.h"
+#include "VoxelConeTracing/Scene/ShadowMapArray.h"
 
 class ShadowMapStage : public kore::FrameBufferStage {
 public:
-  ShadowMapStage(kore::SceneNode* lightNode,
+  ShadowMapStage(ShadowMapArray* shadowMaps,
                  std::vector<kore::SceneNode*>& vRenderNodes,
-                 int shadow_width, int shadow_height);
+                 MeshBatch* meshBatch = NULL);
   virtual ~ShadowMapStage();
+
+  /// Marks the shadow maps of all changed lights for re-rendering. Casters
+  /// that moved are rendered separately on top of a cache of the static
+  /// ones, which is only re-rendered if a light changed.
+  void update();
+
+  /// Renders only the casters visible to the light's camera, one entry
+  /// per render node (see FrustumCuller). Has to be set before update().
+  void setCasterVisibility(uint light,
+                           const std::vector<unsigned char>& visible);
+
+private:
+  const glm::mat4& getCasterTransform(uint caster);
+
+  /// Distributes the casters to the static and composite passes
+  void updateCasterSets();
+
+  ShadowMapArray* _shadowMaps;
+
+  std::vector<kore::SceneNode*> _vCasters;
+  std::vector<glm::mat4> _vCasterTransforms;
+  std::vector<bool> _vDynamic;
+  std::vector<std::vector<unsigned char> > _vCasterVisibility;
 };
 
 
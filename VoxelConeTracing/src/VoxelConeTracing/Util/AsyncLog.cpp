@@ -0,0 +1,308 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#include "VoxelConeTracing/Util/AsyncLog.h"
+
+#include <chrono>
+#include <cstring>
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+// Has to be a power of two
+static const uint ENTRY_CAPACITY = 1 << 16;
+
+// Formatted text is written to the file in chunks of about this size
+static const uint WRITE_CHUNK_SIZE = 64 * 1024;
+
+static const char* LOG_FILE = "./VCT_Log.txt";
+
+AsyncLog::AsyncLog()
+  : _entries(new SEntry[ENTRY_CAPACITY]),
+    _head(0),
+    _tail(0),
+    _quit(false),
+    _running(false) {
+  _thread = std::thread(&AsyncLog::run, this);
+  _running = true;
+}
+
+AsyncLog::~AsyncLog() {
+  shutdown();
+  delete[] _entries;
+}
+
+void AsyncLog::shutdown() {
+  if (!_running) {
+    return;
+  }
+
+  _quit.store(true);
+  _thread.join();
+  _running = false;
+}
+
+AsyncLog::SArg AsyncLog::makeArg(const std::string& value) {
+  char* copy = new char[value.size() + 1];
+  memcpy(copy, value.c_str(), value.size() + 1);
+
+  SArg arg;
+  arg.type = ARG_STRING_COPY;
+  arg.s = copy;
+  return arg;
+}
+
+AsyncLog::SEntry& AsyncLog::beginEntry(EEntryType type, const char* format) {
+  uint head = _head.load(std::memory_order_relaxed);
+
+  // Only wait for the background thread if the ring is full
+  while (head - _tail.load(std::memory_order_acquire) >= ENTRY_CAPACITY) {
+    std::this_thread::yield();
+  }
+
+  SEntry& entry = _entries[head & (ENTRY_CAPACITY - 1)];
+  entry.type = type;
+  entry.format = format;
+  entry.numArgs = 0;
+  entry.values = NULL;
+  return entry;
+}
+
+void AsyncLog::commitEntry(uint numArgs) {
+  uint head = _head.load(std::memory_order_relaxed);
+  _entries[head & (ENTRY_CAPACITY - 1)].numArgs = numArgs;
+  _head.store(head + 1, std::memory_order_release);
+}
+
+void AsyncLog::write(const char* format) {
+  beginEntry(ENTRY_FORMAT, format);
+  commitEntry(0);
+}
+
+void AsyncLog::writeValues(const char* label, const uint* values,
+                           uint numValues, uint valuesPerLine) {
+  uint* copy = new uint[numValues];
+  memcpy(copy, values, numValues * sizeof(uint));
+
+  SEntry& entry = beginEntry(ENTRY_VALUES, label);
+  entry.values = copy;
+  entry.args[0] = makeArg(numValues);
+  entry.args[1] = makeArg(glm::max(valuesPerLine, 1U));
+  commitEntry(2);
+}
+
+void AsyncLog::run() {
+  _file.open(LOG_FILE);
+  std::string text;
+
+  while (true) {
+    uint tail = _tail.load(std::memory_order_relaxed);
+    uint head = _head.load(std::memory_order_acquire);
+
+    if (tail == head) {
+      // Idle, so everything written so far ends up in the file
+      writeText(text);
+      _file.flush();
+
+      // Entries written right before the shutdown still have to be written
+      if (_quit.load()) {
+        if (_head.load(std::memory_order_acquire) == tail) {
+          _file.close();
+          break;
+        }
+        continue;
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+
+    for (; tail != head; ++tail) {
+      SEntry& entry = _entries[tail & (ENTRY_CAPACITY - 1)];
+      if (entry.type == ENTRY_VALUES) {
+        formatValues(entry, text);
+        delete[] entry.values;
+        entry.values = NULL;
+      } else {
+        formatEntry(entry, text);
+        for (uint i = 0; i < entry.numArgs; ++i) {
+          if (entry.args[i].type == ARG_STRING_COPY) {
+            delete[] entry.args[i].s;
+          }
+        }
+      }
+
+      _tail.store(tail + 1, std::memory_order_release);
+
+      if (text.size() >= WRITE_CHUNK_SIZE) {
+        writeText(text);
+      }
+    }
+  }
+}
+
+void AsyncLog::writeText(std::string& text) {
+  _file << text;
+  text.clear();
+}
+
+void AsyncLog::formatEntry(const SEntry& entry, std::string& text) const {
+  char buf[256];
+  uint iArg = 0;
+  const char* c = entry.format;
+
+  while (*c) {
+    if (*c != '%') {
+      text += *c++;
+      continue;
+    }
+
+    if (c[1] == '%') {
+      text += '%';
+      c += 2;
+      continue;
+    }
+
+    // Keep flags, width and precision. The length modifier is replaced by
+    // the one of the stored argument.
+    std::string spec = "%";
+    const char* s = c + 1;
+    while (*s && strchr("-+ #0123456789.", *s)) {
+      spec += *s++;
+    }
+    while (*s && strchr("hlLjzt", *s)) {
+      ++s;
+    }
+
+    char conversion = *s;
+    if (conversion == '\0' || iArg >= entry.numArgs) {
+      text.append(c, s + (conversion ? 1 : 0));
+      c = s + (conversion ? 1 : 0);
+      continue;
+    }
+    c = s + 1;
+
+    const SArg& arg = entry.args[iArg++];
+    bool isString = arg.type == ARG_STRING || arg.type == ARG_STRING_COPY;
+    if ((conversion == 's') != isString) {
+      text += "<invalid argument>";
+      continue;
+    }
+
+    // Numeric arguments are converted to the type of the conversion
+    long long i = 0;
+    unsigned long long u = 0;
+    double d = 0.0;
+    if (arg.type == ARG_INT) {
+      i = arg.i;
+      u = (unsigned long long) arg.i;
+      d = (double) arg.i;
+    } else if (arg.type == ARG_UINT) {
+      i = (long long) arg.u;
+      u = arg.u;
+      d = (double) arg.u;
+    } else if (arg.type == ARG_DOUBLE) {
+      i = (long long) arg.d;
+      u = (unsigned long long) arg.d;
+      d = arg.d;
+    }
+
+    int length = -1;
+    switch (conversion) {
+      case 'd':
+      case 'i':
+        spec += "lld";
+        length = snprintf(buf, sizeof(buf), spec.c_str(), i);
+        break;
+      case 'u':
+      case 'x':
+      case 'X':
+      case 'o':
+        spec += "ll";
+        spec += conversion;
+        length = snprintf(buf, sizeof(buf), spec.c_str(), u);
+        break;
+      case 'f':
+      case 'F':
+      case 'e':
+      case 'E':
+      case 'g':
+      case 'G':
+        spec += conversion;
+        length = snprintf(buf, sizeof(buf), spec.c_str(), d);
+        break;
+      case 's':
+        spec += 's';
+        length = snprintf(buf, sizeof(buf), spec.c_str(), arg.s);
+        break;
+      case 'c':
+        spec += 'c';
+        length = snprintf(buf, sizeof(buf), spec.c_str(), (int) i);
+        break;
+      default:
+        text += "<unsupported>";
+        continue;
+    }
+
+    // Truncated output is not terminated by all implementations
+    buf[sizeof(buf) - 1] = '\0';
+    if (length >= 0) {
+      text += buf;
+    }
+  }
+}
+
+void AsyncLog::formatValues(const SEntry& entry, std::string& text) {
+  char buf[32];
+  uint numValues = static_cast<uint>(entry.args[0].u);
+  uint valuesPerLine = static_cast<uint>(entry.args[1].u);
+
+  text += entry.format;
+  text += " (";
+  snprintf(buf, sizeof(buf), "%u", numValues);
+  buf[sizeof(buf) - 1] = '\0';
+  text += buf;
+  text += " values):\n";
+
+  for (uint i = 0; i < numValues; ++i) {
+    if (i % valuesPerLine == 0) {
+      snprintf(buf, sizeof(buf), "%u:", i);
+      buf[sizeof(buf) - 1] = '\0';
+      text += buf;
+    }
+
+    snprintf(buf, sizeof(buf), " %u", entry.values[i]);
+    buf[sizeof(buf) - 1] = '\0';
+    text += buf;
+
+    if (i % valuesPerLine == valuesPerLine - 1 || i == numValues - 1) {
+      text += '\n';
+      if (text.size() >= WRITE_CHUNK_SIZE) {
+        writeText(text);
+      }
+    }
+  }
+}
@@ -0,0 +1,172 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#ifndef VCT_SRC_VCT_ASYNCLOG_H_
+#define VCT_SRC_VCT_ASYNCLOG_H_
+
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "KoRE/Common.h"
+
+/*! Log for hot paths like per-frame counters and buffer dumps. write() only
+*   stores the format and the raw arguments in a lock-free ring buffer; a
+*   background thread formats them and appends the text to its own file,
+*   VCT_Log.txt. kore::Log is not known to be thread-safe, so it is never
+*   called from the background thread, and the render thread does no I/O.
+*
+*   Only one thread (the render thread) may write. The format and
+*   const char* arguments have to be string literals, as they are only read
+*   when the entry is formatted. std::string arguments are copied.
+*/
+class AsyncLog {
+public:
+  inline static AsyncLog* getInstance() {
+    static AsyncLog instance;
+    return &instance;
+  }
+
+  void write(const char* format);
+
+  template<typename A0>
+  void write(const char* format, A0 a0) {
+    SEntry& entry = beginEntry(ENTRY_FORMAT, format);
+    entry.args[0] = makeArg(a0);
+    commitEntry(1);
+  }
+
+  template<typename A0, typename A1>
+  void write(const char* format, A0 a0, A1 a1) {
+    SEntry& entry = beginEntry(ENTRY_FORMAT, format);
+    entry.args[0] = makeArg(a0);
+    entry.args[1] = makeArg(a1);
+    commitEntry(2);
+  }
+
+  template<typename A0, typename A1, typename A2>
+  void write(const char* format, A0 a0, A1 a1, A2 a2) {
+    SEntry& entry = beginEntry(ENTRY_FORMAT, format);
+    entry.args[0] = makeArg(a0);
+    entry.args[1] = makeArg(a1);
+    entry.args[2] = makeArg(a2);
+    commitEntry(3);
+  }
+
+  template<typename A0, typename A1, typename A2, typename A3>
+  void write(const char* format, A0 a0, A1 a1, A2 a2, A3 a3) {
+    SEntry& entry = beginEntry(ENTRY_FORMAT, format);
+    entry.args[0] = makeArg(a0);
+    entry.args[1] = makeArg(a1);
+    entry.args[2] = makeArg(a2);
+    entry.args[3] = makeArg(a3);
+    commitEntry(4);
+  }
+
+  /// Copies the values and writes them after the label, valuesPerLine per
+  /// line, each line prefixed with the index of its first value. The label
+  /// has to be a string literal.
+  void writeValues(const char* label, const uint* values, uint numValues,
+                   uint valuesPerLine = 8);
+
+  /// Waits until all entries are written and stops the background thread.
+  /// Has to be called before exit.
+  void shutdown();
+
+private:
+  AsyncLog();
+  ~AsyncLog();
+
+  enum EEntryType {
+    ENTRY_FORMAT,
+    ENTRY_VALUES
+  };
+
+  enum EArgType {
+    ARG_INT,
+    ARG_UINT,
+    ARG_DOUBLE,
+    ARG_STRING,
+    ARG_STRING_COPY  // Owned by the entry, deleted once it is formatted
+  };
+
+  struct SArg {
+    EArgType type;
+    union {
+      long long i;
+      unsigned long long u;
+      double d;
+      const char* s;
+    };
+  };
+
+  static const uint MAX_ARGS = 4;
+
+  struct SEntry {
+    EEntryType type;
+    const char* format;
+    uint numArgs;
+    SArg args[MAX_ARGS];
+    uint* values;
+  };
+
+  static SArg makeArg(int value)
+    {SArg arg; arg.type = ARG_INT; arg.i = value; return arg;}
+  static SArg makeArg(long long value)
+    {SArg arg; arg.type = ARG_INT; arg.i = value; return arg;}
+  static SArg makeArg(uint value)
+    {SArg arg; arg.type = ARG_UINT; arg.u = value; return arg;}
+  static SArg makeArg(unsigned long long value)
+    {SArg arg; arg.type = ARG_UINT; arg.u = value; return arg;}
+  static SArg makeArg(double value)
+    {SArg arg; arg.type = ARG_DOUBLE; arg.d = value; return arg;}
+  static SArg makeArg(const char* value)
+    {SArg arg; arg.type = ARG_STRING; arg.s = value; return arg;}
+  static SArg makeArg(const std::string& value);
+
+  SEntry& beginEntry(EEntryType type, const char* format);
+  void commitEntry(uint numArgs);
+
+  void run();
+  void writeText(std::string& text);
+  void formatEntry(const SEntry& entry, std::string& text) const;
+  void formatValues(const SEntry& entry, std::string& text);
+
+  // Single producer, single consumer. Indices only grow and are wrapped
+  // with the capacity mask.
+  SEntry* _entries;
+  std::atomic<uint> _head;
+  std::atomic<uint> _tail;
+
+  std::thread _thread;
+  std::atomic<bool> _quit;
+  bool _running;
+
+  // Only used by the background thread
+  std::ofstream _file;
+};
+
+#endif  // VCT_SRC_VCT_ASYNCLOG_H_
@@ -0,0 +1,159 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#include "VoxelConeTracing/Util/BarrierPlanner.h"
+
+#include <map>
+#include "KoRE/Log.h"
+#include "KoRE/Operations/MemoryBarrierOp.h"
+
+// All bits that are relevant for the declarable usages
+static const GLbitfield ALL_USAGE_BITS = GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+                                       | GL_TEXTURE_FETCH_BARRIER_BIT
+                                       | GL_COMMAND_BARRIER_BIT
+                                       | GL_ATOMIC_COUNTER_BARRIER_BIT
+                                       | GL_BUFFER_UPDATE_BARRIER_BIT
+                                       | GL_TEXTURE_UPDATE_BARRIER_BIT
+                                       | GL_SHADER_STORAGE_BARRIER_BIT;
+
+void ResourceUsage::declareResource(const kore::ShaderData* resource,
+                                    EResourceAccess access,
+                                    EResourceUsage usage) {
+  SResourceUsage resUsage;
+  resUsage.resource = resource;
+  resUsage.access = access;
+  resUsage.usage = usage;
+  _vResourceUsages.push_back(resUsage);
+}
+
+GLbitfield BarrierPlanner::getBarrierBit(EResourceUsage usage) {
+  switch (usage) {
+    case USAGE_IMAGE: return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+    case USAGE_TEXTURE_FETCH: return GL_TEXTURE_FETCH_BARRIER_BIT;
+    // The compute path also reads the thread count as shader storage
+    case USAGE_INDIRECT_COMMAND: return GL_COMMAND_BARRIER_BIT
+                                        | GL_SHADER_STORAGE_BARRIER_BIT;
+    case USAGE_ATOMIC_COUNTER: return GL_ATOMIC_COUNTER_BARRIER_BIT;
+    case USAGE_BUFFER_UPDATE: return GL_BUFFER_UPDATE_BARRIER_BIT;
+    case USAGE_TEXTURE_UPDATE: return GL_TEXTURE_UPDATE_BARRIER_BIT;
+    default: return ALL_USAGE_BITS;
+  }
+}
+
+void BarrierPlanner::insertBarriers(const std::string& name,
+                            std::vector<kore::ShaderProgramPass*>& vPasses,
+                            bool useMinimal) {
+  if (vPasses.empty()) {
+    return;
+  }
+
+  if (!useMinimal) {
+    for (uint i = 0; i < vPasses.size(); ++i) {
+      vPasses[i]->addFinishOperation(
+        new kore::MemoryBarrierOp(GL_ALL_BARRIER_BITS));
+    }
+
+    kore::Log::getInstance()->write("[%s] inserted %u full barriers\n",
+                                    name.c_str(), vPasses.size());
+    return;
+  }
+
+  // For each resource the barrier bits that are required before it can be
+  // accessed again. Only shader writes are incoherent and have to be made
+  // visible. The key is the shared data of the image/sampler ShaderDatas.
+  std::map<const void*, GLbitfield> pendingBits;
+
+  // Bits required for all resources, set by passes without declarations
+  GLbitfield pendingBitsAll = 0;
+
+  uint numBarriers = 0;
+  for (uint iPass = 0; iPass < vPasses.size(); ++iPass) {
+    ResourceUsage* resUsage = dynamic_cast<ResourceUsage*>(vPasses[iPass]);
+
+    GLbitfield requiredBits = 0;
+    if (resUsage == NULL) {
+      requiredBits = ALL_USAGE_BITS;
+    } else {
+      const std::vector<SResourceUsage>& vUsages =
+                                            resUsage->getResourceUsages();
+      for (uint i = 0; i < vUsages.size(); ++i) {
+        GLbitfield bit = getBarrierBit(vUsages[i].usage);
+        GLbitfield pending = pendingBitsAll;
+        if (pendingBits.find(vUsages[i].resource->data) != pendingBits.end()) {
+          pending |= pendingBits[vUsages[i].resource->data];
+        }
+
+        requiredBits |= pending & bit;
+      }
+    }
+
+    // The first pass of a stage relies on the barrier at the end of the
+    // previous stage.
+    if (requiredBits != 0 && iPass > 0) {
+      vPasses[iPass - 1]->addFinishOperation(
+        new kore::MemoryBarrierOp(requiredBits));
+      ++numBarriers;
+
+      kore::Log::getInstance()->write("[%s] barrier 0x%x before '%s'\n",
+        name.c_str(), requiredBits, vPasses[iPass]->getName().c_str());
+    }
+
+    pendingBitsAll &= ~requiredBits;
+    std::map<const void*, GLbitfield>::iterator it;
+    for (it = pendingBits.begin(); it != pendingBits.end(); ++it) {
+      it->second &= ~requiredBits;
+    }
+
+    // Record the new incoherent writes of this pass
+    if (resUsage == NULL) {
+      pendingBitsAll = ALL_USAGE_BITS;
+      continue;
+    }
+
+    const std::vector<SResourceUsage>& vUsages = resUsage->getResourceUsages();
+    for (uint i = 0; i < vUsages.size(); ++i) {
+      if ((vUsages[i].access & ACCESS_WRITE) != 0
+          && (vUsages[i].usage == USAGE_IMAGE
+              || vUsages[i].usage == USAGE_ATOMIC_COUNTER)) {
+        pendingBits[vUsages[i].resource->data] = ALL_USAGE_BITS;
+      }
+    }
+  }
+
+  // Make all writes of this stage visible to the following stages
+  GLbitfield finalBits = pendingBitsAll;
+  std::map<const void*, GLbitfield>::iterator it;
+  for (it = pendingBits.begin(); it != pendingBits.end(); ++it) {
+    finalBits |= it->second;
+  }
+
+  if (finalBits != 0) {
+    vPasses.back()->addFinishOperation(new kore::MemoryBarrierOp(finalBits));
+    ++numBarriers;
+  }
+
+  kore::Log::getInstance()->write("[%s] inserted %u minimal barriers for "
+    "%u passes\n", name.c_str(), numBarriers, vPasses.size());
+}
@@ -0,0 +1,93 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#ifndef VCT_SRC_VCT_BARRIERPLANNER_H_
+#define VCT_SRC_VCT_BARRIERPLANNER_H_
+
+#include <vector>
+#include "KoRE/Common.h"
+#include "KoRE/ShaderData.h"
+#include "KoRE/Passes/ShaderProgramPass.h"
+
+enum EResourceAccess {
+  ACCESS_READ = 1,
+  ACCESS_WRITE = 2,
+  ACCESS_READ_WRITE = ACCESS_READ | ACCESS_WRITE
+};
+
+// How a resource is accessed. Each usage maps to the barrier bit that
+// makes previous shader writes visible to it.
+enum EResourceUsage {
+  USAGE_IMAGE = 0,         // imageLoad/-Store/-Atomic*
+  USAGE_TEXTURE_FETCH,     // Samplers, including texelFetch on buffers
+  USAGE_INDIRECT_COMMAND,  // Sourced as GL_DRAW_INDIRECT_BUFFER
+  USAGE_ATOMIC_COUNTER,    // atomic_uint
+  USAGE_BUFFER_UPDATE,     // glBufferSubData, glMapBuffer, ...
+  USAGE_TEXTURE_UPDATE,    // glTexSubImage, glCopyImageSubData, ...
+
+  USAGE_NUM
+};
+
+struct SResourceUsage {
+  const kore::ShaderData* resource;
+  EResourceAccess access;
+  EResourceUsage usage;
+};
+
+/*! Mixin for passes that declare which resources they read and write.
+*   Image- and sampler-ShaderDatas of the same texture refer to the same
+*   resource, as they share their data-pointer.
+*/
+class ResourceUsage {
+public:
+  inline const std::vector<SResourceUsage>& getResourceUsages()
+  {return _vResourceUsages;}
+
+protected:
+  void declareResource(const kore::ShaderData* resource,
+                       EResourceAccess access, EResourceUsage usage);
+
+private:
+  std::vector<SResourceUsage> _vResourceUsages;
+};
+
+/*! Replaces hand-placed memory barriers between the passes of a stage.
+*   From the declared ResourceUsages it computes which barrier bits are
+*   actually needed before each pass and appends them as a finish-operation
+*   to the preceding pass. Passes without declarations are assumed to access
+*   everything.
+*/
+class BarrierPlanner {
+public:
+  /// Inserts the required barriers between all passes. If useMinimal is
+  /// false, a full barrier is inserted after each pass instead (reference).
+  static void insertBarriers(const std::string& name,
+                      std::vector<kore::ShaderProgramPass*>& vPasses,
+                      bool useMinimal);
+
+  static GLbitfield getBarrierBit(EResourceUsage usage);
+};
+
+#endif  // VCT_SRC_VCT_BARRIERPLANNER_H_
@@ -0,0 +1,277 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#include "VoxelConeTracing/Util/CommandList.h"
+
+#include <algorithm>
+
+#include "KoRE/Operations/Operations.h"
+#include "KoRE/Operations/OperationFactory.h"
+#include "KoRE/Operations/FunctionOp.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
+
+CommandList::CommandList(kore::ShaderProgramPass* pass,
+                         kore::ShaderProgram* shader)
+  : _pass(pass),
+    _shader(shader),
+    _executed(false) {
+  SCommandCounters zero = {0, 0, 0, 0, 0.0};
+  _counters = zero;
+  _lastCounters = zero;
+  getRegistry().push_back(this);
+}
+
+CommandList::~CommandList() {
+  for (uint iNode = 0; iNode < _vNodes.size(); ++iNode) {
+    for (uint i = 0; i < _vNodes[iNode].vCommands.size(); ++i) {
+      delete _vNodes[iNode].vCommands[i].op;
+    }
+  }
+
+  for (uint i = 0; i < _vStartupCommands.size(); ++i) {
+    delete _vStartupCommands[i].op;
+  }
+
+  std::vector<CommandList*>& registry = getRegistry();
+  registry.erase(std::remove(registry.begin(), registry.end(), this),
+                 registry.end());
+}
+
+std::vector<CommandList*>& CommandList::getRegistry() {
+  static std::vector<CommandList*> registry;
+  return registry;
+}
+
+const std::vector<CommandList*>& CommandList::getCommandLists() {
+  return getRegistry();
+}
+
+uint CommandList::getSlot(ECommandType type, const std::string& name) {
+  // Attributes and uniforms have separate namespaces
+  std::string key = (type == COMMAND_BIND_ATTRIBUTE ? "a:" : "u:") + name;
+  std::map<std::string, uint>::iterator it = _slotIDs.find(key);
+  if (it != _slotIDs.end()) {
+    return it->second;
+  }
+
+  uint id = _slotIDs.size();
+  _slotIDs[key] = id;
+  return id;
+}
+
+uint CommandList::getSource(const void* component, const std::string& name) {
+  std::pair<const void*, std::string> key(component, name);
+  std::map<std::pair<const void*, std::string>, uint>::iterator it =
+    _sourceIDs.find(key);
+  if (it != _sourceIDs.end()) {
+    return it->second;
+  }
+
+  uint id = _sourceIDs.size();
+  _sourceIDs[key] = id;
+  return id;
+}
+
+void CommandList::beginNode(kore::NodePass* nodePass) {
+  SNode node;
+  node.nodePass = nodePass;
+  node.enabled = true;
+  _vNodes.push_back(node);
+}
+
+void CommandList::addBind(kore::Operation* op, ECommandType type,
+                          const std::string& slotName,
+                          const void* sourceComponent,
+                          const std::string& sourceName) {
+  SCommand command;
+  command.op = op;
+  command.type = type;
+  command.slot = getSlot(type, slotName);
+  command.source = getSource(sourceComponent, sourceName);
+  _vNodes.back().vCommands.push_back(command);
+}
+
+void CommandList::bindAttribute(const std::string& dataName,
+                                const kore::SceneComponent* component,
+                                const std::string& attributeName) {
+  addBind(kore::OperationFactory::create(kore::OP_BINDATTRIBUTE, dataName,
+                                         component, attributeName, _shader),
+          COMMAND_BIND_ATTRIBUTE, attributeName, component, dataName);
+}
+
+void CommandList::bindUniform(const std::string& dataName,
+                              const kore::SceneComponent* component,
+                              const std::string& uniformName) {
+  addBind(kore::OperationFactory::create(kore::OP_BINDUNIFORM, dataName,
+                                         component, uniformName, _shader),
+          COMMAND_BIND_UNIFORM, uniformName, component, dataName);
+}
+
+void CommandList::bindUniform(const kore::ShaderData* data,
+                              const std::string& uniformName) {
+  addBind(new kore::BindUniform(data, _shader->getUniform(uniformName)),
+          COMMAND_BIND_UNIFORM, uniformName, data, "");
+}
+
+void CommandList::bindTexture(const std::string& textureName,
+                              const kore::SceneComponent* component,
+                              const std::string& samplerName) {
+  addBind(kore::OperationFactory::create(kore::OP_BINDTEXTURE, textureName,
+                                         component, samplerName, _shader),
+          COMMAND_BIND_TEXTURE, samplerName, component, textureName);
+}
+
+void CommandList::draw(kore::MeshComponent* mesh) {
+  SCommand command;
+  command.op = new kore::RenderMesh(mesh);
+  command.type = COMMAND_DRAW;
+  command.slot = 0;
+  command.source = 0;
+  _vNodes.back().vCommands.push_back(command);
+}
+
+void CommandList::bake() {
+  // Source of each slot if all nodes set it to the same one, -1 otherwise
+  const int NOT_SET = -2;
+  std::vector<int> vSharedSources(_slotIDs.size(), NOT_SET);
+
+  for (uint iNode = 0; iNode < _vNodes.size(); ++iNode) {
+    std::vector<bool> vSetByNode(_slotIDs.size(), false);
+    const std::vector<SCommand>& vCommands = _vNodes[iNode].vCommands;
+    for (uint i = 0; i < vCommands.size(); ++i) {
+      const SCommand& command = vCommands[i];
+      if (command.type == COMMAND_DRAW) {
+        continue;
+      }
+
+      int& sharedSource = vSharedSources[command.slot];
+      if (sharedSource == NOT_SET) {
+        sharedSource = command.source;
+      } else if (sharedSource != (int)command.source) {
+        sharedSource = -1;
+      }
+      vSetByNode[command.slot] = true;
+    }
+
+    for (uint iSlot = 0; iSlot < vSetByNode.size(); ++iSlot) {
+      if (!vSetByNode[iSlot]) {
+        vSharedSources[iSlot] = -1;
+      }
+    }
+  }
+
+  // Move the shared binds from the nodes to the start of the pass
+  for (uint iNode = 0; iNode < _vNodes.size(); ++iNode) {
+    std::vector<SCommand>& vCommands = _vNodes[iNode].vCommands;
+    std::vector<SCommand> vRemaining;
+    for (uint i = 0; i < vCommands.size(); ++i) {
+      const SCommand& command = vCommands[i];
+      bool shared = command.type != COMMAND_DRAW
+                    && vSharedSources[command.slot] == (int)command.source;
+
+      if (!shared) {
+        vRemaining.push_back(command);
+      } else if (iNode == 0) {
+        _vStartupCommands.push_back(command);
+      } else {
+        delete command.op;
+      }
+    }
+    vCommands.swap(vRemaining);
+  }
+
+  _vCurrentSources.resize(_slotIDs.size(), -1);
+
+  _pass->addStartupOperation(new kore::FunctionOp(
+    std::bind(&CommandList::executeStartup, this)));
+
+  for (uint iNode = 0; iNode < _vNodes.size(); ++iNode) {
+    _vNodes[iNode].nodePass->addOperation(new kore::FunctionOp(
+      std::bind(&CommandList::executeNode, this, iNode)));
+  }
+}
+
+void CommandList::executeStartup() {
+  if (_executed) {
+    _lastCounters = _counters;
+  }
+  SCommandCounters zero = {0, 0, 0, 0, 0.0};
+  _counters = zero;
+  _executed = true;
+
+  GPUprofiler* profiler = GPUprofiler::getInstance();
+  double startMS = profiler->getCPUtimeMS();
+
+  // Other passes may have changed the state in between
+  std::fill(_vCurrentSources.begin(), _vCurrentSources.end(), -1);
+
+  for (uint i = 0; i < _vStartupCommands.size(); ++i) {
+    executeCommand(_vStartupCommands[i]);
+  }
+
+  _counters.submitMS += profiler->getCPUtimeMS() - startMS;
+}
+
+void CommandList::executeNode(uint node) {
+  if (!_vNodes[node].enabled) {
+    return;
+  }
+
+  GPUprofiler* profiler = GPUprofiler::getInstance();
+  double startMS = profiler->getCPUtimeMS();
+
+  const std::vector<SCommand>& vCommands = _vNodes[node].vCommands;
+  for (uint i = 0; i < vCommands.size(); ++i) {
+    executeCommand(vCommands[i]);
+  }
+
+  _counters.submitMS += profiler->getCPUtimeMS() - startMS;
+}
+
+void CommandList::executeCommand(const SCommand& command) {
+  if (command.type != COMMAND_DRAW) {
+    int& currentSource = _vCurrentSources[command.slot];
+    if (currentSource == (int)command.source) {
+      ++_counters.skippedBinds;
+      return;
+    }
+    currentSource = command.source;
+  }
+
+  command.op->execute();
+
+  switch (command.type) {
+    case COMMAND_BIND_ATTRIBUTE:
+    case COMMAND_BIND_TEXTURE:
+      ++_counters.binds;
+      break;
+    case COMMAND_BIND_UNIFORM:
+      ++_counters.uniformUploads;
+      break;
+    case COMMAND_DRAW:
+      ++_counters.draws;
+      break;
+  }
+}
@@ -0,0 +1,148 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#ifndef VCT_SRC_VCT_COMMANDLIST_H_
+#define VCT_SRC_VCT_COMMANDLIST_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "KoRE/Common.h"
+#include "KoRE/ShaderProgram.h"
+#include "KoRE/Components/SceneComponent.h"
+#include "KoRE/Components/MeshComponent.h"
+#include "KoRE/Operations/Operation.h"
+#include "KoRE/Passes/NodePass.h"
+#include "KoRE/Passes/ShaderProgramPass.h"
+
+/// Executed commands of one execution of a pass
+struct SCommandCounters {
+  uint binds;           // Attribute and texture binds
+  uint uniformUploads;
+  uint draws;
+  uint skippedBinds;    // Binds of state that was already set
+  double submitMS;      // CPU-time of the binds and draws
+};
+
+/*! Records the per-node operations of a pass and bakes them into one
+*   operation per node. Binds that are identical for all nodes (e.g. the
+*   camera matrices) are executed once when the pass starts. All other binds
+*   are only executed if the bound state differs from the current one, which
+*   is tracked per attribute, uniform and sampler of the pass' program.
+*
+*   Usage: per node beginNode() followed by its binds and draws, then bake()
+*   once at the end of the pass' constructor.
+*/
+class CommandList {
+public:
+  CommandList(kore::ShaderProgramPass* pass, kore::ShaderProgram* shader);
+  ~CommandList();
+
+  void beginNode(kore::NodePass* nodePass);
+
+  void bindAttribute(const std::string& dataName,
+                     const kore::SceneComponent* component,
+                     const std::string& attributeName);
+  void bindUniform(const std::string& dataName,
+                   const kore::SceneComponent* component,
+                   const std::string& uniformName);
+  void bindUniform(const kore::ShaderData* data,
+                   const std::string& uniformName);
+  void bindTexture(const std::string& textureName,
+                   const kore::SceneComponent* component,
+                   const std::string& samplerName);
+  void draw(kore::MeshComponent* mesh);
+
+  /// Disabled nodes are skipped, e.g. to draw only some of the meshes.
+  /// Nodes are numbered in the order of the beginNode() calls.
+  inline void setNodeEnabled(uint node, bool enabled)
+  {_vNodes[node].enabled = enabled;}
+
+  inline uint getNumNodes() const {return _vNodes.size();}
+
+  /// Hoists the binds shared by all nodes and adds the baked operations to
+  /// the pass and its node passes.
+  void bake();
+
+  inline kore::ShaderProgramPass* getPass() const {return _pass;}
+
+  /// Counters of the last complete execution of the pass
+  inline const SCommandCounters& getCounters() const {return _lastCounters;}
+
+  /// All command lists, e.g. to show their counters
+  static const std::vector<CommandList*>& getCommandLists();
+
+private:
+  enum ECommandType {
+    COMMAND_BIND_ATTRIBUTE,
+    COMMAND_BIND_UNIFORM,
+    COMMAND_BIND_TEXTURE,
+    COMMAND_DRAW
+  };
+
+  struct SCommand {
+    kore::Operation* op;
+    ECommandType type;
+    uint slot;    // Attribute, uniform or sampler the command sets
+    uint source;  // Data it is set to
+  };
+
+  struct SNode {
+    kore::NodePass* nodePass;
+    std::vector<SCommand> vCommands;
+    bool enabled;
+  };
+
+  void addBind(kore::Operation* op, ECommandType type,
+               const std::string& slotName,
+               const void* sourceComponent, const std::string& sourceName);
+  uint getSlot(ECommandType type, const std::string& name);
+  uint getSource(const void* component, const std::string& name);
+
+  void executeStartup();
+  void executeNode(uint node);
+  void executeCommand(const SCommand& command);
+
+  static std::vector<CommandList*>& getRegistry();
+
+  kore::ShaderProgramPass* _pass;
+  kore::ShaderProgram* _shader;
+
+  std::vector<SNode> _vNodes;
+  std::vector<SCommand> _vStartupCommands;
+
+  std::map<std::string, uint> _slotIDs;
+  std::map<std::pair<const void*, std::string>, uint> _sourceIDs;
+
+  // Source currently set in each slot, -1 if unknown
+  std::vector<int> _vCurrentSources;
+
+  SCommandCounters _counters;
+  SCommandCounters _lastCounters;
+  bool _executed;
+};
+
+#endif  // VCT_SRC_VCT_COMMANDLIST_H_
@@ -0,0 +1,272 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#include "VoxelConeTracing/Util/GPUprofiler.h"
+
+#include "KoRE/Operations/FunctionOp.h"
+
+static const uint DEFAULT_NUM_FRAMES_IN_FLIGHT = 3;
+
+GPUprofiler::GPUprofiler()
+  : _currFrame(0),
+    _frameSampled(false),
+    _fullFrame(false),
+    _fullFrameRequested(false),
+    _frameIndex(0),
+    _subsetStart(0),
+    _enabled(false),
+    _required(false),
+    _mode(PROFILING_EVERY_FRAME),
+    _sampleInterval(10),
+    _subsetSize(8),
+    _numSkippedFrames(0),
+    _cpuTimeMS(0.0) {
+  setNumFramesInFlight(DEFAULT_NUM_FRAMES_IN_FLIGHT);
+  _cpuTimer.start();
+}
+
+GPUprofiler::~GPUprofiler() {
+  // The GL-context is gone when the static instance is destroyed, so the
+  // queries have to be deleted through release() beforehand.
+}
+
+void GPUprofiler::release() {
+  deleteQueries();
+}
+
+void GPUprofiler::deleteQueries() {
+  for (uint iFrame = 0; iFrame < _vFrames.size(); ++iFrame) {
+    std::vector<SSample>& vSamples = _vFrames[iFrame].vSamples;
+    for (uint i = 0; i < vSamples.size(); ++i) {
+      glDeleteQueries(1, &vSamples[i].startQuery);
+      glDeleteQueries(1, &vSamples[i].endQuery);
+    }
+  }
+  _vFrames.clear();
+}
+
+void GPUprofiler::setNumFramesInFlight(uint numFrames) {
+  deleteQueries();
+
+  SFrame frame;
+  frame.numSamples = 0;
+  frame.frameIndex = 0;
+  frame.pending = false;
+  _vFrames.resize(glm::max(numFrames, 1U), frame);
+  _currFrame = 0;
+}
+
+void GPUprofiler::addPass(kore::ShaderProgramPass* pass) {
+  if (!_required && (!Instrumentation::TIMING || !_enabled)) {
+    return;
+  }
+
+  SPass entry;
+  entry.pass = pass;
+  entry.activeSample = -1;
+  entry.gpuMS = 0.0f;
+  entry.cpuMS = 0.0f;
+  entry.measured = false;
+  _vPasses.push_back(entry);
+
+  pass->addStartupOperation(new kore::FunctionOp(
+    std::bind(&GPUprofiler::startPass, this, _vPasses.size() - 1)));
+}
+
+void GPUprofiler::finishSetup() {
+  for (uint i = 0; i < _vPasses.size(); ++i) {
+    _vPasses[i].pass->addFinishOperation(new kore::FunctionOp(
+      std::bind(&GPUprofiler::endPass, this, i)));
+  }
+}
+
+void GPUprofiler::beginFrame() {
+  // Without the TIMING instrumentation, only required passes were added
+  collectResults();
+
+  _frameSampled = false;
+  if (_vPasses.empty()) {
+    return;
+  }
+
+  uint frameIndex = _frameIndex++;
+  if (!_fullFrameRequested && _mode == PROFILING_EVERY_KTH_FRAME
+      && frameIndex % glm::max(_sampleInterval, 1U) != 0) {
+    return;
+  }
+
+  // Never wait for the oldest frame, rather skip this one
+  uint nextFrame = (_currFrame + 1) % _vFrames.size();
+  if (_vFrames[nextFrame].pending) {
+    ++_numSkippedFrames;
+    return;
+  }
+
+  _currFrame = nextFrame;
+  _vFrames[_currFrame].numSamples = 0;
+  _vFrames[_currFrame].frameIndex = frameIndex;
+  _frameSampled = true;
+
+  _fullFrame = _fullFrameRequested;
+  _fullFrameRequested = false;
+  if (!_fullFrame && _mode == PROFILING_ROTATING_SUBSET) {
+    _subsetStart = (_subsetStart + glm::max(_subsetSize, 1U))
+                   % _vPasses.size();
+  }
+}
+
+bool GPUprofiler::isPassSampled(uint pass) const {
+  if (!_frameSampled) {
+    return false;
+  }
+
+  if (_fullFrame || _mode != PROFILING_ROTATING_SUBSET) {
+    return true;
+  }
+
+  // The subset wraps around at the last pass
+  uint numPasses = _vPasses.size();
+  uint offset = (pass + numPasses - _subsetStart) % numPasses;
+  return offset < glm::max(_subsetSize, 1U);
+}
+
+void GPUprofiler::startPass(uint pass) {
+  SPass& entry = _vPasses[pass];
+  entry.activeSample = -1;
+  if (!isPassSampled(pass)) {
+    return;
+  }
+
+  SFrame& frame = _vFrames[_currFrame];
+  if (frame.numSamples == frame.vSamples.size()) {
+    SSample sample;
+    glGenQueries(1, &sample.startQuery);
+    glGenQueries(1, &sample.endQuery);
+    frame.vSamples.push_back(sample);
+  }
+
+  SSample& sample = frame.vSamples[frame.numSamples];
+  sample.pass = pass;
+  glQueryCounter(sample.startQuery, GL_TIMESTAMP);
+
+  entry.activeSample = frame.numSamples++;
+  frame.pending = true;
+  sample.cpuStartMS = getCPUtimeMS();
+  sample.cpuEndMS = sample.cpuStartMS;
+}
+
+void GPUprofiler::endPass(uint pass) {
+  SPass& entry = _vPasses[pass];
+  if (entry.activeSample < 0) {
+    return;
+  }
+
+  SSample& sample = _vFrames[_currFrame].vSamples[entry.activeSample];
+  sample.cpuEndMS = getCPUtimeMS();
+  glQueryCounter(sample.endQuery, GL_TIMESTAMP);
+  entry.activeSample = -1;
+}
+
+void GPUprofiler::collectResults() {
+  // Oldest frame first, so newer measurements replace older ones. The
+  // timestamps complete in order, so no later frame can be available if
+  // one is not.
+  for (uint i = 1; i <= _vFrames.size(); ++i) {
+    SFrame& frame = _vFrames[(_currFrame + i) % _vFrames.size()];
+    if (frame.pending && !collectFrame(frame)) {
+      return;
+    }
+  }
+}
+
+bool GPUprofiler::collectFrame(SFrame& frame) {
+  if (frame.numSamples > 0) {
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(frame.vSamples[frame.numSamples - 1].endQuery,
+                        GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      return false;
+    }
+  }
+
+  _vTimings.clear();
+  for (uint i = 0; i < frame.numSamples; ++i) {
+    const SSample& sample = frame.vSamples[i];
+    GLuint64 startNS = 0;
+    GLuint64 endNS = 0;
+    glGetQueryObjectui64v(sample.startQuery, GL_QUERY_RESULT, &startNS);
+    glGetQueryObjectui64v(sample.endQuery, GL_QUERY_RESULT, &endNS);
+
+    SPass& entry = _vPasses[sample.pass];
+    entry.gpuMS = static_cast<float>((endNS - startNS) / 1000000.0);
+    entry.cpuMS = static_cast<float>(sample.cpuEndMS - sample.cpuStartMS);
+    entry.measured = true;
+
+    if (_frameTimingsCallback) {
+      SPassTiming timing;
+      timing.pass = entry.pass;
+      timing.cpuStartMS = sample.cpuStartMS;
+      timing.cpuEndMS = sample.cpuEndMS;
+      timing.gpuStartNS = startNS;
+      timing.gpuEndNS = endNS;
+      _vTimings.push_back(timing);
+    }
+  }
+
+  frame.pending = false;
+
+  if (_frameTimingsCallback) {
+    _frameTimingsCallback(frame.frameIndex, _vTimings);
+  }
+  return true;
+}
+
+bool GPUprofiler::getPassTimesMS(const kore::ShaderProgramPass* pass,
+                                 float* gpuMS, float* cpuMS) const {
+  for (uint i = 0; i < _vPasses.size(); ++i) {
+    if (_vPasses[i].pass != pass) {
+      continue;
+    }
+
+    if (!_vPasses[i].measured) {
+      return false;
+    }
+
+    if (gpuMS) {
+      *gpuMS = _vPasses[i].gpuMS;
+    }
+    if (cpuMS) {
+      *cpuMS = _vPasses[i].cpuMS;
+    }
+    return true;
+  }
+  return false;
+}
+
+double GPUprofiler::getCPUtimeMS() {
+  // The timer only returns the time since its last call
+  _cpuTimeMS += _cpuTimer.timeSinceLastCall() * 1000.0;
+  return _cpuTimeMS;
+}
@@ -0,0 +1,185 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#ifndef VCT_SRC_VCT_GPUPROFILER_H_
+#define VCT_SRC_VCT_GPUPROFILER_H_
+
+#include <functional>
+#include <vector>
+
+#include "KoRE/Common.h"
+#include "KoRE/Timer.h"
+#include "KoRE/Passes/ShaderProgramPass.h"
+#include "VoxelConeTracing/Util/Instrumentation.h"
+
+enum EProfilingMode {
+  PROFILING_EVERY_FRAME = 0,
+  PROFILING_EVERY_KTH_FRAME,
+  PROFILING_ROTATING_SUBSET
+};
+
+/// One measured execution of a pass. The CPU-times are in ms of
+/// GPUprofiler::getCPUtimeMS(), the GPU-times in ns of the GL timestamp.
+struct SPassTiming {
+  kore::ShaderProgramPass* pass;
+  double cpuStartMS;
+  double cpuEndMS;
+  GLuint64 gpuStartNS;
+  GLuint64 gpuEndNS;
+};
+
+/// Receives all measurements of a sampled frame once they are available.
+typedef std::function<void (uint frameIndex,
+                            const std::vector<SPassTiming>& vTimings)>
+  FrameTimingsCallback;
+
+/*! Measures the GPU-time of the passes with timestamp queries and the
+*   CPU-time spent issuing their operations. The queries of up to
+*   numFramesInFlight sampled frames are kept in a ring and their results are
+*   only read once they are available, so the CPU never waits for the GPU.
+*   If the oldest frame of the ring is still in flight, a frame is not
+*   sampled. To reduce the number of queries, only every Kth frame or a
+*   rotating subset of the passes can be sampled; the last measurement of
+*   each pass is kept until it is sampled again.
+*/
+class GPUprofiler {
+public:
+  inline static GPUprofiler* getInstance() {
+    static GPUprofiler instance;
+    return &instance;
+  }
+
+  /// Passes added while disabled are never profiled. Below the TIMING
+  /// instrumentation level, only required passes are profiled.
+  inline void setEnabled(bool enabled) {_enabled = enabled;}
+  inline bool isEnabled() const {return _enabled;}
+
+  /// Passes added while required are profiled regardless of the
+  /// instrumentation level and setEnabled(), e.g. the ones whose timings
+  /// drive a GPU budget.
+  inline void setRequired(bool required) {_required = required;}
+
+  /// Has to be called before the first frame.
+  void setNumFramesInFlight(uint numFrames);
+
+  /// Deletes all timer queries. Has to be called while the GL-context still
+  /// exists.
+  void release();
+
+  /// Has to be called first in the constructor of the pass, so the start
+  /// timestamp is taken before all of its startup operations.
+  void addPass(kore::ShaderProgramPass* pass);
+
+  /// Appends the end timestamp to all added passes. Has to be called once
+  /// after all stages are set up, so it follows all finish operations of the
+  /// passes (e.g. the planned barriers).
+  void finishSetup();
+
+  /// Collects the available results and decides whether the new frame is
+  /// sampled. Has to be called once per frame before rendering.
+  void beginFrame();
+
+  /// Samples all passes in the next frame regardless of the mode, e.g. to
+  /// measure passes that are only executed once.
+  inline void requestFullFrame() {_fullFrameRequested = true;}
+
+  /// Returns the last measurement of the pass in ms. Returns false if the
+  /// pass has not been measured yet.
+  bool getPassTimesMS(const kore::ShaderProgramPass* pass,
+                      float* gpuMS, float* cpuMS) const;
+
+  /// Called with all timings of each collected frame, e.g. to record them.
+  inline void setFrameTimingsCallback(const FrameTimingsCallback& callback)
+    {_frameTimingsCallback = callback;}
+
+  /// Index of the frame started by the next beginFrame()
+  inline uint getNextFrameIndex() const {return _frameIndex;}
+
+  /// Monotonic CPU-time in ms used for all CPU measurements
+  double getCPUtimeMS();
+
+  inline EProfilingMode* getModePtr() {return &_mode;}
+  inline uint* getSampleIntervalPtr() {return &_sampleInterval;}
+  inline uint* getSubsetSizePtr() {return &_subsetSize;}
+  inline uint* getNumSkippedFramesPtr() {return &_numSkippedFrames;}
+
+private:
+  GPUprofiler();
+  ~GPUprofiler();
+
+  struct SPass {
+    kore::ShaderProgramPass* pass;
+    int activeSample;  // Sample of the current frame, -1 if not sampled
+    float gpuMS;
+    float cpuMS;
+    bool measured;
+  };
+
+  struct SSample {
+    GLuint startQuery;
+    GLuint endQuery;
+    uint pass;
+    double cpuStartMS;
+    double cpuEndMS;
+  };
+
+  struct SFrame {
+    std::vector<SSample> vSamples;
+    uint numSamples;
+    uint frameIndex;
+    bool pending;
+  };
+
+  void startPass(uint pass);
+  void endPass(uint pass);
+  bool isPassSampled(uint pass) const;
+  void collectResults();
+  bool collectFrame(SFrame& frame);
+  void deleteQueries();
+
+  std::vector<SPass> _vPasses;
+  std::vector<SFrame> _vFrames;
+  uint _currFrame;
+  bool _frameSampled;
+  bool _fullFrame;
+  bool _fullFrameRequested;
+  uint _frameIndex;
+  uint _subsetStart;
+
+  bool _enabled;
+  bool _required;
+  EProfilingMode _mode;
+  uint _sampleInterval;
+  uint _subsetSize;
+  uint _numSkippedFrames;
+
+  FrameTimingsCallback _frameTimingsCallback;
+  std::vector<SPassTiming> _vTimings;
+
+  kore::Timer _cpuTimer;
+  double _cpuTimeMS;
+};
+
+#endif  // VCT_SRC_VCT_GPUPROFILER_H_
@@ -0,0 +1,132 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#include "VoxelConeTracing/Util/GPUreadback.h"
+
+GPUreadback::GPUreadback()
+  : _nextBuffer(0),
+    _numPending(0) {
+}
+
+GPUreadback::~GPUreadback() {
+  // The GL-context is gone when the static instance is destroyed, so the
+  // buffers have to be deleted through release() beforehand.
+}
+
+void GPUreadback::release() {
+  for (uint i = 0; i < _stagingBuffers.size(); ++i) {
+    if (_stagingBuffers[i].fence) {
+      glDeleteSync(_stagingBuffers[i].fence);
+    }
+    glDeleteBuffers(1, &_stagingBuffers[i].buffer);
+  }
+  _stagingBuffers.clear();
+  _nextBuffer = 0;
+  _numPending = 0;
+}
+
+uint GPUreadback::getFreeStagingBuffer() {
+  // Reuse the buffers round-robin and only add one if all are in flight
+  for (uint i = 0; i < _stagingBuffers.size(); ++i) {
+    uint index = (_nextBuffer + i) % _stagingBuffers.size();
+    if (!_stagingBuffers[index].fence) {
+      _nextBuffer = (index + 1) % _stagingBuffers.size();
+      return index;
+    }
+  }
+
+  SStagingBuffer staging;
+  glGenBuffers(1, &staging.buffer);
+  staging.byteSize = 0;
+  staging.fence = 0;
+  staging.numValues = 0;
+  _stagingBuffers.push_back(staging);
+  return _stagingBuffers.size() - 1;
+}
+
+void GPUreadback::request(GLuint srcBuffer, uint byteOffset, uint numValues,
+                          const ReadbackCallback& callback) {
+  uint byteSize = numValues * sizeof(uint);
+  SStagingBuffer& staging = _stagingBuffers[getFreeStagingBuffer()];
+
+  // Shader writes to the source have to be finished before the copy
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
+
+  glBindBuffer(GL_COPY_WRITE_BUFFER, staging.buffer);
+  if (staging.byteSize < byteSize) {
+    glBufferData(GL_COPY_WRITE_BUFFER, byteSize, NULL, GL_STREAM_READ);
+    staging.byteSize = byteSize;
+  }
+
+  glBindBuffer(GL_COPY_READ_BUFFER, srcBuffer);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                      byteOffset, 0, byteSize);
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  staging.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  staging.numValues = numValues;
+  staging.callback = callback;
+  ++_numPending;
+}
+
+void GPUreadback::update() {
+  // A callback may request a readback, which can add a staging buffer. So
+  // the buffers are accessed by index, and a slot keeps its fence until it
+  // is unmapped, so it is not reused while its values are read.
+  for (uint i = 0; i < _stagingBuffers.size(); ++i) {
+    if (!_stagingBuffers[i].fence) {
+      continue;
+    }
+
+    // A zero timeout only polls the fence
+    GLenum status = glClientWaitSync(_stagingBuffers[i].fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+      continue;
+    }
+
+    ReadbackCallback callback;
+    callback.swap(_stagingBuffers[i].callback);
+    GLuint buffer = _stagingBuffers[i].buffer;
+    uint numValues = _stagingBuffers[i].numValues;
+
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    const uint* values = (const uint*) glMapBufferRange(GL_COPY_READ_BUFFER,
+                                           0, numValues * sizeof(uint),
+                                           GL_MAP_READ_BIT);
+    if (values) {
+      callback(values, numValues);
+
+      // The callback may have bound other buffers
+      glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+      glUnmapBuffer(GL_COPY_READ_BUFFER);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    glDeleteSync(_stagingBuffers[i].fence);
+    _stagingBuffers[i].fence = 0;
+    --_numPending;
+  }
+}
@@ -0,0 +1,85 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#ifndef VCT_SRC_VCT_GPUREADBACK_H_
+#define VCT_SRC_VCT_GPUREADBACK_H_
+
+#include <functional>
+#include <vector>
+
+#include "KoRE/Common.h"
+
+/// Receives the values of a finished readback. The pointer is only valid
+/// during the call.
+typedef std::function<void (const uint* values, uint numValues)>
+  ReadbackCallback;
+
+/*! Reads buffer contents back to the CPU without stalling the pipeline.
+*   A request copies the values into a staging buffer on the GPU and places
+*   a fence behind the copy. update() polls the fences and delivers the
+*   values of all finished copies to their callbacks, usually a frame or two
+*   later. Staging buffers are reused, so counters can be read every frame.
+*/
+class GPUreadback {
+public:
+  inline static GPUreadback* getInstance() {
+    static GPUreadback instance;
+    return &instance;
+  }
+
+  /// Queues a readback of numValues uints at byteOffset in srcBuffer
+  void request(GLuint srcBuffer, uint byteOffset, uint numValues,
+               const ReadbackCallback& callback);
+
+  /// Delivers all finished readbacks. Never waits for the GPU. Callbacks
+  /// may request new readbacks.
+  void update();
+
+  /// Deletes all staging buffers and drops the pending readbacks. Has to be
+  /// called while the GL-context still exists.
+  void release();
+
+  inline uint getNumPending() const {return _numPending;}
+
+private:
+  GPUreadback();
+  ~GPUreadback();
+
+  struct SStagingBuffer {
+    GLuint buffer;
+    uint byteSize;
+    GLsync fence;
+    uint numValues;
+    ReadbackCallback callback;
+  };
+
+  uint getFreeStagingBuffer();
+
+  std::vector<SStagingBuffer> _stagingBuffers;
+  uint _nextBuffer;
+  uint _numPending;
+};
+
+#endif  // VCT_SRC_VCT_GPUREADBACK_H_
@@ -0,0 +1,66 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#ifndef VCT_SRC_VCT_INSTRUMENTATION_H_
+#define VCT_SRC_VCT_INSTRUMENTATION_H_
+
+// Instrumentation levels. Each level includes the ones below.
+#define VCT_INSTRUMENTATION_OFF 0
+#define VCT_INSTRUMENTATION_TIMING 1      // GPUprofiler and trace capture
+#define VCT_INSTRUMENTATION_VALIDATION 2  // GL error check of every frame
+#define VCT_INSTRUMENTATION_FULL 3        // GL debug output with stack traces
+
+// Can be set per configuration in the project. Release builds default to no
+// instrumentation, all other builds to the full one.
+#ifndef VCT_INSTRUMENTATION_LEVEL
+#ifdef NDEBUG
+#define VCT_INSTRUMENTATION_LEVEL VCT_INSTRUMENTATION_OFF
+#else
+#define VCT_INSTRUMENTATION_LEVEL VCT_INSTRUMENTATION_FULL
+#endif
+#endif
+
+// Cone trace statistics of the final render. They distort its GPU-time, so
+// they have their own switch, independent of the level. Off by default, a
+// configuration with them is not used for timing.
+#ifndef VCT_CONE_TRACE_STATS
+#define VCT_CONE_TRACE_STATS 0
+#endif
+
+/*! Compile-time flags of the instrumentation level. Code guarded by a false
+*   flag is removed by the compiler but still compiled in every
+*   configuration, so it cannot rot in release builds.
+*/
+namespace Instrumentation {
+  static const bool TIMING =
+    VCT_INSTRUMENTATION_LEVEL >= VCT_INSTRUMENTATION_TIMING;
+  static const bool VALIDATION =
+    VCT_INSTRUMENTATION_LEVEL >= VCT_INSTRUMENTATION_VALIDATION;
+  static const bool FULL =
+    VCT_INSTRUMENTATION_LEVEL >= VCT_INSTRUMENTATION_FULL;
+  static const bool CONE_TRACE_STATS = VCT_CONE_TRACE_STATS != 0;
+}
+
+#endif  // VCT_SRC_VCT_INSTRUMENTATION_H_
@@ -0,0 +1,164 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#include "VoxelConeTracing/Util/MappedFile.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() :
+  _data(NULL),
+  _size(0)
+#ifdef _WIN32
+  , _fileHandle(INVALID_HANDLE_VALUE),
+  _mappingHandle(NULL)
+#endif
+  {
+}
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+bool MappedFile::getFileStamp(const std::string& file,
+                              unsigned long long* size,
+                              unsigned long long* modifiedTime) {
+#ifdef _WIN32
+  struct _stat64 info;
+  if (_stat64(file.c_str(), &info) != 0) {
+    return false;
+  }
+#else
+  struct stat info;
+  if (stat(file.c_str(), &info) != 0) {
+    return false;
+  }
+#endif
+
+  *size = static_cast<unsigned long long>(info.st_size);
+  *modifiedTime = static_cast<unsigned long long>(info.st_mtime);
+  return true;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& file) {
+  close();
+
+  HANDLE fileHandle = CreateFileA(file.c_str(), GENERIC_READ,
+                                  FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                  FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (fileHandle == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  _fileHandle = fileHandle;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(fileHandle, &size) || size.QuadPart == 0) {
+    close();
+    return false;
+  }
+
+  _mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY,
+                                      0, 0, NULL);
+  if (_mappingHandle == NULL) {
+    close();
+    return false;
+  }
+
+  _data = static_cast<const char*>(
+    MapViewOfFile(_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+  if (_data == NULL) {
+    close();
+    return false;
+  }
+
+  _size = static_cast<unsigned long long>(size.QuadPart);
+  return true;
+}
+
+void MappedFile::close() {
+  if (_data) {
+    UnmapViewOfFile(_data);
+  }
+  if (_mappingHandle) {
+    CloseHandle(_mappingHandle);
+  }
+  if (_fileHandle != INVALID_HANDLE_VALUE) {
+    CloseHandle(_fileHandle);
+  }
+
+  _data = NULL;
+  _size = 0;
+  _mappingHandle = NULL;
+  _fileHandle = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::open(const std::string& file) {
+  close();
+
+  int fd = ::open(file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  // The mapping stays valid after the descriptor is closed
+  void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  _data = static_cast<const char*>(data);
+  _size = static_cast<unsigned long long>(info.st_size);
+  return true;
+}
+
+void MappedFile::close() {
+  if (_data) {
+    munmap(const_cast<char*>(_data), _size);
+  }
+
+  _data = NULL;
+  _size = 0;
+}
+
+#endif
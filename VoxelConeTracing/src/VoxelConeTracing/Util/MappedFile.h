@@ -0,0 +1,69 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#ifndef VCT_SRC_VCT_MAPPEDFILE_H_
+#define VCT_SRC_VCT_MAPPEDFILE_H_
+
+#include <string>
+
+#include "KoRE/Common.h"
+
+/*! Read-only memory mapping of a whole file. The pages are read by the OS
+*   on first access, so opening is cheap and the data is never copied into
+*   the process heap. Used for the binary caches of previous runs.
+*/
+class MappedFile {
+public:
+  MappedFile();
+  ~MappedFile();
+
+  /// Returns false if the file doesn't exist, is empty or can't be mapped.
+  bool open(const std::string& file);
+  void close();
+
+  inline bool isOpen() const {return _data != NULL;}
+  inline const char* getData() const {return _data;}
+  inline unsigned long long getSize() const {return _size;}
+
+  /// Size and last modification time of a file. Returns false if the file
+  /// doesn't exist.
+  static bool getFileStamp(const std::string& file,
+                           unsigned long long* size,
+                           unsigned long long* modifiedTime);
+
+private:
+  // Not copyable, the mapping is released in the destructor
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  const char* _data;
+  unsigned long long _size;
+#ifdef _WIN32
+  void* _fileHandle;
+  void* _mappingHandle;
+#endif
+};
+
+#endif  // VCT_SRC_VCT_MAPPEDFILE_H_
@@ -0,0 +1,156 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#include "VoxelConeTracing/Util/SVOdump.h"
+#include "VoxelConeTracing/Util/SVOdumpFormat.h"
+
+#include <fstream>
+#include <string.h>
+
+#include "KoRE/RenderManager.h"
+#include "KoRE/Log.h"
+
+// Have to match ENodePoolAttributes and EBrickPoolAttributes
+static const char* NODEPOOL_ATTRIBUTE_NAMES[NODEPOOL_ATTRIBUTES_NUM] = {
+  "next", "color", "normal",
+  "neighbour_x", "neighbour_neg_x",
+  "neighbour_y", "neighbour_neg_y",
+  "neighbour_z", "neighbour_neg_z"
+};
+
+static const char* BRICKPOOL_ATTRIBUTE_NAMES[BRICKPOOL_ATTRIBUTES_NUM] = {
+  "color",
+  "color_x", "color_x_neg",
+  "color_y", "color_y_neg",
+  "color_z", "color_z_neg",
+  "irradiance", "normal", "irradiance_display"
+};
+
+uint SVOdump::readAtomicCounter(kore::IndexedBuffer* buffer) {
+  GLuint value = 0;
+  kore::RenderManager::getInstance()->bindBuffer(GL_ATOMIC_COUNTER_BUFFER,
+                                                 buffer->getHandle());
+  glGetBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &value);
+  return value;
+}
+
+bool SVOdump::write(VCTscene* vctScene, const std::string& file) {
+  kore::RenderManager* renderMgr = kore::RenderManager::getInstance();
+  NodePool* nodePool = vctScene->getNodePool();
+  BrickPool* brickPool = vctScene->getBrickPool();
+
+  std::ofstream out(file.c_str(), std::ios::out | std::ios::binary);
+  if (!out.is_open()) {
+    kore::Log::getInstance()->write("[ERROR] Could not write SVO dump %s\n",
+                                    file.c_str());
+    return false;
+  }
+
+  // Make all shader writes visible to the read back below
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT |
+                  GL_TEXTURE_UPDATE_BARRIER_BIT |
+                  GL_ATOMIC_COUNTER_BARRIER_BIT);
+
+  uint leafResolution = brickPool->getBrickPoolResolution_leaf();
+  uint nodeResolution = brickPool->getBrickPoolResolution_nodes();
+
+  SSVOdumpHeader header;
+  header.magic = SVODUMP_MAGIC;
+  header.version = SVODUMP_VERSION;
+  header.numLevels = nodePool->getNumLevels();
+  header.numNodes = nodePool->getNumNodes();
+  header.numAllocatedNodes = glm::min(header.numNodes,
+    1 + 8 * readAtomicCounter(nodePool->getAcNodePoolNextFree()));
+  header.numNodeAttributes = NODEPOOL_ATTRIBUTES_NUM;
+  header.brickPoolResolution = leafResolution;
+  header.numAllocatedBricks = readAtomicCounter(brickPool->getAcNextFree());
+  header.numBrickAttributes = BRICKPOOL_ATTRIBUTES_NUM;
+  const glm::vec3& gridCenter = vctScene->getVoxelGridCenter();
+  header.voxelGridCenter[0] = gridCenter.x;
+  header.voxelGridCenter[1] = gridCenter.y;
+  header.voxelGridCenter[2] = gridCenter.z;
+  out.write((const char*) &header, sizeof(SSVOdumpHeader));
+
+  std::vector<uint> levelAddresses(header.numLevels);
+  renderMgr->bindBuffer(GL_TEXTURE_BUFFER,
+                        nodePool->getLevelAddressBuffer()->getBufferHandle());
+  glGetBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(uint) * header.numLevels,
+                     &levelAddresses[0]);
+  out.write((const char*) &levelAddresses[0], sizeof(uint) * header.numLevels);
+
+  // Node pool, only the allocated part
+  std::vector<uint> values(header.numAllocatedNodes);
+  for (uint i = 0; i < NODEPOOL_ATTRIBUTES_NUM; ++i) {
+    SSVOdumpPool pool;
+    memset(&pool, 0, sizeof(SSVOdumpPool));
+    strncpy(pool.name, NODEPOOL_ATTRIBUTE_NAMES[i], SVODUMP_NAME_LENGTH - 1);
+    pool.byteSize = sizeof(uint) * header.numNodes;
+    pool.hasData = 1;
+    out.write((const char*) &pool, sizeof(SSVOdumpPool));
+
+    kore::TextureBuffer* buffer =
+      nodePool->getNodePool(static_cast<ENodePoolAttributes>(i));
+    renderMgr->bindBuffer(GL_TEXTURE_BUFFER, buffer->getBufferHandle());
+    glGetBufferSubData(GL_TEXTURE_BUFFER, 0,
+                       sizeof(uint) * header.numAllocatedNodes, &values[0]);
+    out.write((const char*) &values[0],
+              sizeof(uint) * header.numAllocatedNodes);
+  }
+
+  // Brick pools. Only the leaf-resolution color, normal and displayed
+  // irradiance pools are dumped, the others are just listed with their size.
+  std::vector<uint> texels;
+  for (uint i = 0; i < BRICKPOOL_ATTRIBUTES_NUM; ++i) {
+    EBrickPoolAttributes eAttribute = static_cast<EBrickPoolAttributes>(i);
+    bool isNodeResolution = eAttribute >= BRICKPOOL_COLOR_X &&
+                            eAttribute <= BRICKPOOL_COLOR_Z_NEG;
+
+    SSVOdumpPool pool;
+    memset(&pool, 0, sizeof(SSVOdumpPool));
+    strncpy(pool.name, BRICKPOOL_ATTRIBUTE_NAMES[i], SVODUMP_NAME_LENGTH - 1);
+    pool.resolution = isNodeResolution ? nodeResolution : leafResolution;
+    pool.byteSize = 4 * pool.resolution * pool.resolution * pool.resolution;
+    pool.hasData = eAttribute == BRICKPOOL_COLOR ||
+                   eAttribute == BRICKPOOL_NORMAL ||
+                   eAttribute == BRICKPOOL_IRRADIANCE_DISPLAY;
+    out.write((const char*) &pool, sizeof(SSVOdumpPool));
+
+    if (!pool.hasData) {
+      continue;
+    }
+
+    texels.resize(pool.resolution * pool.resolution * pool.resolution);
+    renderMgr->bindTexture(GL_TEXTURE_3D,
+                           brickPool->getBrickPoolTex(eAttribute)->getHandle());
+    glGetTexImage(GL_TEXTURE_3D, 0, GL_RGBA, GL_UNSIGNED_BYTE, &texels[0]);
+    renderMgr->bindTexture(GL_TEXTURE_3D, 0);
+    out.write((const char*) &texels[0], pool.byteSize);
+  }
+
+  kore::Log::getInstance()->write(
+    "[DEBUG] Wrote SVO dump %s (%u nodes, %u bricks)\n", file.c_str(),
+    header.numAllocatedNodes, header.numAllocatedBricks);
+  return true;
+}
@@ -0,0 +1,47 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#ifndef VCT_SRC_VCT_SVODUMP_H_
+#define VCT_SRC_VCT_SVODUMP_H_
+
+#include <string>
+
+#include "KoRE/Common.h"
+#include "VoxelConeTracing/Scene/VCTscene.h"
+
+/*! Writes the node pool, the level addresses and the leaf brick pools of the
+*   current SVO to a file (see SVOdumpFormat.h) for offline inspection with
+*   the SVOinspect tool and for rendering it with a BrickCache.
+*/
+class SVOdump {
+public:
+  /// Reads back the SVO and writes it to file. Waits for the GPU to finish.
+  static bool write(VCTscene* vctScene, const std::string& file);
+
+private:
+  static uint readAtomicCounter(kore::IndexedBuffer* buffer);
+};
+
+#endif  // VCT_SRC_VCT_SVODUMP_H_
@@ -0,0 +1,69 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#ifndef VCT_SRC_VCT_SVODUMPFORMAT_H_
+#define VCT_SRC_VCT_SVODUMPFORMAT_H_
+
+// Layout of the SVO dumps written by SVOdump and read by the SVOinspect
+// tool. Kept free of KoRE and OpenGL, so the tool builds without them.
+//
+// A dump consists of:
+//   SSVOdumpHeader
+//   unsigned int levelAddress[numLevels]
+//   numNodeAttributes times: SSVOdumpPool, then
+//                            unsigned int values[numAllocatedNodes]
+//   numBrickAttributes times: SSVOdumpPool, then if hasData
+//                             unsigned int rgba8[resolution^3]
+
+static const unsigned int SVODUMP_MAGIC = 0x4F565356;  // "VSVO"
+static const unsigned int SVODUMP_VERSION = 2;
+static const unsigned int SVODUMP_NAME_LENGTH = 32;
+
+// Node flags, see _utilityFunctions.shader
+static const unsigned int SVODUMP_NODE_MASK_VALUE = 0x3FFFFFFF;
+static const unsigned int SVODUMP_NODE_MASK_TAG = 0x80000000;
+static const unsigned int SVODUMP_NODE_MASK_BRICK = 0x40000000;
+
+struct SSVOdumpHeader {
+  unsigned int magic;
+  unsigned int version;
+  unsigned int numLevels;
+  unsigned int numNodes;  // Capacity of the node pool
+  unsigned int numAllocatedNodes;  // Root + 8 * allocated tiles
+  unsigned int numNodeAttributes;
+  unsigned int brickPoolResolution;  // Leaf brick pool, in texels per axis
+  unsigned int numAllocatedBricks;
+  unsigned int numBrickAttributes;
+  float voxelGridCenter[3];  // World space, the grid follows the camera
+};
+
+struct SSVOdumpPool {
+  char name[SVODUMP_NAME_LENGTH];
+  unsigned int resolution;  // Texels per axis, 0 for node attributes
+  unsigned int byteSize;  // Allocated GPU memory of the attribute
+  unsigned int hasData;
+};
+
+#endif  // VCT_SRC_VCT_SVODUMPFORMAT_H_
@@ -0,0 +1,99 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#include "VoxelConeTracing/Util/ShaderProgramCache.h"
+
+#include "KoRE/Timer.h"
+
+ShaderProgramCache::ShaderProgramCache() :
+  _sharingEnabled(true),
+  _numCompiled(0),
+  _numShared(0),
+  _compileTimeMS(0.0) {
+}
+
+ShaderProgramCache::~ShaderProgramCache() {
+  // The GL-context is gone when the static instance is destroyed, so the
+  // programs have to be deleted through release() beforehand.
+}
+
+void ShaderProgramCache::release() {
+  std::map<std::string, kore::ShaderProgram*>::iterator it;
+  for (it = _programs.begin(); it != _programs.end(); ++it) {
+    delete it->second;
+  }
+
+  for (uint i = 0; i < _vUnsharedPrograms.size(); ++i) {
+    delete _vUnsharedPrograms[i];
+  }
+
+  _programs.clear();
+  _vUnsharedPrograms.clear();
+}
+
+double ShaderProgramCache::getSavedTimeMS() const {
+  if (_numCompiled == 0) {
+    return 0.0;
+  }
+  return _numShared * (_compileTimeMS / _numCompiled);
+}
+
+kore::ShaderProgram*
+  ShaderProgramCache::getProgram(const std::string& name,
+                                 const std::string& file,
+                                 GLenum shaderType,
+                                 const std::string& defines) {
+  std::string key = file + "|" + std::to_string((unsigned long long) shaderType) + "|" + defines;
+
+  if (_sharingEnabled) {
+    std::map<std::string, kore::ShaderProgram*>::iterator it =
+                                                          _programs.find(key);
+    if (it != _programs.end()) {
+      ++_numShared;
+      return it->second;
+    }
+  }
+
+  kore::Timer compileTimer;
+  compileTimer.start();
+
+  kore::ShaderProgram* program = new kore::ShaderProgram;
+  program->loadShader(file, shaderType, defines);
+  program->setName(name);
+  program->init();
+  ++_numCompiled;
+
+  // Waits for the driver, as it may compile and link asynchronously
+  glFinish();
+  _compileTimeMS += compileTimer.timeSinceLastCall() * 1000.0;
+
+  if (_sharingEnabled) {
+    _programs[key] = program;
+  } else {
+    _vUnsharedPrograms.push_back(program);
+  }
+
+  return program;
+}
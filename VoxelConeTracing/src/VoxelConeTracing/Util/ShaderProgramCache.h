@@ -0,0 +1,85 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#ifndef VCT_SRC_VCT_SHADERPROGRAMCACHE_H_
+#define VCT_SRC_VCT_SHADERPROGRAMCACHE_H_
+
+#include <map>
+#include <vector>
+#include <string>
+#include "KoRE/Common.h"
+#include "KoRE/ShaderProgram.h"
+
+/*! Shares identical shader programs between passes. Many passes are created
+*   once per octree level and brick pool attribute but use the same shader
+*   source and defines. Programs are keyed by source file, shader stage and
+*   defines; the included files are implied by the source file.
+*   The time spent compiling is measured, so the time saved by sharing
+*   can be reported after setup.
+*/
+class ShaderProgramCache {
+public:
+  inline static ShaderProgramCache* getInstance()
+    {static ShaderProgramCache instance; return &instance;}
+
+  ~ShaderProgramCache();
+
+  /// Deletes all programs. Has to be called while the GL-context still
+  /// exists.
+  void release();
+
+  /// Returns the program built from file and defines. It is only compiled
+  /// if no identical program has been requested before. The cache keeps
+  /// ownership of the program.
+  kore::ShaderProgram* getProgram(const std::string& name,
+                                  const std::string& file,
+                                  GLenum shaderType,
+                                  const std::string& defines = "");
+
+  /// If disabled, each request compiles a new program (for comparison).
+  inline void setSharingEnabled(bool enabled) {_sharingEnabled = enabled;}
+
+  inline uint getNumCompiled() const {return _numCompiled;}
+  inline uint getNumShared() const {return _numShared;}
+
+  /// CPU-time spent compiling and linking programs
+  inline double getCompileTimeMS() const {return _compileTimeMS;}
+
+  /// Compile time the shared requests would have cost, estimated from the
+  /// average compile time of the compiled programs.
+  double getSavedTimeMS() const;
+
+private:
+  ShaderProgramCache();
+
+  std::map<std::string, kore::ShaderProgram*> _programs;
+  std::vector<kore::ShaderProgram*> _vUnsharedPrograms;
+  bool _sharingEnabled;
+  uint _numCompiled;
+  uint _numShared;
+  double _compileTimeMS;
+};
+
+#endif  // VCT_SRC_VCT_SHADERPROGRAMCACHE_H_
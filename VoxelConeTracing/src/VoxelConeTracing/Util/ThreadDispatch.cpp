@@ -0,0 +1,89 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#include "VoxelConeTracing/Util/ThreadDispatch.h"
+
+#include <cstddef>
+#include <functional>
+#include "KoRE/Operations/Operations.h"
+#include "KoRE/Operations/FunctionOp.h"
+
+void SDrawArraysIndirectCommand::setNumThreads(uint numThreads) {
+  numVertices = numThreads;
+  numPrimitives = 1;
+
+  // Large thread counts are spread over the y-dimension, as only
+  // MAX_DISPATCH_GROUPS groups are guaranteed per dimension.
+  uint numGroups = (numThreads + THREAD_GROUP_SIZE - 1) / THREAD_GROUP_SIZE;
+  numGroupsX = numGroups < MAX_DISPATCH_GROUPS ? numGroups : MAX_DISPATCH_GROUPS;
+  numGroupsY = numGroupsX > 0 ? (numGroups + numGroupsX - 1) / numGroupsX : 1;
+  numGroupsZ = 1;
+}
+
+GLenum ThreadDispatch::getShaderType(bool useComputeShaders) {
+  return useComputeShaders ? GL_COMPUTE_SHADER : GL_VERTEX_SHADER;
+}
+
+std::string ThreadDispatch::getShaderDefines(bool useComputeShaders) {
+  std::string defines =
+    std::string("#define THREAD_GROUP_SIZE ")
+    + std::to_string(THREAD_GROUP_SIZE) + std::string("\n")
+    + std::string("#define MAX_DISPATCH_GROUPS ")
+    + std::to_string(MAX_DISPATCH_GROUPS) + std::string("\n")
+    + std::string("#define THREAD_CMD_BINDING ")
+    + std::to_string(THREAD_CMD_BINDING) + std::string("\n");
+
+  if (useComputeShaders) {
+    defines += std::string("#define COMPUTE_SHADER_PATH\n");
+  }
+
+  return defines;
+}
+
+void ThreadDispatch::addLaunchOperations(kore::ShaderProgramPass* pass,
+                                         GLuint indirectBuffer,
+                                         bool useComputeShaders) {
+  using namespace kore;
+
+  if (useComputeShaders) {
+    pass->addStartupOperation(
+      new FunctionOp(std::bind(&ThreadDispatch::dispatchIndirect,
+                               indirectBuffer)));
+  } else {
+    pass->addStartupOperation(
+      new BindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer));
+    pass->addStartupOperation(
+      new ColorMaskOp(glm::bvec4(false, false, false, false)));
+    pass->addStartupOperation(new DrawIndirectOp(GL_POINTS, 0));
+  }
+}
+
+void ThreadDispatch::dispatchIndirect(GLuint indirectBuffer) {
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, THREAD_CMD_BINDING,
+                   indirectBuffer);
+  glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, indirectBuffer);
+  glDispatchComputeIndirect(
+    offsetof(SDrawArraysIndirectCommand, numGroupsX));
+}
@@ -0,0 +1,96 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#ifndef VCT_SRC_VCT_THREADDISPATCH_H_
+#define VCT_SRC_VCT_THREADDISPATCH_H_
+
+#include <string>
+#include "KoRE/Common.h"
+#include "KoRE/Passes/ShaderProgramPass.h"
+
+// Invocations per compute workgroup of the thread-per-item kernels
+#define THREAD_GROUP_SIZE 64
+
+// Shader storage binding at which the kernels find their command buffer
+#define THREAD_CMD_BINDING 7
+
+// Max. number of workgroups in one dispatch dimension guaranteed by GL
+#define MAX_DISPATCH_GROUPS 65535
+
+/*! Command buffer layout used for all thread-per-item passes. The first four
+*   uints are the glDrawArraysIndirect-arguments (one point per thread), the
+*   following three the glDispatchComputeIndirect-arguments for the same
+*   number of threads. Both are kept in sync by setNumThreads() on the CPU and
+*   by ModifyIndirectBufferPass on the GPU.
+*/
+struct SDrawArraysIndirectCommand {
+  SDrawArraysIndirectCommand() :
+    numVertices(0),
+    numPrimitives(0),
+    firstVertexIdx(0),
+    baseInstanceIdx(0),
+    numGroupsX(0),
+    numGroupsY(1),
+    numGroupsZ(1),
+    padding(0) {}
+
+  void setNumThreads(uint numThreads);
+
+  uint numVertices;
+  uint numPrimitives;
+  uint firstVertexIdx;
+  uint baseInstanceIdx;
+
+  uint numGroupsX;
+  uint numGroupsY;
+  uint numGroupsZ;
+  uint padding;
+};
+
+/*! Launches the threads of a thread-per-item pass either as points with a
+*   vertex shader (glDrawArraysIndirect) or as a compute shader
+*   (glDispatchComputeIndirect). The shaders include _threadIndex.shader to
+*   work in both configurations.
+*/
+class ThreadDispatch {
+public:
+  /// Returns the shader stage the kernels are compiled for
+  static GLenum getShaderType(bool useComputeShaders);
+
+  /// Returns the defines the kernels need in the given configuration
+  static std::string getShaderDefines(bool useComputeShaders);
+
+  /// Adds the operations that launch one thread per item described in the
+  /// command buffer indirectBuffer. Call this after all other bindings.
+  static void addLaunchOperations(kore::ShaderProgramPass* pass,
+                                  GLuint indirectBuffer,
+                                  bool useComputeShaders);
+
+  /// Dispatches the compute kernel with the arguments in indirectBuffer.
+  /// The buffer is also bound as shader storage to bound-check the threads.
+  static void dispatchIndirect(GLuint indirectBuffer);
+};
+
+#endif  // VCT_SRC_VCT_THREADDISPATCH_H_
@@ -0,0 +1,130 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+#include "VoxelConeTracing/Util/ThreadPool.h"
+
+ThreadPool::ThreadPool()
+  : _task(NULL),
+    _numTasks(0),
+    _nextTask(0),
+    _numBusyWorkers(0),
+    _jobID(0),
+    _quit(false) {
+}
+
+ThreadPool::~ThreadPool() {
+  shutdown();
+}
+
+void ThreadPool::init(uint numWorkers) {
+  if (!_vWorkers.empty()) {
+    return;
+  }
+
+  if (numWorkers == 0) {
+    uint numHardwareThreads = std::thread::hardware_concurrency();
+    numWorkers = numHardwareThreads > 1 ? numHardwareThreads - 1 : 0;
+  }
+
+  _quit = false;
+  for (uint i = 0; i < numWorkers; ++i) {
+    _vWorkers.push_back(std::thread(&ThreadPool::workerLoop, this));
+  }
+}
+
+void ThreadPool::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _quit = true;
+  }
+  _wakeCondition.notify_all();
+
+  for (uint i = 0; i < _vWorkers.size(); ++i) {
+    _vWorkers[i].join();
+  }
+  _vWorkers.clear();
+}
+
+void ThreadPool::run(uint numTasks, const std::function<void(uint)>& task) {
+  if (numTasks == 0) {
+    return;
+  }
+
+  if (_vWorkers.empty() || numTasks == 1) {
+    for (uint i = 0; i < numTasks; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _task = &task;
+    _numTasks = numTasks;
+    _nextTask.store(0);
+    _numBusyWorkers = _vWorkers.size();
+    ++_jobID;
+  }
+  _wakeCondition.notify_all();
+
+  executeTasks();
+
+  // The workers still reference the job until they are done
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (_numBusyWorkers > 0) {
+    _doneCondition.wait(lock);
+  }
+  _task = NULL;
+}
+
+void ThreadPool::executeTasks() {
+  for (uint i = _nextTask++; i < _numTasks; i = _nextTask++) {
+    (*_task)(i);
+  }
+}
+
+void ThreadPool::workerLoop() {
+  uint lastJobID = 0;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      while (!_quit && _jobID == lastJobID) {
+        _wakeCondition.wait(lock);
+      }
+
+      if (_quit) {
+        return;
+      }
+      lastJobID = _jobID;
+    }
+
+    executeTasks();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (--_numBusyWorkers == 0) {
+      _doneCondition.notify_one();
+    }
+  }
+}
@@ -0,0 +1,87 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+#ifndef VCT_SRC_VCT_THREADPOOL_H_
+#define VCT_SRC_VCT_THREADPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "KoRE/Common.h"
+
+/*! Fixed set of worker threads for short, data-parallel CPU jobs of the
+*   render thread (e.g. the frustum culling). run() blocks until all tasks
+*   of the job are done, the calling thread works on them as well.
+*
+*   Only one thread may call run() at a time.
+*/
+class ThreadPool {
+public:
+  inline static ThreadPool* getInstance() {
+    static ThreadPool instance;
+    return &instance;
+  }
+
+  /// Starts numWorkers threads, one less than the hardware threads if 0.
+  void init(uint numWorkers = 0);
+
+  /// Calls task(i) for every i in [0, numTasks) and returns once all calls
+  /// returned. The tasks are distributed dynamically, so they should be
+  /// many more than threads if their cost varies.
+  void run(uint numTasks, const std::function<void(uint)>& task);
+
+  /// Worker threads plus the calling thread
+  inline uint getNumThreads() const {return _vWorkers.size() + 1;}
+
+  /// Stops the worker threads. Has to be called before exit.
+  void shutdown();
+
+private:
+  ThreadPool();
+  ~ThreadPool();
+
+  void workerLoop();
+  void executeTasks();
+
+  std::vector<std::thread> _vWorkers;
+
+  std::mutex _mutex;
+  std::condition_variable _wakeCondition;
+  std::condition_variable _doneCondition;
+
+  // The current job, only changed by run() while no worker is busy
+  const std::function<void(uint)>* _task;
+  uint _numTasks;
+  std::atomic<uint> _nextTask;
+
+  uint _numBusyWorkers;
+  uint _jobID;
+  bool _quit;
+};
+
+#endif  // VCT_SRC_VCT_THREADPOOL_H_
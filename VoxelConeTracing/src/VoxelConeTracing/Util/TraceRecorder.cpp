@@ -0,0 +1,269 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#include "VoxelConeTracing/Util/TraceRecorder.h"
+
+#include <fstream>
+#include <iomanip>
+
+#include "KoRE/Log.h"
+
+static std::string escapeJSON(const std::string& str) {
+  std::string escaped;
+  for (uint i = 0; i < str.size(); ++i) {
+    if (str[i] == '"' || str[i] == '\\') {
+      escaped += '\\';
+    }
+    escaped += str[i];
+  }
+  return escaped;
+}
+
+TraceRecorder::TraceRecorder()
+  : _firstFrame(0),
+    _lastFrame(0),
+    _capturing(false),
+    _frameCaptured(false),
+    _frameIndex(0),
+    _frameStartMS(0.0),
+    _gpuBaseNS(0),
+    _cpuBaseMS(0.0) {
+}
+
+TraceRecorder::~TraceRecorder() {
+}
+
+void TraceRecorder::addStage(kore::FrameBufferStage* stage,
+                             const std::string& name) {
+  SStage entry;
+  entry.stage = stage;
+  entry.name = name;
+  _vStages.push_back(entry);
+}
+
+void TraceRecorder::capture(uint firstFrame, uint numFrames,
+                            const std::string& file) {
+  if (!Instrumentation::TIMING) {
+    return;
+  }
+
+  if (_capturing) {
+    kore::Log::getInstance()->write(
+      "[WARNING] A trace is already being captured, ignoring %s\n",
+      file.c_str());
+    return;
+  }
+
+  if (numFrames == 0) {
+    return;
+  }
+
+  _file = file;
+  _firstFrame = firstFrame;
+  _lastFrame = firstFrame + numFrames - 1;
+  _capturing = true;
+  _frameCaptured = false;
+  _vEvents.clear();
+
+  GPUprofiler::getInstance()->setFrameTimingsCallback(
+    std::bind(&TraceRecorder::onFrameTimings, this,
+              std::placeholders::_1, std::placeholders::_2));
+}
+
+void TraceRecorder::captureNext(uint numFrames, const std::string& file) {
+  capture(GPUprofiler::getInstance()->getNextFrameIndex(), numFrames, file);
+}
+
+void TraceRecorder::beginFrame() {
+  if (!_capturing) {
+    return;
+  }
+
+  GPUprofiler* profiler = GPUprofiler::getInstance();
+  double nowMS = profiler->getCPUtimeMS();
+
+  if (_frameCaptured) {
+    addEvent("Frame " + std::to_string(_frameIndex),
+             TRACK_CPU, _frameStartMS, nowMS);
+    _frameCaptured = false;
+  }
+  _vZoneStack.clear();
+
+  _frameIndex = profiler->getNextFrameIndex();
+  if (_frameIndex < _firstFrame || _frameIndex > _lastFrame) {
+    return;
+  }
+
+  if (_frameIndex == _firstFrame) {
+    // The GL time is taken once all previous commands reached the GPU, so
+    // the tracks are aligned up to the latency of the command queue.
+    glGetInteger64v(GL_TIMESTAMP, &_gpuBaseNS);
+    _cpuBaseMS = profiler->getCPUtimeMS();
+  }
+
+  profiler->requestFullFrame();
+  _frameCaptured = true;
+  _frameStartMS = nowMS;
+}
+
+void TraceRecorder::pushZone(const char* name) {
+  SZone zone;
+  zone.name = name;
+  zone.startMS = GPUprofiler::getInstance()->getCPUtimeMS();
+  _vZoneStack.push_back(zone);
+}
+
+void TraceRecorder::popZone() {
+  if (_vZoneStack.empty()) {
+    return;
+  }
+
+  const SZone& zone = _vZoneStack.back();
+  addEvent(zone.name, TRACK_CPU, zone.startMS,
+           GPUprofiler::getInstance()->getCPUtimeMS());
+  _vZoneStack.pop_back();
+}
+
+void TraceRecorder::addEvent(const std::string& name, ETrack track,
+                             double startMS, double endMS) {
+  SEvent evt;
+  evt.name = name;
+  evt.track = track;
+  evt.startMS = startMS;
+  evt.durationMS = endMS - startMS;
+  _vEvents.push_back(evt);
+}
+
+double TraceRecorder::gpuToCPUtimeMS(GLuint64 gpuNS) const {
+  GLint64 sinceBaseNS = static_cast<GLint64>(gpuNS) - _gpuBaseNS;
+  return _cpuBaseMS + static_cast<double>(sinceBaseNS) / 1000000.0;
+}
+
+int TraceRecorder::findStage(const kore::ShaderProgramPass* pass) const {
+  for (uint iStage = 0; iStage < _vStages.size(); ++iStage) {
+    std::vector<kore::ShaderProgramPass*>& vPasses =
+      _vStages[iStage].stage->getShaderProgramPasses();
+    for (uint iPass = 0; iPass < vPasses.size(); ++iPass) {
+      if (vPasses[iPass] == pass) {
+        return iStage;
+      }
+    }
+  }
+  return -1;
+}
+
+void TraceRecorder::onFrameTimings(uint frameIndex,
+                                   const std::vector<SPassTiming>& vTimings) {
+  if (!_capturing || frameIndex < _firstFrame) {
+    return;
+  }
+
+  if (frameIndex <= _lastFrame) {
+    // Spans of the stages on both tracks: cpuStart, cpuEnd, gpuStart, gpuEnd
+    std::vector<glm::dvec4> vStageSpans(_vStages.size(),
+                                        glm::dvec4(-1.0));
+    for (uint i = 0; i < vTimings.size(); ++i) {
+      const SPassTiming& timing = vTimings[i];
+      double gpuStartMS = gpuToCPUtimeMS(timing.gpuStartNS);
+      double gpuEndMS = gpuToCPUtimeMS(timing.gpuEndNS);
+
+      const std::string& name = timing.pass->getName();
+      addEvent(name, TRACK_CPU, timing.cpuStartMS, timing.cpuEndMS);
+      addEvent(name, TRACK_GPU, gpuStartMS, gpuEndMS);
+
+      int stage = findStage(timing.pass);
+      if (stage < 0) {
+        continue;
+      }
+
+      glm::dvec4& span = vStageSpans[stage];
+      if (span.x < 0.0) {
+        span = glm::dvec4(timing.cpuStartMS, timing.cpuEndMS,
+                          gpuStartMS, gpuEndMS);
+      } else {
+        span.x = glm::min(span.x, timing.cpuStartMS);
+        span.y = glm::max(span.y, timing.cpuEndMS);
+        span.z = glm::min(span.z, gpuStartMS);
+        span.w = glm::max(span.w, gpuEndMS);
+      }
+    }
+
+    for (uint iStage = 0; iStage < vStageSpans.size(); ++iStage) {
+      const glm::dvec4& span = vStageSpans[iStage];
+      if (span.x < 0.0) {
+        continue;
+      }
+      addEvent(_vStages[iStage].name, TRACK_CPU, span.x, span.y);
+      addEvent(_vStages[iStage].name, TRACK_GPU, span.z, span.w);
+    }
+  }
+
+  // Frames after the range only arrive if the last one was not sampled
+  if (frameIndex >= _lastFrame) {
+    write();
+    _capturing = false;
+    _frameCaptured = false;
+    _vEvents.clear();
+  }
+}
+
+bool TraceRecorder::write() const {
+  std::ofstream file(_file.c_str());
+  if (!file.is_open()) {
+    kore::Log::getInstance()->write("[ERROR] Could not write trace %s\n",
+                                    _file.c_str());
+    return false;
+  }
+
+  // Timestamps start at the earliest event, in microseconds
+  double originMS = 0.0;
+  for (uint i = 0; i < _vEvents.size(); ++i) {
+    if (i == 0 || _vEvents[i].startMS < originMS) {
+      originMS = _vEvents[i].startMS;
+    }
+  }
+
+  file << std::fixed << std::setprecision(3);
+  file << "{\"traceEvents\":[\n";
+  file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+       << TRACK_CPU << ",\"args\":{\"name\":\"CPU\"}},\n";
+  file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+       << TRACK_GPU << ",\"args\":{\"name\":\"GPU\"}}";
+
+  for (uint i = 0; i < _vEvents.size(); ++i) {
+    const SEvent& evt = _vEvents[i];
+    file << ",\n{\"name\":\"" << escapeJSON(evt.name) << "\",\"cat\":\""
+         << (evt.track == TRACK_CPU ? "cpu" : "gpu")
+         << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << evt.track
+         << ",\"ts\":" << (evt.startMS - originMS) * 1000.0
+         << ",\"dur\":" << evt.durationMS * 1000.0 << "}";
+  }
+  file << "\n]}\n";
+
+  kore::Log::getInstance()->write(
+    "[DEBUG] Trace of frames %u to %u written to %s (%u events)\n",
+    _firstFrame, _lastFrame, _file.c_str(), _vEvents.size());
+  return true;
+}
@@ -0,0 +1,134 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+#ifndef VCT_SRC_VCT_TRACERECORDER_H_
+#define VCT_SRC_VCT_TRACERECORDER_H_
+
+#include <string>
+#include <vector>
+
+#include "KoRE/Common.h"
+#include "KoRE/Passes/FrameBufferStage.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
+
+/*! Records a range of frames as a timeline in the Chrome trace-event format
+*   (viewable in chrome://tracing or Perfetto). The CPU track holds the
+*   frames, the zones around main-loop calls and the time spent issuing each
+*   stage and pass; the GPU track holds the execution of the stages and
+*   passes measured by the GPUprofiler. All passes are profiled during a
+*   capture. The file is written once the GPU results of the last captured
+*   frame have arrived. Nothing is recorded below the TIMING instrumentation
+*   level.
+*/
+class TraceRecorder {
+public:
+  inline static TraceRecorder* getInstance() {
+    static TraceRecorder instance;
+    return &instance;
+  }
+
+  /// Names the stage on the timeline. Passes of unnamed stages are recorded
+  /// without a stage.
+  void addStage(kore::FrameBufferStage* stage, const std::string& name);
+
+  /// Captures numFrames frames starting with frame firstFrame (as counted by
+  /// the GPUprofiler) into file.
+  void capture(uint firstFrame, uint numFrames, const std::string& file);
+
+  /// Captures numFrames frames starting with the next one.
+  void captureNext(uint numFrames, const std::string& file);
+
+  inline bool isCapturing() const {return _capturing;}
+
+  /// Has to be called once per frame before GPUprofiler::beginFrame().
+  void beginFrame();
+
+  /// Records a CPU-zone in a captured frame. Zones have to be nested.
+  inline void beginZone(const char* name) {
+    if (Instrumentation::TIMING && _frameCaptured) {
+      pushZone(name);
+    }
+  }
+
+  inline void endZone() {
+    if (Instrumentation::TIMING && _frameCaptured) {
+      popZone();
+    }
+  }
+
+private:
+  TraceRecorder();
+  ~TraceRecorder();
+
+  enum ETrack {
+    TRACK_CPU = 1,
+    TRACK_GPU
+  };
+
+  struct SEvent {
+    std::string name;
+    ETrack track;
+    double startMS;
+    double durationMS;
+  };
+
+  struct SZone {
+    const char* name;
+    double startMS;
+  };
+
+  struct SStage {
+    kore::FrameBufferStage* stage;
+    std::string name;
+  };
+
+  void pushZone(const char* name);
+  void popZone();
+  void addEvent(const std::string& name, ETrack track,
+                double startMS, double endMS);
+  void onFrameTimings(uint frameIndex,
+                      const std::vector<SPassTiming>& vTimings);
+  double gpuToCPUtimeMS(GLuint64 gpuNS) const;
+  int findStage(const kore::ShaderProgramPass* pass) const;
+  bool write() const;
+
+  std::vector<SStage> _vStages;
+  std::vector<SEvent> _vEvents;
+  std::vector<SZone> _vZoneStack;
+
+  std::string _file;
+  uint _firstFrame;
+  uint _lastFrame;
+  bool _capturing;
+  bool _frameCaptured;
+  uint _frameIndex;
+  double _frameStartMS;
+
+  // GPU-timestamp and CPU-time at the same moment, to align the tracks
+  GLint64 _gpuBaseNS;
+  double _cpuBaseMS;
+};
+
+#endif  // VCT_SRC_VCT_TRACERECORDER_H_
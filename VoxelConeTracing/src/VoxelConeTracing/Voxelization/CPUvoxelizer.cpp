@@ -0,0 +1,464 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+#include "VoxelConeTracing/Voxelization/CPUvoxelizer.h"
+
+#include <algorithm>
+#include <functional>
+#include <emmintrin.h>
+
+#include "VoxelConeTracing/Util/ThreadPool.h"
+
+// Triangles per setup and binning task
+static const uint CHUNK_SIZE = 4096;
+
+static inline uint packRGBA8(const glm::vec4& value) {
+  // Truncated like convVec4ToRGBA8() in voxelizeFrag.shader
+  return (static_cast<uint>(value.w) & 0xFF) << 24
+       | (static_cast<uint>(value.z) & 0xFF) << 16
+       | (static_cast<uint>(value.y) & 0xFF) << 8
+       | (static_cast<uint>(value.x) & 0xFF);
+}
+
+static inline glm::vec4 unpackRGBA8(uint value) {
+  return glm::vec4(static_cast<float>(value & 0xFF),
+                   static_cast<float>((value >> 8) & 0xFF),
+                   static_cast<float>((value >> 16) & 0xFF),
+                   static_cast<float>((value >> 24) & 0xFF));
+}
+
+static inline int wrap(int i, int n) {
+  return ((i % n) + n) % n;
+}
+
+// Bilinear with GL_REPEAT, in [0, 1]. White without a texture.
+static glm::vec4 sampleTexture(const SVoxelizerTexture* texture,
+                               float s, float t) {
+  if (!texture || !texture->texels || !texture->width || !texture->height) {
+    return glm::vec4(1.0f);
+  }
+
+  int w = static_cast<int>(texture->width);
+  int h = static_cast<int>(texture->height);
+  float x = s * w - 0.5f;
+  float y = t * h - 0.5f;
+  float fx = floorf(x);
+  float fy = floorf(y);
+  float ax = x - fx;
+  float ay = y - fy;
+
+  int x0 = wrap(static_cast<int>(fx), w);
+  int y0 = wrap(static_cast<int>(fy), h);
+  int x1 = wrap(x0 + 1, w);
+  int y1 = wrap(y0 + 1, h);
+
+  const uint* texels = texture->texels;
+  glm::vec4 bottom = unpackRGBA8(texels[y0 * w + x0]) * (1.0f - ax)
+                   + unpackRGBA8(texels[y0 * w + x1]) * ax;
+  glm::vec4 top = unpackRGBA8(texels[y1 * w + x0]) * (1.0f - ax)
+                + unpackRGBA8(texels[y1 * w + x1]) * ax;
+  return (bottom * (1.0f - ay) + top * ay) * (1.0f / 255.0f);
+}
+
+CPUvoxelizer::CPUvoxelizer()
+  : _vMeshes(NULL),
+    _resolution(0),
+    _numTilesPerAxis(0) {
+}
+
+CPUvoxelizer::~CPUvoxelizer() {
+}
+
+uint CPUvoxelizer::packXYZ10(uint x, uint y, uint z) {
+  // Like vec3ToUintXYZ10() in voxelizeFrag.shader
+  return (z & 0x3FF) << 20 | (y & 0x3FF) << 10 | (x & 0x3FF);
+}
+
+void CPUvoxelizer::unpackXYZ10(uint packed, uint& x, uint& y, uint& z) {
+  x = packed & 0x3FF;
+  y = (packed >> 10) & 0x3FF;
+  z = (packed >> 20) & 0x3FF;
+}
+
+void CPUvoxelizer::voxelize(const std::vector<SVoxelizerMesh>& vMeshes,
+                            const glm::mat4& gridTransformI,
+                            uint resolution) {
+  ThreadPool* threadPool = ThreadPool::getInstance();
+
+  _vMeshes = &vMeshes;
+  _gridTransformI = gridTransformI;
+  _resolution = resolution;
+  _numTilesPerAxis = (resolution + TILE_SIZE - 1) / TILE_SIZE;
+
+  _vMeshFirstTriangles.resize(vMeshes.size() + 1);
+  _vMeshFirstTriangles[0] = 0;
+  for (uint i = 0; i < vMeshes.size(); ++i) {
+    uint numCorners = vMeshes[i].indices ? vMeshes[i].numIndices
+                                         : vMeshes[i].numVertices;
+    _vMeshFirstTriangles[i + 1] = _vMeshFirstTriangles[i] + numCorners / 3;
+  }
+
+  uint numTriangles = _vMeshFirstTriangles.back();
+  uint numChunks = (numTriangles + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  _vTriangles.resize(numTriangles);
+  threadPool->run(numChunks, std::bind(&CPUvoxelizer::setupTriangles, this,
+                                       std::placeholders::_1));
+
+  _vChunkBins.clear();
+  _vChunkBins.resize(numChunks);
+  threadPool->run(numChunks, std::bind(&CPUvoxelizer::binTriangles, this,
+                                       std::placeholders::_1));
+
+  // Counting sort of the (tile, triangle) pairs, keeps the triangle order
+  uint numTiles = _numTilesPerAxis * _numTilesPerAxis * _numTilesPerAxis;
+  _vTileOffsets.assign(numTiles + 1, 0);
+  for (uint c = 0; c < numChunks; ++c) {
+    for (uint i = 0; i < _vChunkBins[c].size(); ++i) {
+      ++_vTileOffsets[_vChunkBins[c][i].first + 1];
+    }
+  }
+  for (uint t = 0; t < numTiles; ++t) {
+    _vTileOffsets[t + 1] += _vTileOffsets[t];
+  }
+
+  std::vector<uint> vTileEnds(_vTileOffsets.begin(), _vTileOffsets.end() - 1);
+  _vTileTriangles.resize(_vTileOffsets.back());
+  for (uint c = 0; c < numChunks; ++c) {
+    for (uint i = 0; i < _vChunkBins[c].size(); ++i) {
+      _vTileTriangles[vTileEnds[_vChunkBins[c][i].first]++] =
+        _vChunkBins[c][i].second;
+    }
+  }
+  _vChunkBins.clear();
+
+  _vTileResults.clear();
+  _vTileResults.resize(numTiles);
+  threadPool->run(numTiles, std::bind(&CPUvoxelizer::voxelizeTile, this,
+                                      std::placeholders::_1));
+
+  uint numFragments = 0;
+  uint numVoxels = 0;
+  for (uint t = 0; t < numTiles; ++t) {
+    numFragments += _vTileResults[t].vFragments.size();
+    numVoxels += _vTileResults[t].vVoxels.size();
+  }
+
+  _vFragmentPositions.clear();
+  _vFragmentPositions.reserve(numFragments);
+  _vVoxelPositions.clear();
+  _vVoxelPositions.reserve(numVoxels);
+  _vVoxelColors.clear();
+  _vVoxelColors.reserve(numVoxels);
+  _vVoxelNormals.clear();
+  _vVoxelNormals.reserve(numVoxels);
+
+  for (uint t = 0; t < numTiles; ++t) {
+    const STileResult& result = _vTileResults[t];
+    _vFragmentPositions.insert(_vFragmentPositions.end(),
+                               result.vFragments.begin(),
+                               result.vFragments.end());
+    _vVoxelPositions.insert(_vVoxelPositions.end(),
+                            result.vVoxels.begin(), result.vVoxels.end());
+    _vVoxelColors.insert(_vVoxelColors.end(),
+                         result.vColors.begin(), result.vColors.end());
+    _vVoxelNormals.insert(_vVoxelNormals.end(),
+                          result.vNormals.begin(), result.vNormals.end());
+  }
+  _vTileResults.clear();
+}
+
+void CPUvoxelizer::setupTriangles(uint chunk) {
+  uint begin = chunk * CHUNK_SIZE;
+  uint end = std::min(begin + CHUNK_SIZE, (uint) _vTriangles.size());
+
+  uint iMesh = std::upper_bound(_vMeshFirstTriangles.begin(),
+                                _vMeshFirstTriangles.end(), begin)
+               - _vMeshFirstTriangles.begin() - 1;
+
+  for (uint t = begin; t < end; ++t) {
+    while (t >= _vMeshFirstTriangles[iMesh + 1]) {
+      ++iMesh;
+    }
+
+    const SVoxelizerMesh& mesh = (*_vMeshes)[iMesh];
+    glm::mat4 toGrid = _gridTransformI * mesh.modelMat;
+    STriangle& tri = _vTriangles[t];
+    tri.texture = &mesh.texture;
+
+    uint firstCorner = (t - _vMeshFirstTriangles[iMesh]) * 3;
+    for (uint i = 0; i < 3; ++i) {
+      uint v = mesh.indices ? mesh.indices[firstCorner + i] : firstCorner + i;
+
+      // Same as posTexSpace in voxelizeGeom.shader, scaled to voxels
+      glm::vec3 gridPos(toGrid * glm::vec4(mesh.positions[v], 1.0f));
+      tri.pos[i] = (gridPos * 0.5f + glm::vec3(0.5f))
+                   * static_cast<float>(_resolution);
+      tri.normal[i] = mesh.normals ? mesh.normalMat * mesh.normals[v]
+                                   : glm::vec3(0.0f);
+      tri.uv[i] = mesh.uvs ? glm::vec2(mesh.uvs[v].x, mesh.uvs[v].y)
+                           : glm::vec2(0.0f);
+    }
+
+    tri.boundsMin = glm::min(tri.pos[0], glm::min(tri.pos[1], tri.pos[2]));
+    tri.boundsMax = glm::max(tri.pos[0], glm::max(tri.pos[1], tri.pos[2]));
+
+    glm::vec3 edges[3] = {tri.pos[1] - tri.pos[0],
+                          tri.pos[2] - tri.pos[1],
+                          tri.pos[0] - tri.pos[2]};
+    glm::vec3 axes[NUM_AXES];
+    axes[0] = glm::cross(edges[0], edges[1]);
+    for (uint i = 0; i < 3; ++i) {
+      glm::vec3 gridAxis(0.0f);
+      gridAxis[i] = 1.0f;
+      for (uint e = 0; e < 3; ++e) {
+        axes[1 + i * 3 + e] = glm::cross(gridAxis, edges[e]);
+      }
+    }
+
+    // Projection interval of the triangle, widened by the projected
+    // half size of a voxel
+    for (uint a = 0; a < NUM_AXES; ++a) {
+      float p0 = glm::dot(axes[a], tri.pos[0]);
+      float p1 = glm::dot(axes[a], tri.pos[1]);
+      float p2 = glm::dot(axes[a], tri.pos[2]);
+      float r = 0.5f * (fabsf(axes[a].x) + fabsf(axes[a].y)
+                        + fabsf(axes[a].z));
+
+      tri.axisX[a] = axes[a].x;
+      tri.axisY[a] = axes[a].y;
+      tri.axisZ[a] = axes[a].z;
+      tri.axisMin[a] = std::min(p0, std::min(p1, p2)) - r;
+      tri.axisMax[a] = std::max(p0, std::max(p1, p2)) + r;
+    }
+
+    glm::vec3 e0 = tri.pos[1] - tri.pos[0];
+    glm::vec3 e1 = tri.pos[2] - tri.pos[0];
+    tri.d00 = glm::dot(e0, e0);
+    tri.d01 = glm::dot(e0, e1);
+    tri.d11 = glm::dot(e1, e1);
+    float denom = tri.d00 * tri.d11 - tri.d01 * tri.d01;
+    tri.invDenom = denom > 0.0f ? 1.0f / denom : 0.0f;
+  }
+}
+
+void CPUvoxelizer::binTriangles(uint chunk) {
+  uint begin = chunk * CHUNK_SIZE;
+  uint end = std::min(begin + CHUNK_SIZE, (uint) _vTriangles.size());
+  std::vector<std::pair<uint, uint> >& vBins = _vChunkBins[chunk];
+
+  float gridSize = static_cast<float>(_resolution);
+  int maxTile = static_cast<int>(_numTilesPerAxis) - 1;
+  float tileSize = static_cast<float>(TILE_SIZE);
+
+  for (uint t = begin; t < end; ++t) {
+    const STriangle& tri = _vTriangles[t];
+    if (tri.boundsMax.x < 0.0f || tri.boundsMax.y < 0.0f
+        || tri.boundsMax.z < 0.0f || tri.boundsMin.x > gridSize
+        || tri.boundsMin.y > gridSize || tri.boundsMin.z > gridSize) {
+      continue;
+    }
+
+    int tileMin[3];
+    int tileMax[3];
+    for (uint i = 0; i < 3; ++i) {
+      tileMin[i] = glm::clamp(static_cast<int>(tri.boundsMin[i] / tileSize),
+                              0, maxTile);
+      tileMax[i] = glm::clamp(static_cast<int>(tri.boundsMax[i] / tileSize),
+                              0, maxTile);
+    }
+
+    for (int z = tileMin[2]; z <= tileMax[2]; ++z) {
+      for (int y = tileMin[1]; y <= tileMax[1]; ++y) {
+        for (int x = tileMin[0]; x <= tileMax[0]; ++x) {
+          // Same axis test as for the voxels, with the tile as box
+          glm::vec3 center = (glm::vec3(static_cast<float>(x),
+                                        static_cast<float>(y),
+                                        static_cast<float>(z))
+                              + glm::vec3(0.5f)) * tileSize;
+          bool overlaps = true;
+          for (uint a = 0; a < NUM_AXES && overlaps; ++a) {
+            float widen = (tileSize - 1.0f) * 0.5f
+              * (fabsf(tri.axisX[a]) + fabsf(tri.axisY[a])
+                 + fabsf(tri.axisZ[a]));
+            float s = tri.axisX[a] * center.x + tri.axisY[a] * center.y
+                    + tri.axisZ[a] * center.z;
+            overlaps = s >= tri.axisMin[a] - widen
+                    && s <= tri.axisMax[a] + widen;
+          }
+
+          if (overlaps) {
+            uint tile = (z * _numTilesPerAxis + y) * _numTilesPerAxis + x;
+            vBins.push_back(std::make_pair(tile, t));
+          }
+        }
+      }
+    }
+  }
+}
+
+void CPUvoxelizer::voxelizeTile(uint tile) {
+  uint begin = _vTileOffsets[tile];
+  uint end = _vTileOffsets[tile + 1];
+  if (begin == end) {
+    return;
+  }
+
+  uint tileCoords[3] = {tile % _numTilesPerAxis,
+                        (tile / _numTilesPerAxis) % _numTilesPerAxis,
+                        tile / (_numTilesPerAxis * _numTilesPerAxis)};
+  int tileMin[3];
+  int tileMax[3];
+  for (uint i = 0; i < 3; ++i) {
+    tileMin[i] = static_cast<int>(tileCoords[i] * TILE_SIZE);
+    tileMax[i] = std::min(tileMin[i] + (int) TILE_SIZE,
+                          (int) _resolution) - 1;
+  }
+
+  // Sums of the attributes, w counts the overlapping triangles
+  std::vector<glm::vec4> vColorSums(TILE_SIZE * TILE_SIZE * TILE_SIZE,
+                                    glm::vec4(0.0f));
+  std::vector<glm::vec4> vNormalSums(vColorSums.size(), glm::vec4(0.0f));
+  std::vector<uint> vTouched;
+
+  STileResult& result = _vTileResults[tile];
+  const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+
+  for (uint i = begin; i < end; ++i) {
+    const STriangle& tri = _vTriangles[_vTileTriangles[i]];
+
+    int voxelMin[3];
+    int voxelMax[3];
+    bool empty = false;
+    for (uint c = 0; c < 3; ++c) {
+      voxelMin[c] = std::max(static_cast<int>(floorf(tri.boundsMin[c])),
+                             tileMin[c]);
+      voxelMax[c] = std::min(static_cast<int>(floorf(tri.boundsMax[c])),
+                             tileMax[c]);
+      empty = empty || voxelMin[c] > voxelMax[c];
+    }
+    if (empty) {
+      continue;
+    }
+
+    __m128 axisX[NUM_AXES];
+    __m128 axisMin[NUM_AXES];
+    __m128 axisMax[NUM_AXES];
+    for (uint a = 0; a < NUM_AXES; ++a) {
+      axisX[a] = _mm_set1_ps(tri.axisX[a]);
+      axisMin[a] = _mm_set1_ps(tri.axisMin[a]);
+      axisMax[a] = _mm_set1_ps(tri.axisMax[a]);
+    }
+
+    for (int z = voxelMin[2]; z <= voxelMax[2]; ++z) {
+      for (int y = voxelMin[1]; y <= voxelMax[1]; ++y) {
+        // Part of dot(axis, center) that is constant along the row
+        __m128 rowOffsets[NUM_AXES];
+        for (uint a = 0; a < NUM_AXES; ++a) {
+          rowOffsets[a] = _mm_set1_ps(tri.axisY[a] * (y + 0.5f)
+                                      + tri.axisZ[a] * (z + 0.5f));
+        }
+
+        for (int x = voxelMin[0]; x <= voxelMax[0]; x += 4) {
+          __m128 centerX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)),
+                                      laneOffsets);
+          __m128 overlaps = _mm_castsi128_ps(_mm_set1_epi32(-1));
+          for (uint a = 0; a < NUM_AXES; ++a) {
+            __m128 s = _mm_add_ps(_mm_mul_ps(axisX[a], centerX),
+                                  rowOffsets[a]);
+            overlaps = _mm_and_ps(overlaps,
+                                  _mm_and_ps(_mm_cmpge_ps(s, axisMin[a]),
+                                             _mm_cmple_ps(s, axisMax[a])));
+          }
+
+          int numLanes = std::min(4, voxelMax[0] - x + 1);
+          int mask = _mm_movemask_ps(overlaps) & ((1 << numLanes) - 1);
+
+          for (int lane = 0; mask; ++lane, mask >>= 1) {
+            if (!(mask & 1)) {
+              continue;
+            }
+
+            // Attributes at the voxel center projected onto the triangle
+            glm::vec3 center(x + lane + 0.5f, y + 0.5f, z + 0.5f);
+            glm::vec3 toCenter = center - tri.pos[0];
+            float d20 = glm::dot(toCenter, tri.pos[1] - tri.pos[0]);
+            float d21 = glm::dot(toCenter, tri.pos[2] - tri.pos[0]);
+            float v = std::max(0.0f,
+                        (tri.d11 * d20 - tri.d01 * d21) * tri.invDenom);
+            float w = std::max(0.0f,
+                        (tri.d00 * d21 - tri.d01 * d20) * tri.invDenom);
+            float u = std::max(0.0f, 1.0f - v - w);
+            float sum = u + v + w;
+            if (sum > 0.0f) {
+              u /= sum;
+              v /= sum;
+              w /= sum;
+            } else {
+              u = v = w = 1.0f / 3.0f;
+            }
+
+            glm::vec2 uv = tri.uv[0] * u + tri.uv[1] * v + tri.uv[2] * w;
+            glm::vec4 color = sampleTexture(tri.texture, uv.x, 1.0f - uv.y);
+            color.w = 1.0f;
+
+            glm::vec3 normal = tri.normal[0] * u + tri.normal[1] * v
+                             + tri.normal[2] * w;
+            float length = glm::length(normal);
+            normal = length > 0.0f ? normal / length : glm::vec3(0.0f);
+
+            uint local = ((z - tileMin[2]) * TILE_SIZE + (y - tileMin[1]))
+                         * TILE_SIZE + (x + lane - tileMin[0]);
+            if (vColorSums[local].w == 0.0f) {
+              vTouched.push_back(local);
+            }
+            vColorSums[local] += color;
+            vNormalSums[local] += glm::vec4(normal * 0.5f + glm::vec3(0.5f),
+                                            1.0f);
+
+            result.vFragments.push_back(packXYZ10(x + lane, y, z));
+          }
+        }
+      }
+    }
+  }
+
+  // Averaged and with full alpha as written by imageAtomicRGBA8Avg()
+  result.vVoxels.reserve(vTouched.size());
+  result.vColors.reserve(vTouched.size());
+  result.vNormals.reserve(vTouched.size());
+  for (uint i = 0; i < vTouched.size(); ++i) {
+    uint local = vTouched[i];
+    uint x = tileMin[0] + local % TILE_SIZE;
+    uint y = tileMin[1] + (local / TILE_SIZE) % TILE_SIZE;
+    uint z = tileMin[2] + local / (TILE_SIZE * TILE_SIZE);
+
+    glm::vec4 color = vColorSums[local] * (255.0f / vColorSums[local].w);
+    glm::vec4 normal = vNormalSums[local] * (255.0f / vNormalSums[local].w);
+    color.w = normal.w = 255.0f;
+
+    result.vVoxels.push_back(packXYZ10(x, y, z));
+    result.vColors.push_back(packRGBA8(color));
+    result.vNormals.push_back(packRGBA8(normal));
+  }
+}
@@ -0,0 +1,153 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+#ifndef VCT_SRC_VCT_CPUVOXELIZER_H_
+#define VCT_SRC_VCT_CPUVOXELIZER_H_
+
+#include <vector>
+
+#include "KoRE/Common.h"
+
+/// RGBA8 texels in GL order (first row at t = 0)
+struct SVoxelizerTexture {
+  const uint* texels;
+  uint width;
+  uint height;
+};
+
+/// Triangles of one mesh with tightly packed vertex attributes
+struct SVoxelizerMesh {
+  const glm::vec3* positions;
+  const glm::vec3* normals;
+  const glm::vec3* uvs;
+  const uint* indices;  // NULL if the vertices are not indexed
+  uint numVertices;
+  uint numIndices;
+  glm::mat4 modelMat;
+  glm::mat3 normalMat;
+  SVoxelizerTexture texture;
+};
+
+/*! Voxelizes triangle meshes on the CPU into the formats of the GPU
+*   voxelization (voxelizeFrag.shader): one XYZ10 position per
+*   triangle/voxel overlap as in the VoxelFragList and the averaged RGBA8
+*   color and normal of each voxel as in the VoxelFragTex. Doesn't use GL,
+*   so scenes can be baked without a GPU and the result can serve as
+*   reference for the GPU voxelization.
+*
+*   A voxel is set if its box overlaps the triangle (separating axis test,
+*   i.e. a conservative voxelization). The triangles are binned into tiles
+*   of TILE_SIZE^3 voxels, the tiles are voxelized in parallel on the
+*   ThreadPool. Within a tile, four voxels of a row are tested at once
+*   with SSE.
+*/
+class CPUvoxelizer {
+public:
+  static const uint TILE_SIZE = 16;
+
+  CPUvoxelizer();
+  ~CPUvoxelizer();
+
+  /// gridTransformI maps world space to [-1, 1]^3 of the voxel grid (the
+  /// inverse model matrix of the voxel grid node).
+  void voxelize(const std::vector<SVoxelizerMesh>& vMeshes,
+                const glm::mat4& gridTransformI, uint resolution);
+
+  /// Same content as the VoxelFragList, in tile order
+  inline const std::vector<uint>& getFragmentPositions() const
+  {return _vFragmentPositions;}
+
+  /// Every voxel once with its VoxelFragTex color and normal
+  inline const std::vector<uint>& getVoxelPositions() const
+  {return _vVoxelPositions;}
+  inline const std::vector<uint>& getVoxelColors() const
+  {return _vVoxelColors;}
+  inline const std::vector<uint>& getVoxelNormals() const
+  {return _vVoxelNormals;}
+
+  inline uint getNumTriangles() const {return _vTriangles.size();}
+
+  static uint packXYZ10(uint x, uint y, uint z);
+  static void unpackXYZ10(uint packed, uint& x, uint& y, uint& z);
+
+private:
+  // Number of box/triangle separating axes besides the grid axes: the
+  // triangle normal and the cross products of the edges with the grid axes
+  static const uint NUM_AXES = 10;
+
+  // Triangle in voxel grid space with its separating axes. A voxel with
+  // center c overlaps the triangle if, for every axis a,
+  // axisMin <= dot(a, c) <= axisMax.
+  struct STriangle {
+    glm::vec3 pos[3];
+    glm::vec3 normal[3];
+    glm::vec2 uv[3];
+    const SVoxelizerTexture* texture;
+
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+
+    float axisX[NUM_AXES];
+    float axisY[NUM_AXES];
+    float axisZ[NUM_AXES];
+    float axisMin[NUM_AXES];
+    float axisMax[NUM_AXES];
+
+    // For the barycentric coordinates of the voxel centers
+    float d00, d01, d11, invDenom;
+  };
+
+  struct STileResult {
+    std::vector<uint> vFragments;
+    std::vector<uint> vVoxels;
+    std::vector<uint> vColors;
+    std::vector<uint> vNormals;
+  };
+
+  void setupTriangles(uint chunk);
+  void binTriangles(uint chunk);
+  void voxelizeTile(uint tile);
+
+  const std::vector<SVoxelizerMesh>* _vMeshes;
+  std::vector<uint> _vMeshFirstTriangles;
+  glm::mat4 _gridTransformI;
+  uint _resolution;
+  uint _numTilesPerAxis;
+
+  std::vector<STriangle> _vTriangles;
+
+  // Triangle indices per tile (counting sort of the per-chunk bins)
+  std::vector<std::vector<std::pair<uint, uint> > > _vChunkBins;
+  std::vector<uint> _vTileOffsets;
+  std::vector<uint> _vTileTriangles;
+
+  std::vector<STileResult> _vTileResults;
+
+  std::vector<uint> _vFragmentPositions;
+  std::vector<uint> _vVoxelPositions;
+  std::vector<uint> _vVoxelColors;
+  std::vector<uint> _vVoxelNormals;
+};
+
+#endif  // VCT_SRC_VCT_CPUVOXELIZER_H_
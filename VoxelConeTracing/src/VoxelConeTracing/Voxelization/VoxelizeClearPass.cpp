@@ -25,6 +25,8 @@
 
 #include "VoxelConeTracing/Voxelization/VoxelizeClearPass.h"
 #include "Kore/Operations/Operations.h"
+#include "VoxelConeTracing/Util/ShaderProgramCache.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
 
 VoxelizeClearPass::~VoxelizeClearPass(void) {
 }
@@ -34,22 +36,18 @@ VoxelizeClearPass::VoxelizeClearPass(VCTscene* vctScene,
   using namespace kore;
 
   _name = std::string("VoxelizeClear Pass");
-  _useGPUProfiling = vctScene->getUseGPUprofiling();
+  GPUprofiler::getInstance()->addPass(this);
+  bool useCompute = vctScene->getUseComputeShaders();
   
   this->setExecutionType(executionType);
 
-  ShaderProgram* shader = new ShaderProgram();
-  shader->loadShader("./assets/shader/voxelizeClear.shader",
-                 GL_VERTEX_SHADER);
-  shader->setName("VoxelizeClear shader");
-  shader->init();
+  ShaderProgram* shader = ShaderProgramCache::getInstance()->getProgram(
+    "VoxelizeClear shader", "./assets/shader/voxelizeClear.shader",
+    ThreadDispatch::getShaderType(useCompute),
+    ThreadDispatch::getShaderDefines(useCompute));
   this->setShaderProgram(shader);
 
 
-  addStartupOperation(new kore::BindBuffer(GL_DRAW_INDIRECT_BUFFER, 
-        vctScene->getVoxelFragTex()->getVoxelFragTexIndCmdBuf()->getHandle()));
-  addStartupOperation(new ColorMaskOp(glm::bvec4(false, false, false, false)));
-
 
   addStartupOperation(new BindImageTexture(
                     vctScene->getVoxelFragTex()->getShdVoxelFragTex(VOXELATT_COLOR),
@@ -59,7 +57,12 @@ VoxelizeClearPass::VoxelizeClearPass(VCTscene* vctScene,
                     vctScene->getVoxelFragTex()->getShdVoxelFragTex(VOXELATT_NORMAL),
                     shader->getUniform("voxelFragTex_normal")));
   
-  addStartupOperation(new kore::DrawIndirectOp(GL_POINTS, 0));
-
-  addStartupOperation(new MemoryBarrierOp(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
+  ThreadDispatch::addLaunchOperations(this,
+    vctScene->getVoxelFragTex()->getVoxelFragTexIndCmdBuf()->getHandle(),
+    useCompute);
+
+  declareResource(vctScene->getVoxelFragTex()->getShdVoxelFragTex(VOXELATT_COLOR),
+                  ACCESS_WRITE, USAGE_IMAGE);
+  declareResource(vctScene->getVoxelFragTex()->getShdVoxelFragTex(VOXELATT_NORMAL),
+                  ACCESS_WRITE, USAGE_IMAGE);
 }
@@ -28,8 +28,10 @@
 
 #include "KoRE/Passes/ShaderProgramPass.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
+#include "VoxelConeTracing/Util/BarrierPlanner.h"
 
-class VoxelizeClearPass : public kore::ShaderProgramPass
+class VoxelizeClearPass : public kore::ShaderProgramPass,
+                          public ResourceUsage
 {
   public:
     VoxelizeClearPass(VCTscene* vctScene,
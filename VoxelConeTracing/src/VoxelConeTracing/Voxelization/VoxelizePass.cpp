@@ -25,6 +25,10 @@
 
 #include "VoxelConeTracing/Voxelization/VoxelizePass.h"
 
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "KoRE/Log.h"
 #include "KoRE/ResourceManager.h"
 #include "KoRE/Operations/ViewportOp.h"
 #include "KoRE/Operations/EnableDisableOp.h"
@@ -38,15 +42,48 @@
 #include "KoRE/Operations/ResetAtomicCounterBuffer.h"
 #include "KoRE/Operations/MemoryBarrierOp.h"
 #include "KoRE/Operations/FunctionOp.h"
+#include "KoRE/Operations/BindOperations/BindTexture.h"
+#include "VoxelConeTracing/Util/GPUprofiler.h"
+#include "VoxelConeTracing/Util/GPUreadback.h"
+#include "VoxelConeTracing/Util/AsyncLog.h"
+#include "VoxelConeTracing/Util/CommandList.h"
+#include "VoxelConeTracing/Scene/MeshBatch.h"
+
+#ifndef GL_CONSERVATIVE_RASTERIZATION_NV
+#define GL_CONSERVATIVE_RASTERIZATION_NV 0x9346
+#endif
+
+static bool hasExtension(const char* name) {
+  GLint numExtensions = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+  for (GLint i = 0; i < numExtensions; ++i) {
+    const char* extension =
+      reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+    if (extension && strcmp(extension, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void enableConservativeRaster() {
+  glEnable(GL_CONSERVATIVE_RASTERIZATION_NV);
+}
+
+static void disableConservativeRaster() {
+  glDisable(GL_CONSERVATIVE_RASTERIZATION_NV);
+}
 
 VoxelizePass::VoxelizePass(const glm::vec3& voxelGridSize, 
                            VCTscene* vctScene,
                            kore::EOperationExecutionType executionType)
-{
+  : _vctScene(vctScene),
+    _commandList(NULL),
+    _batchDraw(NULL) {
   using namespace kore;
 
   this->_name = "Voxelization";
-  this->_useGPUProfiling = vctScene->getUseGPUprofiling();
+  GPUprofiler::getInstance()->addPass(this);
 
   this->setExecutionType(executionType);
   this->init(voxelGridSize);
@@ -54,18 +91,34 @@ VoxelizePass::VoxelizePass(const glm::vec3& voxelGridSize,
 
   // Init Voxelize procedure
   //////////////////////////////////////////////////////////////////////////
+  MeshBatch* meshBatch = vctScene->getMeshBatch();
+  std::string defines = meshBatch ? MeshBatch::getShaderDefines() : "";
+
+  // The triangles are enlarged by the rasterizer if it supports it and by
+  // the geometry shader otherwise
+  bool hwConservativeRaster = false;
+  if (vctScene->getConservativeVoxelization()) {
+    hwConservativeRaster = hasExtension("GL_NV_conservative_raster");
+    defines += "#define CONSERVATIVE_VOXELIZATION\n";
+    if (hwConservativeRaster) {
+      defines += "#define HW_CONSERVATIVE_RASTER\n";
+    }
+    Log::getInstance()->write("[DEBUG] Conservative voxelization: %s\n",
+      hwConservativeRaster ? "GL_NV_conservative_raster" : "geometry shader");
+  }
+
   ShaderProgram* voxelizeShader = new ShaderProgram;
   voxelizeShader->
     loadShader("./assets/shader/VoxelConeTracing/voxelizeVert.shader",
-    GL_VERTEX_SHADER);
+    GL_VERTEX_SHADER, defines);
 
   voxelizeShader->
     loadShader("./assets/shader/VoxelConeTracing/voxelizeGeom.shader",
-    GL_GEOMETRY_SHADER);
+    GL_GEOMETRY_SHADER, defines);
 
   voxelizeShader->
     loadShader("./assets/shader/VoxelConeTracing/voxelizeFrag.shader",
-    GL_FRAGMENT_SHADER);
+    GL_FRAGMENT_SHADER, defines);
   voxelizeShader->setName("voxelizeShader");
   voxelizeShader->init();
 
@@ -91,9 +144,16 @@ VoxelizePass::VoxelizePass(const glm::vec3& voxelGridSize,
 
   addStartupOperation(new ColorMaskOp(glm::bvec4(false, false, false, false)));
 
+  if (hwConservativeRaster) {
+    addStartupOperation(new FunctionOp(enableConservativeRaster));
+    addFinishOperation(new FunctionOp(disableConservativeRaster));
+  }
+
   addStartupOperation(new BindUniform(&_shdVoxelGridSize,
     voxelizeShader->getUniform("voxelGridSize")));
 
+  addStartupOperation(
+    new FunctionOp(std::bind(&VoxelizePass::updateViewProjs, this)));
  addStartupOperation(new BindUniform(&_shdViewProjMatsArr, voxelizeShader->getUniform("viewProjs[0]")));
  /*addStartupOperation(new BindUniform(&_shdViewProjMatsArr, voxelizeShader->getUniform("viewProjs")));*/
 
@@ -128,6 +188,50 @@ VoxelizePass::VoxelizePass(const glm::vec3& voxelGridSize,
 
   //////////////////////////////////////////////////////////////////////////
 
+  if (meshBatch) {
+    kore::TexSamplerProperties samplerProps;
+    samplerProps.type = GL_SAMPLER_2D_ARRAY;
+    samplerProps.wrapping = glm::uvec3(GL_REPEAT);
+    samplerProps.minfilter = GL_LINEAR_MIPMAP_LINEAR;
+    samplerProps.magfilter = GL_LINEAR;
+    voxelizeShader->setSamplerProperties("diffuseTexArray", samplerProps);
+
+    // Meshes without texture are not voxelized, as in the per-node path
+    _batchDraw = new MeshBatchDraw(this, meshBatch,
+                           voxelizeShader->getUniform("diffuseTexArray"));
+    for (uint i = 0; i < meshBatch->getNumDraws(); ++i) {
+      _batchDraw->setDrawEnabled(i,
+                                 meshBatch->getDrawData(i).diffuseLayer >= 0);
+    }
+
+    addStartupOperation(
+      new FunctionOp(std::bind(&MeshBatchDraw::execute, _batchDraw)));
+  } else {
+    initNodeDraws(vRenderNodes, voxelizeShader);
+  }
+
+  addFinishOperation(
+    new FunctionOp(std::bind(&VoxelizePass::requestVoxelCount, this)));
+
+  declareResource(vctScene->getShdAcVoxelIndex(),
+                  ACCESS_WRITE, USAGE_BUFFER_UPDATE);
+  declareResource(vctScene->getShdAcVoxelIndex(),
+                  ACCESS_READ_WRITE, USAGE_ATOMIC_COUNTER);
+  declareResource(vctScene->getVoxelFragList()->getShdVoxelFragList(),
+                  ACCESS_WRITE, USAGE_IMAGE);
+  declareResource(vctScene->getVoxelFragTex()->getShdVoxelFragTex(VOXELATT_COLOR),
+                  ACCESS_READ_WRITE, USAGE_IMAGE);
+  declareResource(vctScene->getVoxelFragTex()->getShdVoxelFragTex(VOXELATT_NORMAL),
+                  ACCESS_READ_WRITE, USAGE_IMAGE);
+}
+
+void VoxelizePass::initNodeDraws(
+                        const std::vector<kore::SceneNode*>& vRenderNodes,
+                        kore::ShaderProgram* voxelizeShader) {
+  using namespace kore;
+
+  _commandList = new CommandList(this, voxelizeShader);
+
   for (uint i = 0; i < vRenderNodes.size(); ++i) {
     const TexturesComponent* texComp =
       static_cast<TexturesComponent*>(
@@ -154,40 +258,20 @@ VoxelizePass::VoxelizePass(const glm::vec3& voxelGridSize,
    MeshComponent* meshComp =
      static_cast<MeshComponent*>(vRenderNodes[i]->getComponent(COMPONENT_MESH));
    
-   nodePass
-     ->addOperation(OperationFactory::create(OP_BINDATTRIBUTE, "v_position",
-                                             meshComp, "v_position",
-                                             voxelizeShader));
-  nodePass
-    ->addOperation(OperationFactory::create(OP_BINDATTRIBUTE, "v_normal",
-                                            meshComp, "v_normal",
-                                            voxelizeShader));
-   nodePass
-     ->addOperation(OperationFactory::create(OP_BINDATTRIBUTE, "v_uv0",
-                                             meshComp, "v_uvw", voxelizeShader));
-   nodePass
-     ->addOperation(OperationFactory::create(OP_BINDUNIFORM, "model Matrix",
-                                             vRenderNodes[i]->getTransform(),
-                                             "modelWorld",
-                                             voxelizeShader));
-   nodePass
-     ->addOperation(OperationFactory::create(OP_BINDUNIFORM, "normal Matrix",
-                                             vRenderNodes[i]->getTransform(),
-                                             "modelWorldNormal",
-                                             voxelizeShader));
-  
-   nodePass
-     ->addOperation(OperationFactory::create(OP_BINDTEXTURE, tex->getName(),
-     texComp, "diffuseTex", voxelizeShader));
-
-   nodePass
-     ->addOperation(new RenderMesh(meshComp));
+    _commandList->beginNode(nodePass);
+    _commandList->bindAttribute("v_position", meshComp, "v_position");
+    _commandList->bindAttribute("v_normal", meshComp, "v_normal");
+    _commandList->bindAttribute("v_uv0", meshComp, "v_uvw");
+    _commandList->bindUniform("model Matrix", vRenderNodes[i]->getTransform(),
+                              "modelWorld");
+    _commandList->bindUniform("normal Matrix",
+                              vRenderNodes[i]->getTransform(),
+                              "modelWorldNormal");
+    _commandList->bindTexture(tex->getName(), texComp, "diffuseTex");
+    _commandList->draw(meshComp);
   }
 
-  // Make sure that the contents of the imageBuffers are valid at this point
-  this->addFinishOperation(
-    new MemoryBarrierOp(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
-                        | GL_ATOMIC_COUNTER_BARRIER_BIT));
+  _commandList->bake();
 }
 
 void VoxelizePass::init(const glm::vec3& voxelGridSize) {
@@ -223,9 +307,10 @@ void VoxelizePass::init(const glm::vec3& voxelGridSize) {
   viewMats[2][2] = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
   viewMats[2][3] = glm::vec4(0.0f, 0.0f, -1.0f, 1.0f);
 
-  _viewProjMats[0] = camProjMatrix * viewMats[0];
-  _viewProjMats[1] = camProjMatrix * viewMats[1];
-  _viewProjMats[2] = camProjMatrix * viewMats[2];
+  _viewProjMatsOrigin[0] = camProjMatrix * viewMats[0];
+  _viewProjMatsOrigin[1] = camProjMatrix * viewMats[1];
+  _viewProjMatsOrigin[2] = camProjMatrix * viewMats[2];
+  updateViewProjs();
 
 
   // Init ShaderDatas
@@ -244,7 +329,31 @@ void VoxelizePass::init(const glm::vec3& voxelGridSize) {
   //////////////////////////////////////////////////////////////////////////
 }
 
+void VoxelizePass::updateViewProjs() {
+  glm::mat4 gridTranslationI =
+    glm::translate(glm::mat4(1.0f), -_vctScene->getVoxelGridCenter());
+
+  for (uint i = 0; i < 3; ++i) {
+    _viewProjMats[i] = _viewProjMatsOrigin[i] * gridTranslationI;
+  }
+}
+
+void VoxelizePass::requestVoxelCount() {
+  using std::placeholders::_1;
+  using std::placeholders::_2;
+
+  GPUreadback::getInstance()->request(
+    _vctScene->getAcVoxelIndex()->getHandle(), 0, 1,
+    std::bind(&VoxelizePass::onVoxelCountRead, this, _1, _2));
+}
+
+void VoxelizePass::onVoxelCountRead(const uint* values, uint) {
+  AsyncLog::getInstance()->write("Voxel fragments (conservative %s): %u\n",
+    _vctScene->getConservativeVoxelization() ? "on" : "off", values[0]);
+}
 
 VoxelizePass::~VoxelizePass(void) {
+  delete _commandList;
+  delete _batchDraw;
 }
 
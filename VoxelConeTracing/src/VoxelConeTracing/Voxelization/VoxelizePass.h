@@ -28,8 +28,13 @@
 
 #include "KoRE/Passes/ShaderProgramPass.h"
 #include "VoxelConeTracing/Scene/VCTscene.h"
+#include "VoxelConeTracing/Util/BarrierPlanner.h"
 
-class VoxelizePass : public kore::ShaderProgramPass {
+class CommandList;
+class MeshBatchDraw;
+
+class VoxelizePass : public kore::ShaderProgramPass,
+                     public ResourceUsage {
 public:
   VoxelizePass(const glm::vec3& voxelGridSize, 
                VCTscene* vctScene,
@@ -38,14 +43,30 @@ public:
 
 private:
   void init(const glm::vec3& voxelGridSize);
+  void initNodeDraws(const std::vector<kore::SceneNode*>& vRenderNodes,
+                     kore::ShaderProgram* voxelizeShader);
+
+  // Follows the voxel grid if it has been moved
+  void updateViewProjs();
+
+  // Reads back the number of voxel fragments and logs it with the
+  // voxelization mode, so both modes can be compared
+  void requestVoxelCount();
+  void onVoxelCountRead(const uint* values, uint numValues);
+
+  VCTscene* _vctScene;
   
   //glm::vec3 _worldAxes[3];
   //kore::ShaderData _shdWorldAxesArr;
 
+  glm::mat4 _viewProjMatsOrigin[3];  // For the grid centered at the origin
   glm::mat4 _viewProjMats[3];
   kore::ShaderData _shdViewProjMatsArr;
 
   glm::vec3 _voxelGridSize;
   kore::ShaderData _shdVoxelGridSize;
+
+  CommandList* _commandList;
+  MeshBatchDraw* _batchDraw;
 };
 #endif  // VCT_SRC_VCT_VOXELIZEPASS_H_
\ No newline at end of file
@@ -0,0 +1,253 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+#include "VoxelConeTracing/Voxelization/VoxelizerBenchmark.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+
+#include "KoRE/Log.h"
+#include "KoRE/Mesh.h"
+#include "KoRE/RenderManager.h"
+#include "KoRE/Timer.h"
+#include "KoRE/Components/MeshComponent.h"
+#include "KoRE/Components/TexturesComponent.h"
+#include "VoxelConeTracing/Util/ThreadPool.h"
+#include "VoxelConeTracing/Voxelization/CPUvoxelizer.h"
+
+// CPU copy of the data of one render node
+struct SBenchmarkMesh {
+  std::vector<glm::vec3> vPositions;
+  std::vector<glm::vec3> vNormals;
+  std::vector<glm::vec3> vUVs;
+  const kore::Texture* texture;
+};
+
+// Copies a vertex attribute as vec3s, false if it is not on the CPU
+static bool copyAttribute(const kore::Mesh* mesh, const std::string& name,
+                          std::vector<glm::vec3>& dst) {
+  const kore::MeshAttributeArray* att = mesh->getAttributeByName(name);
+  if (!att || !att->data || att->componentType != GL_FLOAT
+      || att->numComponents > 3 || mesh->getNumVertices() == 0) {
+    return false;
+  }
+
+  dst.assign(mesh->getNumVertices(), glm::vec3(0.0f));
+  const float* src = static_cast<const float*>(att->data);
+  for (uint v = 0; v < mesh->getNumVertices(); ++v) {
+    for (uint c = 0; c < att->numComponents; ++c) {
+      dst[v][c] = src[v * att->numComponents + c];
+    }
+  }
+  return true;
+}
+
+static void readTexture(const kore::Texture* texture,
+                        std::vector<uint>& texels, SVoxelizerTexture& info) {
+  kore::RenderManager* renderMgr = kore::RenderManager::getInstance();
+  renderMgr->bindTexture(GL_TEXTURE_2D, texture->getHandle());
+
+  GLint width = 0;
+  GLint height = 0;
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+
+  texels.resize(width * height);
+  if (!texels.empty()) {
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, &texels[0]);
+  }
+  renderMgr->bindTexture(GL_TEXTURE_2D, 0);
+
+  info.texels = texels.empty() ? NULL : &texels[0];
+  info.width = width;
+  info.height = height;
+}
+
+static uint readAtomicCounter(kore::IndexedBuffer* buffer) {
+  GLuint value = 0;
+  kore::RenderManager::getInstance()->bindBuffer(GL_ATOMIC_COUNTER_BUFFER,
+                                                 buffer->getHandle());
+  glGetBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &value);
+  return value;
+}
+
+// Compares the CPU voxels with the voxel fragments of the GPU
+static void compareWithGPU(VCTscene* vctScene, const CPUvoxelizer& voxelizer) {
+  kore::RenderManager* renderMgr = kore::RenderManager::getInstance();
+  uint resolution = vctScene->getVoxelGridResolution();
+
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT |
+                  GL_TEXTURE_UPDATE_BARRIER_BIT |
+                  GL_ATOMIC_COUNTER_BARRIER_BIT);
+
+  kore::TextureBuffer* fragList =
+    vctScene->getVoxelFragList()->getVoxelFragList();
+  renderMgr->bindBuffer(GL_TEXTURE_BUFFER, fragList->getBufferHandle());
+  GLint fragListSize = 0;
+  glGetBufferParameteriv(GL_TEXTURE_BUFFER, GL_BUFFER_SIZE, &fragListSize);
+
+  uint numGPUfragments = readAtomicCounter(vctScene->getAcVoxelIndex());
+  numGPUfragments = std::min(numGPUfragments,
+                             static_cast<uint>(fragListSize / sizeof(uint)));
+
+  std::vector<uint> vGPUvoxels(numGPUfragments);
+  if (numGPUfragments > 0) {
+    glGetBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(uint) * numGPUfragments,
+                       &vGPUvoxels[0]);
+  }
+  std::sort(vGPUvoxels.begin(), vGPUvoxels.end());
+  vGPUvoxels.erase(std::unique(vGPUvoxels.begin(), vGPUvoxels.end()),
+                   vGPUvoxels.end());
+
+  std::vector<uint> vCPUvoxels = voxelizer.getVoxelPositions();
+  std::sort(vCPUvoxels.begin(), vCPUvoxels.end());
+
+  std::vector<uint> vCommon;
+  std::set_intersection(vGPUvoxels.begin(), vGPUvoxels.end(),
+                        vCPUvoxels.begin(), vCPUvoxels.end(),
+                        std::back_inserter(vCommon));
+
+  kore::Log::getInstance()->write(
+    "[DEBUG] GPU voxelization: %u fragments, %u voxels. Common: %u,"
+    " only GPU: %u, only CPU: %u\n", numGPUfragments,
+    (uint)vGPUvoxels.size(), (uint)vCommon.size(),
+    (uint)(vGPUvoxels.size() - vCommon.size()),
+    (uint)(vCPUvoxels.size() - vCommon.size()));
+
+  // Mean color difference of the common voxels
+  std::vector<uint> vGPUcolors(resolution * resolution * resolution);
+  renderMgr->bindTexture(GL_TEXTURE_3D, vctScene->getVoxelFragTex()
+                         ->getVoxelFragTex(VOXELATT_COLOR)->getHandle());
+  glGetTexImage(GL_TEXTURE_3D, 0, GL_RED_INTEGER, GL_UNSIGNED_INT,
+                &vGPUcolors[0]);
+  renderMgr->bindTexture(GL_TEXTURE_3D, 0);
+
+  const std::vector<uint>& vPositions = voxelizer.getVoxelPositions();
+  const std::vector<uint>& vColors = voxelizer.getVoxelColors();
+  double sumDiff = 0.0;
+  uint numCompared = 0;
+  for (uint i = 0; i < vPositions.size(); ++i) {
+    if (!std::binary_search(vGPUvoxels.begin(), vGPUvoxels.end(),
+                            vPositions[i])) {
+      continue;
+    }
+
+    uint x, y, z;
+    CPUvoxelizer::unpackXYZ10(vPositions[i], x, y, z);
+    uint gpuColor = vGPUcolors[(z * resolution + y) * resolution + x];
+    for (uint c = 0; c < 3; ++c) {
+      int cpuValue = (vColors[i] >> (c * 8)) & 0xFF;
+      int gpuValue = (gpuColor >> (c * 8)) & 0xFF;
+      sumDiff += abs(cpuValue - gpuValue);
+    }
+    ++numCompared;
+  }
+
+  kore::Log::getInstance()->write(
+    "[DEBUG] Mean RGB difference of the common voxels: %f (of 255)\n",
+    numCompared > 0 ? sumDiff / (3.0 * numCompared) : 0.0);
+}
+
+void VoxelizerBenchmark::run(VCTscene* vctScene, uint numRuns) {
+  using namespace kore;
+
+  const std::vector<SceneNode*>& vRenderNodes = vctScene->getRenderNodes();
+
+  // Same nodes as the GPU voxelization: only those with texture
+  std::vector<SBenchmarkMesh> vMeshData(vRenderNodes.size());
+  std::vector<std::vector<uint> > vTexels(vRenderNodes.size());
+  std::vector<SVoxelizerMesh> vMeshes;
+  for (uint i = 0; i < vRenderNodes.size(); ++i) {
+    const TexturesComponent* texComp = static_cast<TexturesComponent*>(
+      vRenderNodes[i]->getComponent(COMPONENT_TEXTURES));
+    MeshComponent* meshComp = static_cast<MeshComponent*>(
+      vRenderNodes[i]->getComponent(COMPONENT_MESH));
+    if (!texComp || !texComp->getTexture(0) || !meshComp
+        || !meshComp->getMesh()) {
+      continue;
+    }
+
+    const Mesh* mesh = meshComp->getMesh();
+    SBenchmarkMesh& data = vMeshData[i];
+    if (!copyAttribute(mesh, "v_position", data.vPositions)) {
+      Log::getInstance()->write("[WARNING] CPU voxelization: vertices of"
+                                " render node %u are not available\n", i);
+      continue;
+    }
+    copyAttribute(mesh, "v_normal", data.vNormals);
+    copyAttribute(mesh, "v_uv0", data.vUVs);
+
+    SVoxelizerMesh voxelizerMesh;
+    voxelizerMesh.positions = &data.vPositions[0];
+    voxelizerMesh.normals = data.vNormals.empty() ? NULL : &data.vNormals[0];
+    voxelizerMesh.uvs = data.vUVs.empty() ? NULL : &data.vUVs[0];
+    voxelizerMesh.indices = mesh->hasIndices() ? &mesh->getIndices()[0]
+                                               : NULL;
+    voxelizerMesh.numVertices = mesh->getNumVertices();
+    voxelizerMesh.numIndices = mesh->hasIndices() ? mesh->getIndices().size()
+                                                  : 0;
+
+    const SceneComponent* transform = vRenderNodes[i]->getTransform();
+    voxelizerMesh.modelMat = *static_cast<glm::mat4*>(
+      transform->getShaderData("model Matrix")->data);
+    voxelizerMesh.normalMat = *static_cast<glm::mat3*>(
+      transform->getShaderData("normal Matrix")->data);
+
+    readTexture(texComp->getTexture(0), vTexels[i], voxelizerMesh.texture);
+    vMeshes.push_back(voxelizerMesh);
+  }
+
+  const glm::mat4& gridTransformI = *static_cast<glm::mat4*>(
+    vctScene->getVoxelGridNode()->getTransform()
+    ->getShaderData("inverse model Matrix")->data);
+  uint resolution = vctScene->getVoxelGridResolution();
+
+  CPUvoxelizer voxelizer;
+  Timer timer;
+  double bestMS = 0.0;
+  for (uint i = 0; i < glm::max(numRuns, 1U); ++i) {
+    timer.start();
+    voxelizer.voxelize(vMeshes, gridTransformI, resolution);
+    double runMS = timer.timeSinceLastCall() * 1000.0;
+    bestMS = i == 0 ? runMS : glm::min(bestMS, runMS);
+  }
+
+  double seconds = glm::max(bestMS, 0.001) / 1000.0;
+  uint numTriangles = voxelizer.getNumTriangles();
+  uint numFragments = voxelizer.getFragmentPositions().size();
+  uint numVoxels = voxelizer.getVoxelPositions().size();
+
+  Log::getInstance()->write(
+    "[DEBUG] CPU voxelization (%u^3, %u threads, best of %u): %u triangles,"
+    " %u fragments, %u voxels in %f ms\n", resolution,
+    ThreadPool::getInstance()->getNumThreads(), glm::max(numRuns, 1U),
+    numTriangles, numFragments, numVoxels, bestMS);
+  Log::getInstance()->write(
+    "[DEBUG] CPU voxelization throughput: %f MTriangles/s,"
+    " %f MFragments/s, %f MVoxels/s\n", numTriangles / seconds / 1e6,
+    numFragments / seconds / 1e6, numVoxels / seconds / 1e6);
+
+  compareWithGPU(vctScene, voxelizer);
+}
@@ -0,0 +1,42 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+#ifndef VCT_SRC_VCT_VOXELIZERBENCHMARK_H_
+#define VCT_SRC_VCT_VOXELIZERBENCHMARK_H_
+
+#include "KoRE/Common.h"
+#include "VoxelConeTracing/Scene/VCTscene.h"
+
+/*! Runs the CPUvoxelizer on the render nodes of the scene, logs its
+*   throughput and compares its voxels with those of the last GPU
+*   voxelization (VoxelFragList and VoxelFragTex).
+*/
+class VoxelizerBenchmark {
+public:
+  /// Voxelizes numRuns times and logs the fastest run. Reads back the GPU
+  /// voxelization, so it waits for the GPU to finish.
+  static void run(VCTscene* vctScene, uint numRuns);
+};
+
+#endif  // VCT_SRC_VCT_VOXELIZERBENCHMARK_H_
@@ -88,7 +88,21 @@
 #include "VoxelConeTracing/Stages/SVOconstructionStage.h"
 #include "VoxelConeTracing/Stages/ShadowMapStage.h"
 #include "Stages/SVOlightUpdateStage.h"
-#include "KoRE/GPUtimer.h"
+#include "Util/ShaderProgramCache.h"
+#include "Scene/PoolCalibrator.h"
+#include "Util/SVOdump.h"
+#include "Util/GPUreadback.h"
+#include "Util/GPUprofiler.h"
+#include "Util/TraceRecorder.h"
+#include "Util/AsyncLog.h"
+#include "Util/Instrumentation.h"
+#include "Util/CommandList.h"
+#include "Util/ThreadPool.h"
+#include "Scene/FrustumCuller.h"
+#include "Scene/VCTcascades.h"
+#include "Scene/BrickCache.h"
+#include "Scene/MeshCache.h"
+#include "Voxelization/VoxelizerBenchmark.h"
 
 static const uint screen_width = 1280;
 static const uint screen_height = 720;
@@ -101,21 +115,52 @@ static kore::FrameBufferStage* _backbufferStage = NULL;
 
 static VCTscene _vctScene;
 
+// SVO cascades around the camera, each with twice the extent of the last
+static const uint _numSVOcascades = 2;
+static VCTcascades _vctCascades;
+
+// Renders the SVO of a dump ('P') instead of constructing one, with a brick
+// pool that pages the bricks in from the dump. NULL to disable.
+static const char* _pagedSVOfile = NULL;  // e.g. "./SVOdump.bin"
+static const uint _brickCacheResolution = 30 * 3;
+static BrickCache _brickCache;
+
 static ObAllocatePass* _obAllocatePass = NULL;
 static OctreeVisPass* _octreeVisPass = NULL;
 static uint _numLevels = 0;
 
 static bool _oldPageUp = false;
 static bool _oldPageDown = false;
+static bool _oldDumpKey = false;
+static bool _oldTraceKey = false;
+static bool _oldVoxelizeKey = false;
 
 static std::string _timerResults = "";
 
 static TwBar* _performanceBar;
-static std::vector<SDurationResult> _vDurationsResults;
-
-static kore::ShaderProgramPass* _finalRenderPass = NULL;
+static FrameBufferStage* _svoStage = NULL;
+static bool _svoTimeLogged = false;
+static bool _useMinimalBarriers = true;
+
+static PoolCalibrator _poolCalibrator;
+static MeshCache _meshCache;
+static bool _recalibratePools = false;  // Measure again with the defaults
+static const float _poolHeadroom = 0.1f;
+
+// Frames to trace at startup (0 frames to disable) and on pressing 'T'
+static const uint _traceFirstFrame = 0;
+static const uint _traceNumFrames = 0;
+static const uint _traceKeyNumFrames = 5;
+static const char* _traceFile = "./trace.json";
+
+static std::vector<RenderPass*> _vFinalRenderPasses;
 static kore::ShaderProgramPass* _coneTracePass = NULL;
-static kore::FrameBufferStage* _lightUpdateStage = NULL;
+static SVOlightUpdateStage* _lightUpdateStage = NULL;
+static ShadowMapStage* _shadowMapStage = NULL;
+static GBufferStage* _gBufferStage = NULL;
+
+// Culls against the main camera (0) and the shadow map lights (1 + light)
+static FrustumCuller _frustumCuller;
 
 
 void changeAllocPassLevel() {
@@ -123,6 +168,24 @@ void changeAllocPassLevel() {
   _obAllocatePass->setLevel((currLevel++) % _numLevels);
 }
 
+void loadScene(const std::string& file) {
+  using namespace kore;
+
+  // KoRE parses and uploads the scene in one blocking call on the GL thread,
+  // so show a cleared frame with a loading title while it runs.
+  glfwSetWindowTitle(std::string("Loading ").append(file).c_str());
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  glfwSwapBuffers();
+
+  Timer loadTimer;
+  loadTimer.start();
+  ResourceManager::getInstance()->loadScene(file);
+  Log::getInstance()->write("[SETUP] Loading %s took %f ms\n", file.c_str(),
+                            loadTimer.timeSinceLastCall() * 1000.0);
+
+  glfwSetWindowTitle("Sparse Voxel Octree Demo");
+}
+
 void setup() {
   using namespace kore;
 
@@ -155,11 +218,14 @@ void setup() {
   
 
   //Load the scene and get all mesh nodes
-  //ResourceManager::getInstance()->loadScene("./assets/meshes/sibenik.dae");
-  //ResourceManager::getInstance()->loadScene("./assets/meshes/sponza_diff_small_combi.dae");
-  //ResourceManager::getInstance()->loadScene("./assets/meshes/sponza_diff_big_combi.dae");
-  ResourceManager::getInstance()->loadScene("./assets/meshes/sponza_diff_medium_combi.dae");
-  //ResourceManager::getInstance()->loadScene("./assets/meshes/sponza_outerCube.dae");
+  //std::string sceneFile = "./assets/meshes/sibenik.dae";
+  //std::string sceneFile = "./assets/meshes/sponza_diff_small_combi.dae";
+  //std::string sceneFile = "./assets/meshes/sponza_diff_big_combi.dae";
+  std::string sceneFile = "./assets/meshes/sponza_diff_medium_combi.dae";
+  //std::string sceneFile = "./assets/meshes/sponza_outerCube.dae";
+  // Read the batch geometry of the last run while KoRE parses the scene
+  _meshCache.startLoad(sceneFile);
+  loadScene(sceneFile);
   
   std::vector<SceneNode*> renderNodes;
   SceneManager::getInstance()
@@ -174,6 +240,15 @@ void setup() {
   params.voxel_grid_sidelengths = glm::vec3(50, 50, 50);
   params.shadowMapResolution = glm::vec2(2048,2048);
   params.voxel_grid_resolution = 256;
+  params.lightUpdateBudgetMS = 4.0f;
+  params.constructionBudgetMS = 4.0f;
+  params.useMinimalBarriers = true;
+  params.useComputeShaders = true;
+  params.shareShaderPrograms = true;
+  params.maxNumNodes = 0;
+  params.useMeshBatching = true;
+  params.meshCache = &_meshCache;
+  params.conservativeVoxelization = true;
 
   if (params.voxel_grid_resolution == 128) {
     params.fraglist_size_multiplier = 10;
@@ -185,15 +260,35 @@ void setup() {
     params.brickPoolResolution = 70 * 3;
   }
 
+  // Fit the grid around the meshes and replace the hand-tuned pool sizes
+  // above with the measurement of a previous run with the same grid.
+  // Without one, this run measures the SVO built with the fitted grid.
+  SceneManager::getInstance()->update();
+  bool gridFitted =
+    _poolCalibrator.fitGrid(renderNodes, _poolHeadroom, params);
+  bool poolsCalibrated = _poolCalibrator.load(sceneFile)
+    && !_recalibratePools && _poolCalibrator.apply(_poolHeadroom, params);
+
+  // A paged SVO is neither constructed nor lit again, so it has no cascades
+  bool pagedSVO = _pagedSVOfile &&
+    _brickCache.load(_pagedSVOfile, _brickCacheResolution, params);
+  uint numCascades = pagedSVO ? 1 : _numSVOcascades;
+
+  // The cascades are constructed again while the camera moves. A copy of
+  // the last complete SVO is rendered until the new one is lit.
+  params.displayCopySVO = !pagedSVO;
   
   // Make sure all lightnodes are initialized with camera components
   std::vector<SceneNode*> lightNodes;
   SceneManager::getInstance()->getSceneNodesByComponent(COMPONENT_LIGHT, lightNodes);
 
+  // The shadow maps have to cover the coarsest cascade
+  float cascadeScale = static_cast<float>(1 << (numCascades - 1));
   for(uint i=0; i<lightNodes.size(); ++i){
     Camera* cam  = new Camera();
-    float projsize = params.voxel_grid_sidelengths.x / 2;
-    cam->setProjectionOrtho(-projsize,projsize,-projsize,projsize,1,100); 
+    float projsize = cascadeScale * params.voxel_grid_sidelengths.x / 2;
+    cam->setProjectionOrtho(-projsize,projsize,-projsize,projsize,1,
+                            100 * cascadeScale); 
     cam->setAspectRatio(1.0);   
     //_pCamera = cam;
     lightNodes[i]->addComponent(cam);
@@ -203,38 +298,87 @@ void setup() {
 
   _lightNode = lightNodes[0];
 
-  _vctScene.init(params, renderNodes, _pCamera);
-  _vctScene.setUseGPUprofiling(true);
+  ShaderProgramCache::getInstance()
+    ->setSharingEnabled(params.shareShaderPrograms);
+
+  // Profile the passes without waiting for the GPU. Sampling is configured
+  // in the tweak bar.
+  GPUprofiler::getInstance()->setEnabled(true);
+  GPUprofiler::getInstance()->setNumFramesInFlight(3);
+
+  _vctScene.init(params, renderNodes, lightNodes, _pCamera);
+  if (pagedSVO) {
+    _brickCache.init(&_vctScene);
+  } else if (gridFitted) {
+    // The first construction (and the measurement) covers the whole scene
+    _vctScene.setVoxelGridCenter(_poolCalibrator.getGridCenter());
+  }
 
   _numLevels = _vctScene.getNodePool()->getNumLevels(); 
 
   // GBuffer Stage
-  FrameBufferStage* gBufferStage =
-    new GBufferStage(_pCamera, renderNodes, screen_width, screen_height);
+  _gBufferStage =
+    new GBufferStage(_pCamera, renderNodes, screen_width, screen_height,
+                     _vctScene.getMeshBatch());
   
-  RenderManager::getInstance()->addFramebufferStage(gBufferStage);
+  RenderManager::getInstance()->addFramebufferStage(_gBufferStage);
   //////////////////////////////////////////////////////////////////////////
 
   // Shadowmap Stage
-  FrameBufferStage* shadowMapStage =
-    new ShadowMapStage(lightNodes[0], renderNodes, params.shadowMapResolution.x, params.shadowMapResolution.y);
+  _shadowMapStage =
+    new ShadowMapStage(_vctScene.getShadowMapArray(), renderNodes,
+                       _vctScene.getMeshBatch());
+
+  RenderManager::getInstance()->addFramebufferStage(_shadowMapStage);
+  //////////////////////////////////////////////////////////////////////////
 
-  RenderManager::getInstance()->addFramebufferStage(shadowMapStage);
+  // Frustum culling of the G-buffer and shadow map draws
+  ThreadPool::getInstance()->init();
+  _frustumCuller.init(renderNodes);
+  _frustumCuller.addCamera(_pCamera, "Camera");
+
+  ShadowMapArray* shadowMaps = _vctScene.getShadowMapArray();
+  for (uint i = 0; i < shadowMaps->getNumLights(); ++i) {
+    Camera* lightCam = static_cast<Camera*>(
+      shadowMaps->getLightNode(i)->getComponent(COMPONENT_CAMERA));
+    _frustumCuller.addCamera(lightCam,
+                           "Light " + std::to_string((unsigned long long)i));
+  }
   //////////////////////////////////////////////////////////////////////////
   
   // Voxelize & SVO Stage
-  FrameBufferStage* svoStage = 
-    new SVOconstructionStage(lightNodes[0], renderNodes, params, _vctScene, shadowMapStage->getFrameBuffer(), kore::EXECUTE_ONCE); 
+  SVOconstructionStage* svoStage = NULL;
+  if (!pagedSVO) {
+    svoStage = new SVOconstructionStage(renderNodes, params, _vctScene, kore::EXECUTE_ONCE); 
+
+    RenderManager::getInstance()->addFramebufferStage(svoStage);
+    _svoStage = svoStage;
+    _useMinimalBarriers = params.useMinimalBarriers;
 
-  RenderManager::getInstance()->addFramebufferStage(svoStage);
+    if (!poolsCalibrated) {
+      _poolCalibrator.measureAfter(svoStage->getShaderProgramPasses().back(),
+                                   &_vctScene, params);
+    } else {
+      _poolCalibrator.checkAfter(svoStage->getShaderProgramPasses().back(),
+                                 &_vctScene, params);
+    }
+  }
   ////////////////////////////////////////////////////////////////////////// 
    
 
-  // Light update stage
+  // Light update stage. Only the irradiance of the dump is paged, so the
+  // stage isn't executed for a paged SVO.
   _lightUpdateStage =
-    new SVOlightUpdateStage(lightNodes[0], renderNodes, params, _vctScene, shadowMapStage->getFrameBuffer(), kore::EXECUTE_ONCE);
+    new SVOlightUpdateStage(renderNodes, params, _vctScene, kore::EXECUTE_ONCE);
+
+  if (!pagedSVO) {
+    RenderManager::getInstance()->addFramebufferStage(_lightUpdateStage);
+  }
+  ////////////////////////////////////////////////////////////////////////// 
 
-  RenderManager::getInstance()->addFramebufferStage(_lightUpdateStage);
+  // Coarser cascades with their construction and light update stages
+  _vctCascades.init(&_vctScene, svoStage, _lightUpdateStage, params,
+                    numCascades, renderNodes, lightNodes);
   ////////////////////////////////////////////////////////////////////////// 
   
   _backbufferStage = new FrameBufferStage;
@@ -246,10 +390,38 @@ void setup() {
   _backbufferStage->addProgramPass(new DebugPass(&_vctScene, kore::EXECUTE_ONCE));
   
    _coneTracePass = new ConeTracePass(&_vctScene);
-   _finalRenderPass = new RenderPass(gBufferStage->getFrameBuffer(), shadowMapStage->getFrameBuffer(), lightNodes, &_vctScene);
+   for (uint i = 0; i < _vctCascades.getNumCascades(); ++i) {
+     _vFinalRenderPasses.push_back(
+       new RenderPass(_gBufferStage->getFrameBuffer(),
+                      _vctCascades.getScene(i), &_vctCascades, i,
+                      pagedSVO ? &_brickCache : NULL));
+   }
   
   RenderManager::getInstance()->addFramebufferStage(_backbufferStage);
   //////////////////////////////////////////////////////////////////////////
+
+  TraceRecorder* traceRecorder = TraceRecorder::getInstance();
+  traceRecorder->addStage(_gBufferStage, "G-Buffer");
+  traceRecorder->addStage(_shadowMapStage, "Shadow maps");
+  if (!pagedSVO) {
+    traceRecorder->addStage(svoStage, "SVO construction");
+    traceRecorder->addStage(_lightUpdateStage, "Light update");
+  }
+  for (uint i = 1; i < _vctCascades.getNumCascades(); ++i) {
+    std::string cascadeName =
+      " (cascade " + std::to_string((unsigned long long)i) + ")";
+    traceRecorder->addStage(_vctCascades.getConstructionStage(i),
+                            "SVO construction" + cascadeName);
+    traceRecorder->addStage(_vctCascades.getLightUpdateStage(i),
+                            "Light update" + cascadeName);
+  }
+  traceRecorder->addStage(_backbufferStage, "Final render");
+  traceRecorder->capture(_traceFirstFrame, _traceNumFrames, _traceFile);
+
+  GPUprofiler::getInstance()->finishSetup();
+
+  // The SVO construction is only executed in the first frame
+  GPUprofiler::getInstance()->requestFullFrame();
 }
 
 
@@ -259,15 +431,76 @@ void TW_CALL durationStringCallback(void *value, void * clientData)
   std::string *destPtr = static_cast<std::string *>(value);
   ShaderProgramPass* pass = static_cast<ShaderProgramPass*>(clientData);
 
-  GLuint durationID = pass->getTimerQueryObject();
- 
-  for (uint i = 0; i < _vDurationsResults.size(); ++i) {
-       if (_vDurationsResults[i].startQueryID == durationID) {
-      TwCopyStdStringToLibrary(*destPtr, 
-        std::to_string((double)((uint)(_vDurationsResults[i].durationNS)) / 1000000.0));
+  float gpuMS = 0.0f;
+  float cpuMS = 0.0f;
+  if (GPUprofiler::getInstance()->getPassTimesMS(pass, &gpuMS, &cpuMS)) {
+    TwCopyStdStringToLibrary(*destPtr, std::to_string((double)gpuMS)
+                             + " / " + std::to_string((double)cpuMS));
+  }
+}
+
+
+void TW_CALL cullingCountersCallback(void *value, void * clientData)
+{
+  std::string *destPtr = static_cast<std::string *>(value);
+  const SCullingCounters* counters =
+    static_cast<SCullingCounters*>(clientData);
+
+  TwCopyStdStringToLibrary(*destPtr,
+                        std::to_string((unsigned long long)counters->numVisible)
+    + " / " + std::to_string((unsigned long long)counters->numCulled));
+}
+
+
+void TW_CALL commandCountersCallback(void *value, void * clientData)
+{
+  std::string *destPtr = static_cast<std::string *>(value);
+  const CommandList* commandList = static_cast<CommandList*>(clientData);
+  const SCommandCounters& counters = commandList->getCounters();
+
+  TwCopyStdStringToLibrary(*destPtr,
+                           std::to_string((unsigned long long)counters.binds)
+    + " / " + std::to_string((unsigned long long)counters.uniformUploads)
+    + " / " + std::to_string((unsigned long long)counters.draws)
+    + " / " + std::to_string((unsigned long long)counters.skippedBinds));
+}
+
+// Draw calls and CPU submit time of a per-node (CommandList) or batched
+// (MeshBatchDraw) pass
+void TW_CALL submitCountersCallback(void *value, void * clientData)
+{
+  std::string *destPtr = static_cast<std::string *>(value);
+  const SCommandCounters* counters =
+    static_cast<const SCommandCounters*>(clientData);
+
+  TwCopyStdStringToLibrary(*destPtr,
+                        std::to_string((unsigned long long)counters->draws)
+                        + " / " + std::to_string(counters->submitMS));
+}
+
+
+// Logs the summed GPU-time of the SVO construction once all of its passes
+// have been measured, to compare the barrier placement strategies.
+void logSVOconstructionTime() {
+  if (_svoTimeLogged || !_svoStage) {
+    return;
+  }
+
+  std::vector<ShaderProgramPass*>& vPasses = _svoStage->getShaderProgramPasses();
+  double sumMS = 0.0;
+  for (uint iPass = 0; iPass < vPasses.size(); ++iPass) {
+    float gpuMS = 0.0f;
+    if (!GPUprofiler::getInstance()->getPassTimesMS(vPasses[iPass],
+                                                    &gpuMS, NULL)) {
       return;
     }
+    sumMS += gpuMS;
   }
+
+  kore::Log::getInstance()->write(
+    "[DEBUG] SVO construction took %f ms GPU-time (%s barriers)\n",
+    sumMS, _useMinimalBarriers ? "minimal" : "full");
+  _svoTimeLogged = true;
 }
 
 
@@ -343,14 +576,24 @@ int main(void) {
             glewGetString(GLEW_VERSION)));
 
 
-  VSDebugLib::init();
-  VSDebugLib::enableUserMessages(true);
+  if (Instrumentation::FULL) {
+    VSDebugLib::init();
+    VSDebugLib::enableUserMessages(true);
+  }
   
   kore::RenderManager::getInstance()
     ->setScreenResolution(glm::ivec2(screen_width, screen_height));
 
+  kore::Timer setupTimer;
+  setupTimer.start();
   setup();
-
+  ShaderProgramCache* programCache = ShaderProgramCache::getInstance();
+  kore::Log::getInstance()->write(
+    "[SETUP] Setup took %f ms (%u programs compiled in %f ms, %u shared, "
+    "saving about %f ms)\n",
+    setupTimer.timeSinceLastCall() * 1000.0,
+    programCache->getNumCompiled(), programCache->getCompileTimeMS(),
+    programCache->getNumShared(), programCache->getSavedTimeMS());
 
 
   TwBar* bar = TwNewBar("TweakBar");
@@ -372,31 +615,141 @@ int main(void) {
   TwAddVarRW(bar, "Render AO", TW_TYPE_BOOLCPP, &_vctScene._renderAO,
     "group='Lighting parameters' ");
 
+  TwAddVarRW(bar, "Skip empty space", TW_TYPE_BOOLCPP, &_vctScene._skipEmptySpace,
+    "group='Lighting parameters' ");
+
   //TwAddVarRW(bar, "Use alpha correction" , TW_TYPE_BOOLCPP, &_vctScene._useAlphaCorrection,
    // "group='Lighting parameters' ");
 
+  TwAddVarRW(bar, "Light update budget", TW_TYPE_FLOAT, _lightUpdateStage->getFrameBudgetMSptr(),
+    " group='Light update' label='Budget (ms)' min=0 max=100 step=0.1 ");
+  TwAddVarRO(bar, "Light update frames", TW_TYPE_UINT32, _lightUpdateStage->getNumFramesLastUpdatePtr(),
+    " group='Light update' label='Frames per update' ");
+
+  if (_brickCache.isActive()) {
+    TwAddVarRO(bar, "Resident bricks", TW_TYPE_UINT32, _brickCache.getNumResidentPtr(),
+      " group='Brick cache' ");
+    TwAddVarRO(bar, "Paged-in bricks", TW_TYPE_UINT32, _brickCache.getNumPagedInPtr(),
+      " group='Brick cache' ");
+    TwAddVarRO(bar, "Evicted bricks", TW_TYPE_UINT32, _brickCache.getNumEvictedPtr(),
+      " group='Brick cache' ");
+  }
+
   TwAddVarRW(bar, "Cone diameter", TW_TYPE_FLOAT, &_vctScene._coneDiameter, " group='Lighting parameters' min=0 max=10 step=0.001 ");
   //TwAddVarRW(bar, "Cone max distance", TW_TYPE_FLOAT, &_vctScene._coneMaxDistance, " group='Lighting parameters' min=0 max=1 step=0.00001 ");
 
-    
-  auto stages = RenderManager::getInstance()->getFrameBufferStages();
-  for (uint iStage = 0; iStage < stages.size(); ++iStage) {
-    auto passes = stages[iStage]->getShaderProgramPasses();
+  // Compare the steps per cone when toggling the skipping. The render time
+  // of this configuration is distorted by the statistics.
+  if (Instrumentation::CONE_TRACE_STATS) {
+    for (uint i = 0; i < _vFinalRenderPasses.size(); ++i) {
+      std::string szCascade = std::to_string((unsigned long long)i);
+      TwAddVarRO(bar, ("Steps per cone " + szCascade).c_str(), TW_TYPE_FLOAT,
+        _vFinalRenderPasses[i]->getStepsPerConePtr(),
+        (" group='Cone tracing' label='Steps per cone (cascade " + szCascade + ")' ").c_str());
+      TwAddVarRO(bar, ("Cones " + szCascade).c_str(), TW_TYPE_UINT32,
+        _vFinalRenderPasses[i]->getNumConesPtr(),
+        (" group='Cone tracing' label='Cones (cascade " + szCascade + ")' ").c_str());
+    }
+  }
 
-    TwAddVarCB(bar, "ConeTrace", TW_TYPE_STDSTRING, NULL, durationStringCallback, _coneTracePass, " group='Performance' ");
-    TwAddVarCB(bar, "Final Render", TW_TYPE_STDSTRING, NULL, durationStringCallback, _finalRenderPass, " group='Performance' ");
+  // The timings only exist with the TIMING instrumentation level
+  if (Instrumentation::TIMING) {
+    GPUprofiler* profiler = GPUprofiler::getInstance();
+    TwEnumVal profilingModes[] = {
+      {PROFILING_EVERY_FRAME, "Every frame"},
+      {PROFILING_EVERY_KTH_FRAME, "Every Kth frame"},
+      {PROFILING_ROTATING_SUBSET, "Rotating subset"}};
+    TwType profilingModeType = TwDefineEnum("ProfilingMode", profilingModes, 3);
+    TwAddVarRW(bar, "Profiling mode", profilingModeType, profiler->getModePtr(),
+      " group='Profiling' label='Mode' ");
+    TwAddVarRW(bar, "Profiling interval", TW_TYPE_UINT32, profiler->getSampleIntervalPtr(),
+      " group='Profiling' label='K' min=1 max=1000 ");
+    TwAddVarRW(bar, "Profiling subset", TW_TYPE_UINT32, profiler->getSubsetSizePtr(),
+      " group='Profiling' label='Passes per frame' min=1 max=1000 ");
+    TwAddVarRO(bar, "Profiling skipped", TW_TYPE_UINT32, profiler->getNumSkippedFramesPtr(),
+      " group='Profiling' label='Skipped frames' ");
+
+    auto stages = RenderManager::getInstance()->getFrameBufferStages();
+    for (uint iStage = 0; iStage < stages.size(); ++iStage) {
+      auto passes = stages[iStage]->getShaderProgramPasses();
+
+      TwAddVarCB(bar, "ConeTrace", TW_TYPE_STDSTRING, NULL, durationStringCallback, _coneTracePass, " group='Performance' ");
+      TwAddVarCB(bar, "Final Render", TW_TYPE_STDSTRING, NULL, durationStringCallback, static_cast<ShaderProgramPass*>(_vFinalRenderPasses[0]), " group='Performance' ");
+
+      for (uint iPass = 0; iPass < passes.size(); ++iPass) {
+         std::string szParameters = std::string(" group='Performance' ") + std::string("label='") + passes[iPass]->getName() + "'";
+         std::string szUniqueName = (std::to_string(iPass) + std::to_string(iStage));
+
+         TwAddVarCB(bar, szUniqueName.c_str(),
+                    TW_TYPE_STDSTRING, NULL, 
+                    durationStringCallback, passes[iPass], szParameters.c_str());
+      }
+    }
 
-    for (uint iPass = 0; iPass < passes.size(); ++iPass) {
-       std::string szParameters = std::string(" group='Performance' ") + std::string("label='") + passes[iPass]->getName() + "'";
-       std::string szUniqueName = (std::to_string(iPass) + std::to_string(iStage));
+    // Per-node and batched path, see SVCTparameters::useMeshBatching
+    const std::vector<CommandList*>& vSubmitLists =
+      CommandList::getCommandLists();
+    for (uint i = 0; i < vSubmitLists.size(); ++i) {
+      std::string szParameters = " group='Performance' label='"
+        + vSubmitLists[i]->getPass()->getName() + " submit (draws / CPU ms)'";
+      std::string szUniqueName =
+        "Submit" + std::to_string((unsigned long long)i);
+      TwAddVarCB(bar, szUniqueName.c_str(), TW_TYPE_STDSTRING, NULL,
+                 submitCountersCallback,
+                 const_cast<SCommandCounters*>(&vSubmitLists[i]->getCounters()),
+                 szParameters.c_str());
+    }
 
-       TwAddVarCB(bar, szUniqueName.c_str(),
-                  TW_TYPE_STDSTRING, NULL, 
-                  durationStringCallback, passes[iPass], szParameters.c_str());
+    const std::vector<MeshBatchDraw*>& vBatchDraws =
+      MeshBatchDraw::getBatchDraws();
+    for (uint i = 0; i < vBatchDraws.size(); ++i) {
+      std::string szParameters = " group='Performance' label='"
+        + vBatchDraws[i]->getPass()->getName()
+        + " batched submit (draws / CPU ms)'";
+      std::string szUniqueName =
+        "BatchSubmit" + std::to_string((unsigned long long)i);
+      TwAddVarCB(bar, szUniqueName.c_str(), TW_TYPE_STDSTRING, NULL,
+                 submitCountersCallback,
+                 const_cast<SCommandCounters*>(&vBatchDraws[i]->getCounters()),
+                 szParameters.c_str());
     }
+
+    TwDefine(" TweakBar/Performance label='Performance (GPU / CPU ms)' ");
   }
 
-  
+  const std::vector<CommandList*>& vCommandLists =
+    CommandList::getCommandLists();
+  for (uint i = 0; i < vCommandLists.size(); ++i) {
+    std::string szParameters = std::string(" group='Commands' label='")
+                               + vCommandLists[i]->getPass()->getName() + "'";
+    std::string szUniqueName =
+      "Commands" + std::to_string((unsigned long long)i);
+
+    TwAddVarCB(bar, szUniqueName.c_str(), TW_TYPE_STDSTRING, NULL,
+               commandCountersCallback, vCommandLists[i],
+               szParameters.c_str());
+  }
+  TwDefine(" TweakBar/Commands label='Commands (binds / uniforms / draws / skipped)' ");
+
+  TwAddVarRW(bar, "Frustum culling", TW_TYPE_BOOLCPP,
+             _frustumCuller.getEnabledPtr(),
+             " group='Culling' label='Enabled' ");
+  TwAddVarRO(bar, "Culling time", TW_TYPE_FLOAT,
+             _frustumCuller.getCullTimeMSptr(),
+             " group='Culling' label='CPU ms' precision=3 ");
+  for (uint i = 0; i < _frustumCuller.getNumCameras(); ++i) {
+    std::string szParameters = std::string(" group='Culling' label='")
+                               + _frustumCuller.getCameraName(i) + "'";
+    std::string szUniqueName =
+      "Culling" + std::to_string((unsigned long long)i);
+
+    TwAddVarCB(bar, szUniqueName.c_str(), TW_TYPE_STDSTRING, NULL,
+               cullingCountersCallback,
+               const_cast<SCullingCounters*>(&_frustumCuller.getCounters(i)),
+               szParameters.c_str());
+  }
+  TwDefine(" TweakBar/Culling label='Culling (visible / culled)' ");
+
   //TwAddVarRW(_performanceBar, "Frame duration", TW_TYPE_UINT32, &_frameDuration, "");
 
 
@@ -426,35 +779,103 @@ int main(void) {
    
   // Main loop
   while (running) {
+    TraceRecorder* traceRecorder = TraceRecorder::getInstance();
+    traceRecorder->beginFrame();
+    GPUprofiler::getInstance()->beginFrame();
+
     time = the_timer.timeSinceLastCall();
+
+    // Moves the grids before their transforms are updated. The grid of a
+    // paged SVO stays where it was dumped.
+    if (!_brickCache.isActive()) {
+      _vctCascades.update();
+    }
+
+    traceRecorder->beginZone("SceneManager::update");
     kore::SceneManager::getInstance()->update();
+    traceRecorder->endZone();
+
+    // Upload the transforms of moved meshes to the batch's draw data
+    if (_vctScene.getMeshBatch()) {
+      _vctScene.getMeshBatch()->update();
+    }
 
-    GPUtimer::getInstance()->checkQueryResults(); 
-    GPUtimer::getInstance()->getDurationResultsMS(_vDurationsResults);
+    traceRecorder->beginZone("Frustum culling");
+    _frustumCuller.update();
+    traceRecorder->endZone();
+
+    _gBufferStage->setVisibility(_frustumCuller.getVisibility(0));
+    for (uint i = 1; i < _frustumCuller.getNumCameras(); ++i) {
+      _shadowMapStage->setCasterVisibility(i - 1,
+                                           _frustumCuller.getVisibility(i));
+    }
+
+    logSVOconstructionTime();
+    GPUreadback::getInstance()->update();
+    _brickCache.update();
 
     std::vector<kore::ShaderProgramPass*>& vBackbufferPasses = _backbufferStage->getShaderProgramPasses();
     if (*_vctScene.getRenderVoxelsPtr()) {
       _backbufferStage->removeProgramPass(_coneTracePass);
-      _backbufferStage->addProgramPass(_finalRenderPass);
+      for (uint i = 0; i < _vFinalRenderPasses.size(); ++i) {
+        _backbufferStage->addProgramPass(_vFinalRenderPasses[i]);
+      }
     } else {
-      _backbufferStage->removeProgramPass(_finalRenderPass);
+      for (uint i = 0; i < _vFinalRenderPasses.size(); ++i) {
+        _backbufferStage->removeProgramPass(_vFinalRenderPasses[i]);
+      }
       _backbufferStage->addProgramPass(_coneTracePass);
     }
 
 
+    // Dump the SVO for offline inspection with the SVOinspect tool
+    if (glfwGetKey('P')) {
+      if (!_oldDumpKey) {
+        _oldDumpKey = true;
+        SVOdump::write(&_vctScene, "./SVOdump.bin");
+      }
+    } else {
+      _oldDumpKey = false;
+    }
+
+    // Trace the next frames for chrome://tracing or Perfetto
+    if (glfwGetKey('T')) {
+      if (!_oldTraceKey) {
+        _oldTraceKey = true;
+        traceRecorder->captureNext(_traceKeyNumFrames, _traceFile);
+      }
+    } else {
+      _oldTraceKey = false;
+    }
+
+    // Benchmark the CPU voxelizer and compare it with the GPU voxelization
+    if (glfwGetKey('V')) {
+      if (!_oldVoxelizeKey) {
+        _oldVoxelizeKey = true;
+        VoxelizerBenchmark::run(&_vctScene, 5);
+      }
+    } else {
+      _oldVoxelizeKey = false;
+    }
+
     if (glfwGetKey('J')) {
         // Rotate the light
         _lightNode->rotate(5.0f * static_cast<float>(time), glm::vec3(0.0f, 1.0f, 0.0f), SPACE_WORLD);
-        
-        // Reset all lightUpdate-passes
-        _lightUpdateStage->setExecuted(false);
-        std::vector<kore::ShaderProgramPass*>& lightPasses =
-                                    _lightUpdateStage->getShaderProgramPasses();
+    }
 
-        for (int i = 0;  i < lightPasses.size(); ++i) {
-          lightPasses[i]->setExecuted(false);
-        }
+    // Only re-render the shadow maps of changed lights and inject only
+    // the changed lights into the SVO again.
+    ShadowMapArray* shadowMaps = _vctScene.getShadowMapArray();
+    shadowMaps->update();
+    _shadowMapStage->update();
+
+    uint dirtyLights = shadowMaps->getDirtyLights();
+    if (dirtyLights != 0) {
+        _vctCascades.requestLightUpdate(dirtyLights);
     }
+
+    // Spread the light update over several frames within the GPU budget
+    _vctCascades.updateLightUpdateStages();
        
     if (_pCamera) {
       if (glfwGetKey(GLFW_KEY_UP) || glfwGetKey('W')) {
@@ -515,22 +936,36 @@ int main(void) {
     }
 
    // /*
-    kore::GLerror::gl_ErrorCheckStart();
+    if (Instrumentation::VALIDATION) {
+      kore::GLerror::gl_ErrorCheckStart();
+    }
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |GL_STENCIL_BUFFER_BIT);
     
 
+    traceRecorder->beginZone("RenderManager::renderFrame");
     kore::RenderManager::getInstance()->renderFrame();
+    traceRecorder->endZone();
         
-    kore::GLerror::gl_ErrorCheckFinish("Main Loop"); 
+    if (Instrumentation::VALIDATION) {
+      kore::GLerror::gl_ErrorCheckFinish("Main Loop");
+    }
     
     TwDraw();
      
+    traceRecorder->beginZone("glfwSwapBuffers");
     glfwSwapBuffers();
+    traceRecorder->endZone();
 
     // Check if ESC key was pressed or window was closed
     running = !glfwGetKey(GLFW_KEY_ESC) && glfwGetWindowParam(GLFW_OPENED);
   }
 
+  _brickCache.shutdown();
+  ThreadPool::getInstance()->shutdown();
+  AsyncLog::getInstance()->shutdown();
+  ShaderProgramCache::getInstance()->release();
+  GPUreadback::getInstance()->release();
+  GPUprofiler::getInstance()->release();
   TwTerminate();
   glfwTerminate();
 
@@ -23,7 +23,9 @@
 * \author Andreas Weinmann (andy.weinmann@gmail.com)
 */
 
-#version 420 core
+#version 430 core
+
+#include "assets/shader/_threadIndex.shader"
 
 layout(r32ui) uniform uimageBuffer nodePool_next;
 layout(r32ui) uniform uimageBuffer nodePool_color;
@@ -51,7 +53,11 @@ void alloc3x3x3TextureBrick(in int nodeAddress) {
 }
 
 void main() {
-  uint tileAddress = (8U * gl_VertexID);
+  if (!isThreadActive()) {
+    return;
+  }
+
+  uint tileAddress = (8U * THREAD_ID);
 
   for (uint i = 0; i < 8; ++i) {
     int address = int(tileAddress + i);
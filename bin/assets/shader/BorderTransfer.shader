@@ -25,6 +25,8 @@
 
 #version 430 core
 
+#include "assets/shader/_threadIndex.shader"
+
 uniform usamplerBuffer nodePool_color;
 uniform usamplerBuffer nodePool_Neighbour;
 
@@ -35,9 +37,7 @@ uniform int level;
 uniform uint numLevels;
 uniform uint axis;
 
-uniform usampler2D nodeMap;
-uniform ivec2 nodeMapOffset[8];
-uniform ivec2 nodeMapSize[8];
+uniform usamplerBuffer lightNodeList;
 
 #define NODE_MASK_VALUE 0x3FFFFFFF
 #define NODE_NOT_FOUND 0xFFFFFFFF
@@ -58,9 +58,13 @@ vec4 getFinalVal(in vec4 borderVal, in vec4 neighbourBorderVal) {
 }
 
 ///*
-//This shader is launched for every node up to a specific level, so that gl_VertexID 
+//This shader is launched for every node up to a specific level, so that THREAD_ID 
 //exactly matches all node-addresses in a dense octree. */
 void main() {
+  if (!isThreadActive()) {
+    return;
+  }
+
   uint nodeAddress = getThreadNode();
   if(nodeAddress == NODE_NOT_FOUND) {
     return;  // The requested threadID-node does not belong to the current level
@@ -25,6 +25,8 @@
 
 #version 430 core
 
+#include "assets/shader/_threadIndex.shader"
+
 #define CLEAR_ALL 0U
 #define CLEAR_DYNAMIC 1U
 
@@ -32,14 +34,22 @@ layout(rgba8) uniform image3D brickPool_color;
 layout(rgba8) uniform image3D brickPool_irradiance;
 layout(rgba8) uniform image3D brickPool_normal;
 
+// One bit per light, see LightInjectionFrag.shader
+layout(r32ui) uniform uimage3D lightMask;
+uniform uint injectLights;
+
 uniform uint clearMode;
 
 void main() {
+  if (!isThreadActive()) {
+    return;
+  }
+
   int size = imageSize(brickPool_color).x;
   ivec3 texCoord = ivec3(0);
-  texCoord.x = gl_VertexID % size;
-  texCoord.y = (gl_VertexID / size) % size;
-  texCoord.z = gl_VertexID / (size * size);
+  texCoord.x = THREAD_ID % size;
+  texCoord.y = (THREAD_ID / size) % size;
+  texCoord.z = THREAD_ID / (size * size);
 
   vec4 clearColor = vec4(0.0, 0.0, 0.0, 0.0);
   vec4 clearIrradiance = vec4(0.0, 0.0, 0.0, 0.0);
@@ -48,9 +58,14 @@ void main() {
     imageStore(brickPool_color, texCoord, clearColor);
     imageStore(brickPool_irradiance, texCoord, clearIrradiance);
     imageStore(brickPool_normal, texCoord, clearNormal);
+    imageStore(lightMask, texCoord, uvec4(0U));
   }
 
   else if (clearMode == CLEAR_DYNAMIC) {
+    // The irradiance is resolved again from all lights in the mask. Only
+    // the lights that are injected again lose their bits.
     imageStore(brickPool_irradiance, texCoord, clearIrradiance);
+    uint lights = imageLoad(lightMask, texCoord).x;
+    imageStore(lightMask, texCoord, uvec4(lights & ~injectLights));
   }
 }
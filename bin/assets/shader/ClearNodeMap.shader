@@ -25,16 +25,36 @@
 
 #version 430 core
 
+#include "assets/shader/_threadIndex.shader"
+
 #define NODE_NOT_FOUND 0xFFFFFFFF
 
-layout(r32ui) uniform uimage2D nodeMap;
+layout(r32ui) uniform uimage2DArray nodeMap;
 //layout(rgba8) uniform image2D nodeMap;
+layout(r32ui) uniform uimageBuffer nodeFlags;
 
 void main() {
-  ivec2 nodeMapSize = imageSize(nodeMap);
-  ivec2 uv = ivec2(0);
-  uv.x = (gl_VertexID % nodeMapSize.x);
-  uv.y = (gl_VertexID / nodeMapSize.x);
+  if (!isThreadActive()) {
+    return;
+  }
+
+  ivec3 nodeMapSize = imageSize(nodeMap);
+  int layerSize = nodeMapSize.x * nodeMapSize.y;
+  int texelID = THREAD_ID % layerSize;
+
+  ivec3 uv = ivec3(0);
+  uv.x = (texelID % nodeMapSize.x);
+  uv.y = (texelID / nodeMapSize.x);
+  uv.z = (THREAD_ID / layerSize);  // One layer per light
+
+  // Reset the visited-flags of the previous compaction. All nodes that
+  // have been flagged are still referenced in the nodemap at this point.
+  uint oldNodeAddress = imageLoad(nodeMap, uv).x;
+  if (oldNodeAddress != NODE_NOT_FOUND &&
+      oldNodeAddress >> 5U < uint(imageSize(nodeFlags))) {
+    imageStore(nodeFlags, int(oldNodeAddress >> 5U), uvec4(0));
+  }
+
   imageStore(nodeMap, uv, uvec4(NODE_NOT_FOUND));
   //imageStore(nodeMap, uv, vec4(0));
 }
@@ -0,0 +1,77 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+/**
+This shader compacts the nodes of one level of the light node map into a list
+of unique nodes. The shader is launched with one thread per nodemap-texel of
+the level in every light-layer. Many texels map to the same node, so every
+node is only appended by the thread that first sets its visited-bit.
+*/
+
+#version 430 core
+
+#include "assets/shader/_threadIndex.shader"
+
+#define NODE_NOT_FOUND 0xFFFFFFFF
+
+uniform usampler2DArray nodeMap;
+uniform ivec2 nodeMapOffset[8];
+uniform ivec2 nodeMapSize[8];
+uniform uint level;
+
+layout(r32ui) uniform volatile uimageBuffer nodeFlags;
+layout(r32ui) uniform uimageBuffer lightNodeList;
+layout(binding = 0) uniform atomic_uint numLightNodes;
+
+void main() {
+  if (!isThreadActive()) {
+    return;
+  }
+
+  ivec2 nmSize = nodeMapSize[level];
+  int layerSize = nmSize.x * nmSize.y;
+  int texelID = THREAD_ID % layerSize;
+  int layer = THREAD_ID / layerSize;
+
+  ivec2 uv = ivec2(0);
+  uv.x = (texelID % nmSize.x);
+  uv.y = (texelID / nmSize.x);
+
+  uint nodeAddress =
+    texelFetch(nodeMap, ivec3(nodeMapOffset[level] + uv, layer), 0).x;
+  if (nodeAddress == NODE_NOT_FOUND) {
+    return;  // No node has been stored in this texel
+  }
+
+  uint flagBit = 1U << (nodeAddress & 31U);
+  uint prevFlags = imageAtomicOr(nodeFlags, int(nodeAddress >> 5U), flagBit);
+
+  if ((prevFlags & flagBit) != 0U) {
+    return;  // Another thread already appended this node
+  }
+
+  uint listIndex = atomicCounterIncrement(numLightNodes);
+  imageStore(lightNodeList, int(listIndex), uvec4(nodeAddress));
+}
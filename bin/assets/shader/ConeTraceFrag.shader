@@ -44,6 +44,7 @@ uniform uint numLevels;
 uniform float coneAngle;
 
 uniform bool useLighting = true;
+uniform bool skipEmptySpace = true;
 
 out vec4 color;
 
@@ -25,9 +25,11 @@
 
 #version 430
 
+#include "assets/shader/_threadIndex.shader"
+
 // Note: Size has to be manually adjusted depending on the number of levels
-layout(r32ui) uniform uimage2D nodeMap;
-uniform sampler2D smPosition;
+layout(r32ui) uniform uimage2DArray nodeMap;
+uniform sampler2DArray smPosition;
 //layout(rgba8) uniform image2D nodeMap;
 
 uniform usamplerBuffer nodePool_next;
@@ -36,11 +38,22 @@ layout(rgba8) uniform image3D brickPool_irradiance;
 layout(rgba8) uniform image3D brickPool_color;
 //layout(rgba8) uniform image3D brickPool_normal;
 
+// One bit per light that sees the leaf voxel, see getRadiance()
+layout(r32ui) uniform coherent uimage3D lightMask;
+uniform uint injectLights;  // Lights that are injected again
+
+// The lights are marked in the first launch and resolved in the second
+#define PHASE_MARK 0U
+#define PHASE_RESOLVE 1U
+uniform uint injectionPhase;
+
 uniform mat4 voxelGridTransformI;
 uniform uint numLevels;
 
-uniform vec3 lightColor;
-uniform vec3 lightDir;
+// MAX_NUM_LIGHTS is defined by the application
+uniform uint numLights;
+uniform vec3 lightColor[MAX_NUM_LIGHTS];
+uniform vec3 lightDir[MAX_NUM_LIGHTS];
 
 uniform ivec2 nodeMapOffset[8];
 uniform ivec2 nodeMapSize[8];
@@ -48,76 +61,107 @@ uniform ivec2 nodeMapSize[8];
 #include "assets/shader/_utilityFunctions.shader"
 #include "assets/shader/_traverseUtil.shader"
 
-void storeNodeInNodemap(in vec2 uv, in uint level, in int nodeAddress) {
+void storeNodeInNodemap(in vec2 uv, in int layer, in uint level,
+                        in int nodeAddress) {
   ivec2 storePos = nodeMapOffset[level] + ivec2(uv * nodeMapSize[level]);
-  imageStore(nodeMap, storePos, uvec4(nodeAddress));
+  imageStore(nodeMap, ivec3(storePos, layer), uvec4(nodeAddress));
 
   //DEBUG:
   //imageStore(nodeMap, storePos, vec4(0.143 * level + 0.1));
 }
 
-void main() {
-  
-  ivec2 smTexSize = textureSize(smPosition, 0);
-  vec2 uv = vec2(0);
-  uv.x = (gl_VertexID % smTexSize.x) / float(smTexSize.x);
-  uv.y = (gl_VertexID / smTexSize.x) / float(smTexSize.y);
-
-  vec4 posWS = vec4(texture(smPosition, uv).xyz, 1.0);
-  vec3 posTex = (voxelGridTransformI * posWS).xyz * 0.5 + 0.5;
-
-  if (posTex.x < 0 || posTex.y < 0 || posTex.z < 0 ||
-      posTex.x > 1 || posTex.y > 1 || posTex.z > 1) {
-       return;
+/*
+Every light sets its bit in the mask of the leaf voxels it sees. The bits of
+the lights that did not change are kept from the last update, so only the
+changed lights are injected again. Once all bits are set, every thread
+writes the summed radiance of all lights in the mask, so all threads that
+hit the same voxel write the same value.
+*/
+vec3 getRadiance(in uint lights) {
+  vec3 radiance = vec3(0.0);
+  for (int iLight = 0; iLight < int(numLights); ++iLight) {
+    if ((lights & (1U << uint(iLight))) != 0U) {
+      radiance += lightColor[iLight];
+    }
   }
-    
+  return radiance;
+}
+
+// Descends to the node without children that contains posTex and returns
+// the brick voxel of posTex in it. Stores the visited nodes in the nodeMap
+// if storeNodes is set.
+ivec3 findInjectionVoxel(in vec3 posTex, in vec2 uv, in int layer,
+                         in bool storeNodes) {
   int nodeAddress = 0;
-  vec3 nodePosTex = vec3(0.0);
-  vec3 nodePosMaxTex = vec3(1.0);
-  float sideLength = 1.0;
 
   for (uint iLevel = 0U; iLevel < numLevels; ++iLevel) {
-    // Store nodes during traversal in the nodeMap
-    storeNodeInNodemap(uv, iLevel, nodeAddress);
+    if (storeNodes) {
+      storeNodeInNodemap(uv, layer, iLevel, nodeAddress);
+    }
 
     uint nodeNext = texelFetch(nodePool_next, nodeAddress).x;
-    
     uint childStartAddress = nodeNext & NODE_MASK_VALUE;
-    if (childStartAddress == 0U) {
-       uint nodeColorU = texelFetch(nodePool_color, nodeAddress).x;
-       
-       ivec3 brickCoords = ivec3(uintXYZ10ToVec3(nodeColorU));
-       uvec3 offVec = uvec3(2.0 * posTex);
-       uint off = offVec.x + 2U * offVec.y + 4U * offVec.z;
-
-        ivec3 injectionPos = brickCoords  + 2 * ivec3(childOffsets[off]);
-        //vec3 voxelNormal = normalize(imageLoad(brickPool_normal, injectionPos).xyz * 2.0 - 1.0);
-        vec4 voxelColor = imageLoad(brickPool_color, injectionPos);
-       
-        vec4 reflectedRadiance = vec4(lightColor, 1)
-                                * voxelColor;
-        //reflectedRadiance.xyz *= clamp(abs(dot(-lightDir, voxelNormal)) + 0.3, 0.0, 1.0);
-  
-        imageStore(brickPool_irradiance, injectionPos, reflectedRadiance);
-     
-         //store Radiance in brick corners
-        /*imageStore(brickPool_irradiance,
-               injectionPos,
-               vec4(lightColor, 1)); */
-
-        return;
-    }
-      
+
     uvec3 offVec = uvec3(2.0 * posTex);
     uint off = offVec.x + 2U * offVec.y + 4U * offVec.z;
 
+    if (childStartAddress == 0U) {
+      uint nodeColorU = texelFetch(nodePool_color, nodeAddress).x;
+      ivec3 brickCoords = ivec3(uintXYZ10ToVec3(nodeColorU));
+      return brickCoords + 2 * ivec3(childOffsets[off]);
+    }
+
     // Restart while-loop with the child node (aka recursion)
-    sideLength = sideLength / 2.0;
     nodeAddress = int(childStartAddress + off);
-    nodePosTex += vec3(childOffsets[off]) * vec3(sideLength);
-    nodePosMaxTex = nodePosTex + vec3(sideLength);
     posTex = 2.0 * posTex - vec3(offVec);
   } // level-for
-    //*/
+
+  return ivec3(-1);
 }
 
+void main() {
+  if (!isThreadActive()) {
+    return;
+  }
+
+  
+  ivec2 smTexSize = textureSize(smPosition, 0).xy;
+  int layerSize = smTexSize.x * smTexSize.y;
+  int texelID = THREAD_ID % layerSize;
+  int layer = THREAD_ID / layerSize;  // One layer per light
+
+  ivec2 smTexel = ivec2(texelID % smTexSize.x, texelID / smTexSize.x);
+  vec2 uv = vec2(smTexel) / vec2(smTexSize);
+
+  vec4 posWS = vec4(texelFetch(smPosition, ivec3(smTexel, layer), 0).xyz, 1.0);
+  vec3 posTex = (voxelGridTransformI * posWS).xyz * 0.5 + 0.5;
+
+  if (posTex.x < 0 || posTex.y < 0 || posTex.z < 0 ||
+      posTex.x > 1 || posTex.y > 1 || posTex.z > 1) {
+       return;
+  }
+
+  // The nodemap is cleared for every update, so all lights store their
+  // nodes, but only the changed ones set their bits again
+  bool marking = injectionPhase == PHASE_MARK;
+  ivec3 injectionPos = findInjectionVoxel(posTex, uv, layer, marking);
+  if (injectionPos.x < 0) {
+    return;
+  }
+
+  if (marking) {
+    uint lightBit = 1U << uint(layer);
+    if ((injectLights & lightBit) != 0U) {
+      imageAtomicOr(lightMask, injectionPos, lightBit);
+    }
+    return;
+  }
+
+  uint lights = imageLoad(lightMask, injectionPos).x;
+  vec4 voxelColor = imageLoad(brickPool_color, injectionPos);
+  //vec3 voxelNormal = normalize(imageLoad(brickPool_normal, injectionPos).xyz * 2.0 - 1.0);
+  vec4 reflectedRadiance = vec4(getRadiance(lights), 1) * voxelColor;
+  //reflectedRadiance.xyz *= clamp(abs(dot(-lightDir, voxelNormal)) + 0.3, 0.0, 1.0);
+
+  imageStore(brickPool_irradiance, injectionPos, reflectedRadiance);
+}
@@ -25,9 +25,11 @@
 
 #version 430 core
 
+#include "assets/shader/_threadIndex.shader"
+
 layout(r32ui) uniform readonly uimageBuffer nodePool_next;
 layout(r32ui) uniform readonly uimageBuffer nodePool_color;
-uniform usampler2D nodeMap;
+uniform usamplerBuffer lightNodeList;
 uniform usamplerBuffer levelAddressBuffer;
 uniform uint mipmapMode;
 uniform uint numLevels;
@@ -35,8 +37,6 @@ uniform uint numLevels;
 layout(rgba8) uniform image3D brickPool_value;
 
 uniform uint level;
-uniform ivec2 nodeMapOffset[8];
-uniform ivec2 nodeMapSize[8];
 
 #include "assets/shader/_utilityFunctions.shader"
 #include "assets/shader/_threadNodeUtil.shader"
@@ -44,6 +44,10 @@ uniform ivec2 nodeMapSize[8];
 
 
 void main() {
+  if (!isThreadActive()) {
+    return;
+  }
+
   uint nodeAddress = getThreadNode();
   if(nodeAddress == NODE_NOT_FOUND) {
     return;  // The requested threadID-node does not belong to the current level
@@ -23,7 +23,11 @@
 * \author Andreas Weinmann (andy.weinmann@gmail.com)
 */
 
-#version 420 core
+#version 430 core
+
+#ifdef COMPUTE_SHADER_PATH
+layout(local_size_x = 1) in;
+#endif
 
 layout(r32ui) uniform uimageBuffer indirectCommandBuf;
 layout(binding = 0) uniform atomic_uint numThreads;
@@ -33,4 +37,13 @@ void main() {
   
   imageStore(indirectCommandBuf, 0, uvec4(num));  // Vertex-Count
   imageStore(indirectCommandBuf, 1, uvec4(1));  // Primitive Count
+
+  // Dispatch arguments for the compute path (see SDrawArraysIndirectCommand)
+  uint groupSize = uint(THREAD_GROUP_SIZE);
+  uint numGroups = (num + groupSize - 1U) / groupSize;
+  uint numGroupsX = min(numGroups, uint(MAX_DISPATCH_GROUPS));
+  uint numGroupsY = numGroupsX > 0U ? (numGroups + numGroupsX - 1U) / numGroupsX : 1U;
+  imageStore(indirectCommandBuf, 4, uvec4(numGroupsX));
+  imageStore(indirectCommandBuf, 5, uvec4(numGroupsY));
+  imageStore(indirectCommandBuf, 6, uvec4(1));
 }
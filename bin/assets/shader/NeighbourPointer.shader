@@ -25,6 +25,8 @@
 
 #version 430 core
 
+#include "assets/shader/_threadIndex.shader"
+
 layout(r32ui) uniform readonly uimageBuffer nodePool_next;
 layout(r32ui) uniform readonly uimageBuffer voxelFragmentListPosition;
 
@@ -44,8 +46,12 @@ uniform uint voxelGridResolution;
 #include "assets/shader/_octreeTraverse.shader"
 
 void main() {
+  if (!isThreadActive()) {
+    return;
+  }
+
   // Find the node for this position
-  uint voxelPosU = imageLoad(voxelFragmentListPosition, gl_VertexID).x;
+  uint voxelPosU = imageLoad(voxelFragmentListPosition, THREAD_ID).x;
   uvec3 voxelPos = uintXYZ10ToVec3(voxelPosU);
   vec3 posTex = vec3(voxelPos) / vec3(voxelGridResolution);
   float stepTex = 1.0 / float(pow2[level]);
@@ -23,7 +23,9 @@
 * \author Andreas Weinmann (andy.weinmann@gmail.com)
 */
 
-#version 420 core
+#version 430 core
+
+#include "assets/shader/_threadIndex.shader"
 
 layout(r32ui) uniform volatile uimageBuffer nodePool_next;
 layout(r32ui) uniform volatile uimageBuffer levelAddressBuffer;
@@ -44,13 +46,17 @@ uint allocChildTile(in int nodeAddress) {
 }
 
 void main() {
-  uint nodeNextU = imageLoad(nodePool_next, gl_VertexID).x;
+  if (!isThreadActive()) {
+    return;
+  }
+
+  uint nodeNextU = imageLoad(nodePool_next, THREAD_ID).x;
 
   if (isFlagged(nodeNextU)) {
     //alloc child and unflag
-    nodeNextU = NODE_MASK_VALUE & allocChildTile(gl_VertexID);
+    nodeNextU = NODE_MASK_VALUE & allocChildTile(THREAD_ID);
 
     // Store the unflagged nodeNextU
-    imageStore(nodePool_next, gl_VertexID, uvec4(nodeNextU, 0, 0, 0));
+    imageStore(nodePool_next, THREAD_ID, uvec4(nodeNextU, 0, 0, 0));
   }
 }
@@ -23,7 +23,9 @@
 * \author Andreas Weinmann (andy.weinmann@gmail.com)
 */
 
-#version 420 core
+#version 430 core
+
+#include "assets/shader/_threadIndex.shader"
 
 layout(r32ui) uniform volatile uimageBuffer nodePool_X;
 layout(r32ui) uniform volatile uimageBuffer nodePool_Y;
@@ -33,12 +35,16 @@ layout(r32ui) uniform volatile uimageBuffer nodePool_Y_neg;
 layout(r32ui) uniform volatile uimageBuffer nodePool_Z_neg;
 
 void main() {
-  imageStore(nodePool_X, gl_VertexID, uvec4(0));
-  imageStore(nodePool_Y, gl_VertexID, uvec4(0));
-  imageStore(nodePool_Z, gl_VertexID, uvec4(0));
-  imageStore(nodePool_X_neg, gl_VertexID, uvec4(0));
-  imageStore(nodePool_Y_neg, gl_VertexID, uvec4(0));
-  imageStore(nodePool_Z_neg, gl_VertexID, uvec4(0));
+  if (!isThreadActive()) {
+    return;
+  }
+
+  imageStore(nodePool_X, THREAD_ID, uvec4(0));
+  imageStore(nodePool_Y, THREAD_ID, uvec4(0));
+  imageStore(nodePool_Z, THREAD_ID, uvec4(0));
+  imageStore(nodePool_X_neg, THREAD_ID, uvec4(0));
+  imageStore(nodePool_Y_neg, THREAD_ID, uvec4(0));
+  imageStore(nodePool_Z_neg, THREAD_ID, uvec4(0));
 }
 
 
@@ -23,7 +23,9 @@
 * \author Andreas Weinmann (andy.weinmann@gmail.com)
 */
 
-#version 420 core
+#version 430 core
+
+#include "assets/shader/_threadIndex.shader"
 
 layout(r32ui) uniform volatile uimageBuffer nodePool_color;
 layout(r32ui) uniform volatile uimageBuffer nodePool_next;
@@ -37,17 +39,21 @@ layout(r32ui) uniform volatile uimageBuffer nodePool_normal;
 
 
 void main() {
-  imageStore(nodePool_color,gl_VertexID,uvec4(0));
-  imageStore(nodePool_next,gl_VertexID,uvec4(0));
-  imageStore(nodePool_normal,gl_VertexID,uvec4(0));
+  if (!isThreadActive()) {
+    return;
+  }
+
+  imageStore(nodePool_color,THREAD_ID,uvec4(0));
+  imageStore(nodePool_next,THREAD_ID,uvec4(0));
+  imageStore(nodePool_normal,THREAD_ID,uvec4(0));
 
   /*
-  imageStore(nodePool_X, gl_VertexID, uvec4(0));
-  imageStore(nodePool_Y, gl_VertexID, uvec4(0));
-  imageStore(nodePool_Z, gl_VertexID, uvec4(0));
-  imageStore(nodePool_X_neg, gl_VertexID, uvec4(0));
-  imageStore(nodePool_Y_neg, gl_VertexID, uvec4(0));
-  imageStore(nodePool_Z_neg, gl_VertexID, uvec4(0));
+  imageStore(nodePool_X, THREAD_ID, uvec4(0));
+  imageStore(nodePool_Y, THREAD_ID, uvec4(0));
+  imageStore(nodePool_Z, THREAD_ID, uvec4(0));
+  imageStore(nodePool_X_neg, THREAD_ID, uvec4(0));
+  imageStore(nodePool_Y_neg, THREAD_ID, uvec4(0));
+  imageStore(nodePool_Z_neg, THREAD_ID, uvec4(0));
   */
 }
 
@@ -23,7 +23,9 @@
 * \author Andreas Weinmann (andy.weinmann@gmail.com)
 */
 
-#version 420 core
+#version 430 core
+
+#include "assets/shader/_threadIndex.shader"
 
 layout(r32ui) uniform volatile uimageBuffer voxelFragmentListPosition;
 layout(r32ui) uniform volatile uimageBuffer nodePool_next;
@@ -37,7 +39,11 @@ uniform uint numLevels;
 void flagNode(in uint nodeNext, in int address);
 
 void main() {
-  uint voxelPosU = imageLoad(voxelFragmentListPosition, gl_VertexID).x;
+  if (!isThreadActive()) {
+    return;
+  }
+
+  uint voxelPosU = imageLoad(voxelFragmentListPosition, THREAD_ID).x;
   uvec3 voxelPos = uintXYZ10ToVec3(voxelPosU);
   vec3 posTex = vec3(voxelPos) / vec3(voxelGridResolution);
 
@@ -31,7 +31,9 @@ Every voxel is read from the voxel fragment list and its position is used
 to traverse the octree and find the leaf-node.
 */
 
-#version 420 core
+#version 430 core
+
+#include "assets/shader/_threadIndex.shader"
 
 layout(r32ui) uniform uimageBuffer voxelFragList_position;
 layout(r32ui) uniform uimage3D voxelFragTex_color;
@@ -73,8 +75,12 @@ void storeInLeaf(in vec3 posTex, in int nodeAddress, in uint voxelColorU, in uin
 }
 
 void main() {
+  if (!isThreadActive()) {
+    return;
+  }
+
   // Get the voxel's position and color from the voxel frag list.
-  uint voxelPosU = imageLoad(voxelFragList_position, gl_VertexID).x;
+  uint voxelPosU = imageLoad(voxelFragList_position, THREAD_ID).x;
   uvec3 voxelPos = uintXYZ10ToVec3(voxelPosU);
     
   uint voxelColorU = imageLoad(voxelFragTex_color, ivec3(voxelPos)).x;
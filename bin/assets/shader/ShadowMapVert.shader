@@ -23,15 +23,21 @@
 * \author Andreas Weinmann (andy.weinmann@gmail.com)
 */
 
-#version 420 core
+#version 430 core
 
 layout (location = 0) in vec3 v_position;
 out vec4 posWS;
  
 uniform mat4 viewProjMat;
 uniform mat4 modelMat;
+
+#include "assets/shader/_meshBatch.shader"
  
 void main(){
+#ifdef MESH_BATCHING
+  posWS = drawData[v_drawID].modelMat * vec4(v_position, 1);
+#else
   posWS = modelMat* vec4(v_position,1);
+#endif
   gl_Position = viewProjMat * posWS;
 }
\ No newline at end of file
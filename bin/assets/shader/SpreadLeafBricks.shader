@@ -31,15 +31,15 @@ Every voxel is read from the voxel fragment list and its position is used
 to traverse the octree and find the leaf-node.
 */
 
-#version 420 core
+#version 430 core
+
+#include "assets/shader/_threadIndex.shader"
 
 layout(r32ui) uniform readonly uimageBuffer nodePool_color;
 layout(rgba8) uniform volatile image3D brickPool_value;
 
-uniform usampler2D nodeMap;
+uniform usamplerBuffer lightNodeList;
 uniform usamplerBuffer levelAddressBuffer;
-uniform ivec2 nodeMapOffset[8];
-uniform ivec2 nodeMapSize[8];
 
 uniform uint numLevels;  // Number of levels in the octree
 
@@ -80,6 +80,10 @@ void loadVoxelValues(in ivec3 brickAddress){
 
 ///*
 void main() {
+  if (!isThreadActive()) {
+    return;
+  }
+
   uint nodeAddress = getThreadNode();
   if(nodeAddress == NODE_NOT_FOUND) {
     return;  // The requested threadID-node does not belong to the current level
@@ -33,13 +33,26 @@ layout(r32ui) uniform volatile uimage3D voxelFragTex_normal;
 
 layout(binding = 0) uniform atomic_uint voxel_index;
 
+#ifdef MESH_BATCHING
+uniform sampler2DArray diffuseTexArray;
+#else
 uniform sampler2D diffuseTex;
+#endif
 uniform uint voxelTexSize;
 
 in VoxelData {
     vec3 posTexSpace;
     vec3 normal;
     vec2 uv;
+    flat int texLayer;
+#ifdef CONSERVATIVE_VOXELIZATION
+    flat vec3 aabbMin;
+    flat vec3 aabbMax;
+    flat int projAxis;
+    flat vec3 triV0;
+    flat vec3 triV1;
+    flat vec3 triV2;
+#endif
 } In;
 
 
@@ -102,10 +115,64 @@ uint imageAtomicRGBA8Avg(layout(r32ui) volatile uimage3D img,
     return newValU;
 }
 
+void storeVoxelFragment(uvec3 voxel, vec4 diffColor, vec4 normal) {
+  uint voxelIndex = atomicCounterIncrement(voxel_index);
+  memoryBarrier();
+
+  //Store voxel position in FragmentList
+  imageStore(voxelFragList_position, int(voxelIndex), uvec4(vec3ToUintXYZ10(voxel)));
+
+  //Avg voxel attributes and store in FragmentTexXXX
+  imageAtomicRGBA8Avg(voxelFragTex_color, ivec3(voxel), diffColor);
+  imageAtomicRGBA8Avg(voxelFragTex_normal, ivec3(voxel), normal);
+}
+
+#ifdef CONSERVATIVE_VOXELIZATION
+// True if axis separates the triangle (relative to the voxel center) from
+// the voxel, i.e. the projected intervals do not overlap
+bool isSeparatingAxis(vec3 axis, vec3 v0, vec3 v1, vec3 v2) {
+  float p0 = dot(v0, axis);
+  float p1 = dot(v1, axis);
+  float p2 = dot(v2, axis);
+  float r = 0.5 * (abs(axis.x) + abs(axis.y) + abs(axis.z));
+  return min(p0, min(p1, p2)) > r || max(p0, max(p1, p2)) < -r;
+}
+
+// Separating axis test of the triangle against a voxel. The three voxel
+// axes are covered by the bounds clip and the plane normal only roughly by
+// the depth range, so the plane and the nine edge cross axis products are
+// tested here.
+bool overlapsTriangle(ivec3 voxel) {
+  vec3 center = vec3(voxel) + 0.5;
+  vec3 v0 = In.triV0 - center;
+  vec3 v1 = In.triV1 - center;
+  vec3 v2 = In.triV2 - center;
+  vec3 edges[3] = vec3[3](v1 - v0, v2 - v1, v0 - v2);
+
+  if (isSeparatingAxis(cross(edges[0], edges[1]), v0, v1, v2)) {
+    return false;
+  }
+
+  for (int e = 0; e < 3; ++e) {
+    for (int a = 0; a < 3; ++a) {
+      vec3 voxelAxis = vec3(0.0);
+      voxelAxis[a] = 1.0;
+      if (isSeparatingAxis(cross(edges[e], voxelAxis), v0, v1, v2)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+#endif
+
 void main() {
-  uvec3 baseVoxel = uvec3(floor(In.posTexSpace * voxelTexSize));
-  
+#ifdef MESH_BATCHING
+  vec4 diffColor = texture(diffuseTexArray,
+                           vec3(In.uv.x, 1.0 - In.uv.y, In.texLayer));
+#else
   vec4 diffColor = texture(diffuseTex,  vec2(In.uv.x, 1.0 - In.uv.y));
+#endif
   // Pre-multiply alpha:
   diffColor.a = 1.0;
 
@@ -113,23 +180,42 @@ void main() {
   normal.xyz *= diffColor.a;
   normal.a = diffColor.a;
 
-
-  uint voxelIndex = atomicCounterIncrement(voxel_index);
-  memoryBarrier();
-
-  //Store voxel position in FragmentList
-  imageStore(voxelFragList_position, int(voxelIndex), uvec4(vec3ToUintXYZ10(baseVoxel)));
+#ifdef CONSERVATIVE_VOXELIZATION
+  vec3 posVoxel = In.posTexSpace * float(voxelTexSize);
+
+  // Depth range of the triangle plane within the pixel
+  float depth = posVoxel[In.projAxis];
+  float depthExtent = 0.5 * (abs(dFdx(depth)) + abs(dFdy(depth)));
+
+  // Clip the pixels of the enlarged triangle outside of the bounds
+  ivec3 voxel = ivec3(floor(posVoxel));
+  ivec3 aabbMin = ivec3(floor(In.aabbMin));
+  ivec3 aabbMax = ivec3(floor(In.aabbMax));
+  voxel[In.projAxis] = aabbMin[In.projAxis];
+  if (any(lessThan(voxel, aabbMin)) || any(greaterThan(voxel, aabbMax))) {
+    discard;
+  }
+
+  int depthMin = max(int(floor(depth - depthExtent)), aabbMin[In.projAxis]);
+  int depthMax = min(int(floor(depth + depthExtent)), aabbMax[In.projAxis]);
+
+  // One fragment per voxel the triangle touches, at most three as the
+  // triangle is projected along its dominant axis
+  for (int d = depthMin; d <= depthMax; ++d) {
+    voxel[In.projAxis] = d;
+    if (overlapsTriangle(voxel)) {
+      storeVoxelFragment(uvec3(voxel), diffColor, normal);
+    }
+  }
+#else
+  uvec3 baseVoxel = uvec3(floor(In.posTexSpace * voxelTexSize));
+  storeVoxelFragment(baseVoxel, diffColor, normal);
+#endif
   
-  //Avg voxel attributes and store in FragmentTexXXX
   /*
   uint diffColorU = convVec4ToRGBA8(diffColor * 255.0);
   uint normalU = convVec4ToRGBA8(normal * 255.0);
   imageStore(voxelFragTex_color, ivec3(baseVoxel), uvec4(diffColorU));
   imageStore(voxelFragTex_normal, ivec3(baseVoxel), uvec4(normalU));
   //*/
-   
-  imageAtomicRGBA8Avg(voxelFragTex_color, ivec3(baseVoxel), diffColor);
-  imageAtomicRGBA8Avg(voxelFragTex_normal, ivec3(baseVoxel), normal);
-
-  
 }
@@ -32,12 +32,22 @@ in VertexData {
     vec3 pos;
     vec3 normal;
     vec2 uv;
+    flat int texLayer;
 } In[3];
 
 out VoxelData {
     vec3 posTexSpace;
     vec3 normal;
     vec2 uv;
+    flat int texLayer;
+#ifdef CONSERVATIVE_VOXELIZATION
+    flat vec3 aabbMin;  // Bounds of the triangle in voxels
+    flat vec3 aabbMax;
+    flat int projAxis;
+    flat vec3 triV0;  // Triangle vertices in voxels
+    flat vec3 triV1;
+    flat vec3 triV2;
+#endif
 } Out;
 
 
@@ -82,6 +92,89 @@ uint calcProjAxis() {
   return projAxis;
 }
 
+#ifdef CONSERVATIVE_VOXELIZATION
+// Axis along which the geometric normal is largest. The projected triangle
+// then covers at most three voxels in depth per pixel.
+uint calcProjAxisGeometric() {
+  vec3 n = abs(cross(In[1].pos - In[0].pos, In[2].pos - In[0].pos));
+  if (n.x >= n.y && n.x >= n.z) {
+    return X;
+  }
+  return n.y >= n.z ? Y : Z;
+}
+
+void main()
+{
+  uint projAxisIdx = calcProjAxisGeometric();
+
+  vec3 projPos[3];
+  vec3 posTexSpace[3];
+  for (int i = 0; i < 3; ++i) {
+    projPos[i] = (viewProjs[projAxisIdx] * vec4(In[i].pos, 1.0)).xyz;
+    posTexSpace[i] =
+      (voxelGridTransformI * vec4(In[i].pos, 1.0)).xyz * 0.5 + 0.5;
+  }
+
+  // The enlarged triangle covers pixels beyond the triangle, e.g. at sharp
+  // vertices. The fragment shader discards them with the bounds.
+  vec3 aabbMin = min(min(posTexSpace[0], posTexSpace[1]), posTexSpace[2]);
+  vec3 aabbMax = max(max(posTexSpace[0], posTexSpace[1]), posTexSpace[2]);
+
+  // Barycentric coordinates of the emitted vertices
+  vec3 bary[3] = vec3[3](vec3(1.0, 0.0, 0.0),
+                         vec3(0.0, 1.0, 0.0),
+                         vec3(0.0, 0.0, 1.0));
+
+#ifndef HW_CONSERVATIVE_RASTER
+  // Move every edge outwards by the half pixel diagonal projected onto its
+  // normal. The new vertices are the intersections of adjacent edges, so
+  // every pixel the triangle touches has its center in the new triangle.
+  vec2 e0 = projPos[1].xy - projPos[0].xy;
+  vec2 e1 = projPos[2].xy - projPos[0].xy;
+  float area = e0.x * e1.y - e0.y * e1.x;
+
+  if (abs(area) > 1e-12) {
+    float halfPixel = 1.0 / float(voxelTexSize);
+
+    // Edge lines in homogeneous form, positive inside the triangle
+    vec3 edges[3];
+    for (int i = 0; i < 3; ++i) {
+      edges[i] = cross(vec3(projPos[i].xy, 1.0),
+                       vec3(projPos[(i + 1) % 3].xy, 1.0)) * sign(area);
+      edges[i].z += halfPixel * (abs(edges[i].x) + abs(edges[i].y));
+    }
+
+    for (int i = 0; i < 3; ++i) {
+      vec3 corner = cross(edges[(i + 2) % 3], edges[i]);
+      vec2 d = corner.xy / corner.z - projPos[0].xy;
+      float b1 = (d.x * e1.y - d.y * e1.x) / area;
+      float b2 = (e0.x * d.y - e0.y * d.x) / area;
+      bary[i] = vec3(1.0 - b1 - b2, b1, b2);
+    }
+  }
+#endif
+
+  for (int i = 0; i < 3; ++i) {
+    vec3 b = bary[i];
+    gl_Position = vec4(projPos[0] * b.x + projPos[1] * b.y + projPos[2] * b.z,
+                       1.0);
+    Out.posTexSpace = posTexSpace[0] * b.x + posTexSpace[1] * b.y
+                      + posTexSpace[2] * b.z;
+    Out.normal = In[0].normal * b.x + In[1].normal * b.y + In[2].normal * b.z;
+    Out.uv = In[0].uv * b.x + In[1].uv * b.y + In[2].uv * b.z;
+    Out.texLayer = In[0].texLayer;
+    Out.aabbMin = aabbMin * float(voxelTexSize);
+    Out.aabbMax = aabbMax * float(voxelTexSize);
+    Out.projAxis = int(projAxisIdx);
+    Out.triV0 = posTexSpace[0] * float(voxelTexSize);
+    Out.triV1 = posTexSpace[1] * float(voxelTexSize);
+    Out.triV2 = posTexSpace[2] * float(voxelTexSize);
+    EmitVertex();
+  }
+  EndPrimitive();
+}
+
+#else
 void main()
 {
   const vec3 worldAxes[3] = vec3[3]( vec3(1.0, 0.0, 0.0),
@@ -105,12 +198,14 @@ void main()
 
     Out.normal = In[i].normal;
     Out.uv = In[i].uv;
+    Out.texLayer = In[i].texLayer;
 
     // done with the vertex
     EmitVertex();
   }
   EndPrimitive();
 }
+#endif
 
 
 /*
@@ -23,26 +23,39 @@
 * \author Andreas Weinmann (andy.weinmann@gmail.com)
 */
 
-#version 420
+#version 430
 
-in vec3 v_position;
-in vec3 v_normal;
-in vec3 v_uvw;
+layout(location = 0) in vec3 v_position;
+layout(location = 1) in vec3 v_normal;
+layout(location = 3) in vec3 v_uvw;
 
 out VertexData {
   vec3 pos;
   vec3 normal;
   vec2 uv;
+  flat int texLayer;
 } Out;
 
 uniform mat4 modelWorld;
 uniform mat3 modelWorldNormal;
 
+#include "assets/shader/_meshBatch.shader"
+
 void main() {
   // We don't need to write gl_Position here because we'll generate positions
   // in the geometry shader.
 
-  Out.pos = (modelWorld * vec4(v_position, 1.0)).xyz;
-  Out.normal = modelWorldNormal * v_normal;
+#ifdef MESH_BATCHING
+  mat4 model = drawData[v_drawID].modelMat;
+  mat3 normalModel = mat3(drawData[v_drawID].normalMat);
+  Out.texLayer = drawData[v_drawID].diffuseLayer;
+#else
+  mat4 model = modelWorld;
+  mat3 normalModel = modelWorldNormal;
+  Out.texLayer = 0;
+#endif
+
+  Out.pos = (model * vec4(v_position, 1.0)).xyz;
+  Out.normal = normalModel * v_normal;
   Out.uv = v_uvw.xy;
 }
@@ -5,6 +5,20 @@
 
 
 
+#ifdef CONE_TRACE_STATS
+uint numTracedCones = 0U;
+uint numConeSteps = 0U;
+#endif
+
+#ifdef BRICK_USAGE_FEEDBACK
+void markNodeUsed(in int address) {
+  // Most nodes are hit by many samples, only write once per frame
+  if (imageLoad(nodePool_usage, address).x != brickUsageStamp) {
+    imageStore(nodePool_usage, address, uvec4(brickUsageStamp));
+  }
+}
+#endif
+
 void correctAlpha(inout vec4 color, in float alphaCorrection) {
   const float oldColA = color.a;
   color.a = 1.0 - pow((1.0 - color.a), alphaCorrection);
@@ -228,10 +242,18 @@ vec4 coneTrace(in vec3 rayOriginTex, in vec3 rayDirTex, in float coneDiameter, i
     return vec4(0);
   }
 
+#ifdef CONE_TRACE_STATS
+  ++numTracedCones;
+#endif
+
   vec4 returnColor = vec4(0);
   for (float d = tEnter + nodeSizes[numLevels - 1]; d < tLeave; d += nodeSize) {
     const vec3 posTex = (rayOriginTex + rayDirTex * d);
 
+#ifdef CONE_TRACE_STATS
+    ++numConeSteps;
+#endif
+
     nodeSize = clamp(coneDiameter * d, nodeSizes[numLevels - 1], 1.0);
     const float sampleLOD = clamp(log2(1.0 / nodeSize), 0.0, float(numLevels) - 1.00001);
         
@@ -241,11 +263,42 @@ vec4 coneTrace(in vec3 rayOriginTex, in vec3 rayDirTex, in float coneDiameter, i
     int cAddress = traverseOctree_level(posTex, cLevel, cMin, cMax, pAddress, pMin, pMax);
     
     if (cAddress == int(NODE_NOT_FOUND)) {
+      // cMin and cMax bound the coarsest empty node on the way down, so the
+      // cone can leave all of it in one step instead of one per LOD node
+      float tEmptyEnter = 0.0;
+      float tEmptyLeave = 0.0;
+      if (skipEmptySpace &&
+          intersectRayWithAABB(posTex, rayDirTex, cMin, cMax,
+                               tEmptyEnter, tEmptyLeave)) {
+        nodeSize = max(nodeSize, tEmptyLeave + nodeSizes[numLevels - 1] * 0.01);
+      }
       continue;
     }
 
-    const ivec3 cBrickAdd = ivec3(uintXYZ10ToVec3(texelFetch(nodePool_colorS, cAddress).x));
-    const ivec3 pBrickAdd = ivec3(uintXYZ10ToVec3(texelFetch(nodePool_colorS, pAddress).x));
+    uint cBrickU = texelFetch(nodePool_colorS, cAddress).x;
+    uint pBrickU = texelFetch(nodePool_colorS, pAddress).x;
+    float cWeight = fract(sampleLOD);
+
+#ifdef BRICK_USAGE_FEEDBACK
+    markNodeUsed(cAddress);
+    markNodeUsed(pAddress);
+
+    // A brick that is not paged in yet is replaced by the other one of the
+    // LOD pair. Without both, the sample is skipped like an empty node.
+    if (cBrickU == BRICK_NOT_RESIDENT && pBrickU == BRICK_NOT_RESIDENT) {
+      continue;
+    }
+    if (cBrickU == BRICK_NOT_RESIDENT) {
+      cBrickU = pBrickU;
+      cWeight = 0.0;
+    } else if (pBrickU == BRICK_NOT_RESIDENT) {
+      pBrickU = cBrickU;
+      cWeight = 1.0;
+    }
+#endif
+
+    const ivec3 cBrickAdd = ivec3(uintXYZ10ToVec3(cBrickU));
+    const ivec3 pBrickAdd = ivec3(uintXYZ10ToVec3(pBrickU));
     const vec3 cBrickAddUVW = (vec3(cBrickAdd) + 0.5) / brickRes;
     const vec3 pBrickAddUVW = (vec3(pBrickAdd) + 0.5) / brickRes;
     
@@ -276,7 +329,7 @@ vec4 coneTrace(in vec3 rayOriginTex, in vec3 rayDirTex, in float coneDiameter, i
     correctAlpha(cCol, alphaCorrection);
     correctAlpha(pCol, alphaCorrection * 2);
 
-    const vec4 newCol = mix(pCol, cCol, fract(sampleLOD));
+    const vec4 newCol = mix(pCol, cCol, cWeight);
     returnColor += (1.0 - returnColor.a) * newCol;
    
     if (returnColor.a > 0.99 || (maxDistance > 0.000001 && d >= maxDistance)) {
@@ -0,0 +1,116 @@
+// Encoding of the G-buffer, shared by the deferred shader (pack) and the
+// final render shader (unpack). Layout:
+//   0: RGB8     diffuse color
+//   1: RG16     normal, octahedral encoded
+//   2: RGB10A2  tangent frame as quaternion (xyz: smallest three
+//               components, a: index of the dropped one)
+//   D24S8       depth, the position is reconstructed from it
+
+const float SQRT_HALF = 0.70710678118654752440;
+
+vec2 signNotZero(in vec2 v) {
+  return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 packNormal(in vec3 n) {
+  n /= abs(n.x) + abs(n.y) + abs(n.z);
+  vec2 oct = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signNotZero(n.xy);
+  return oct * 0.5 + 0.5;
+}
+
+vec3 unpackNormal(in vec2 packed) {
+  vec2 oct = packed * 2.0 - 1.0;
+  vec3 n = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+  if (n.z < 0.0) {
+    n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+  }
+  return normalize(n);
+}
+
+// Rotation from the tangent frame (tangent, bitangent, normal) to world
+// space. The columns of frame have to be orthonormal and right handed.
+vec4 frameToQuat(in mat3 frame) {
+  float trace = frame[0][0] + frame[1][1] + frame[2][2];
+  vec4 q;
+  if (trace > 0.0) {
+    float s = 0.5 / sqrt(trace + 1.0);
+    q = vec4((frame[1][2] - frame[2][1]) * s,
+             (frame[2][0] - frame[0][2]) * s,
+             (frame[0][1] - frame[1][0]) * s,
+             0.25 / s);
+  } else if (frame[0][0] > frame[1][1] && frame[0][0] > frame[2][2]) {
+    float s = 2.0 * sqrt(1.0 + frame[0][0] - frame[1][1] - frame[2][2]);
+    q = vec4(0.25 * s,
+             (frame[1][0] + frame[0][1]) / s,
+             (frame[2][0] + frame[0][2]) / s,
+             (frame[1][2] - frame[2][1]) / s);
+  } else if (frame[1][1] > frame[2][2]) {
+    float s = 2.0 * sqrt(1.0 + frame[1][1] - frame[0][0] - frame[2][2]);
+    q = vec4((frame[1][0] + frame[0][1]) / s,
+             0.25 * s,
+             (frame[2][1] + frame[1][2]) / s,
+             (frame[2][0] - frame[0][2]) / s);
+  } else {
+    float s = 2.0 * sqrt(1.0 + frame[2][2] - frame[0][0] - frame[1][1]);
+    q = vec4((frame[2][0] + frame[0][2]) / s,
+             (frame[2][1] + frame[1][2]) / s,
+             0.25 * s,
+             (frame[0][1] - frame[1][0]) / s);
+  }
+  return normalize(q);
+}
+
+// Builds the tangent frame around the (shading) normal. The tangent is
+// orthogonalized against it, any perpendicular vector is used if the mesh
+// has no usable tangent.
+vec4 packTangentFrame(in vec3 normal, in vec3 tangent) {
+  vec3 t = tangent - normal * dot(normal, tangent);
+  if (dot(t, t) < 1e-8) {
+    t = abs(normal.x) < 0.9 ? cross(normal, vec3(1, 0, 0))
+                            : cross(normal, vec3(0, 1, 0));
+  }
+  t = normalize(t);
+  vec4 q = frameToQuat(mat3(t, cross(normal, t), normal));
+
+  // q and -q are the same rotation: drop the largest component and make it
+  // positive, the other three are then within +-sqrt(0.5)
+  vec4 absQ = abs(q);
+  int iMax = 0;
+  float maxVal = absQ.x;
+  if (absQ.y > maxVal) { iMax = 1; maxVal = absQ.y; }
+  if (absQ.z > maxVal) { iMax = 2; maxVal = absQ.z; }
+  if (absQ.w > maxVal) { iMax = 3; }
+
+  if (q[iMax] < 0.0) {
+    q = -q;
+  }
+
+  vec3 rest = iMax == 0 ? q.yzw : iMax == 1 ? q.xzw : iMax == 2 ? q.xyw : q.xyz;
+  return vec4(rest / SQRT_HALF * 0.5 + 0.5, float(iMax) / 3.0);
+}
+
+vec4 unpackTangentQuat(in vec4 packed) {
+  vec3 rest = (packed.xyz * 2.0 - 1.0) * SQRT_HALF;
+  float largest = sqrt(max(0.0, 1.0 - dot(rest, rest)));
+  int iMax = int(packed.w * 3.0 + 0.5);
+
+  if (iMax == 0) return vec4(largest, rest);
+  if (iMax == 1) return vec4(rest.x, largest, rest.yz);
+  if (iMax == 2) return vec4(rest.xy, largest, rest.z);
+  return vec4(rest, largest);
+}
+
+// First column of the rotation, i.e. the tangent in world space
+vec3 unpackTangent(in vec4 packed) {
+  vec4 q = unpackTangentQuat(packed);
+  return vec3(1.0 - 2.0 * (q.y * q.y + q.z * q.z),
+              2.0 * (q.x * q.y + q.w * q.z),
+              2.0 * (q.x * q.z - q.w * q.y));
+}
+
+// World-space position of the fragment at uv with the given depth
+vec3 reconstructPosition(in vec2 uv, in float depth, in mat4 viewProjI) {
+  vec4 posNDC = vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+  vec4 posWS = viewProjI * posNDC;
+  return posWS.xyz / posWS.w;
+}
@@ -0,0 +1,20 @@
+// Per-draw data of the MeshBatch (see MeshBatch.h), only declared if the
+// pass draws the batch (MESH_BATCHING). The draw ID comes in as instanced
+// attribute, it is the base instance of the draw's indirect command.
+
+#ifdef MESH_BATCHING
+struct SDrawData {
+  mat4 modelMat;
+  mat4 normalMat;
+  int diffuseLayer;
+  int normalLayer;
+  int diffuseArray;  // Bound per multi-draw, see MeshBatchDraw
+  int normalArray;
+};
+
+layout(std430, binding = MESH_BATCH_BINDING) readonly buffer MeshBatchDraws {
+  SDrawData drawData[];
+};
+
+layout(location = 4) in uint v_drawID;
+#endif
@@ -0,0 +1,26 @@
+// Thread index of the thread-per-item kernels. They are either launched as
+// points of a vertex shader or as compute shader (COMPUTE_SHADER_PATH).
+// In the compute case the last workgroup may contain more invocations than
+// items, so each kernel has to return early if !isThreadActive().
+
+#ifdef COMPUTE_SHADER_PATH
+layout(local_size_x = THREAD_GROUP_SIZE) in;
+
+// The command buffer the kernel was dispatched with (see ThreadDispatch)
+layout(std430, binding = THREAD_CMD_BINDING) readonly buffer ThreadCommand {
+  uint threadCmd_numThreads;
+};
+
+#define THREAD_ID int(gl_GlobalInvocationID.y * gl_NumWorkGroups.x \
+                      * uint(THREAD_GROUP_SIZE) + gl_GlobalInvocationID.x)
+
+bool isThreadActive() {
+  return uint(THREAD_ID) < threadCmd_numThreads;
+}
+#else
+#define THREAD_ID gl_VertexID
+
+bool isThreadActive() {
+  return true;
+}
+#endif
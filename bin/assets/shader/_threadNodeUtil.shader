@@ -10,21 +10,14 @@ uint getThreadNode() {
       int nextLevelStart = int(texelFetch(levelAddressBuffer, int(level + 1)).x);
       memoryBarrier();
 
-     index = uint(levelStart) + uint(gl_VertexID);
+     index = uint(levelStart) + uint(THREAD_ID);
 
       if (level < int(numLevels - 1) && index >= nextLevelStart) {
         return NODE_NOT_FOUND;
       }
 #elif THREAD_MODE == THREAD_MODE_LIGHT
-      // Only lightMap-Node
-  
-      ivec2 nmSize = nodeMapSize[level];
-  
-      ivec2 uv = ivec2(0);
-      uv.x = (gl_VertexID % nmSize.x);
-      uv.y = (gl_VertexID / nmSize.x);
-
-      index = texelFetch(nodeMap, nodeMapOffset[level] + uv, 0).x;
+      // Only the unique lightMap-Nodes of this level (see CompactNodeMap)
+      index = texelFetch(lightNodeList, THREAD_ID).x;
 #else
 #endif
     return index;
@@ -3,6 +3,10 @@
 // _traverseUtil.shader
 
 
+// Returns the node of targetLevel that contains posTex. If the octree ends
+// above targetLevel, NODE_NOT_FOUND is returned and nodePosTex and
+// nodePosMaxTex bound the node without children the descent stopped at, the
+// coarsest empty node around posTex.
 int traverseOctree_level(in vec3 posTex, in uint targetLevel,
                    out vec3 nodePosTex, out vec3 nodePosMaxTex, 
                    out int parentAddress, 
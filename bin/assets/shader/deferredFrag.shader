@@ -22,36 +22,67 @@
 * \author Dominik Lazarek (dominik.lazarek@gmail.com)
 * \author Andreas Weinmann (andy.weinmann@gmail.com)
 */
-#version 420
+#version 430
 
 in VertexData {
   vec3 position;
   vec3 normal;
   vec3 tangent;
   vec2 uv;
+  flat ivec2 texLayers;
 } In;
 
+#ifdef MESH_BATCHING
+uniform sampler2DArray diffuseTexArray;
+uniform sampler2DArray normalTexArray;
+
+vec4 sampleDiffuse(in vec2 uv) {
+  return texture(diffuseTexArray, vec3(uv, In.texLayers.x));
+}
+
+vec4 sampleNormalMap(in vec2 uv) {
+  return texture(normalTexArray, vec3(uv, In.texLayers.y));
+}
+
+bool hasNormalMap() {
+  return In.texLayers.y >= 0;
+}
+#else
 uniform sampler2D	diffuseTex;
 uniform sampler2D normalTex;
 uniform int useNormalMap = 0;
 
-out vec4 color[4];
+vec4 sampleDiffuse(in vec2 uv) {
+  return texture(diffuseTex, uv);
+}
+
+vec4 sampleNormalMap(in vec2 uv) {
+  return texture(normalTex, uv);
+}
+
+bool hasNormalMap() {
+  return useNormalMap == 1;
+}
+#endif
+
+out vec4 color[3];
+
+#include "assets/shader/_gBufferPacking.shader"
 
 void main(void)
 {
-  color[0] = vec4(texture(diffuseTex, vec2(In.uv.x, 1.0 - In.uv.y)).rgb, 0);
-  color[1] = vec4(In.position, 0); 
-  if (useNormalMap == 1) {
-    vec3 surfNormal = normalize(In.normal);
+  color[0] = vec4(sampleDiffuse(vec2(In.uv.x, 1.0 - In.uv.y)).rgb, 0);
+
+  // The position is reconstructed from the depth buffer
+  vec3 normal = normalize(In.normal);
+  if (hasNormalMap()) {
+    vec3 surfNormal = normal;
     vec3 surfTangent = normalize(In.tangent);
     vec3 bitangent = cross(surfNormal, surfTangent);
-    vec3 nMap = texture(normalTex, vec2(In.uv.x, 1.0 - In.uv.y)).xyz * 2 - 1;
-    vec3 normal = surfNormal + surfTangent * nMap.x + bitangent * nMap.y;
-    color[2] = vec4(normalize(normal), 0);
-  } else {
-    color[2] = vec4(normalize(In.normal), 0);  
+    vec3 nMap = sampleNormalMap(vec2(In.uv.x, 1.0 - In.uv.y)).xyz * 2 - 1;
+    normal = normalize(surfNormal + surfTangent * nMap.x + bitangent * nMap.y);
   }
 
-  
-  color[3] = vec4(normalize(In.tangent), 0);
+  color[1] = vec4(packNormal(normal), 0, 0);
+  color[2] = packTangentFrame(normal, In.tangent);
 }
@@ -23,7 +23,7 @@
 * \author Andreas Weinmann (andy.weinmann@gmail.com)
 */
 
-#version 420
+#version 430
 // vertex position in modelspace
 layout(location = 0) in vec3 v_position;
 layout(location = 1) in vec3 v_normal;
@@ -35,20 +35,34 @@ uniform mat4 viewMat;
 uniform mat4 modelMat;
 uniform mat3 normalMat;
 
+#include "assets/shader/_meshBatch.shader"
+
 // World-space vectors
 out VertexData {
   vec3 position;
   vec3 normal;
   vec3 tangent;
   vec2 uv;
+  flat ivec2 texLayers;  // Diffuse and normal map layer if batched
 } Out;
 
 void main()
 {
-  Out.position = (modelMat * vec4(v_position, 1.0)).xyz;
+#ifdef MESH_BATCHING
+  mat4 model = drawData[v_drawID].modelMat;
+  mat3 normalModel = mat3(drawData[v_drawID].normalMat);
+  Out.texLayers = ivec2(drawData[v_drawID].diffuseLayer,
+                        drawData[v_drawID].normalLayer);
+#else
+  mat4 model = modelMat;
+  mat3 normalModel = normalMat;
+  Out.texLayers = ivec2(0);
+#endif
+
+  Out.position = (model * vec4(v_position, 1.0)).xyz;
   gl_Position = projectionMat * viewMat * vec4(Out.position, 1.0);
 
-  Out.normal = normalMat * v_normal;
-  Out.tangent = (modelMat * vec4(v_tangent, 0.0)).xyz;
+  Out.normal = normalModel * v_normal;
+  Out.tangent = (model * vec4(v_tangent, 0.0)).xyz;
   Out.uv = v_uv0.xy;
 }
@@ -38,22 +38,32 @@ uniform sampler3D brickPool_normal;
 uniform sampler3D brickPool_irradiance; 
 
 uniform sampler2D gBuffer_color;
-uniform sampler2D gBuffer_pos;
 uniform sampler2D gBuffer_normal;
 uniform sampler2D gBuffer_tangent;
-uniform sampler2D shadowMap;
+uniform sampler2D gBuffer_depth;
+uniform sampler2DArray shadowMap;
 
 //layout(r32ui) uniform readonly uimageBuffer nodePool_next;
 uniform usamplerBuffer nodePool_nextS; 
 uniform usamplerBuffer nodePool_colorS;
 
-uniform vec3 lightDir;
-uniform mat4 lightCamProjMat;
-uniform mat4 lightCamviewMat;
+#ifdef BRICK_USAGE_FEEDBACK
+// Last frame each node was sampled in, read back by the BrickCache
+layout(r32ui) uniform uimageBuffer nodePool_usage;
+uniform uint brickUsageStamp;
+#endif
+
+// MAX_NUM_LIGHTS is defined by the application
+uniform uint numLights;
+uniform vec3 lightDir[MAX_NUM_LIGHTS];
+uniform mat4 lightViewProj[MAX_NUM_LIGHTS];
 
 uniform uint voxelGridResolution;
 uniform mat4 viewI;
+uniform mat4 viewProjI;
 uniform mat4 voxelGridTransformI;
+uniform mat4 finerGridTransformI;  // Of the next finer SVO cascade
+uniform vec2 cascadeGridRange;  // Pixels of this SVO cascade
 uniform uint numLevels;
 
 
@@ -65,12 +75,32 @@ uniform float coneAngle;
 uniform float coneMaxDistance;
 uniform bool useLighting = true;
 uniform bool renderAO = false;
+uniform bool skipEmptySpace = true;
+
+#ifdef CONE_TRACE_STATS
+// Number of traced cones and their steps of each pixel in this frame, two
+// values per pixel. They are summed on the CPU.
+layout(r32ui) uniform writeonly uimageBuffer coneTraceStats;
+uniform uint coneTraceStatsWidth;
+#endif
 
 #include "assets/shader/_utilityFunctions.shader"
 #include "assets/shader/_traverseUtil.shader"
 #include "assets/shader/_traverseFast.shader"
 #include "assets/shader/_coneTrace.shader"
 
+#ifdef CONE_TRACE_STATS
+void storeConeTraceStats() {
+  int pixel = 2 * (int(gl_FragCoord.x)
+                   + int(gl_FragCoord.y) * int(coneTraceStatsWidth));
+  if (pixel + 1 < imageSize(coneTraceStats)) {
+    imageStore(coneTraceStats, pixel, uvec4(numTracedCones));
+    imageStore(coneTraceStats, pixel + 1, uvec4(numConeSteps));
+  }
+}
+#endif
+#include "assets/shader/_gBufferPacking.shader"
+
 const float PI = 3.1415926535897932384626433832795;
 
 
@@ -103,9 +133,24 @@ vec4 gatherIndirectIllum(in vec3 posTex, in vec3 normal, in vec3 tangent) {
 
 void main(void)
 {
-  vec4 posWS = vec4(vec3(texture(gBuffer_pos, In.uv)),1);
-  vec3 normalWS = texture(gBuffer_normal, In.uv).xyz;
-  vec3 tangentWS = texture(gBuffer_tangent, In.uv).xyz;
+  float depth = texture(gBuffer_depth, In.uv).x;
+  vec4 posWS = vec4(reconstructPosition(In.uv, depth, viewProjI), 1);
+
+  // Each pixel is shaded with the finest cascade that contains it, at
+  // least a cell inside the displayed grid
+  vec3 finerPos = abs((finerGridTransformI * posWS).xyz);
+  vec3 gridPos = abs((voxelGridTransformI * posWS).xyz);
+  float finerDist = max(finerPos.x, max(finerPos.y, finerPos.z));
+  float gridDist = max(gridPos.x, max(gridPos.y, gridPos.z));
+  if (finerDist < cascadeGridRange.x || gridDist >= cascadeGridRange.y) {
+#ifdef CONE_TRACE_STATS
+    storeConeTraceStats();  // Other cascades
+#endif
+    discard;
+  }
+
+  vec3 normalWS = unpackNormal(texture(gBuffer_normal, In.uv).xy);
+  vec3 tangentWS = unpackTangent(texture(gBuffer_tangent, In.uv));
   vec4 diffColor = vec4(texture(gBuffer_color, In.uv).xyz, 1.0);
   vec3 posTex = (voxelGridTransformI * posWS).xyz * 0.5 + 0.5; 
   
@@ -117,31 +162,32 @@ void main(void)
   }
 
   else {
-    // Shadow mapping
-   float visibility = 1.0;
-   vec4 posLVS = lightCamviewMat * posWS;
-   vec4 posLProj = lightCamProjMat * posLVS;
-   posLProj.xyz /= posLProj.w;
-   posLProj.xyz = posLProj.xyz * 0.5 + 0.5;
-
    vec3 lightIntensity = vec3(0);
    vec3 view = normalize(posWS.xyz - viewI[3].xyz);
 
    float e = 0.0008;
    if (useLighting) {
-    float sMapDepth = abs(texture(shadowMap, posLProj.xy).x);
-    if (posLProj.x < 0.00001 ||posLProj.x > 0.99999 || posLProj.y < 0.000001 ||posLProj.y > 0.99999 || sMapDepth + e < abs(posLProj.z)){
+    for (int iLight = 0; iLight < int(numLights); ++iLight) {
+     // Shadow mapping
+     float visibility = 1.0;
+     vec4 posLProj = lightViewProj[iLight] * posWS;
+     posLProj.xyz /= posLProj.w;
+     posLProj.xyz = posLProj.xyz * 0.5 + 0.5;
+
+     float sMapDepth = abs(texture(shadowMap, vec3(posLProj.xy, iLight)).x);
+     if (posLProj.x < 0.00001 ||posLProj.x > 0.99999 || posLProj.y < 0.000001 ||posLProj.y > 0.99999 || sMapDepth + e < abs(posLProj.z)){
        visibility = 0.0;
      }
 
      // Light intensity
-     vec3 h = normalize((-view) + lightDir);
+     vec3 h = normalize((-view) + lightDir[iLight]);
      vec3 lightColor = vec3(1) * giIntensity;  //TODO: Replace with uniform
    
      // Account for local shading      
-     float diff = max(0.0, dot(lightDir, normalWS));
+     float diff = max(0.0, dot(lightDir[iLight], normalWS));
      float spec = pow(max(0.0, dot(normalWS, h)), specExponent);
      lightIntensity += visibility * (lightColor * diff + spec);
+    }
    }
    
 
@@ -152,4 +198,8 @@ void main(void)
    
    outColor = diffColor * vec4(lightIntensity, 1.0);
   }
+
+#ifdef CONE_TRACE_STATS
+  storeConeTraceStats();
+#endif
 }
\ No newline at end of file